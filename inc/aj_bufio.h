@@ -50,6 +50,21 @@ typedef AJ_Status (*AJ_TxFunc)(struct _AJ_IOBuffer* buf);
  */
 typedef AJ_Status (*AJ_RxFunc)(struct _AJ_IOBuffer* buf, uint32_t len, uint32_t timeout);
 
+/**
+ * Function pointer type for an abstracted scatter-gather transmit function. This sends any data in
+ * the buffer followed by a region of application data that is sent directly from where it is
+ * rather than being copied into the buffer.
+ *
+ * @param buf     The buffer holding data to be sent ahead of the application data
+ * @param data    The application data
+ * @param len     The number of bytes of application data
+ *
+ * @return
+ *         - AJ_OK if all the data was sent
+ *         - AJ_ERR_WRITE the send failed irrecoverably
+ */
+typedef AJ_Status (*AJ_TxVecFunc)(struct _AJ_IOBuffer* buf, const uint8_t* data, uint32_t len);
+
 #define AJ_IO_BUF_RX     1 /**< I/O direction is receive */
 #define AJ_IO_BUF_TX     2 /**< I/O direction is send */
 
@@ -69,7 +84,12 @@ typedef struct _AJ_IOBuffer {
         AJ_TxFunc send;
         AJ_RxFunc recv;
     };
+    AJ_TxVecFunc sendv; /**< Optional scatter-gather send function for Tx buffers */
     void* context;      /**< Abstracted context for managing I/O */
+    uint32_t syscalls;  /**< Number of system calls made by the transport for this buffer */
+    uint32_t messages;  /**< Number of messages sent or received through this buffer */
+    uint8_t* ringStart; /**< Start of the ring memory for a ring buffer, NULL for a linear buffer */
+    uint8_t pending;    /**< Set by the send function when it returns before all the data was written */
 
 } AJ_IOBuffer;
 
@@ -95,6 +115,7 @@ typedef struct _AJ_IOBuffer {
     do { \
         (iobuf)->readPtr = (iobuf)->bufStart; \
         (iobuf)->writePtr = (iobuf)->bufStart; \
+        (iobuf)->pending = FALSE; \
     } while (0)
 
 /**
@@ -109,7 +130,22 @@ typedef struct _AJ_IOBuffer {
 void AJ_IOBufInit(AJ_IOBuffer* ioBuf, uint8_t* buffer, uint32_t bufLen, uint8_t direction, void* context);
 
 /**
- * Move any unconsumed data to the start of the buffer.
+ * Initialize an I/O Buffer as a ring buffer. The ring memory must be mapped twice, the second
+ * mapping immediately following the first, so that data that wraps around the end of the ring can
+ * be accessed as contiguous bytes. The ring memory must be 8 byte aligned.
+ *
+ * @param ioBuf     The I/O buffer to initialize
+ * @param ring      The first of the two mappings of the ring memory
+ * @param ringLen   The size of the ring memory (not including the second mapping)
+ * @param direction Indicates if the buffer is being used for sending or receiving data
+ * @param context   Abstracted context for managing I/O
+ */
+void AJ_IOBufInitRing(AJ_IOBuffer* ioBuf, uint8_t* ring, uint32_t ringLen, uint8_t direction, void* context);
+
+/**
+ * Move any unconsumed data to the start of the buffer. For a ring buffer the start of the buffer is
+ * moved to the unconsumed data instead. The data is not moved unless the target defines
+ * AJ_STRICT_ALIGNMENT, then it is moved down by up to 7 bytes to keep it 8 byte aligned.
  *
  * @param ioBuf  An RX I/O buf that may contain unconsumed data
  */
@@ -22,6 +22,33 @@
 #include "aj_target.h"
 #include "aj_status.h"
 
+/**
+ * An AES-128 key prepared once and used for many messages. Targets that define
+ * AJ_AES_SCHEDULE_SIZE keep the expanded key schedule with the key so it is not expanded again for
+ * each message.
+ */
+typedef struct _AJ_KeySchedule {
+    uint8_t key[16];                                   /**< The raw key */
+#ifdef AJ_AES_SCHEDULE_SIZE
+    uint8_t schedule[AJ_AES_SCHEDULE_SIZE] __attribute__((aligned(16)));   /**< Target specific expanded key */
+#endif
+} AJ_KeySchedule;
+
+/**
+ * Prepare a key for use with AJ_Encrypt_CCM_Key() and AJ_Decrypt_CCM_Key()
+ *
+ * @param ks   The key schedule to initialize
+ * @param key  The 16 byte AES-128 key
+ */
+void AJ_AES_InitKey(AJ_KeySchedule* ks, const uint8_t* key);
+
+/**
+ * Wipe a key schedule so no trace of the key is left in memory
+ *
+ * @param ks   The key schedule to clear
+ */
+void AJ_AES_ClearKey(AJ_KeySchedule* ks);
+
 /**
  * Implements AES-CCM (Counter with CBC-MAC) encryption as described in RFC 3610. The message in
  * encrypted in place.
@@ -71,6 +98,28 @@ AJ_Status AJ_Decrypt_CCM(const uint8_t* key,
                          const uint8_t* nonce,
                          uint32_t nLen);
 
+/**
+ * AES-CCM encryption with a prepared key, see AJ_Encrypt_CCM()
+ */
+AJ_Status AJ_Encrypt_CCM_Key(const AJ_KeySchedule* ks,
+                             uint8_t* msg,
+                             uint32_t msgLen,
+                             uint32_t hdrLen,
+                             uint8_t tagLen,
+                             const uint8_t* nonce,
+                             uint32_t nLen);
+
+/**
+ * AES-CCM decryption with a prepared key, see AJ_Decrypt_CCM()
+ */
+AJ_Status AJ_Decrypt_CCM_Key(const AJ_KeySchedule* ks,
+                             uint8_t* msg,
+                             uint32_t msgLen,
+                             uint32_t hdrLen,
+                             uint8_t tagLen,
+                             const uint8_t* nonce,
+                             uint32_t nLen);
+
 /**
  * A pseudo-random function for generation of keying material. This function uses AES-CCM to
  * as the MAC function.
@@ -157,5 +206,97 @@ void AJ_AES_CBC_128_ENCRYPT(const uint8_t* key, const uint8_t* in, uint8_t* out,
  */
 void AJ_AES_ECB_128_ENCRYPT(const uint8_t* key, const uint8_t* in, uint8_t* out);
 
+#ifdef AJ_AES_SCHEDULE_SIZE
+/**
+ * Expand a key into the target specific schedule held by an AJ_KeySchedule. Called by
+ * AJ_AES_InitKey().
+ *
+ * @param key       The 16 byte AES-128 key
+ * @param schedule  Buffer of AJ_AES_SCHEDULE_SIZE bytes to receive the schedule
+ */
+void AJ_AES_ExpandKey(const uint8_t* key, uint8_t* schedule);
+
+/**
+ * Enable AES with an expanded key schedule instead of expanding a key as AJ_AES_Enable() does. The
+ * schedule must stay valid until AJ_AES_Disable() is called.
+ *
+ * @param schedule  A schedule filled in by AJ_AES_ExpandKey()
+ */
+void AJ_AES_EnableSchedule(const uint8_t* schedule);
+#endif
+
+#ifdef AJ_AES_CTR_CBC
+/**
+ * One pass of CCM over the message body: each block is added to the CBC-MAC and encrypted or
+ * decrypted in counter mode. The MAC is always computed over the plaintext with the final partial
+ * block padded with zeroes. Targets that define AJ_AES_CTR_CBC provide this so the two AES streams
+ * can be interleaved.
+ *
+ * @param key      The AES encryption key
+ * @param data     The data to encrypt or decrypt in place
+ * @param len      The length of the data, need not be a multiple of 16
+ * @param mac      Pointer to the 16 byte CBC-MAC chaining value, updated on return
+ * @param ctr      Pointer to a 16 byte counter block, updated on return
+ * @param encrypt  TRUE to encrypt, FALSE to decrypt
+ */
+void AJ_AES_CTR_CBC_128(const uint8_t* key, uint8_t* data, uint32_t len, uint8_t* mac, uint8_t* ctr, uint8_t encrypt);
+#endif
+
+#ifdef AJ_CCM_OFFLOAD
+/**
+ * Whole message AES-CCM by a crypto engine outside the process. Called by AJ_Encrypt_CCM_Key() and
+ * AJ_Decrypt_CCM_Key() on targets that define AJ_CCM_OFFLOAD, the arguments are the same.
+ *
+ * @param encrypt  TRUE to encrypt, FALSE to decrypt
+ *
+ * @return  Return AJ_Status
+ *          - AJ_OK if the message was encrypted or decrypted
+ *          - AJ_ERR_SECURITY if authentication failed, the message is cleared
+ *          - AJ_ERR_DISALLOWED if the engine did not take the message, it is unchanged and
+ *            must be processed in software
+ *          - AJ_ERR_FAILURE if the engine failed part way through encryption
+ */
+AJ_Status AJ_CCM_Offload(const AJ_KeySchedule* ks,
+                         uint8_t* msg,
+                         uint32_t msgLen,
+                         uint32_t hdrLen,
+                         uint8_t tagLen,
+                         const uint8_t* nonce,
+                         uint32_t nLen,
+                         uint8_t encrypt);
+
+/**
+ * Remove a key from the crypto engine. Called by AJ_AES_ClearKey().
+ *
+ * @param key  The 16 byte key
+ */
+void AJ_CCM_ReleaseKey(const uint8_t* key);
+#endif
+
+#if AJ_AES_AF_ALG
+/**
+ * Set the message length from which AES-CCM is done by the kernel crypto API instead of in
+ * process. Intended for testing and benchmarking.
+ *
+ * @param minLen  Messages of at least this many bytes are offloaded, 0xFFFFFFFF to offload none
+ *
+ * @return  TRUE if the kernel provides ccm(aes)
+ */
+uint8_t AJ_CCM_SetOffloadThreshold(uint32_t minLen);
+#endif
+
+#if AJ_AES_HW
+/**
+ * Choose whether AES uses the CPU's AES instructions or the software implementation. The
+ * instructions are used by default when the CPU has them. This takes effect from the next call to
+ * AJ_AES_Enable() and is intended for testing and benchmarking.
+ *
+ * @param enable  TRUE to use the AES instructions if the CPU has them
+ *
+ * @return  TRUE if the AES instructions will be used
+ */
+uint8_t AJ_AES_UseHardware(uint8_t enable);
+#endif
+
 
 #endif
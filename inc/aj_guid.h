@@ -21,6 +21,7 @@
 
 #include "aj_target.h"
 #include "aj_status.h"
+#include "aj_crypto.h"
 
 /**
  * Type for a GUID
@@ -143,4 +144,30 @@ AJ_Status AJ_GetSessionKey(const char* name, uint8_t* key, uint8_t* role);
  */
 AJ_Status AJ_GetGroupKey(const char* name, uint8_t* key);
 
+/**
+ * Gets the prepared session key for an entry from the GUID map. The key schedule was expanded when
+ * the key was set and remains valid until the entry is deleted.
+ *
+ * @param name  The unique or well-known name for a remote peer
+ * @param ks    Returns a pointer to the session key schedule
+ * @param role  Indicates which peer initiated the session key
+ *
+ * @return  Return AJ_Status
+ *          - AJ_OK if the key was obtained
+ *          - AJ_ERR_NO_MATCH if there is no entry to the peer
+ */
+AJ_Status AJ_GetSessionKeySchedule(const char* name, const AJ_KeySchedule** ks, uint8_t* role);
+
+/**
+ * Gets the prepared group key for an entry from the GUID map
+ *
+ * @param name  The unique or well-known name for a remote peer or NULL to get the local group key.
+ * @param ks    Returns a pointer to the group key schedule
+ *
+ * @return  Return AJ_Status
+ *          - AJ_OK if the key was obtained
+ *          - AJ_ERR_NO_MATCH if there is no entry to the peer
+ */
+AJ_Status AJ_GetGroupKeySchedule(const char* name, const AJ_KeySchedule** ks);
+
 #endif
@@ -39,6 +39,8 @@
  *
  * @return  Return AJ_Status
  *          - AJ_OK if the message was correctly decoded (and a reply sent in the case of a method call)
+ *          - AJ_ERR_DEFERRED if the handler saved a reply token with AJ_SaveReplyToken() and will
+ *            reply to the method call later. Not supported for handlers run on worker threads.
  *          - An error status if something went wrong decoding the message
  */
 typedef AJ_Status (*MessageHandler)(AJ_Message* msg, AJ_Message* reply);
@@ -54,12 +56,19 @@ typedef AJ_Status (*MessageHandler)(AJ_Message* msg, AJ_Message* reply);
  */
 typedef uint8_t (*AcceptSessionHandler)(AJ_Message* msg);
 
+/*
+ * Flags for a message handler entry
+ */
+#define AJ_HANDLER_WORKER   0x01   /**< Method calls can be handled on a worker thread, see AJ_StartWorkers() */
+#define AJ_HANDLER_ORDERED  0x02   /**< Method calls in the same session are handled one at a time in the order received */
+
 /**
  *  Type to describe a mapping of message id to message handler.
  */
 typedef struct {
     uint32_t msgid;
     MessageHandler handler;
+    uint8_t flags;          /**< AJ_HANDLER_WORKER and AJ_HANDLER_ORDERED flags */
 } MessageHandlerEntry;
 
 /**
@@ -103,6 +112,191 @@ typedef struct {
  */
 AJ_Status AJ_RunAllJoynService(AJ_BusAttachment* bus, AllJoynConfiguration* config);
 
+#if AJ_NET_EPOLL
+/**
+ * Callback function prototype for AJ_ServiceBuses()
+ *
+ * @param bus       The bus attachment the message was received on
+ * @param msg       The message received or NULL if the connection failed
+ * @param status    AJ_OK if a message was received otherwise the reason the connection failed. The
+ *                  application should disconnect the bus attachment.
+ */
+typedef void (*AJ_BusMessageHandler)(AJ_BusAttachment* bus, AJ_Message* msg, AJ_Status status);
+
+/**
+ * Services all connected bus attachments from one thread. Waits until some bus attachments have
+ * messages, a timer is due or a method call times out, then calls the handler for each message
+ * received. Replies to asynchronous method calls, and the errors for calls that timed out, are passed
+ * to their callbacks instead. Messages are closed after the handler returns. This is one iteration of
+ * the application's message loop.
+ *
+ * @param handler   Called for each message received and for each connection that fails
+ * @param timeout   The longest time to wait for a message
+ *
+ * @return  AJ_OK if any bus attachments were serviced, AJ_ERR_TIMEOUT otherwise
+ */
+AJ_Status AJ_ServiceBuses(AJ_BusMessageHandler handler, uint32_t timeout);
+#endif
+
+#if AJ_WORKER_POOL
+/**
+ * Start a pool of worker threads to run method handlers that have the AJ_HANDLER_WORKER flag. This
+ * must be called from the thread running the message loop after the objects have been registered,
+ * the worker threads register the same objects. The message loop thread keeps ownership of the bus
+ * connections: method calls are copied to the workers and the replies are sent by the message loop
+ * on the bus each call was received on. Each message loop thread has its own pool, method calls
+ * dispatched on a thread that has not started workers are handled on that thread.
+ *
+ * Handlers running on a worker can only use the method call and reply messages they are passed.
+ * Method calls with the AJ_HANDLER_ORDERED flag are handled one at a time for each session so the
+ * replies are sent in the same order as the calls were received. Encrypted method calls, and method
+ * calls with a body that is too big for the receive buffer, are handled on the message loop thread.
+ *
+ * @param numWorkers  The number of worker threads
+ *
+ * @return  AJ_OK if the workers were started
+ */
+AJ_Status AJ_StartWorkers(uint32_t numWorkers);
+
+/**
+ * Stop the worker threads. Replies that have not been sent yet are discarded.
+ */
+void AJ_StopWorkers(void);
+
+/**
+ * Get the number of worker threads that are running
+ */
+uint32_t AJ_GetNumWorkers(void);
+
+/**
+ * Pass a method call to the worker threads. This is called by AJ_DispatchMessage().
+ *
+ * @param msg       The method call
+ * @param handler   The handler to call on the worker thread
+ * @param flags     The handler flags
+ *
+ * @return  AJ_OK if the method call was queued, any other status means it must be handled by the
+ *          caller
+ */
+AJ_Status AJ_QueueMethodCall(AJ_Message* msg, MessageHandler handler, uint8_t flags);
+
+/**
+ * Send the replies for method calls the workers have handled. An application message loop should
+ * call this each time AJ_Net_Poll() returns, AJ_RunAllJoynService() and AJ_ServiceBuses() do this.
+ *
+ * @param bus       Send the replies to calls received on this bus or NULL to send all the replies.
+ *                  Replies for other buses are kept until this is called for their bus.
+ *
+ * @return  AJ_OK or the first error status returned by a handler or by sending a reply
+ */
+AJ_Status AJ_DeliverCompletedCalls(AJ_BusAttachment* bus);
+#endif
+
+#if AJ_TX_QUEUE
+/**
+ * Let other threads send messages on a bus connection. This must be called from the thread running
+ * the message loop after the objects have been registered. Producer threads marshal messages into
+ * their own buffers and queue them without locking or waiting on the socket, the message loop
+ * sends everything queued in one batch each time AJ_SendQueued() is called.
+ *
+ * @param bus  The bus attachment owned by the calling thread
+ *
+ * @return
+ *          - AJ_OK if the queue was enabled
+ *          - AJ_ERR_UNEXPECTED if the bus already has a queue
+ *          - AJ_ERR_RESOURCES if too many queues are enabled
+ */
+AJ_Status AJ_EnableTxQueue(AJ_BusAttachment* bus);
+
+/**
+ * Send anything still queued and disable the queue. This must be called from the message loop
+ * thread before the bus is disconnected.
+ *
+ * @param bus  The bus attachment
+ *
+ * @return
+ *          - AJ_OK if the queue was disabled
+ *          - AJ_ERR_UNEXPECTED if the bus has no queue or producers are still attached to it
+ */
+AJ_Status AJ_DisableTxQueue(AJ_BusAttachment* bus);
+
+/**
+ * Get the number of transmit queues owned by the calling thread
+ */
+uint32_t AJ_GetNumTxQueues(void);
+
+/**
+ * Send the messages queued by producers. An application message loop should call this each time
+ * AJ_Net_Poll() returns, AJ_RunAllJoynService() and AJ_ServiceBuses() do this. Messages that could
+ * not be sent are discarded.
+ *
+ * @param bus  The bus attachment or NULL for every queue owned by the calling thread
+ *
+ * @return  AJ_OK or the status of the first send that failed
+ */
+AJ_Status AJ_SendQueued(AJ_BusAttachment* bus);
+
+/**
+ * Set up a bus attachment for the calling thread that sends through the transmit queue of a bus.
+ * The producer is used with AJ_MarshalSignal() and AJ_DeliverMsg() like the bus itself, it has the
+ * same unique name and objects. Producers cannot receive messages, make method calls that expect a
+ * reply, or send encrypted messages or messages bigger than AJ_TX_FRAME_SIZE. AJ_DeliverMsg() only
+ * waits if all of the producer's buffers are still queued.
+ *
+ * @param bus       The bus attachment with a transmit queue
+ * @param producer  Returns the bus attachment for the calling thread
+ *
+ * @return
+ *          - AJ_OK if the producer was started
+ *          - AJ_ERR_UNEXPECTED if the bus has no queue
+ *          - AJ_ERR_RESOURCES if the buffers could not be allocated
+ */
+AJ_Status AJ_StartProducer(AJ_BusAttachment* bus, AJ_BusAttachment* producer);
+
+/**
+ * Detach a producer from its transmit queue. Messages it has queued are still sent.
+ *
+ * @param producer  The bus attachment set up by AJ_StartProducer()
+ */
+void AJ_StopProducer(AJ_BusAttachment* producer);
+#endif
+
+/**
+ * Dispatch a message to the application's message or property handler, passing any message that
+ * has no handler to the built-in bus message handler. The handlers are compiled into a hash table
+ * keyed by message id the first time a set of handler lists is used. This is called by
+ * AJ_RunAllJoynService() and can also be called from an application's own message loop.
+ *
+ * @param msg       The message received
+ * @param config    The AllJoyn configuration object holding the handlers
+ *
+ * @return  The status returned by the handler
+ */
+AJ_Status AJ_DispatchMessage(AJ_Message* msg, const AllJoynConfiguration* config);
+
+/**
+ * Pass the reply to an asynchronous method call to the callback registered by
+ * AJ_MarshalMethodCallAsync(). This is called by AJ_DispatchMessage(), an application that runs its
+ * own message loop without AJ_DispatchMessage() should call this for each message it receives.
+ *
+ * @param msg   The message received
+ *
+ * @return  AJ_OK if the message was passed to a callback, AJ_ERR_NO_MATCH if it has no callback
+ */
+AJ_Status AJ_DispatchReply(AJ_Message* msg);
+
+/**
+ * Get the number of messages passed to AJ_DispatchMessage() that did not have an application
+ * handler and were passed to AJ_BusHandleBusMessage().
+ *
+ * @param msgId     The message id to get the count for or AJ_INVALID_MSG_ID for the total
+ *
+ * @return  The number of unhandled messages. Counts are kept per message id, saturating at 0xFFFF,
+ *          while there is space in the dispatch table (AJ_DISPATCH_TABLE_SIZE) and are reset
+ *          when the table is rebuilt.
+ */
+uint32_t AJ_GetUnhandledCount(uint32_t msgId);
+
 /**
  * Callback function prototype for a timer function callback
  *
@@ -119,17 +313,33 @@ typedef void (*TimeoutHandler)(void* context);
  * @param repeat        If nonzero, repeat this timer every <repeat> msec
  *
  * @return The id of the new timer, which can be used to cancel it later
- *          0 if timer was not set.
+ *          0 if timer was not set because all AJ_MAX_TIMERS timers are in use.
  */
 uint32_t AJ_SetTimer(uint32_t relative_time, TimeoutHandler handler, void* context, uint32_t repeat);
 
 /**
- *  Cancel the timer specified
+ *  Cancel the timer specified. Cancelling a timer that has already fired or been cancelled has no
+ *  effect.
  *
  * @param id    The id of the timer to cancel (returned by AJ_SetTimer)
  */
 void AJ_CancelTimer(uint32_t id);
 
+/**
+ *  Run the handlers for all timers that have expired. Applications that do not use
+ *  AJ_RunAllJoynService() should call this from their message loop.
+ */
+void AJ_RunExpiredTimers(void);
+
+/**
+ *  Get the time until the next timer is due
+ *
+ * @return  The number of milliseconds until the next timer is due, 0 if a timer is overdue or
+ *          (uint32_t)-1 if there are no timers running. This can be passed directly as the timeout
+ *          to AJ_UnmarshalMsg().
+ */
+uint32_t AJ_GetNextTimeout(void);
+
 
 /**
  * Helper function that connects to a bus initializes an AllJoyn service.
@@ -24,6 +24,12 @@
 /**
  * Initialization for AllJoyn. This function should be called before calling any
  * other AllJoyn APIs.
+ *
+ * On targets where AJ_THREAD_LOCAL is not empty the runtime state (registered objects, timers, reply
+ * contexts, authentication state and the transport) belongs to the thread that uses it. Call this
+ * once before starting any threads, then each thread registers its own objects and runs its own
+ * bus attachments with no locking. The NVRAM credential store is shared by all threads and is not
+ * locked.
  */
 void AJ_Initialize(void);
 
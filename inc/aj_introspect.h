@@ -148,11 +148,32 @@ typedef struct _AJ_Object {
  * objects that have methods that this object can call and signals
  * that remote objects emit that this application can receive.
  *
+ * The object lists are indexed by object path when they are registered so identifying a received
+ * message does not have to search the lists. If an object path or the AJ_OBJ_FLAG_SECURE flag is
+ * changed after the objects are registered (other than with AJ_SetProxyObjectPath()) the objects
+ * must be registered again. Registered objects are per thread, see AJ_Initialize().
+ *
  * @param localObjects  A NULL terminated array of object info structs.
  * @param proxyObjects  A NULL terminated array of object info structs.
  */
 void AJ_RegisterObjects(const AJ_Object* localObjects, const AJ_Object* proxyObjects);
 
+/**
+ * Get the objects registered by the calling thread
+ *
+ * @param localObjects  Returns the local objects passed to AJ_RegisterObjects()
+ * @param proxyObjects  Returns the proxy objects passed to AJ_RegisterObjects()
+ */
+void AJ_GetRegisteredObjects(const AJ_Object** localObjects, const AJ_Object** proxyObjects);
+
+/**
+ * Received messages are identified using an index of the registered objects. The index is enabled
+ * by default, disabling it is mainly useful for testing and benchmarking.
+ *
+ * @param enable  TRUE to enable the object index, FALSE to search the object lists linearly
+ */
+void AJ_EnableObjectIndex(uint8_t enable);
+
 /**
  * This function checks that a message ifrom a remote peer is valid and correct and returns the
  * message id for that message.
@@ -201,6 +222,16 @@ AJ_Status AJ_UnmarshalPropertyArgs(AJ_Message* msg, uint32_t* propId, char* sig,
  */
 AJ_Status AJ_MarshalPropertyArgs(AJ_Message* msg, uint32_t propId);
 
+/**
+ * Supply a buffer for caching the introspection XML generated for each object. Once an object has
+ * been introspected subsequent requests are served from the cache. The cache is flushed when the
+ * objects are registered or if the flags of a cached object change.
+ *
+ * @param buffer     A buffer for the cache or NULL to disable caching
+ * @param bufLen     The size of the buffer
+ */
+void AJ_SetIntrospectionCache(uint8_t* buffer, uint32_t bufLen);
+
 /**
  * Handle an introspection request
  *
@@ -238,10 +269,17 @@ AJ_Status AJ_InitMessageFromMsgId(AJ_Message* msg, uint32_t msgId, uint8_t msgTy
  */
 AJ_Status AJ_SetProxyObjectPath(AJ_Object* proxyObjects, uint32_t msgId, const char* objPath);
 
+/*
+ * Maximum number of method calls that can be waiting for a reply
+ */
+#ifndef AJ_NUM_REPLY_CONTEXTS
+#define AJ_NUM_REPLY_CONTEXTS   16
+#endif
+
 /**
  * Internal function to allocate a reply context for a method call message. Reply contexts are used
- * to associate method replies with method calls. Depending on avaiable system resources the number
- * of reply contexts may be very limited, in some cases only one reply context.
+ * to associate method replies with method calls. The number of reply contexts is set at compile time
+ * by AJ_NUM_REPLY_CONTEXTS, on constrained systems this may be as few as one reply context.
  *
  * @param msg      A method call message that needs a reply context
  * @param timeout  The time to wait for a reply  (0 to use the internal default)
@@ -253,21 +291,58 @@ AJ_Status AJ_SetProxyObjectPath(AJ_Object* proxyObjects, uint32_t msgId, const c
 AJ_Status AJ_AllocReplyContext(AJ_Message* msg, uint32_t timeout);
 
 /**
- * Internal function to release all reply contexts. Called when disconnecting from the bus.
+ * Internal function to allocate a reply context for a method call message that has a reply
+ * callback, see AJ_MarshalMethodCallAsync().
+ *
+ * @param msg       A method call message that needs a reply context
+ * @param timeout   The time to wait for a reply  (0 to use the internal default)
+ * @param callback  Function to call with the reply or NULL
+ * @param context   Context pointer for the callback
+ *
+ * @return   Return AJ_Status
+ *         - AJ_OK if the reply context was allocated
+ *         - AJ_ERR_RESOURCES if the reply context could not be allocated
  */
-void AJ_ReleaseReplyContexts(void);
+AJ_Status AJ_AllocAsyncReplyContext(AJ_Message* msg, uint32_t timeout, AJ_ReplyCallback callback, void* context);
+
+/**
+ * Internal function to release the reply contexts for a bus. Called when disconnecting from the
+ * bus. The callbacks for asynchronous method calls that are still waiting for a reply are called
+ * with a NULL reply.
+ *
+ * @param bus  The bus to release the reply contexts for or NULL to release them for all buses
+ */
+void AJ_ReleaseReplyContexts(AJ_BusAttachment* bus);
 
 /**
  * Internal function to check for timed out method calls. Returns TRUE and sets some information in
  * the message struct to identify the timed-out call if there was one. This function is called by
  * AJ_UnmarshalMessage() when there are no messages to unmarshal.
  *
- * @param msg  A message structure to initialize if there was a timed-out method call.
+ * @param msg  A message structure to initialize if there was a timed-out method call. Only calls
+ *             sent on msg->bus are checked.
  *
  * @return  Returns TRUE if there was a timed-out method call, FALSE otherwise.
  */
 uint8_t AJ_TimedOutMethodCall(AJ_Message* msg);
 
+/**
+ * Internal function to find a bus that has a timed out method call, see AJ_ServiceBuses().
+ *
+ * @return  The bus the earliest timed out method call was sent on or NULL if no calls have timed out
+ */
+AJ_BusAttachment* AJ_TimedOutBus(void);
+
+/**
+ * Internal function to limit a receive timeout so that it expires no later than the earliest
+ * outstanding method call on any bus times out.
+ *
+ * @param timeout  The receive timeout requested by the application
+ *
+ * @return  Returns the timeout to use for the receive
+ */
+uint32_t AJ_ReplyTimeout(uint32_t timeout);
+
 /**
  * Internal function called to release a reply context in the case that a message could not be marshaled.
  *
@@ -147,6 +147,16 @@ typedef struct _AJ_MsgHeader {
     uint32_t headerLen;    /**< Length of the header data */
 } AJ_MsgHeader;
 
+/**
+ * Callback function prototype for the reply to an asynchronous method call
+ *
+ * @param reply    The method reply, an error reply (including a timeout error generated locally if
+ *                 no reply was received in time) or NULL if the bus was disconnected before the
+ *                 reply was received. The reply is closed after the callback returns.
+ * @param context  The context pointer passed in to AJ_MarshalMethodCallAsync()
+ */
+typedef void (*AJ_ReplyCallback)(AJ_Message* reply, void* context);
+
 /**
  * AllJoyn Message
  */
@@ -176,6 +186,8 @@ struct _AJ_Message {
     uint16_t bodyBytes;        /**< Running count of the number body bytes written */
     AJ_BusAttachment* bus;     /**< Bus attachment for this message */
     struct _AJ_Arg* outer;     /**< Container arg current being marshaled */
+    AJ_ReplyCallback callback; /**< For a reply, the callback registered with the method call */
+    void* callbackContext;     /**< Context pointer for the callback */
 
 };
 
@@ -196,6 +208,47 @@ struct _AJ_Message {
  */
 AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeout);
 
+/*
+ * Flags returned by AJ_GetIOInterest()
+ */
+#define AJ_IO_WANT_READ   0x01  /**< Call AJ_ProcessReady() when the bus socket is readable */
+#define AJ_IO_WANT_WRITE  0x02  /**< Call AJ_ProcessReady() when the bus socket is writable */
+#define AJ_IO_PENDING     0x04  /**< A message is already buffered, call AJ_ProcessReady() now */
+
+/**
+ * Non-blocking version of AJ_UnmarshalMsg() for applications that run their own event loop. Reads
+ * whatever data is available on the bus socket and returns AJ_ERR_WOULD_BLOCK if a complete message
+ * has not arrived yet. Partially received messages are kept in the receive buffer and parsing
+ * resumes on the next call. The message header and body are both received before the message is
+ * returned unless the body is too big for the receive buffer, in which case the body is loaded as it
+ * is unmarshaled.
+ *
+ * The application should wait on the socket returned by AJ_Net_GetFd() for the events requested by
+ * AJ_GetIOInterest() with a timeout no longer than AJ_ReplyTimeout() so that method call timeouts
+ * are reported.
+ *
+ * @param bus     The bus attachment
+ * @param msg     Pointer to a structure to receive the unmarshalled message
+ *
+ * @return
+ *          - AJ_OK if a message was unmarshaled, the message must be closed with AJ_CloseMsg()
+ *          - AJ_ERR_WOULD_BLOCK if a complete message is not available yet
+ *          - AJ_ERR_UNMARSHAL if the message was badly formed
+ *          - AJ_ERR_RESOURCES if the message header is too big to unmarshal into the attached buffer
+ *          - AJ_ERR_READ if there was a read failure
+ *          - AJ_ERR_WRITE if pending data could not be sent
+ */
+AJ_Status AJ_ProcessReady(AJ_BusAttachment* bus, AJ_Message* msg);
+
+/**
+ * Reports which bus socket events AJ_ProcessReady() is waiting for.
+ *
+ * @param bus     The bus attachment
+ *
+ * @return  A combination of AJ_IO_WANT_READ, AJ_IO_WANT_WRITE and AJ_IO_PENDING
+ */
+uint8_t AJ_GetIOInterest(AJ_BusAttachment* bus);
+
 /**
  * Unmarshals the next argument from a message.
  *
@@ -225,6 +278,24 @@ AJ_Status AJ_UnmarshalArg(AJ_Message* msg, AJ_Arg* arg);
  */
 AJ_Status AJ_UnmarshalArgs(AJ_Message* msg, const char* signature, ...);
 
+/**
+ * Unmarshals an array of fixed size scalars, for example an array with signature "ai" or "at". The
+ * elements are converted to host byte order in place and the entire array is returned as a single
+ * pointer into the receive buffer. The array must fit in the receive buffer.
+ *
+ * @param msg     A pointer to a message that was unmarshaled by an earlier call to AJ_UnmarshalMsg
+ * @param typeId  The type of the array elements
+ * @param data    Returns a pointer to the array elements
+ * @param count   Returns the number of elements in the array
+ *
+ * @return
+ *          - AJ_OK if the array was unmarshaled
+ *          - AJ_ERR_UNEXPECTED if typeId is not a fixed size scalar type
+ *          - AJ_ERR_UNMARSHAL if the next argument is not an array of typeId
+ *          - AJ_ERR_RESOURCES if the array doesn't fit in the receive buffer
+ */
+AJ_Status AJ_UnmarshalScalarArray(AJ_Message* msg, uint8_t typeId, const void** data, size_t* count);
+
 /**
  * Unmarshals data from a message as raw bytes.
  *
@@ -295,6 +366,20 @@ AJ_Status AJ_CloseMsg(AJ_Message* msg);
  */
 typedef uint32_t AJ_SessionId;
 
+/**
+ * The parts of a method call needed to reply to it later. A handler saves a reply token with
+ * AJ_SaveReplyToken() so the call message can be closed and the reply marshaled after the slow
+ * operation completes.
+ */
+typedef struct _AJ_ReplyToken {
+    AJ_BusAttachment* bus;   /**< Bus attachment the method call was received on */
+    uint32_t msgId;          /**< Message id of the method call */
+    uint32_t serialNum;      /**< Serial number of the method call */
+    AJ_SessionId sessionId;  /**< Session the method call was received on */
+    uint8_t flags;           /**< Header flags of the method call */
+    char sender[16];         /**< Unique name of the caller */
+} AJ_ReplyToken;
+
 /**
  * Marshal a METHOD_CALL message.
  *
@@ -314,6 +399,33 @@ typedef uint32_t AJ_SessionId;
  */
 AJ_Status AJ_MarshalMethodCall(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t msgId, const char* destination, AJ_SessionId sessionId, uint8_t flags, uint32_t timeout);
 
+/**
+ * Marshal a METHOD_CALL message that has its reply passed to a callback. The callback is registered
+ * with the reply context for the call and is called by AJ_DispatchMessage() when the reply, an error
+ * or a timeout is received, so many calls can be in flight without the application matching replies
+ * to calls. The number of calls in flight is limited by AJ_NUM_REPLY_CONTEXTS.
+ *
+ * @param bus          The bus attachment
+ * @param msg          Pointer to a message structure
+ * @param msgId        The message identifier for this message
+ * @param destination  Bus address of the destination for this message
+ * @param sessionId    The session this message is for.
+ * @param flags        A logical OR of the applicable message flags
+ * @param timeout      Time in milliseconds to allow for a reply to the message before the callback
+ *                     is called with a timeout error.
+ * @param callback     The function to call with the reply, this is never called if the
+ *                     AJ_FLAG_NO_REPLY_EXPECTED flag is set
+ * @param context      A context pointer passed to the callback
+ *
+ * @return
+ *          - AJ_OK if a message header was succesfully marshaled
+ *          - AJ_ERR_RESOURCES if the message is too big to marshal into the message buffer or
+ *            there are too many calls in flight
+ *          - AJ_ERR_WRITE if there was a write failure
+ */
+AJ_Status AJ_MarshalMethodCallAsync(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t msgId, const char* destination, AJ_SessionId sessionId,
+                                    uint8_t flags, uint32_t timeout, AJ_ReplyCallback callback, void* context);
+
 /**
  * Marshal a SIGNAL message.
  *
@@ -368,6 +480,44 @@ AJ_Status AJ_MarshalErrorMsg(const AJ_Message* methodCall, AJ_Message* reply, co
  */
 AJ_Status AJ_MarshalStatusMsg(const AJ_Message* methodCall, AJ_Message* reply, AJ_Status status);
 
+/**
+ * Save what is needed to reply to a method call after the call message has been closed. A method
+ * handler that cannot reply straight away saves a reply token and returns AJ_ERR_DEFERRED so
+ * AJ_DispatchMessage() does not send a reply.
+ *
+ * @param methodCall  The method call message that was received
+ * @param token       Returns the reply token
+ *
+ * @return   Return AJ_Status
+ *         - AJ_OK if the token was saved
+ *         - AJ_ERR_NULL if the method call has no sender to reply to
+ *         - AJ_ERR_RESOURCES if the sender name is too long for the token
+ */
+AJ_Status AJ_SaveReplyToken(const AJ_Message* methodCall, AJ_ReplyToken* token);
+
+/**
+ * Initialize and marshal a reply to a method call that was saved as a reply token. The token must
+ * not be changed until the reply has been delivered.
+ *
+ * @param token  The reply token for the method call
+ * @param reply  The reply to be initialized
+ *
+ * @return   Return AJ_Status
+ */
+AJ_Status AJ_MarshalDeferredReply(const AJ_ReplyToken* token, AJ_Message* reply);
+
+/**
+ * Initialize and marshal an error response to a method call that was saved as a reply token. The
+ * token must not be changed until the reply has been delivered.
+ *
+ * @param token  The reply token for the method call
+ * @param reply  The reply to be initialized
+ * @param error  The error name to use in the response.
+ *
+ * @return   Return AJ_Status
+ */
+AJ_Status AJ_MarshalDeferredError(const AJ_ReplyToken* token, AJ_Message* reply, const char* error);
+
 /**
  * Delivers a marshalled message to the network.
  *
@@ -413,6 +563,32 @@ AJ_Status AJ_DeliverMsgPartial(AJ_Message* msg, uint32_t bytesRemaining);
  */
 AJ_Status AJ_MarshalArgs(AJ_Message* msg, const char* signature, ...);
 
+/**
+ * AJ_MarshalArgs() and AJ_UnmarshalArgs() compile signatures into plans that are cached so repeated
+ * calls with the same signature skip the per-argument signature checks. Plans are enabled by
+ * default, disabling them is mainly useful for testing and benchmarking.
+ *
+ * @param enable  TRUE to enable signature plans, FALSE to disable them
+ */
+void AJ_EnableSignaturePlans(uint8_t enable);
+
+/**
+ * Headers for signals and method calls are cached as templates so sending the same message id
+ * again with the same destination, session id, flags and time-to-live only has to copy the header
+ * and patch the serial number and timestamp. Templates are enabled by default, disabling them is
+ * mainly useful for testing and benchmarking.
+ *
+ * @param enable  TRUE to enable header templates, FALSE to disable them
+ */
+void AJ_EnableHeaderTemplates(uint8_t enable);
+
+/**
+ * Discard all cached header templates. This must be called if anything that goes into a message
+ * header changes, this is done internally when the object lists are registered, when a proxy
+ * object path is set, and when the bus is connected or disconnected.
+ */
+void AJ_InvalidateHeaderTemplates(void);
+
 /**
  * Initializes a non-container argument of any of the following types:
  *
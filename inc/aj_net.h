@@ -60,6 +60,95 @@ AJ_Status AJ_Net_Connect(AJ_NetSocket* netSock, uint16_t port, uint8_t addrType,
  */
 void AJ_Net_Disconnect(AJ_NetSocket* netSock);
 
+/**
+ * Get the file descriptor of the bus connection so it can be added to an application event loop
+ *
+ * @return        The socket file descriptor or -1 if the target does not have one
+ */
+int AJ_Net_GetFd(AJ_NetSocket* netSock);
+
+#ifdef AJ_RX_RING_SIZE
+/**
+ * Map memory for a receive ring buffer, see AJ_IOBufInitRing(). The same memory is mapped twice
+ * back to back so data that wraps around the end of the ring can still be accessed as contiguous
+ * bytes.
+ *
+ * @param size    The size of the ring, a multiple of the page size
+ *
+ * @return        The first of the two mappings or NULL if the ring cannot be mapped
+ */
+uint8_t* AJ_Net_MapRing(uint32_t size);
+
+/**
+ * Unmap a ring returned by AJ_Net_MapRing()
+ *
+ * @param ring    The ring to unmap, may be NULL
+ * @param size    The size the ring was mapped with
+ */
+void AJ_Net_UnmapRing(uint8_t* ring, uint32_t size);
+#endif
+
+#if AJ_NET_EPOLL
+/**
+ * Wait for bus connections to have data to read. This is how one thread services many bus
+ * attachments, see AJ_ServiceBuses().
+ *
+ * @param ready   Array to receive the bus connection sockets that are ready
+ * @param max     The size of the array, any other ready sockets are returned by the next call
+ * @param timeout How long to wait if no sockets are ready
+ *
+ * @return        The number of sockets returned, zero if the wait timed out
+ */
+uint32_t AJ_Net_Poll(AJ_NetSocket** ready, uint32_t max, uint32_t timeout);
+
+/**
+ * Add a file descriptor owned by the application to the calling thread's wait set. AJ_Net_Poll()
+ * returns early when it becomes readable so another thread can wake up the bus thread. The watched
+ * file descriptor is never read by the transport.
+ *
+ * @param fd      The file descriptor to watch
+ *
+ * @return        AJ_OK or AJ_ERR_RESOURCES if the file descriptor could not be watched
+ */
+AJ_Status AJ_Net_Watch(int fd);
+
+/**
+ * Remove a file descriptor added by AJ_Net_Watch() from the calling thread's wait set
+ *
+ * @param fd      The file descriptor to stop watching
+ */
+void AJ_Net_Unwatch(int fd);
+
+/**
+ * Every bus attachment has its own socket so a process with many bus attachments can run out of
+ * file descriptors. This raises the soft limit on open files for the whole process to the hard
+ * limit. It is never done implicitly, call it before connecting if the process needs it.
+ *
+ * @return        The soft limit on open files after the call, 0 if it could not be read
+ */
+uint32_t AJ_Net_RaiseFileLimit(void);
+
+/**
+ * Maximum number of frames passed to one call to AJ_Net_SendFrames()
+ */
+#ifndef AJ_NET_MAX_FRAMES
+#define AJ_NET_MAX_FRAMES 64
+#endif
+
+/**
+ * Send any data in a transmit buffer followed by a list of complete messages marshaled elsewhere,
+ * batched into as few system calls as possible. Waits for the socket if it is full.
+ *
+ * @param txBuf   The transmit buffer of the bus connection
+ * @param frames  The messages to send
+ * @param lens    The length of each message
+ * @param num     The number of messages, no more than AJ_NET_MAX_FRAMES
+ *
+ * @return        AJ_OK if everything was sent, AJ_ERR_WRITE if the connection failed
+ */
+AJ_Status AJ_Net_SendFrames(AJ_IOBuffer* txBuf, uint8_t* const* frames, const uint32_t* lens, uint32_t num);
+#endif
+
 /**
  * Enable multicast data (for discover and advertising)
  *
@@ -47,7 +47,9 @@ typedef enum {
     AJ_ERR_RESTART      = 20, /**< The OEM event loop must restart */
     AJ_ERR_LINK_TIMEOUT = 21, /**< The bus link is inactive too long */
     AJ_ERR_DRIVER       = 22, /**< An error communicating with a lower-layer driver */
-    AJ_ERR_OBJECT_PATH  = 23  /**< Object path was not specified */
+    AJ_ERR_OBJECT_PATH  = 23, /**< Object path was not specified */
+    AJ_ERR_WOULD_BLOCK  = 24, /**< The operation would block, retry when the socket is ready */
+    AJ_ERR_DEFERRED     = 25  /**< A method handler will send the reply later */
 
 } AJ_Status;
 
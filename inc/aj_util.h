@@ -124,6 +124,16 @@ AJ_Status AJ_RawToHex(const uint8_t* raw, size_t rawLen, char* hex, size_t hexLe
  */
 AJ_Status AJ_HexToRaw(const char* hex, size_t hexLen, uint8_t* raw, size_t rawLen);
 
+/**
+ * Reverses the byte order of each element in an array of 2, 4 or 8 byte scalars. The swap is done in
+ * place and uses vector instructions when the target has them.
+ *
+ * @param data  The array of scalars to swap
+ * @param size  The size in bytes of each scalar, arrays of 1 byte scalars are left unchanged
+ * @param num   The number of scalars in the array
+ */
+void AJ_SwapBytes(void* data, uint8_t size, uint32_t num);
+
 /**
  * get a line of input from the the file pointer (most likely stdin).
  * This will capture the the num-1 characters or till a newline character is
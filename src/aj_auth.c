@@ -71,12 +71,12 @@ typedef struct _PinAuthContext {
 /*
  * This is only 36 bytes - probably not worth malloc'ing
  */
-static PinAuthContext context;
+static AJ_THREAD_LOCAL PinAuthContext context;
 
 #ifndef NDEBUG
 static char* Hex(const uint8_t* buf, size_t len)
 {
-    static char hex[128];
+    static AJ_THREAD_LOCAL char hex[128];
     AJ_RawToHex(buf, len, hex, sizeof(hex));
     return hex;
 }
@@ -30,12 +30,51 @@ void AJ_IOBufInit(AJ_IOBuffer* ioBuf, uint8_t* buffer, uint32_t bufLen, uint8_t
     ioBuf->readPtr = buffer;
     ioBuf->writePtr = buffer;
     ioBuf->direction = direction;
+    ioBuf->sendv = NULL;
     ioBuf->context = context;
+    ioBuf->syscalls = 0;
+    ioBuf->messages = 0;
+    ioBuf->ringStart = NULL;
+    ioBuf->pending = FALSE;
+}
+
+void AJ_IOBufInitRing(AJ_IOBuffer* ioBuf, uint8_t* ring, uint32_t ringLen, uint8_t direction, void* context)
+{
+    AJ_IOBufInit(ioBuf, ring, ringLen, direction, context);
+    ioBuf->ringStart = ring;
 }
 
 void AJ_IOBufRebase(AJ_IOBuffer* ioBuf)
 {
     int32_t unconsumed = AJ_IO_BUF_AVAIL(ioBuf);
+
+    if (ioBuf->ringStart) {
+        /*
+         * The buffer start moves up to the unconsumed data. Because the ring is mapped twice the
+         * buffer can extend past the end of the first mapping, but once the start itself has moved
+         * into the second mapping all the pointers are moved back into the first.
+         */
+#if AJ_STRICT_ALIGNMENT
+        /*
+         * Messages are not padded to a multiple of 8 bytes so on CPUs that trap on unaligned loads
+         * the unconsumed data is moved down by the few bytes needed to align it.
+         */
+        ioBuf->bufStart = ioBuf->readPtr - ((size_t)ioBuf->readPtr & 7);
+        if (unconsumed && (ioBuf->bufStart != ioBuf->readPtr)) {
+            memmove(ioBuf->bufStart, ioBuf->readPtr, unconsumed);
+        }
+        ioBuf->readPtr = ioBuf->bufStart;
+        ioBuf->writePtr = ioBuf->bufStart + unconsumed;
+#else
+        ioBuf->bufStart = ioBuf->readPtr;
+#endif
+        if (ioBuf->bufStart >= (ioBuf->ringStart + ioBuf->bufSize)) {
+            ioBuf->bufStart -= ioBuf->bufSize;
+            ioBuf->readPtr -= ioBuf->bufSize;
+            ioBuf->writePtr -= ioBuf->bufSize;
+        }
+        return;
+    }
     /*
      * Move any unconsumed data to the start of the I/O buffer
      */
@@ -47,7 +47,7 @@ static uint32_t DefaultBusAuthPwdFunc(uint8_t* buffer, uint32_t bufLen)
     return (uint32_t)strlen(defaultPwd);
 }
 
-static BusAuthPwdFunc busAuthPwdFunc = DefaultBusAuthPwdFunc;
+static AJ_THREAD_LOCAL BusAuthPwdFunc busAuthPwdFunc = DefaultBusAuthPwdFunc;
 
 void SetBusAuthPwdCallback(BusAuthPwdFunc callback)
 {
@@ -209,6 +209,10 @@ AJ_Status AJ_Connect(AJ_BusAttachment* bus, const char* serviceName, uint32_t ti
                     } else {
                         memcpy(bus->uniqueName, arg.val.v_string, arg.len);
                         bus->uniqueName[arg.len] = '\0';
+                        /*
+                         * Cached message headers have the old unique name as the sender
+                         */
+                        AJ_InvalidateHeaderTemplates();
                     }
                 }
             }
@@ -230,7 +234,11 @@ void AJ_Disconnect(AJ_BusAttachment* bus)
     /*
      * We won't be getting any more method replies.
      */
-    AJ_ReleaseReplyContexts();
+    AJ_ReleaseReplyContexts(bus);
+    /*
+     * Cached message headers are not valid for the next connection
+     */
+    AJ_InvalidateHeaderTemplates();
     /*
      * Disconnect the network closing sockets etc.
      */
@@ -55,6 +55,7 @@ typedef struct _CCM_Context {
     AES_Block T;      /* authentication tag */
     AES_Block ivec0;  /* ivec for CBC MAC */
     AES_Block ivec;   /* ivec for CTR mode encrypt/decrypt */
+    AES_Block S_0;    /* key stream block for the authentication tag */
     union {
         AES_Block A;   /* Working data for CBC MAC */
         AES_Block B_0; /* Initial block for CBC MAC */
@@ -81,13 +82,13 @@ static void CBC_MAC(const uint8_t* key, const uint8_t* in, uint32_t len, CCM_Con
 }
 
 /**
- * Compute the AES-CCM authentication tag.
+ * Start the AES-CCM authentication tag with the B_0 block and the header data, these are
+ * authenticated but not encrypted.
  */
-static void Compute_CCM_AuthTag(const uint8_t* key,
-                                CCM_Context* context,
-                                const uint8_t* msg,
-                                uint32_t mLen,
-                                uint32_t hdrLen)
+static void CCM_MAC_Header(const uint8_t* key,
+                           CCM_Context* context,
+                           const uint8_t* msg,
+                           uint32_t hdrLen)
 {
     /*
      * Initialize CBC-MAC with B_0 initialization vector is 0.
@@ -123,145 +124,235 @@ static void Compute_CCM_AuthTag(const uint8_t* key,
          * Continue computing the CBC-MAC
          */
         CBC_MAC(key, msg, hdrLen, context);
-        msg += hdrLen;
     }
-    /*
-     * Continue computing CBC-MAC over the message data.
-     */
-    if (mLen) {
-        CBC_MAC(key, msg, mLen, context);
+}
+
+/**
+ * Continue the CBC-MAC over the message data while encrypting or decrypting it in a single pass, the
+ * MAC is over the plaintext. When done the CBC-MAC is the authentication tag.
+ */
+static void CCM_Payload(const uint8_t* key, CCM_Context* context, uint8_t* data, uint32_t len, uint8_t encrypt)
+{
+#ifdef AJ_AES_CTR_CBC
+    AJ_AES_CTR_CBC_128(key, data, len, context->ivec0.data, context->ivec.data, encrypt);
+#else
+    while (len) {
+        uint32_t n = min(len, BLOCKSZ);
+        if (!encrypt) {
+            AJ_AES_CTR_128(key, data, data, n, context->ivec.data);
+        }
+        ZERO(context->A);
+        memcpy(context->A.data, data, n);
+        AJ_AES_CBC_128_ENCRYPT(key, context->A.data, context->T.data, BLOCKSZ, context->ivec0.data);
+        if (encrypt) {
+            AJ_AES_CTR_128(key, data, data, n, context->ivec.data);
+        }
+        data += n;
+        len -= n;
     }
-    Trace("CBC-MAC", context->T.data, context->M);
+#endif
+    memcpy(context->T.data, context->ivec0.data, BLOCKSZ);
+    Trace("CBC-MAC", context->T.data, BLOCKSZ);
 }
 
-static CCM_Context* InitCCMContext(const uint8_t* nonce, uint32_t nLen, uint32_t hdrLen, uint32_t msgLen, uint8_t M)
+static void InitCCMContext(CCM_Context* context, const uint8_t* nonce, uint32_t nLen, uint32_t hdrLen, uint32_t msgLen, uint8_t M)
 {
     int i;
     int l;
     uint8_t L  = 15 - max(nLen, 11);
     uint8_t flags = ((hdrLen) ? 0x40 : 0) | (((M - 2) / 2) << 3) | (L - 1);
-    CCM_Context* context;
 
     AJ_ASSERT(nLen <= 15);
 
-    context = (CCM_Context*)AJ_Malloc(sizeof(CCM_Context));
-    if (context) {
-        memset(context, 0, sizeof(CCM_Context));
-        /*
-         * Set ivec and other initial args.
-         */
-        context->ivec.data[0] = L - 1;
-        memcpy(&context->ivec.data[1], nonce, nLen);
-        /*
-         * Compute the B_0 block. This encodes the flags, the nonce, and the message length.
-         */
-        context->B_0.data[0] = flags;
-        memcpy(&context->B_0.data[1], nonce, nLen);
-        for (i = 15, l = msgLen - hdrLen; l != 0; i--) {
-            context->B_0.data[i] = (uint8_t)l;
-            l >>= 8;
-        }
+    memset(context, 0, sizeof(CCM_Context));
+    /*
+     * Set ivec and other initial args.
+     */
+    context->ivec.data[0] = L - 1;
+    memcpy(&context->ivec.data[1], nonce, nLen);
+    /*
+     * Compute the B_0 block. This encodes the flags, the nonce, and the message length.
+     */
+    context->B_0.data[0] = flags;
+    memcpy(&context->B_0.data[1], nonce, nLen);
+    for (i = 15, l = msgLen - hdrLen; l != 0; i--) {
+        context->B_0.data[i] = (uint8_t)l;
+        l >>= 8;
+    }
+}
+
+/**
+ * The authentication tag is encrypted with the key stream for counter 0 and the message starts at
+ * counter 1.
+ */
+static void CCM_TagKeyStream(const uint8_t* key, CCM_Context* context)
+{
+    AJ_AES_ECB_128_ENCRYPT(key, context->ivec.data, context->S_0.data);
+    context->ivec.data[BLOCKSZ - 1] = 1;
+    Trace("CTR Start", context->ivec.data, BLOCKSZ);
+}
+
+void AJ_AES_InitKey(AJ_KeySchedule* ks, const uint8_t* key)
+{
+    memcpy(ks->key, key, sizeof(ks->key));
+#ifdef AJ_AES_SCHEDULE_SIZE
+    AJ_AES_ExpandKey(key, ks->schedule);
+#endif
+}
+
+void AJ_AES_ClearKey(AJ_KeySchedule* ks)
+{
+    /*
+     * Written through a volatile pointer so the compiler cannot drop the stores
+     */
+    volatile uint8_t* p = (volatile uint8_t*)ks;
+    size_t n = sizeof(AJ_KeySchedule);
+
+#ifdef AJ_CCM_OFFLOAD
+    AJ_CCM_ReleaseKey(ks->key);
+#endif
+
+    while (n--) {
+        *p++ = 0;
     }
-    return context;
+}
+
+/*
+ * Do any platform specific operations to enable AES
+ */
+static void EnableKey(const AJ_KeySchedule* ks)
+{
+#ifdef AJ_AES_SCHEDULE_SIZE
+    AJ_AES_EnableSchedule(ks->schedule);
+#else
+    AJ_AES_Enable(ks->key);
+#endif
 }
 
 /*
  * Implements AES-CCM (Counter with CBC-MAC) encryption as described in RFC 3610
  */
-AJ_Status AJ_Encrypt_CCM(const uint8_t* key,
-                         uint8_t* msg,
-                         uint32_t msgLen,
-                         uint32_t hdrLen,
-                         uint8_t tagLen,
-                         const uint8_t* nonce,
-                         uint32_t nLen)
+AJ_Status AJ_Encrypt_CCM_Key(const AJ_KeySchedule* ks,
+                             uint8_t* msg,
+                             uint32_t msgLen,
+                             uint32_t hdrLen,
+                             uint8_t tagLen,
+                             const uint8_t* nonce,
+                             uint32_t nLen)
 {
-    AJ_Status status = AJ_OK;
-    CCM_Context* context;
+    CCM_Context context;
+    const uint8_t* key = ks->key;
+    uint8_t i;
 
-    if (!(context = InitCCMContext(nonce, nLen, hdrLen, msgLen, tagLen))) {
-        return AJ_ERR_RESOURCES;
+#ifdef AJ_CCM_OFFLOAD
+    AJ_Status status = AJ_CCM_Offload(ks, msg, msgLen, hdrLen, tagLen, nonce, nLen, TRUE);
+    if (status != AJ_ERR_DISALLOWED) {
+        return status;
     }
+#endif
+    InitCCMContext(&context, nonce, nLen, hdrLen, msgLen, tagLen);
+    EnableKey(ks);
+    CCM_TagKeyStream(key, &context);
     /*
-     * Do any platform specific operations to enable AES
-     */
-    AJ_AES_Enable(key);
-    /*
-     * Compute the authentication tag
-     */
-    Compute_CCM_AuthTag(key, context, msg, msgLen - hdrLen, hdrLen);
-    /*
-     * Encrypt the authentication tag
-     */
-    AJ_AES_CTR_128(key, context->T.data, msg + msgLen, tagLen, context->ivec.data);
-    Trace("CTR Start", context->ivec.data, BLOCKSZ);
-    /*
-     * Encrypt the message
+     * Compute the authentication tag while encrypting the message
      */
-    if (msgLen != hdrLen) {
-        AJ_AES_CTR_128(key, msg + hdrLen, msg + hdrLen, msgLen - hdrLen, context->ivec.data);
-    }
+    CCM_MAC_Header(key, &context, msg, hdrLen);
+    CCM_Payload(key, &context, msg + hdrLen, msgLen - hdrLen, TRUE);
     /*
      * Balance the enable call above
      */
     AJ_AES_Disable();
     /*
-     * Done with the context
+     * Encrypt the authentication tag
      */
-    AJ_Free(context);
-    return status;
+    for (i = 0; i < tagLen; ++i) {
+        msg[msgLen + i] = context.T.data[i] ^ context.S_0.data[i];
+    }
+    return AJ_OK;
 }
 
 /*
  * Implements AES-CCM (Counter with CBC-MAC) decryption as described in RFC 3610
  */
-AJ_Status AJ_Decrypt_CCM(const uint8_t* key,
-                         uint8_t* msg,
-                         uint32_t msgLen,
-                         uint32_t hdrLen,
-                         uint8_t tagLen,
-                         const uint8_t* nonce,
-                         uint32_t nLen)
+AJ_Status AJ_Decrypt_CCM_Key(const AJ_KeySchedule* ks,
+                             uint8_t* msg,
+                             uint32_t msgLen,
+                             uint32_t hdrLen,
+                             uint8_t tagLen,
+                             const uint8_t* nonce,
+                             uint32_t nLen)
 {
     AJ_Status status = AJ_OK;
-    CCM_Context* context;
+    CCM_Context context;
+    const uint8_t* key = ks->key;
+    uint8_t i;
 
-    if (!(context = InitCCMContext(nonce, nLen, hdrLen, msgLen, tagLen))) {
-        return AJ_ERR_RESOURCES;
+#ifdef AJ_CCM_OFFLOAD
+    status = AJ_CCM_Offload(ks, msg, msgLen, hdrLen, tagLen, nonce, nLen, FALSE);
+    if (status != AJ_ERR_DISALLOWED) {
+        return status;
     }
-    /*
-     * Do any platform specific operations to enable AES
-     */
-    AJ_AES_Enable(key);
+    status = AJ_OK;
+#endif
+    InitCCMContext(&context, nonce, nLen, hdrLen, msgLen, tagLen);
+    EnableKey(ks);
+    CCM_TagKeyStream(key, &context);
     /*
      * Decrypt the authentication field
      */
-    AJ_AES_CTR_128(key, msg + msgLen, msg + msgLen, tagLen, context->ivec.data);
-    /*
-     * Decrypt message.
-     */
-    if (msgLen != hdrLen) {
-        AJ_AES_CTR_128(key, msg + hdrLen, msg + hdrLen, msgLen - hdrLen, context->ivec.data);
+    for (i = 0; i < tagLen; ++i) {
+        msg[msgLen + i] ^= context.S_0.data[i];
     }
     /*
-     * Compute and verify the authentication tag T.
+     * Decrypt the message while computing the authentication tag T
      */
-    Compute_CCM_AuthTag(key, context, msg, msgLen - hdrLen, hdrLen);
+    CCM_MAC_Header(key, &context, msg, hdrLen);
+    CCM_Payload(key, &context, msg + hdrLen, msgLen - hdrLen, FALSE);
     /*
      * Balance the enable call above
      */
     AJ_AES_Disable();
-    if (memcmp(context->T.data, msg + msgLen, tagLen) != 0) {
+    if (memcmp(context.T.data, msg + msgLen, tagLen) != 0) {
         /*
          * Authentication failed Clear the decrypted data
          */
         memset(msg, 0, msgLen + tagLen);
         status = AJ_ERR_SECURITY;
     }
-    /*
-     * Done with the context
-     */
-    AJ_Free(context);
+    return status;
+}
+
+AJ_Status AJ_Encrypt_CCM(const uint8_t* key,
+                         uint8_t* msg,
+                         uint32_t msgLen,
+                         uint32_t hdrLen,
+                         uint8_t tagLen,
+                         const uint8_t* nonce,
+                         uint32_t nLen)
+{
+    AJ_Status status;
+    AJ_KeySchedule ks;
+
+    AJ_AES_InitKey(&ks, key);
+    status = AJ_Encrypt_CCM_Key(&ks, msg, msgLen, hdrLen, tagLen, nonce, nLen);
+    AJ_AES_ClearKey(&ks);
+    return status;
+}
+
+AJ_Status AJ_Decrypt_CCM(const uint8_t* key,
+                         uint8_t* msg,
+                         uint32_t msgLen,
+                         uint32_t hdrLen,
+                         uint8_t tagLen,
+                         const uint8_t* nonce,
+                         uint32_t nLen)
+{
+    AJ_Status status;
+    AJ_KeySchedule ks;
+
+    AJ_AES_InitKey(&ks, key);
+    status = AJ_Decrypt_CCM_Key(&ks, msg, msgLen, hdrLen, tagLen, nonce, nLen);
+    AJ_AES_ClearKey(&ks);
     return status;
 }
 
@@ -121,6 +121,8 @@ const char* AJ_StatusText(AJ_Status status)
         AJ_CASE(AJ_ERR_RESTART);
         AJ_CASE(AJ_ERR_LINK_TIMEOUT);
         AJ_CASE(AJ_ERR_DRIVER);
+        AJ_CASE(AJ_ERR_WOULD_BLOCK);
+        AJ_CASE(AJ_ERR_DEFERRED);
 
     default:
         return "<unknown>";
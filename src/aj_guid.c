@@ -30,13 +30,14 @@ typedef struct _NameToGUID {
     char uniqueName[MAX_NAME_SIZE + 1];
     const char* serviceName;
     AJ_GUID guid;
-    uint8_t sessionKey[16];
-    uint8_t groupKey[16];
+    AJ_KeySchedule sessionKey;
+    AJ_KeySchedule groupKey;
 } NameToGUID;
 
-static uint8_t localGroupKey[16];
+static AJ_THREAD_LOCAL AJ_KeySchedule localGroupKey;
+static AJ_THREAD_LOCAL uint8_t localGroupKeySet;
 
-static NameToGUID nameMap[NAME_MAP_GUID_SIZE];
+static AJ_THREAD_LOCAL NameToGUID nameMap[NAME_MAP_GUID_SIZE];
 
 AJ_Status AJ_GUID_ToString(const AJ_GUID* guid, char* buffer, uint32_t bufLen)
 {
@@ -84,6 +85,8 @@ void AJ_GUID_DeleteNameMapping(const char* uniqueName)
 {
     NameToGUID* mapping = LookupName(uniqueName);
     if (mapping) {
+        AJ_AES_ClearKey(&mapping->sessionKey);
+        AJ_AES_ClearKey(&mapping->groupKey);
         memset(mapping, 0, sizeof(NameToGUID));
     }
 }
@@ -97,6 +100,12 @@ const AJ_GUID* AJ_GUID_Find(const char* name)
 
 void AJ_GUID_ClearNameMap(void)
 {
+    uint32_t i;
+
+    for (i = 0; i < NAME_MAP_GUID_SIZE; ++i) {
+        AJ_AES_ClearKey(&nameMap[i].sessionKey);
+        AJ_AES_ClearKey(&nameMap[i].groupKey);
+    }
     memset(nameMap, 0, sizeof(nameMap));
 }
 
@@ -104,7 +113,7 @@ AJ_Status AJ_SetGroupKey(const char* uniqueName, const uint8_t* key)
 {
     NameToGUID* mapping = LookupName(uniqueName);
     if (mapping) {
-        memcpy(mapping->groupKey, key, 16);
+        AJ_AES_InitKey(&mapping->groupKey, key);
         return AJ_OK;
     } else {
         return AJ_ERR_NO_MATCH;
@@ -116,42 +125,65 @@ AJ_Status AJ_SetSessionKey(const char* uniqueName, const uint8_t* key, uint8_t r
     NameToGUID* mapping = LookupName(uniqueName);
     if (mapping) {
         mapping->keyRole = role;
-        memcpy(mapping->sessionKey, key, 16);
+        AJ_AES_InitKey(&mapping->sessionKey, key);
         return AJ_OK;
     } else {
         return AJ_ERR_NO_MATCH;
     }
 }
 
-AJ_Status AJ_GetSessionKey(const char* name, uint8_t* key, uint8_t* role)
+AJ_Status AJ_GetSessionKeySchedule(const char* name, const AJ_KeySchedule** ks, uint8_t* role)
 {
     NameToGUID* mapping = LookupName(name);
     if (mapping) {
         *role = mapping->keyRole;
-        memcpy(key, mapping->sessionKey, 16);
+        *ks = &mapping->sessionKey;
         return AJ_OK;
     } else {
         return AJ_ERR_NO_MATCH;
     }
 }
 
-AJ_Status AJ_GetGroupKey(const char* name, uint8_t* key)
+AJ_Status AJ_GetGroupKeySchedule(const char* name, const AJ_KeySchedule** ks)
 {
     if (name) {
         NameToGUID* mapping = LookupName(name);
         if (!mapping) {
             return AJ_ERR_NO_MATCH;
         }
-        memcpy(key, mapping->groupKey, 16);
+        *ks = &mapping->groupKey;
     } else {
         /*
          * Check if the group key needs to be initialized
          */
-        memset(key, 0, 16);
-        if (memcmp(localGroupKey, key, 16) == 0) {
-            AJ_RandBytes(localGroupKey, 16);
+        if (!localGroupKeySet) {
+            uint8_t key[16];
+            AJ_RandBytes(key, sizeof(key));
+            AJ_AES_InitKey(&localGroupKey, key);
+            memset(key, 0, sizeof(key));
+            localGroupKeySet = TRUE;
         }
-        memcpy(key, localGroupKey, 16);
+        *ks = &localGroupKey;
     }
     return AJ_OK;
 }
+
+AJ_Status AJ_GetSessionKey(const char* name, uint8_t* key, uint8_t* role)
+{
+    const AJ_KeySchedule* ks;
+    AJ_Status status = AJ_GetSessionKeySchedule(name, &ks, role);
+    if (status == AJ_OK) {
+        memcpy(key, ks->key, 16);
+    }
+    return status;
+}
+
+AJ_Status AJ_GetGroupKey(const char* name, uint8_t* key)
+{
+    const AJ_KeySchedule* ks;
+    AJ_Status status = AJ_GetGroupKeySchedule(name, &ks);
+    if (status == AJ_OK) {
+        memcpy(key, ks->key, 16);
+    }
+    return status;
+}
@@ -24,7 +24,36 @@
 #define CONNECT_PAUSE     (10 * 1000)
 
 
-#define MAX_TIMERS 4
+/*
+ * Maximum number of timers that can be set at one time
+ */
+#ifndef AJ_MAX_TIMERS
+#define AJ_MAX_TIMERS 16
+#endif
+
+#if (AJ_MAX_TIMERS < 1) || (AJ_MAX_TIMERS > 0xFFFE)
+#error AJ_MAX_TIMERS must be between 1 and 0xFFFE
+#endif
+
+/*
+ * Timers are held in a hierarchical timing wheel. Level 0 has a slot for each of the next 64
+ * milliseconds, each higher level has slots 64 times as coarse. Timers in a higher level slot are
+ * redistributed to the lower levels when the time reaches the start of the slot. Five levels cover
+ * 2^30 milliseconds, timers further out than that are parked in the top level until they are in
+ * range.
+ */
+#define WHEEL_BITS   6
+#define WHEEL_SLOTS  (1 << WHEEL_BITS)
+#define WHEEL_MASK   (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 5
+#define WHEEL_RANGE  ((uint32_t)1 << (WHEEL_BITS * WHEEL_LEVELS))
+
+#define NO_TIMER     0xFFFF
+
+/*
+ * Times wrap so are compared by the sign of the difference
+ */
+#define TIME_BEFORE(a, b) ((int32_t)((a) - (b)) < 0)
 
 /**
  *  Type to describe pending timers
@@ -34,89 +63,608 @@ typedef struct {
     void* context;          /**< A context pointer passed in by the user */
     uint32_t abs_time;      /**< The absolute time when this timer will fire */
     uint32_t repeat;        /**< The amount of time between timer events */
+    uint16_t next;          /**< Next timer in the wheel slot or the free list */
+    uint16_t prev;          /**< Previous timer in the wheel slot */
+    uint16_t slot;          /**< The wheel slot the timer is in or NO_TIMER */
+    uint16_t gen;           /**< Incremented each time the timer is freed to detect stale ids */
 } Timer;
 
-static Timer Timers[MAX_TIMERS] = {
-    { NULL }
-};
+static AJ_THREAD_LOCAL Timer Timers[AJ_MAX_TIMERS];
+
+/*
+ * Heads of the timer lists for each wheel slot and bitmaps of the non-empty slots in each level
+ */
+static AJ_THREAD_LOCAL uint16_t Wheel[WHEEL_LEVELS * WHEEL_SLOTS];
+static AJ_THREAD_LOCAL uint64_t WheelBusy[WHEEL_LEVELS];
 
-static Timer* GetNextTimeout()
+/*
+ * The next millisecond that has not yet been processed
+ */
+static AJ_THREAD_LOCAL uint32_t wheelTime;
+static AJ_THREAD_LOCAL uint16_t freeTimers = NO_TIMER;
+static AJ_THREAD_LOCAL uint16_t numTimers = 0;
+static AJ_THREAD_LOCAL uint8_t wheelInit = FALSE;
+
+static uint32_t GetNow(void)
 {
-    Timer* next = NULL;
-    uint32_t lowest = (uint32_t) -1;
-    uint32_t i;
+    AJ_Time start = { 0, 0 };
+    return AJ_GetElapsedTime(&start, FALSE);
+}
 
-    // find the timer with the lowest timeout value
-    for (i = 0; i < MAX_TIMERS; ++i) {
-        Timer* timer = Timers + i;
-        if (timer->abs_time != 0 && timer->abs_time < lowest) {
-            next = timer;
+static void InitTimers(void)
+{
+    uint16_t i;
+
+    for (i = 0; i < AJ_MAX_TIMERS; ++i) {
+        Timers[i].next = (i + 1 < AJ_MAX_TIMERS) ? i + 1 : NO_TIMER;
+        Timers[i].slot = NO_TIMER;
+    }
+    for (i = 0; i < WHEEL_LEVELS * WHEEL_SLOTS; ++i) {
+        Wheel[i] = NO_TIMER;
+    }
+    memset(WheelBusy, 0, sizeof(WheelBusy));
+    freeTimers = 0;
+    wheelTime = GetNow();
+    wheelInit = TRUE;
+}
+
+/*
+ * Returns the offset of the first busy slot at or after slot idx wrapping around the level or
+ * WHEEL_SLOTS if there are no busy slots.
+ */
+static uint32_t NextBusySlot(uint64_t busy, uint32_t idx)
+{
+    uint32_t offset = 0;
+
+    busy = idx ? ((busy >> idx) | (busy << (WHEEL_SLOTS - idx))) : busy;
+    if (!busy) {
+        return WHEEL_SLOTS;
+    }
+    while (!(busy & 0xFF)) {
+        busy >>= 8;
+        offset += 8;
+    }
+    while (!(busy & 1)) {
+        busy >>= 1;
+        ++offset;
+    }
+    return offset;
+}
+
+static void WheelInsert(uint16_t id)
+{
+    Timer* timer = &Timers[id];
+    uint32_t expires = timer->abs_time;
+    uint32_t delta = expires - wheelTime;
+    uint32_t level = 0;
+    uint32_t slot;
+
+    if ((int32_t)delta < 0) {
+        /*
+         * Overdue timers go in the slot that is about to be processed
+         */
+        expires = wheelTime;
+        delta = 0;
+    } else if (delta >= WHEEL_RANGE) {
+        /*
+         * Park the timer at the far end of the wheel, it gets reinserted when that slot is reached
+         */
+        expires = wheelTime + WHEEL_RANGE - 1;
+        delta = WHEEL_RANGE - 1;
+    }
+    while (delta >= ((uint32_t)WHEEL_SLOTS << (WHEEL_BITS * level))) {
+        ++level;
+    }
+    slot = level * WHEEL_SLOTS + ((expires >> (WHEEL_BITS * level)) & WHEEL_MASK);
+    timer->slot = (uint16_t)slot;
+    timer->prev = NO_TIMER;
+    timer->next = Wheel[slot];
+    if (timer->next != NO_TIMER) {
+        Timers[timer->next].prev = id;
+    }
+    Wheel[slot] = id;
+    WheelBusy[level] |= (uint64_t)1 << (slot & WHEEL_MASK);
+}
+
+static void WheelRemove(uint16_t id)
+{
+    Timer* timer = &Timers[id];
+
+    if (timer->prev != NO_TIMER) {
+        Timers[timer->prev].next = timer->next;
+    } else {
+        Wheel[timer->slot] = timer->next;
+        if (timer->next == NO_TIMER) {
+            WheelBusy[timer->slot / WHEEL_SLOTS] &= ~((uint64_t)1 << (timer->slot & WHEEL_MASK));
         }
     }
+    if (timer->next != NO_TIMER) {
+        Timers[timer->next].prev = timer->prev;
+    }
+    timer->slot = NO_TIMER;
+}
 
-    return next;
+static void FreeTimer(uint16_t id)
+{
+    Timer* timer = &Timers[id];
+
+    timer->handler = NULL;
+    timer->context = NULL;
+    ++timer->gen;
+    timer->next = freeTimers;
+    freeTimers = id;
+    --numTimers;
 }
 
-static void RunExpiredTimers(uint32_t now)
+/*
+ * Returns the earliest time the wheel needs attention. For level 0 this is the exact time a timer
+ * fires, for higher levels it is the time the earliest busy slot must be redistributed.
+ */
+static uint32_t NextWheelEvent(void)
 {
-    uint32_t i = 0;
+    uint32_t next = wheelTime + WHEEL_RANGE;
+    uint32_t level;
 
-    for (; i < MAX_TIMERS; ++i) {
-        Timer* timer = Timers + i;
-        if (timer->handler != NULL && timer->abs_time <= now) {
-            (timer->handler)(timer->context);
+    for (level = 0; level < WHEEL_LEVELS; ++level) {
+        uint32_t shift = WHEEL_BITS * level;
+        uint32_t cur = wheelTime >> shift;
+        uint32_t offset = NextBusySlot(WheelBusy[level], cur & WHEEL_MASK);
+        uint32_t when;
 
-            if (timer->repeat) {
-                timer->abs_time += timer->repeat;
-            } else {
-                memset(timer, 0, sizeof(Timer));
+        if (offset == WHEEL_SLOTS) {
+            continue;
+        }
+        if (level == 0) {
+            when = wheelTime + offset;
+        } else {
+            /*
+             * The current slot of a higher level has already been redistributed unless the time
+             * is exactly at the start of the slot.
+             */
+            if ((offset == 0) && (wheelTime & ((1u << shift) - 1))) {
+                offset = WHEEL_SLOTS;
             }
+            when = (cur + offset) << shift;
+        }
+        if (TIME_BEFORE(when, next)) {
+            next = when;
         }
     }
+    return next;
 }
 
-uint32_t AJ_SetTimer(uint32_t relative_time, TimeoutHandler handler, void* context, uint32_t repeat)
+/*
+ * Redistribute the timers in the current slot of each level whose slot starts at wheelTime
+ */
+static void Cascade(void)
 {
-    uint32_t i;
-    for (i = 0; i < MAX_TIMERS; ++i) {
-        Timer* timer = Timers + i;
-        // need to find an available timer slot
-        if (timer->handler == NULL) {
-            AJ_Time start = { 0, 0 };
-            uint32_t now = AJ_GetElapsedTime(&start, FALSE);
-            timer->handler = handler;
-            timer->context = context;
-            timer->repeat = repeat;
-            timer->abs_time = now + relative_time;
-            return i + 1;
+    uint32_t level;
+
+    for (level = 1; level < WHEEL_LEVELS; ++level) {
+        uint32_t shift = WHEEL_BITS * level;
+        uint32_t slot;
+
+        if (wheelTime & ((1u << shift) - 1)) {
+            break;
+        }
+        slot = level * WHEEL_SLOTS + ((wheelTime >> shift) & WHEEL_MASK);
+        while (Wheel[slot] != NO_TIMER) {
+            uint16_t id = Wheel[slot];
+            WheelRemove(id);
+            WheelInsert(id);
         }
     }
+}
+
+void AJ_RunExpiredTimers(void)
+{
+    uint32_t now = GetNow();
+
+    if (!wheelInit || !numTimers) {
+        wheelTime = now + 1;
+        return;
+    }
+    while (!TIME_BEFORE(now, wheelTime)) {
+        uint32_t next = NextWheelEvent();
+        uint32_t slot;
+
+        if (TIME_BEFORE(now, next)) {
+            break;
+        }
+        /*
+         * Skip directly to the next time something needs doing
+         */
+        wheelTime = next;
+        Cascade();
+        slot = wheelTime & WHEEL_MASK;
+        while (Wheel[slot] != NO_TIMER) {
+            uint16_t id = Wheel[slot];
+            Timer* timer = &Timers[id];
+            uint16_t gen = timer->gen;
+
+            WheelRemove(id);
+            (timer->handler)(timer->context);
+            /*
+             * The handler may have cancelled the timer
+             */
+            if ((timer->gen == gen) && (timer->slot == NO_TIMER)) {
+                if (timer->repeat) {
+                    /*
+                     * Repeat relative to when the timer was due so the period does not drift.
+                     * Periods missed while the loop was blocked are skipped, not run back to back.
+                     */
+                    timer->abs_time += timer->repeat;
+                    if (!TIME_BEFORE(now, timer->abs_time)) {
+                        timer->abs_time += ((now - timer->abs_time) / timer->repeat + 1) * timer->repeat;
+                    }
+                    WheelInsert(id);
+                } else {
+                    FreeTimer(id);
+                }
+            }
+        }
+        ++wheelTime;
+    }
+    if (TIME_BEFORE(wheelTime, now + 1)) {
+        wheelTime = now + 1;
+    }
+}
+
+uint32_t AJ_GetNextTimeout(void)
+{
+    uint32_t next;
+    uint32_t now;
+
+    if (!numTimers) {
+        return (uint32_t)-1;
+    }
+    next = NextWheelEvent();
+    now = GetNow();
+    return TIME_BEFORE(now, next) ? next - now : 0;
+}
+
+uint32_t AJ_SetTimer(uint32_t relative_time, TimeoutHandler handler, void* context, uint32_t repeat)
+{
+    uint16_t id;
+    Timer* timer;
 
+    if (!wheelInit) {
+        InitTimers();
+    }
     // available slot not found!
-    return 0;
+    if (freeTimers == NO_TIMER) {
+        return 0;
+    }
+    if (!numTimers) {
+        wheelTime = GetNow();
+    }
+    id = freeTimers;
+    timer = &Timers[id];
+    freeTimers = timer->next;
+    ++numTimers;
+    timer->handler = handler;
+    timer->context = context;
+    timer->repeat = repeat;
+    timer->abs_time = GetNow() + relative_time;
+    WheelInsert(id);
+    return ((uint32_t)timer->gen << 16) | (id + 1);
 }
 
 void AJ_CancelTimer(uint32_t id)
 {
-    Timer* timer = Timers + (id - 1);
-    AJ_ASSERT(id > 0 && id <= MAX_TIMERS);
-    memset(timer, 0, sizeof(Timer));
+    uint16_t index = (uint16_t)((id & 0xFFFF) - 1);
+    Timer* timer = Timers + index;
+
+    AJ_ASSERT((id & 0xFFFF) > 0 && (id & 0xFFFF) <= AJ_MAX_TIMERS);
+    /*
+     * Ignore timers that have already fired or been cancelled
+     */
+    if (!wheelInit || !timer->handler || (timer->gen != (uint16_t)(id >> 16))) {
+        return;
+    }
+    if (timer->slot != NO_TIMER) {
+        WheelRemove(index);
+    }
+    FreeTimer(index);
+}
+
+
+/*
+ * Number of entries in the message dispatch hash table, must be a power of 2. The table holds the
+ * message and property handlers and counters for message ids that have no handler and is kept no
+ * more than 3/4 full.
+ */
+#ifndef AJ_DISPATCH_TABLE_SIZE
+#define AJ_DISPATCH_TABLE_SIZE 256
+#endif
+
+#if (AJ_DISPATCH_TABLE_SIZE & (AJ_DISPATCH_TABLE_SIZE - 1)) || (AJ_DISPATCH_TABLE_SIZE > 0x8000)
+#error AJ_DISPATCH_TABLE_SIZE must be a power of 2 no larger than 0x8000
+#endif
+
+#define DISPATCH_FREE      0
+#define DISPATCH_MESSAGE   1
+#define DISPATCH_PROPERTY  2
+#define DISPATCH_UNHANDLED 3
+
+/**
+ *  Type for an entry in the dispatch table
+ */
+typedef struct {
+    uint32_t msgid;     /**< The message id */
+    uint16_t index;     /**< Index of the handler in the handler list or the unhandled count */
+    uint8_t kind;       /**< The type of entry */
+} DispatchEntry;
+
+static AJ_THREAD_LOCAL DispatchEntry Dispatch[AJ_DISPATCH_TABLE_SIZE];
+static AJ_THREAD_LOCAL uint16_t dispatchUsed;
+static AJ_THREAD_LOCAL uint32_t unhandledTotal;
+
+/*
+ * The handler lists the dispatch table was built from
+ */
+static AJ_THREAD_LOCAL const MessageHandlerEntry* dispatchMessages = NULL;
+static AJ_THREAD_LOCAL const PropHandlerEntry* dispatchProps = NULL;
+static AJ_THREAD_LOCAL uint8_t dispatchTable = FALSE;
+
+/*
+ * Message ids are four small indices packed into a word, multiplicative hashing spreads them out
+ */
+static uint32_t DispatchHash(uint32_t msgid)
+{
+    return (msgid * 2654435761u) >> 16;
 }
 
+/*
+ * Returns the entry for a message id or the free entry where it would go
+ */
+static DispatchEntry* DispatchFind(uint32_t msgid)
+{
+    uint32_t i = DispatchHash(msgid);
+
+    for (;;) {
+        DispatchEntry* entry = &Dispatch[i & (AJ_DISPATCH_TABLE_SIZE - 1)];
+        if ((entry->kind == DISPATCH_FREE) || (entry->msgid == msgid)) {
+            return entry;
+        }
+        ++i;
+    }
+}
+
+static uint8_t DispatchAdd(uint32_t msgid, uint8_t kind, uint16_t index)
+{
+    DispatchEntry* entry;
+
+    if (dispatchUsed >= (AJ_DISPATCH_TABLE_SIZE / 4) * 3) {
+        return FALSE;
+    }
+    entry = DispatchFind(msgid);
+    /*
+     * The first handler for a message id takes precedence
+     */
+    if (entry->kind == DISPATCH_FREE) {
+        entry->msgid = msgid;
+        entry->kind = kind;
+        entry->index = index;
+        ++dispatchUsed;
+    }
+    return TRUE;
+}
+
+/*
+ * Compiles the message and property handler lists into the dispatch table. Returns FALSE if the
+ * lists do not fit in which case handlers are found by searching the lists.
+ */
+static uint8_t BuildDispatchTable(const AllJoynConfiguration* config)
+{
+    const MessageHandlerEntry* message_entry = config->message_handlers;
+    const PropHandlerEntry* prop_entry = config->prop_handlers;
+    uint16_t i;
+
+    memset(Dispatch, 0, sizeof(Dispatch));
+    dispatchUsed = 0;
+    unhandledTotal = 0;
+    for (i = 0; message_entry && message_entry[i].msgid != 0; ++i) {
+        if (!DispatchAdd(message_entry[i].msgid, DISPATCH_MESSAGE, i)) {
+            goto TooMany;
+        }
+    }
+    for (i = 0; prop_entry && prop_entry[i].msgid != 0; ++i) {
+        if (!DispatchAdd(prop_entry[i].msgid, DISPATCH_PROPERTY, i)) {
+            goto TooMany;
+        }
+    }
+    return TRUE;
+
+TooMany:
+    AJ_Printf("Too many handlers for dispatch table - increase AJ_DISPATCH_TABLE_SIZE\n");
+    memset(Dispatch, 0, sizeof(Dispatch));
+    dispatchUsed = 0;
+    return FALSE;
+}
+
+/*
+ * Linear search of the handler lists for when the dispatch table could not be built
+ */
+static DispatchEntry* DispatchSearch(const AllJoynConfiguration* config, uint32_t msgid, DispatchEntry* found)
+{
+    const MessageHandlerEntry* message_entry = config->message_handlers;
+    const PropHandlerEntry* prop_entry = config->prop_handlers;
+    uint16_t i;
+
+    found->msgid = msgid;
+    for (i = 0; message_entry && message_entry[i].msgid != 0; ++i) {
+        if (message_entry[i].msgid == msgid) {
+            found->kind = DISPATCH_MESSAGE;
+            found->index = i;
+            return found;
+        }
+    }
+    for (i = 0; prop_entry && prop_entry[i].msgid != 0; ++i) {
+        if (prop_entry[i].msgid == msgid) {
+            found->kind = DISPATCH_PROPERTY;
+            found->index = i;
+            return found;
+        }
+    }
+    return NULL;
+}
+
+static void CountUnhandled(uint32_t msgid)
+{
+    DispatchEntry* entry;
+
+    ++unhandledTotal;
+    if (DispatchAdd(msgid, DISPATCH_UNHANDLED, 0)) {
+        entry = DispatchFind(msgid);
+        if ((entry->kind == DISPATCH_UNHANDLED) && (entry->index != 0xFFFF)) {
+            ++entry->index;
+        }
+    }
+}
+
+uint32_t AJ_GetUnhandledCount(uint32_t msgId)
+{
+    DispatchEntry* entry;
+
+    if (msgId == AJ_INVALID_MSG_ID) {
+        return unhandledTotal;
+    }
+    entry = DispatchFind(msgId);
+    return (entry->kind == DISPATCH_UNHANDLED) ? entry->index : 0;
+}
+
+AJ_Status AJ_DispatchReply(AJ_Message* msg)
+{
+    if (msg->callback) {
+        msg->callback(msg, msg->callbackContext);
+        return AJ_OK;
+    }
+    return AJ_ERR_NO_MATCH;
+}
+
+AJ_Status AJ_DispatchMessage(AJ_Message* msg, const AllJoynConfiguration* config)
+{
+    AJ_Status status = AJ_OK;
+    DispatchEntry found;
+    DispatchEntry* entry;
+
+    if (AJ_DispatchReply(msg) == AJ_OK) {
+        return AJ_OK;
+    }
+
+    if ((config->message_handlers != dispatchMessages) || (config->prop_handlers != dispatchProps)) {
+        dispatchTable = BuildDispatchTable(config);
+        dispatchMessages = config->message_handlers;
+        dispatchProps = config->prop_handlers;
+    }
+    if (dispatchTable) {
+        entry = DispatchFind(msg->msgId);
+        if ((entry->kind != DISPATCH_MESSAGE) && (entry->kind != DISPATCH_PROPERTY)) {
+            entry = NULL;
+        }
+    } else {
+        entry = DispatchSearch(config, msg->msgId, &found);
+    }
+
+    // check the user's handlers first.  ANY message that AllJoyn can handle is override-able.
+    if (entry && entry->kind == DISPATCH_MESSAGE) {
+        const MessageHandlerEntry* message_entry = &config->message_handlers[entry->index];
+        if (msg->hdr->msgType == AJ_MSG_METHOD_CALL) {
+            // build a method reply
+            AJ_Message reply;
+#if AJ_WORKER_POOL
+            if ((message_entry->flags & AJ_HANDLER_WORKER) &&
+                (AJ_QueueMethodCall(msg, message_entry->handler, message_entry->flags) == AJ_OK)) {
+                return AJ_OK;
+            }
+#endif
+            status = AJ_MarshalReplyMsg(msg, &reply);
+
+            if (status == AJ_OK) {
+                status = (message_entry->handler)(msg, &reply);
+            }
+
+            if (status == AJ_OK) {
+                status = AJ_DeliverMsg(&reply);
+            } else {
+                /*
+                 * Discard the reply the handler was given so it is never sent. If the handler sent
+                 * something else that was only partly written the rest must still be sent.
+                 */
+                if (!msg->bus->sock.tx.pending) {
+                    AJ_IO_BUF_RESET(&msg->bus->sock.tx);
+                }
+                if (status == AJ_ERR_DEFERRED) {
+                    /*
+                     * The handler saved a reply token and will reply later
+                     */
+                    status = AJ_OK;
+                }
+            }
+        } else {
+            // call the handler!
+            status = (message_entry->handler)(msg, NULL);
+        }
+    } else if (entry) {
+        // we need to check whether this is a property getter or setter.
+        // these are stored in an array because multiple getters and setters can exist if running more than one bus object
+        const PropHandlerEntry* prop_entry = &config->prop_handlers[entry->index];
+        // extract the method from the ID; GetProperty or SetProperty
+        uint32_t method = prop_entry->msgid & 0x000000FF;
+        if (method == AJ_PROP_GET) {
+            status = AJ_BusPropGet(msg, prop_entry->callback, prop_entry->context);
+        } else if (method == AJ_PROP_SET) {
+            status = AJ_BusPropSet(msg, prop_entry->callback, prop_entry->context);
+        } else {
+            // this should never happen!!!
+            AJ_ASSERT(!"Invalid property method");
+        }
+    } else if (msg->msgId == AJ_METHOD_ACCEPT_SESSION) {
+        uint8_t accepted = (config->acceptor)(msg);
+        status = AJ_BusReplyAcceptSession(msg, accepted);
+    } else {
+        // handler not found!
+        CountUnhandled(msg->msgId);
+        status = AJ_BusHandleBusMessage(msg);
+    }
+    return status;
+}
+
+#if AJ_NET_EPOLL
+/*
+ * Returns TRUE if other threads can have work for the message loop
+ */
+static uint8_t WakeForThreads(void)
+{
+#if AJ_WORKER_POOL
+    if (AJ_GetNumWorkers()) {
+        return TRUE;
+    }
+#endif
+#if AJ_TX_QUEUE
+    if (AJ_GetNumTxQueues()) {
+        return TRUE;
+    }
+#endif
+    return FALSE;
+}
+#endif
 
 AJ_Status AJ_RunAllJoynService(AJ_BusAttachment* bus, AllJoynConfiguration* config)
 {
     uint8_t connected = FALSE;
     AJ_Status status = AJ_OK;
 
+    /*
+     * Handlers may have been changed since the last run
+     */
+    dispatchMessages = NULL;
+    dispatchProps = NULL;
+
     while (TRUE) {
-        AJ_Time start = { 0, 0 };
         AJ_Message msg;
-        uint32_t now;
-        // get the next timeout
-        Timer* timer = GetNextTimeout();
-        // wait forever
-        uint32_t timeout = (uint32_t) -1;
+        uint32_t timeout;
 
         if (!connected) {
             status = AJ_StartService2(
@@ -138,16 +686,35 @@ AJ_Status AJ_RunAllJoynService(AJ_BusAttachment* bus, AllJoynConfiguration* conf
             AJ_SetBusLinkTimeout(bus, config->link_timeout);
         }
 
-        // absolute time in milliseconds
-        now = AJ_GetElapsedTime(&start, FALSE);
-        RunExpiredTimers(now);
-
-        if (timer != NULL) {
-            // if no timers running, wait forever
-            timeout = timer->abs_time - now;
+        AJ_RunExpiredTimers();
+#if AJ_WORKER_POOL
+        AJ_DeliverCompletedCalls(bus);
+#endif
+#if AJ_TX_QUEUE
+        AJ_SendQueued(bus);
+#endif
+        // wait until the next timer is due, forever if there are no timers running
+        timeout = AJ_GetNextTimeout();
+
+#if AJ_NET_EPOLL
+        if (WakeForThreads()) {
+            /*
+             * The loop must also wake up when a worker has finished a method call or a producer has
+             * queued a message so rather than blocking in AJ_UnmarshalMsg() wait for the socket or
+             * the other threads
+             */
+            status = AJ_ProcessReady(bus, &msg);
+            if (status == AJ_ERR_WOULD_BLOCK) {
+                AJ_NetSocket* ready;
+                AJ_Net_Poll(&ready, 1, AJ_ReplyTimeout(timeout));
+                status = AJ_ERR_TIMEOUT;
+            }
+        } else {
+            status = AJ_UnmarshalMsg(bus, &msg, timeout);
         }
-
+#else
         status = AJ_UnmarshalMsg(bus, &msg, timeout);
+#endif
         if (AJ_ERR_TIMEOUT == status && AJ_ERR_LINK_TIMEOUT == AJ_BusLinkStateProc(bus)) {
             status = AJ_ERR_READ;
         }
@@ -158,66 +725,7 @@ AJ_Status AJ_RunAllJoynService(AJ_BusAttachment* bus, AllJoynConfiguration* conf
         }
 
         if (status == AJ_OK) {
-            uint8_t handled = FALSE;
-            const MessageHandlerEntry* message_entry = config->message_handlers;
-            const PropHandlerEntry* prop_entry = config->prop_handlers;
-
-            // check the user's handlers first.  ANY message that AllJoyn can handle is override-able.
-            while (handled != TRUE && message_entry->msgid != 0) {
-                if (message_entry->msgid == msg.msgId) {
-                    if (msg.hdr->msgType == AJ_MSG_METHOD_CALL) {
-                        // build a method reply
-                        AJ_Message reply;
-                        status = AJ_MarshalReplyMsg(&msg, &reply);
-
-                        if (status == AJ_OK) {
-                            status = (message_entry->handler)(&msg, &reply);
-                        }
-
-                        if (status == AJ_OK) {
-                            status = AJ_DeliverMsg(&reply);
-                        }
-                    } else {
-                        // call the handler!
-                        status = (message_entry->handler)(&msg, NULL);
-                    }
-
-                    handled = TRUE;
-                }
-
-                ++message_entry;
-            }
-
-            // we need to check whether this is a property getter or setter.
-            // these are stored in an array because multiple getters and setters can exist if running more than one bus object
-            while (handled != TRUE && prop_entry->msgid != 0) {
-                if (prop_entry->msgid == msg.msgId) {
-                    // extract the method from the ID; GetProperty or SetProperty
-                    uint32_t method = prop_entry->msgid & 0x000000FF;
-                    if (method == AJ_PROP_GET) {
-                        status = AJ_BusPropGet(&msg, prop_entry->callback, prop_entry->context);
-                    } else if (method == AJ_PROP_SET) {
-                        status = AJ_BusPropSet(&msg, prop_entry->callback, prop_entry->context);
-                    } else {
-                        // this should never happen!!!
-                        AJ_ASSERT(!"Invalid property method");
-                    }
-
-                    handled = TRUE;
-                }
-
-                ++prop_entry;
-            }
-
-            // handler not found!
-            if (handled == FALSE) {
-                if (msg.msgId == AJ_METHOD_ACCEPT_SESSION) {
-                    uint8_t accepted = (config->acceptor)(&msg);
-                    status = AJ_BusReplyAcceptSession(&msg, accepted);
-                } else {
-                    status = AJ_BusHandleBusMessage(&msg);
-                }
-            }
+            status = AJ_DispatchMessage(&msg, config);
 
             // Any received packets indicates the link is active, so call to reinforce the bus link state
             AJ_NotifyLinkActive();
@@ -241,6 +749,70 @@ AJ_Status AJ_RunAllJoynService(AJ_BusAttachment* bus, AllJoynConfiguration* conf
     return AJ_OK;
 }
 
+#if AJ_NET_EPOLL
+
+/*
+ * Number of bus attachments serviced for each wait
+ */
+#define SERVICE_BATCH 32
+
+/*
+ * Passes everything that has arrived on a bus, and the timeouts for calls made on the bus, to the
+ * callbacks and the handler
+ */
+static void ServiceBus(AJ_BusAttachment* bus, AJ_BusMessageHandler handler)
+{
+    AJ_Message msg;
+    AJ_Status status;
+
+    while ((status = AJ_ProcessReady(bus, &msg)) == AJ_OK) {
+        if (AJ_DispatchReply(&msg) != AJ_OK) {
+            handler(bus, &msg, AJ_OK);
+        }
+        AJ_CloseMsg(&msg);
+    }
+    if (status != AJ_ERR_WOULD_BLOCK) {
+        handler(bus, NULL, status);
+    }
+}
+
+AJ_Status AJ_ServiceBuses(AJ_BusMessageHandler handler, uint32_t timeout)
+{
+    AJ_NetSocket* ready[SERVICE_BATCH];
+    AJ_BusAttachment* bus;
+    uint32_t num;
+    uint32_t i;
+
+    AJ_RunExpiredTimers();
+    /*
+     * Wake up in time to report calls to peers that never reply
+     */
+    num = AJ_Net_Poll(ready, SERVICE_BATCH, AJ_ReplyTimeout(min(timeout, AJ_GetNextTimeout())));
+    for (i = 0; i < num; ++i) {
+        /*
+         * Sockets are edge-triggered so everything that has arrived must be processed now
+         */
+        ServiceBus((AJ_BusAttachment*)((uint8_t*)ready[i] - offsetof(AJ_BusAttachment, sock)), handler);
+    }
+    /*
+     * Timed out calls on buses that had nothing to read. Each pass reports all the timed out calls
+     * on one bus, the limit stops a bus that keeps failing without disconnecting from looping.
+     */
+    for (i = 0; (i < AJ_NUM_REPLY_CONTEXTS) && ((bus = AJ_TimedOutBus()) != NULL); ++i) {
+        ServiceBus(bus, handler);
+        ++num;
+    }
+#if AJ_WORKER_POOL
+    AJ_DeliverCompletedCalls(NULL);
+#endif
+#if AJ_TX_QUEUE
+    AJ_SendQueued(NULL);
+#endif
+    AJ_RunExpiredTimers();
+    return num ? AJ_OK : AJ_ERR_TIMEOUT;
+}
+
+#endif
 
 AJ_Status AJ_StartService(AJ_BusAttachment* bus,
                           const char* daemonName,
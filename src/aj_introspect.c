@@ -26,23 +26,127 @@
 /*
  * The various object lists
  */
-const AJ_Object* objectLists[3] = { AJ_StandardObjects, NULL, NULL };
+AJ_THREAD_LOCAL const AJ_Object* objectLists[3] = { AJ_StandardObjects, NULL, NULL };
 
-#define NUM_REPLY_CONTEXTS   2
+/*
+ * Number of entries in the hash index of object paths that is built when the object lists are
+ * registered. Must be a power of 2 and should be at least twice the total number of objects. Define
+ * this as zero to compile out the index and always search the object lists linearly.
+ */
+#ifndef AJ_OBJ_INDEX_SIZE
+#define AJ_OBJ_INDEX_SIZE 512
+#endif
+
+#if AJ_OBJ_INDEX_SIZE
+
+#if (AJ_OBJ_INDEX_SIZE & (AJ_OBJ_INDEX_SIZE - 1))
+#error "AJ_OBJ_INDEX_SIZE must be a power of 2"
+#endif
+
+/*
+ * Object indices in a message id are 8 bits so lists longer than this are not indexed
+ */
+#define MAX_INDEXED_OBJECTS 256
+
+/*
+ * An entry in the object path index. Entries for the same path are found in object order by
+ * probing linearly from the slot for the path hash.
+ */
+typedef struct _ObjIndexEntry {
+    uint32_t hash;      /* Hash of the object path */
+    uint8_t inUse;      /* Entry is in use */
+    uint8_t oIndex;     /* The object list */
+    uint8_t pIndex;     /* The object in the list */
+} ObjIndexEntry;
+
+static AJ_THREAD_LOCAL ObjIndexEntry objIndex[AJ_OBJ_INDEX_SIZE];
+
+/*
+ * Precomputed results for the walk in SecurityApplies() - one bit per object
+ */
+static AJ_THREAD_LOCAL uint8_t secureParents[ArraySize(objectLists)][MAX_INDEXED_OBJECTS / 8];
+
+static AJ_THREAD_LOCAL uint32_t wildHash;
+static AJ_THREAD_LOCAL uint8_t objIndexValid = FALSE;
+static uint8_t objIndexEnabled = TRUE;
+
+#endif
+
+#if (AJ_NUM_REPLY_CONTEXTS < 1) || (AJ_NUM_REPLY_CONTEXTS > 0xFFFE)
+#error AJ_NUM_REPLY_CONTEXTS must be between 1 and 0xFFFE
+#endif
+
+/*
+ * Number of serial number hash buckets, must be a power of 2. Serial numbers are allocated
+ * sequentially so with at least as many buckets as contexts the chains are almost always short.
+ */
+#ifndef AJ_REPLY_HASH_SIZE
+#define AJ_REPLY_HASH_SIZE      16
+#endif
+
+#if (AJ_REPLY_HASH_SIZE & (AJ_REPLY_HASH_SIZE - 1))
+#error AJ_REPLY_HASH_SIZE must be a power of 2
+#endif
 
 #define DEFAULT_REPLY_TIMEOUT   1000 * 20
 
+#define NO_REPLY_CONTEXT        0xFFFF
+
 /**
  * Struct for a reply context for a method call
  */
 typedef struct _ReplyContext {
-    AJ_Time callTime;    /**< Time the method call was made - used for timeouts */
-    uint32_t timeout;    /**< How long to wait for a reply */
+    uint32_t deadline;   /**< Time in ms relative to replyEpoch when the call times out */
     uint32_t serial;     /**< Serial number for the reply message */
+    AJ_BusAttachment* bus;  /**< The bus the call was sent on, serial numbers are only unique per bus */
     uint32_t messageId;  /**< The unique message id for the call */
+    AJ_ReplyCallback callback;  /**< Callback for an asynchronous call */
+    void* context;       /**< Context pointer for the callback */
+    uint16_t next;       /**< Next context in the hash chain or free list */
+    uint16_t heapPos;    /**< Position of this context in the deadline heap */
+    uint16_t busSlot;    /**< Index of the entry for the bus in replyBuses */
+    uint16_t child;      /**< First child in the deadline heap for the bus */
+    uint16_t sibling;    /**< Next sibling in the deadline heap for the bus */
+    uint16_t prev;       /**< Previous sibling, or the parent of a first child, in the deadline heap for the bus */
 } ReplyContext;
 
-static ReplyContext replyContexts[NUM_REPLY_CONTEXTS];
+/**
+ * Struct for the reply contexts of one bus
+ */
+typedef struct _ReplyBus {
+    AJ_BusAttachment* bus;  /**< The bus */
+    uint16_t root;       /**< Context with the earliest deadline for the bus */
+    uint16_t pending;    /**< Number of contexts for the bus */
+    uint16_t next;       /**< Next bus in the hash chain or free list */
+} ReplyBus;
+
+static AJ_THREAD_LOCAL ReplyContext replyContexts[AJ_NUM_REPLY_CONTEXTS];
+
+/*
+ * Heads of the serial number hash chains
+ */
+static AJ_THREAD_LOCAL uint16_t replyHash[AJ_REPLY_HASH_SIZE];
+
+/*
+ * Min-heap of context indices ordered by deadline
+ */
+static AJ_THREAD_LOCAL uint16_t replyHeap[AJ_NUM_REPLY_CONTEXTS];
+static AJ_THREAD_LOCAL uint16_t replyHeapLen = 0;
+static AJ_THREAD_LOCAL uint16_t replyFree = NO_REPLY_CONTEXT;
+
+/*
+ * Buses with pending calls. Each bus has a pairing heap of its contexts ordered by deadline, there
+ * can never be more buses than contexts.
+ */
+static AJ_THREAD_LOCAL ReplyBus replyBuses[AJ_NUM_REPLY_CONTEXTS];
+static AJ_THREAD_LOCAL uint16_t replyBusHash[AJ_REPLY_HASH_SIZE];
+static AJ_THREAD_LOCAL uint16_t replyBusFree = NO_REPLY_CONTEXT;
+static AJ_THREAD_LOCAL uint8_t replyInit = FALSE;
+
+/*
+ * Deadlines are stored relative to this time
+ */
+static AJ_THREAD_LOCAL AJ_Time replyEpoch;
 
 /**
  * Function used by XML generator to push generated XML
@@ -332,6 +436,117 @@ void WriteXML(void* context, const char* str, uint32_t len)
     }
 }
 
+/*
+ * Introspection XML is cached in a buffer supplied by the application. Entries are appended to the
+ * buffer as objects are introspected, each entry is followed by the XML and for a place-holder
+ * parent object by the path. When the buffer is full XML for any other objects is generated for
+ * each request.
+ */
+typedef struct _XMLCacheEntry {
+    const AJ_Object* obj;   /* The object or NULL for a place-holder parent object */
+    uint32_t xmlLen;        /* Length of the XML following the entry */
+    uint16_t pathLen;       /* Length of the path following the XML for a place-holder parent */
+    uint8_t flags;          /* Flags of the object when the XML was generated */
+} XMLCacheEntry;
+
+#define XML_CACHE_ENTRY_LEN(e) ((sizeof(XMLCacheEntry) + (e)->xmlLen + (e)->pathLen + 7) & ~7)
+
+static AJ_THREAD_LOCAL uint8_t* xmlCache = NULL;
+static AJ_THREAD_LOCAL uint32_t xmlCacheSize = 0;
+static AJ_THREAD_LOCAL uint32_t xmlCacheUsed = 0;
+
+typedef struct _CacheContext {
+    uint8_t* xml;
+    uint32_t len;
+    uint32_t space;
+} CacheContext;
+
+/*
+ * Function to write XML into the cache
+ */
+static void CacheXML(void* context, const char* str, uint32_t len)
+{
+    CacheContext* cctx = (CacheContext*)context;
+    if (!len) {
+        len = (uint32_t)strlen(str);
+    }
+    if ((cctx->len + len) <= cctx->space) {
+        memcpy(cctx->xml + cctx->len, str, len);
+    }
+    cctx->len += len;
+}
+
+void AJ_SetIntrospectionCache(uint8_t* buffer, uint32_t bufLen)
+{
+    /*
+     * Entries contain pointers so must be aligned
+     */
+    uint32_t pad = (uint32_t)((8 - ((size_t)buffer & 7)) & 7);
+
+    if (!buffer || (bufLen <= (pad + sizeof(XMLCacheEntry)))) {
+        xmlCache = NULL;
+        xmlCacheSize = 0;
+    } else {
+        xmlCache = buffer + pad;
+        xmlCacheSize = bufLen - pad;
+    }
+    xmlCacheUsed = 0;
+}
+
+/*
+ * Returns the cached XML for an object generating it if it is not already cached. Returns NULL
+ * if the XML is not cached and will not fit in the cache.
+ */
+static const XMLCacheEntry* GetCachedXML(const AJ_Object* obj, uint8_t placeHolder)
+{
+    XMLCacheEntry* entry;
+    CacheContext context;
+    uint32_t pathLen = placeHolder ? (uint32_t)strlen(obj->path) : 0;
+    uint32_t offset;
+
+    if (!xmlCache) {
+        return NULL;
+    }
+    for (offset = 0; offset < xmlCacheUsed; offset += XML_CACHE_ENTRY_LEN(entry)) {
+        entry = (XMLCacheEntry*)(xmlCache + offset);
+        if (placeHolder) {
+            if (!entry->obj && (entry->pathLen == pathLen) && (memcmp((uint8_t*)(entry + 1) + entry->xmlLen, obj->path, pathLen) == 0)) {
+                return entry;
+            }
+        } else if (entry->obj == obj) {
+            if (entry->flags == obj->flags) {
+                return entry;
+            }
+            /*
+             * The object flags have changed since the XML was generated. This is rare so rather
+             * than managing free space just start over.
+             */
+            xmlCacheUsed = 0;
+            break;
+        }
+    }
+    if ((xmlCacheUsed + sizeof(XMLCacheEntry)) >= xmlCacheSize) {
+        return NULL;
+    }
+    entry = (XMLCacheEntry*)(xmlCache + xmlCacheUsed);
+    context.xml = (uint8_t*)(entry + 1);
+    context.len = 0;
+    context.space = xmlCacheSize - xmlCacheUsed - sizeof(XMLCacheEntry);
+    if ((GenXML(CacheXML, &context, obj, objectLists[1]) != AJ_OK) || ((context.len + pathLen) > context.space)) {
+        return NULL;
+    }
+    memcpy(context.xml + context.len, obj->path, pathLen);
+    entry->obj = placeHolder ? NULL : obj;
+    entry->xmlLen = context.len;
+    entry->pathLen = (uint16_t)pathLen;
+    entry->flags = obj->flags;
+    xmlCacheUsed += XML_CACHE_ENTRY_LEN(entry);
+    if (xmlCacheUsed > xmlCacheSize) {
+        xmlCacheUsed = xmlCacheSize;
+    }
+    return entry;
+}
+
 AJ_Status AJ_HandleIntrospectRequest(const AJ_Message* msg, AJ_Message* reply)
 {
     AJ_Status status = AJ_OK;
@@ -339,6 +554,7 @@ AJ_Status AJ_HandleIntrospectRequest(const AJ_Message* msg, AJ_Message* reply)
     uint32_t children = 0;
     AJ_Object parent;
     WriteContext context;
+    const XMLCacheEntry* cached;
 
     /*
      * Return an error if there are no local objects
@@ -368,20 +584,26 @@ AJ_Status AJ_HandleIntrospectRequest(const AJ_Message* msg, AJ_Message* reply)
     if ((obj->path == NULL) && children) {
         parent.path = msg->objPath;
         parent.interfaces = NULL;
+        parent.flags = 0;
         obj = &parent;
     }
     /*
      * Skip objects that are hidden or disabled
      */
     if (obj->path && !(obj->flags & (AJ_OBJ_FLAG_HIDDEN | AJ_OBJ_FLAG_DISABLED))) {
-        /*
-         * First pass computes the size of the XML string
-         */
-        context.len = 0;
-        status = GenXML(SizeXML, &context.len, obj, objectLists[1]);
-        if (status != AJ_OK) {
-            AJ_Printf("Failed to generate XML - check interface descriptions for errors\n");
-            return status;
+        cached = GetCachedXML(obj, obj == &parent);
+        if (cached) {
+            context.len = cached->xmlLen;
+        } else {
+            /*
+             * First pass computes the size of the XML string
+             */
+            context.len = 0;
+            status = GenXML(SizeXML, &context.len, obj, objectLists[1]);
+            if (status != AJ_OK) {
+                AJ_Printf("Failed to generate XML - check interface descriptions for errors\n");
+                return status;
+            }
         }
         /*
          * Second pass marshals the XML
@@ -400,10 +622,14 @@ AJ_Status AJ_HandleIntrospectRequest(const AJ_Message* msg, AJ_Message* reply)
         }
         if (status == AJ_OK) {
             uint8_t nul = 0;
-            context.status = AJ_OK;
-            context.reply = reply;
-            GenXML(WriteXML, &context, obj, objectLists[1]);
-            status = context.status;
+            if (cached) {
+                status = AJ_MarshalRaw(reply, cached + 1, cached->xmlLen);
+            } else {
+                context.status = AJ_OK;
+                context.reply = reply;
+                GenXML(WriteXML, &context, obj, objectLists[1]);
+                status = context.status;
+            }
             if (status == AJ_OK) {
                 /*
                  * Marshal the terminating NUL
@@ -421,12 +647,29 @@ AJ_Status AJ_HandleIntrospectRequest(const AJ_Message* msg, AJ_Message* reply)
     return status;
 }
 
+/*
+ * Check if an object is a child of a secure parent object
+ */
+static uint32_t SecureParent(const AJ_Object* obj, const AJ_Object* objList)
+{
+    while (objList->path) {
+        if ((objList->flags & AJ_OBJ_FLAG_SECURE) && ChildPath(objList->path, obj->path, NULL)) {
+            return TRUE;
+        }
+        ++objList;
+    }
+    return FALSE;
+}
+
 /*
  * Security applies if the interface is secure or if the object or it's parent object is flagged as
  * secure and the security is not N/A for the interface.
  */
 static uint32_t SecurityApplies(const char* ifc, const AJ_Object* obj, const AJ_Object* objList)
 {
+#if AJ_OBJ_INDEX_SIZE
+    uint8_t oIndex;
+#endif
     if (*ifc == SECURE_TRUE) {
         return TRUE;
     }
@@ -439,13 +682,17 @@ static uint32_t SecurityApplies(const char* ifc, const AJ_Object* obj, const AJ_
     /*
      * Check that obj is not a child of a secure parent object
      */
-    while (objList->path) {
-        if ((objList->flags & AJ_OBJ_FLAG_SECURE) && ChildPath(objList->path, obj->path, NULL)) {
-            return TRUE;
+#if AJ_OBJ_INDEX_SIZE
+    if (objIndexValid) {
+        for (oIndex = 0; oIndex < ArraySize(objectLists); ++oIndex) {
+            if (objList == objectLists[oIndex]) {
+                uint8_t pIndex = (uint8_t)(obj - objList);
+                return (secureParents[oIndex][pIndex / 8] >> (pIndex % 8)) & 1;
+            }
         }
-        ++objList;
     }
-    return FALSE;
+#endif
+    return SecureParent(obj, objList);
 }
 
 /*
@@ -567,6 +814,39 @@ static AJ_InterfaceDescription FindInterface(const AJ_InterfaceDescription* inte
     return NULL;
 }
 
+/*
+ * Match the interface and member of a message to an object
+ */
+static AJ_Status MatchObject(const AJ_Object* list, uint8_t pIndex, AJ_Message* msg, uint8_t* secure)
+{
+    const AJ_Object* obj = &list[pIndex];
+    uint8_t iIndex;
+    AJ_InterfaceDescription desc;
+
+    if (obj->flags & AJ_OBJ_FLAG_DISABLED) {
+        return AJ_ERR_NO_MATCH;
+    }
+    desc = FindInterface(obj->interfaces, msg->iface, &iIndex);
+    if (desc) {
+        uint8_t mIndex = 0;
+        *secure = SecurityApplies(*desc, obj, list);
+        /*
+         * Skip the interface name and iterate over the members of the interface
+         */
+        while (*(++desc)) {
+            if (MatchMember(*desc, msg)) {
+                AJ_Status status = CheckSignature(*desc, msg);
+                if (status == AJ_OK) {
+                    msg->msgId = (pIndex << 16) | (iIndex << 8) | mIndex;
+                }
+                return status;
+            }
+            ++mIndex;
+        }
+    }
+    return AJ_ERR_NO_MATCH;
+}
+
 static AJ_Status LookupMessageId(const AJ_Object* list, AJ_Message* msg, uint8_t* secure)
 {
     const AJ_Object* obj = list;
@@ -577,25 +857,10 @@ static AJ_Status LookupMessageId(const AJ_Object* list, AJ_Message* msg, uint8_t
              * Match the object path. The wildcard entry is for interfaces that are automatically
              * defined for all objects; specifically to support the introspection and ping methods.
              */
-            if (!(obj->flags & AJ_OBJ_FLAG_DISABLED) && ((obj->path[0] == '*') || (strcmp(obj->path, msg->objPath) == 0))) {
-                uint8_t iIndex;
-                AJ_InterfaceDescription desc = FindInterface(obj->interfaces, msg->iface, &iIndex);
-                if (desc) {
-                    uint8_t mIndex = 0;
-                    *secure = SecurityApplies(*desc, obj, list);
-                    /*
-                     * Skip the interface name and iterate over the members of the interface
-                     */
-                    while (*(++desc)) {
-                        if (MatchMember(*desc, msg)) {
-                            AJ_Status status = CheckSignature(*desc, msg);
-                            if (status == AJ_OK) {
-                                msg->msgId = (pIndex << 16) | (iIndex << 8) | mIndex;
-                            }
-                            return status;
-                        }
-                        ++mIndex;
-                    }
+            if ((obj->path[0] == '*') || (strcmp(obj->path, msg->objPath) == 0)) {
+                AJ_Status status = MatchObject(list, pIndex, msg, secure);
+                if (status != AJ_ERR_NO_MATCH) {
+                    return status;
                 }
             }
             ++pIndex;
@@ -605,6 +870,129 @@ static AJ_Status LookupMessageId(const AJ_Object* list, AJ_Message* msg, uint8_t
     return AJ_ERR_NO_MATCH;
 }
 
+#if AJ_OBJ_INDEX_SIZE
+
+/*
+ * FNV-1a hash of an object path
+ */
+static uint32_t PathHash(const char* path)
+{
+    uint32_t hash = 2166136261u;
+    while (*path) {
+        hash = (hash ^ (uint8_t)*path++) * 16777619u;
+    }
+    return hash;
+}
+
+/*
+ * Returns the next object in a list that has a specific path, or the next wildcard object if path
+ * is NULL, starting from index slot *pos in the object index. Returns -1 if there are no more.
+ */
+static int32_t NextIndexedObject(uint8_t oIndex, uint32_t hash, const char* path, uint32_t* pos)
+{
+    while (objIndex[*pos].inUse) {
+        const ObjIndexEntry* entry = &objIndex[*pos];
+        *pos = (*pos + 1) & (AJ_OBJ_INDEX_SIZE - 1);
+        if ((entry->hash == hash) && (entry->oIndex == oIndex)) {
+            const char* objPath = objectLists[oIndex][entry->pIndex].path;
+            if (path ? ((objPath[0] != '*') && (strcmp(objPath, path) == 0)) : (objPath[0] == '*')) {
+                return entry->pIndex;
+            }
+        }
+    }
+    return -1;
+}
+
+/*
+ * Same as LookupMessageId() but the objects to match are found from the object index. Objects
+ * with the matching path and wildcard objects are matched in the same order as they appear in the
+ * list.
+ */
+static AJ_Status LookupIndexedMessageId(uint8_t oIndex, uint32_t hash, AJ_Message* msg, uint8_t* secure)
+{
+    uint32_t pathPos = hash & (AJ_OBJ_INDEX_SIZE - 1);
+    uint32_t wildPos = wildHash & (AJ_OBJ_INDEX_SIZE - 1);
+    int32_t path = NextIndexedObject(oIndex, hash, msg->objPath, &pathPos);
+    int32_t wild = NextIndexedObject(oIndex, wildHash, NULL, &wildPos);
+
+    while ((path >= 0) || (wild >= 0)) {
+        AJ_Status status;
+        if ((wild < 0) || ((path >= 0) && (path < wild))) {
+            status = MatchObject(objectLists[oIndex], (uint8_t)path, msg, secure);
+            path = NextIndexedObject(oIndex, hash, msg->objPath, &pathPos);
+        } else {
+            status = MatchObject(objectLists[oIndex], (uint8_t)wild, msg, secure);
+            wild = NextIndexedObject(oIndex, wildHash, NULL, &wildPos);
+        }
+        if (status != AJ_ERR_NO_MATCH) {
+            return status;
+        }
+    }
+    return AJ_ERR_NO_MATCH;
+}
+
+/*
+ * Build the object path index and the secure parent bits. If the lists are too long to index the
+ * index is left invalid and the lists are searched linearly.
+ */
+static void BuildObjectIndex(void)
+{
+    uint32_t total = 0;
+    uint8_t oIndex;
+
+    memset(objIndex, 0, sizeof(objIndex));
+    memset(secureParents, 0, sizeof(secureParents));
+    objIndexValid = FALSE;
+    wildHash = PathHash("*");
+
+    if (!objIndexEnabled) {
+        return;
+    }
+    for (oIndex = 0; oIndex < ArraySize(objectLists); ++oIndex) {
+        const AJ_Object* list = objectLists[oIndex];
+        uint32_t pIndex;
+        if (!list) {
+            continue;
+        }
+        for (pIndex = 0; list[pIndex].path; ++pIndex) {
+            /*
+             * All wildcard objects are indexed under the same hash
+             */
+            uint32_t hash = (list[pIndex].path[0] == '*') ? wildHash : PathHash(list[pIndex].path);
+            uint32_t pos = hash & (AJ_OBJ_INDEX_SIZE - 1);
+            /*
+             * Keep the load factor below 3/4
+             */
+            if ((pIndex >= MAX_INDEXED_OBJECTS) || (++total > ((AJ_OBJ_INDEX_SIZE * 3) / 4))) {
+                AJ_Printf("Object lists too long to index\n");
+                memset(objIndex, 0, sizeof(objIndex));
+                return;
+            }
+            while (objIndex[pos].inUse) {
+                pos = (pos + 1) & (AJ_OBJ_INDEX_SIZE - 1);
+            }
+            objIndex[pos].hash = hash;
+            objIndex[pos].inUse = TRUE;
+            objIndex[pos].oIndex = oIndex;
+            objIndex[pos].pIndex = (uint8_t)pIndex;
+            if (SecureParent(&list[pIndex], list)) {
+                secureParents[oIndex][pIndex / 8] |= (1 << (pIndex % 8));
+            }
+        }
+    }
+    objIndexValid = TRUE;
+}
+
+#endif
+
+void AJ_EnableObjectIndex(uint8_t enable)
+{
+#if AJ_OBJ_INDEX_SIZE
+    objIndexEnabled = enable;
+    BuildObjectIndex();
+#endif
+}
+
 #ifndef NDEBUG
 /*
  * Validates an index into a NULL terminated array
@@ -723,7 +1111,7 @@ AJ_Status AJ_InitMessageFromMsgId(AJ_Message* msg, uint32_t msgId, uint8_t msgTy
      * allows up to 255 characters in a signature but that would represent an outgrageously complex
      * message argument list.
      */
-    static char msgSignature[32];
+    static AJ_THREAD_LOCAL char msgSignature[32];
     AJ_Status status = AJ_OK;
 
 #ifndef NDEBUG
@@ -807,16 +1195,226 @@ static AJ_Status CheckReturnSignature(AJ_Message* msg, uint32_t msgId)
     return status;
 }
 
-static ReplyContext* FindReplyContext(uint32_t serial) {
-    size_t i;
-    for (i = 0; i < ArraySize(replyContexts); ++i) {
-        if (replyContexts[i].serial == serial) {
-            return &replyContexts[i];
+#define REPLY_HASH(serial) ((serial) & (AJ_REPLY_HASH_SIZE - 1))
+
+#define BUS_HASH(bus) REPLY_HASH((size_t)(bus) >> 4)
+
+/*
+ * Deadlines wrap so are compared by the sign of the difference
+ */
+#define DEADLINE_BEFORE(a, b) ((int32_t)((a) - (b)) < 0)
+
+static void InitReplyContexts(void)
+{
+    uint16_t i;
+
+    for (i = 0; i < AJ_NUM_REPLY_CONTEXTS; ++i) {
+        replyContexts[i].serial = 0;
+        replyContexts[i].next = (i + 1 < AJ_NUM_REPLY_CONTEXTS) ? i + 1 : NO_REPLY_CONTEXT;
+        replyBuses[i].next = replyContexts[i].next;
+    }
+    for (i = 0; i < AJ_REPLY_HASH_SIZE; ++i) {
+        replyHash[i] = NO_REPLY_CONTEXT;
+        replyBusHash[i] = NO_REPLY_CONTEXT;
+    }
+    replyFree = 0;
+    replyBusFree = 0;
+    replyHeapLen = 0;
+    AJ_InitTimer(&replyEpoch);
+    replyInit = TRUE;
+}
+
+static void HeapSet(uint16_t pos, uint16_t ctx)
+{
+    replyHeap[pos] = ctx;
+    replyContexts[ctx].heapPos = pos;
+}
+
+static void HeapSiftUp(uint16_t pos)
+{
+    uint16_t ctx = replyHeap[pos];
+    uint32_t deadline = replyContexts[ctx].deadline;
+
+    while (pos) {
+        uint16_t parent = (pos - 1) / 2;
+        if (!DEADLINE_BEFORE(deadline, replyContexts[replyHeap[parent]].deadline)) {
+            break;
+        }
+        HeapSet(pos, replyHeap[parent]);
+        pos = parent;
+    }
+    HeapSet(pos, ctx);
+}
+
+static void HeapSiftDown(uint16_t pos)
+{
+    uint16_t ctx = replyHeap[pos];
+    uint32_t deadline = replyContexts[ctx].deadline;
+
+    for (;;) {
+        uint32_t child = 2 * (uint32_t)pos + 1;
+        if (child >= replyHeapLen) {
+            break;
+        }
+        if ((child + 1 < replyHeapLen) && DEADLINE_BEFORE(replyContexts[replyHeap[child + 1]].deadline, replyContexts[replyHeap[child]].deadline)) {
+            ++child;
+        }
+        if (!DEADLINE_BEFORE(replyContexts[replyHeap[child]].deadline, deadline)) {
+            break;
+        }
+        HeapSet(pos, replyHeap[child]);
+        pos = (uint16_t)child;
+    }
+    HeapSet(pos, ctx);
+}
+
+/*
+ * Links two pairing heap roots, the later one becomes the first child of the earlier one
+ */
+static uint16_t PairMeld(uint16_t a, uint16_t b)
+{
+    uint16_t t;
+
+    if (a == NO_REPLY_CONTEXT) {
+        return b;
+    }
+    if (b == NO_REPLY_CONTEXT) {
+        return a;
+    }
+    if (DEADLINE_BEFORE(replyContexts[b].deadline, replyContexts[a].deadline)) {
+        t = a;
+        a = b;
+        b = t;
+    }
+    replyContexts[b].prev = a;
+    replyContexts[b].sibling = replyContexts[a].child;
+    if (replyContexts[a].child != NO_REPLY_CONTEXT) {
+        replyContexts[replyContexts[a].child].prev = b;
+    }
+    replyContexts[a].child = b;
+    return a;
+}
+
+/*
+ * Combines a list of siblings into one pairing heap, melding pairs left to right then the pairs
+ * right to left.
+ */
+static uint16_t PairMergeSiblings(uint16_t first)
+{
+    uint16_t pairs = NO_REPLY_CONTEXT;
+    uint16_t root = NO_REPLY_CONTEXT;
+
+    while (first != NO_REPLY_CONTEXT) {
+        uint16_t a = first;
+        uint16_t b = replyContexts[a].sibling;
+
+        first = (b == NO_REPLY_CONTEXT) ? NO_REPLY_CONTEXT : replyContexts[b].sibling;
+        replyContexts[a].sibling = replyContexts[a].prev = NO_REPLY_CONTEXT;
+        if (b != NO_REPLY_CONTEXT) {
+            replyContexts[b].sibling = replyContexts[b].prev = NO_REPLY_CONTEXT;
+            a = PairMeld(a, b);
+        }
+        /*
+         * The sibling link of a root is free so is used to stack the pairs
+         */
+        replyContexts[a].sibling = pairs;
+        pairs = a;
+    }
+    while (pairs != NO_REPLY_CONTEXT) {
+        uint16_t next = replyContexts[pairs].sibling;
+        replyContexts[pairs].sibling = NO_REPLY_CONTEXT;
+        root = PairMeld(root, pairs);
+        pairs = next;
+    }
+    return root;
+}
+
+static void PairRemove(ReplyBus* replyBus, uint16_t ctx)
+{
+    ReplyContext* repCtx = &replyContexts[ctx];
+
+    if (ctx == replyBus->root) {
+        replyBus->root = PairMergeSiblings(repCtx->child);
+    } else {
+        if (replyContexts[repCtx->prev].child == ctx) {
+            replyContexts[repCtx->prev].child = repCtx->sibling;
+        } else {
+            replyContexts[repCtx->prev].sibling = repCtx->sibling;
+        }
+        if (repCtx->sibling != NO_REPLY_CONTEXT) {
+            replyContexts[repCtx->sibling].prev = repCtx->prev;
+        }
+        replyBus->root = PairMeld(replyBus->root, PairMergeSiblings(repCtx->child));
+    }
+}
+
+static uint16_t FindReplyBus(const AJ_BusAttachment* bus)
+{
+    uint16_t i;
+
+    for (i = replyBusHash[BUS_HASH(bus)]; i != NO_REPLY_CONTEXT; i = replyBuses[i].next) {
+        if (replyBuses[i].bus == bus) {
+            break;
+        }
+    }
+    return i;
+}
+
+static ReplyContext* FindReplyContext(const AJ_BusAttachment* bus, uint32_t serial)
+{
+    uint16_t i;
+
+    if (replyInit) {
+        for (i = replyHash[REPLY_HASH(serial)]; i != NO_REPLY_CONTEXT; i = replyContexts[i].next) {
+            if ((replyContexts[i].serial == serial) && (replyContexts[i].bus == bus)) {
+                return &replyContexts[i];
+            }
         }
     }
     return NULL;
 }
 
+static void ReleaseReplyContext(ReplyContext* repCtx)
+{
+    uint16_t ctx = (uint16_t)(repCtx - replyContexts);
+    uint16_t* link = &replyHash[REPLY_HASH(repCtx->serial)];
+    uint16_t pos = repCtx->heapPos;
+    ReplyBus* replyBus = &replyBuses[repCtx->busSlot];
+
+    /*
+     * Unlink from the hash chain
+     */
+    while (*link != ctx) {
+        link = &replyContexts[*link].next;
+    }
+    *link = repCtx->next;
+    /*
+     * Remove from the heap for the bus and drop the bus when it has no more pending calls
+     */
+    PairRemove(replyBus, ctx);
+    if (--replyBus->pending == 0) {
+        link = &replyBusHash[BUS_HASH(replyBus->bus)];
+        while (*link != repCtx->busSlot) {
+            link = &replyBuses[*link].next;
+        }
+        *link = replyBus->next;
+        replyBus->next = replyBusFree;
+        replyBusFree = repCtx->busSlot;
+    }
+    /*
+     * Remove from the heap by moving the last entry into the vacated position
+     */
+    if (--replyHeapLen != pos) {
+        uint16_t last = replyHeap[replyHeapLen];
+        HeapSet(pos, last);
+        HeapSiftDown(pos);
+        HeapSiftUp(replyContexts[last].heapPos);
+    }
+    repCtx->serial = 0;
+    repCtx->next = replyFree;
+    replyFree = ctx;
+}
+
 AJ_Status AJ_UnmarshalPropertyArgs(AJ_Message* msg, uint32_t* propId, char* sig, size_t len)
 {
     AJ_Status status = AJ_ERR_NO_MATCH;
@@ -878,12 +1476,23 @@ AJ_Status AJ_IdentifyMessage(AJ_Message* msg)
     msg->msgId = AJ_INVALID_MSG_ID;
     if ((msg->hdr->msgType == AJ_MSG_METHOD_CALL) || (msg->hdr->msgType == AJ_MSG_SIGNAL)) {
         uint32_t oIndex;
+#if AJ_OBJ_INDEX_SIZE
+        uint32_t hash = objIndexValid ? PathHash(msg->objPath) : 0;
+#endif
         /*
          * Methods and signals
          */
         for (oIndex = 0; oIndex < ArraySize(objectLists); ++oIndex) {
             secure = FALSE;
+#if AJ_OBJ_INDEX_SIZE
+            if (objIndexValid) {
+                status = LookupIndexedMessageId((uint8_t)oIndex, hash, msg, &secure);
+            } else {
+                status = LookupMessageId(objectLists[oIndex], msg, &secure);
+            }
+#else
             status = LookupMessageId(objectLists[oIndex], msg, &secure);
+#endif
             if (status == AJ_OK) {
                 msg->msgId |= (oIndex << 24);
                 AJ_Printf("Identified message %x\n", msg->msgId);
@@ -903,13 +1512,15 @@ AJ_Status AJ_IdentifyMessage(AJ_Message* msg)
             status = AJ_DeliverMsg(&reply);
         }
     } else {
-        ReplyContext* repCtx = FindReplyContext(msg->replySerial);
+        ReplyContext* repCtx = FindReplyContext(msg->bus, msg->replySerial);
         if (repCtx) {
             status = CheckReturnSignature(msg, repCtx->messageId);
+            msg->callback = repCtx->callback;
+            msg->callbackContext = repCtx->context;
             /*
              * Release the reply context
              */
-            repCtx->serial = 0;
+            ReleaseReplyContext(repCtx);
         }
     }
     return status;
@@ -919,6 +1530,17 @@ void AJ_RegisterObjects(const AJ_Object* localObjects, const AJ_Object* proxyObj
 {
     objectLists[AJ_APP_ID_FLAG] = localObjects;
     objectLists[AJ_PRX_ID_FLAG] = proxyObjects;
+    xmlCacheUsed = 0;
+#if AJ_OBJ_INDEX_SIZE
+    BuildObjectIndex();
+#endif
+    AJ_InvalidateHeaderTemplates();
+}
+
+void AJ_GetRegisteredObjects(const AJ_Object** localObjects, const AJ_Object** proxyObjects)
+{
+    *localObjects = objectLists[AJ_APP_ID_FLAG];
+    *proxyObjects = objectLists[AJ_PRX_ID_FLAG];
 }
 
 AJ_Status AJ_SetProxyObjectPath(AJ_Object* proxyObjects, uint32_t msgId, const char* objPath)
@@ -936,10 +1558,19 @@ AJ_Status AJ_SetProxyObjectPath(AJ_Object* proxyObjects, uint32_t msgId, const c
         }
     }
     proxyObjects[pIndex].path = objPath;
+#if AJ_OBJ_INDEX_SIZE
+    BuildObjectIndex();
+#endif
+    AJ_InvalidateHeaderTemplates();
     return AJ_OK;
 }
 
 AJ_Status AJ_AllocReplyContext(AJ_Message* msg, uint32_t timeout)
+{
+    return AJ_AllocAsyncReplyContext(msg, timeout, NULL, NULL);
+}
+
+AJ_Status AJ_AllocAsyncReplyContext(AJ_Message* msg, uint32_t timeout, AJ_ReplyCallback callback, void* context)
 {
     if (msg->hdr->flags & AJ_FLAG_NO_REPLY_EXPECTED) {
         /*
@@ -947,55 +1578,176 @@ AJ_Status AJ_AllocReplyContext(AJ_Message* msg, uint32_t timeout)
          */
         return AJ_OK;
     } else {
-        ReplyContext* repCtx = FindReplyContext(0);
+        ReplyContext* repCtx;
+        ReplyBus* replyBus;
+        uint16_t ctx;
+        uint16_t busSlot;
 
         AJ_ASSERT(msg->hdr->msgType == AJ_MSG_METHOD_CALL);
 
-        if (repCtx) {
-            repCtx->serial = msg->hdr->serialNum;
-            repCtx->messageId = msg->msgId;
-            repCtx->timeout = timeout ? timeout : DEFAULT_REPLY_TIMEOUT;
-            AJ_InitTimer(&repCtx->callTime);
-            return AJ_OK;
-        } else {
+        if (!replyInit) {
+            InitReplyContexts();
+        }
+        if (replyFree == NO_REPLY_CONTEXT) {
             AJ_Printf("Failed to allocate a reply context\n");
             return AJ_ERR_RESOURCES;
         }
+        ctx = replyFree;
+        repCtx = &replyContexts[ctx];
+        replyFree = repCtx->next;
+        repCtx->serial = msg->hdr->serialNum;
+        repCtx->bus = msg->bus;
+        repCtx->messageId = msg->msgId;
+        repCtx->callback = callback;
+        repCtx->context = context;
+        repCtx->deadline = AJ_GetElapsedTime(&replyEpoch, TRUE) + (timeout ? timeout : DEFAULT_REPLY_TIMEOUT);
+        repCtx->next = replyHash[REPLY_HASH(repCtx->serial)];
+        replyHash[REPLY_HASH(repCtx->serial)] = ctx;
+        HeapSet(replyHeapLen, ctx);
+        HeapSiftUp(replyHeapLen++);
+        /*
+         * There is always a free bus entry if there was a free context
+         */
+        busSlot = FindReplyBus(msg->bus);
+        if (busSlot == NO_REPLY_CONTEXT) {
+            busSlot = replyBusFree;
+            replyBus = &replyBuses[busSlot];
+            replyBusFree = replyBus->next;
+            replyBus->bus = msg->bus;
+            replyBus->root = NO_REPLY_CONTEXT;
+            replyBus->pending = 0;
+            replyBus->next = replyBusHash[BUS_HASH(msg->bus)];
+            replyBusHash[BUS_HASH(msg->bus)] = busSlot;
+        } else {
+            replyBus = &replyBuses[busSlot];
+        }
+        repCtx->busSlot = busSlot;
+        repCtx->child = repCtx->sibling = repCtx->prev = NO_REPLY_CONTEXT;
+        replyBus->root = PairMeld(replyBus->root, ctx);
+        ++replyBus->pending;
+        return AJ_OK;
     }
 }
 
 void AJ_ReleaseReplyContext(AJ_Message* msg)
 {
     if (msg->hdr->msgType == AJ_MSG_METHOD_CALL) {
-        ReplyContext* repCtx = FindReplyContext(msg->hdr->serialNum);
+        ReplyContext* repCtx = FindReplyContext(msg->bus, msg->hdr->serialNum);
         if (repCtx) {
-            repCtx->serial = 0;
+            ReleaseReplyContext(repCtx);
         }
     }
 }
 
+/*
+ * Returns the context with the earliest deadline for a bus
+ */
+static ReplyContext* EarliestReplyContext(const AJ_BusAttachment* bus)
+{
+    uint16_t busSlot = replyInit ? FindReplyBus(bus) : NO_REPLY_CONTEXT;
+
+    return (busSlot == NO_REPLY_CONTEXT) ? NULL : &replyContexts[replyBuses[busSlot].root];
+}
+
 uint8_t AJ_TimedOutMethodCall(AJ_Message* msg)
 {
-    ReplyContext* repCtx = replyContexts;
-    size_t i;
-    for (i = 0; i < ArraySize(replyContexts); ++i, ++repCtx) {
-        if (repCtx->serial && (AJ_GetElapsedTime(&repCtx->callTime, TRUE) > repCtx->timeout)) {
-            /*
-             * Set the reply serial and message id for the timeout error
-             */
-            msg->replySerial = repCtx->serial;
-            msg->msgId = AJ_REPLY_ID(repCtx->messageId);
-            /*
-             * Release the reply context
-             */
-            repCtx->serial = 0;
-            return TRUE;
-        }
+    ReplyContext* repCtx;
+    uint32_t now;
+
+    if (!replyHeapLen) {
+        return FALSE;
+    }
+    /*
+     * Nothing has timed out if the earliest deadline on any bus has not passed
+     */
+    now = AJ_GetElapsedTime(&replyEpoch, TRUE);
+    if (DEADLINE_BEFORE(now, replyContexts[replyHeap[0]].deadline + 1)) {
+        return FALSE;
+    }
+    repCtx = EarliestReplyContext(msg->bus);
+    if (repCtx && !DEADLINE_BEFORE(now, repCtx->deadline + 1)) {
+        /*
+         * Set the reply serial and message id for the timeout error
+         */
+        msg->replySerial = repCtx->serial;
+        msg->msgId = AJ_REPLY_ID(repCtx->messageId);
+        msg->callback = repCtx->callback;
+        msg->callbackContext = repCtx->context;
+        /*
+         * Release the reply context
+         */
+        ReleaseReplyContext(repCtx);
+        return TRUE;
     }
     return FALSE;
 }
 
-void AJ_ReleaseReplyContexts(void)
+AJ_BusAttachment* AJ_TimedOutBus(void)
+{
+    if (replyHeapLen) {
+        ReplyContext* repCtx = &replyContexts[replyHeap[0]];
+        if (!DEADLINE_BEFORE(AJ_GetElapsedTime(&replyEpoch, TRUE), repCtx->deadline + 1)) {
+            return repCtx->bus;
+        }
+    }
+    return NULL;
+}
+
+uint32_t AJ_ReplyTimeout(uint32_t timeout)
 {
-    memset(replyContexts, 0, sizeof(replyContexts));
+    if (replyHeapLen) {
+        int32_t remaining = (int32_t)(replyContexts[replyHeap[0]].deadline + 1 - AJ_GetElapsedTime(&replyEpoch, TRUE));
+        if (remaining <= 0) {
+            return 0;
+        }
+        if ((uint32_t)remaining < timeout) {
+            return (uint32_t)remaining;
+        }
+    }
+    return timeout;
+}
+
+void AJ_ReleaseReplyContexts(AJ_BusAttachment* bus)
+{
+    uint32_t pending = replyHeapLen;
+    ReplyContext* repCtx;
+
+    if (!replyInit) {
+        InitReplyContexts();
+        return;
+    }
+    if (bus) {
+        uint16_t busSlot = FindReplyBus(bus);
+        pending = (busSlot == NO_REPLY_CONTEXT) ? 0 : replyBuses[busSlot].pending;
+    }
+    /*
+     * Asynchronous calls are told they will not get a reply. Calls made from the callbacks are
+     * released without being reported.
+     */
+    while (pending--) {
+        AJ_ReplyCallback callback;
+        void* context;
+
+        if (bus) {
+            repCtx = EarliestReplyContext(bus);
+        } else {
+            repCtx = replyHeapLen ? &replyContexts[replyHeap[0]] : NULL;
+        }
+        if (!repCtx) {
+            break;
+        }
+        callback = repCtx->callback;
+        context = repCtx->context;
+        ReleaseReplyContext(repCtx);
+        if (callback) {
+            callback(NULL, context);
+        }
+    }
+    if (bus) {
+        while ((repCtx = EarliestReplyContext(bus)) != NULL) {
+            ReleaseReplyContext(repCtx);
+        }
+    } else {
+        InitReplyContexts();
+    }
 }
@@ -33,8 +33,8 @@ typedef struct _AJ_BusLinkWatcher {
     AJ_Time pingTimer;                   /**< Timer for tracking probe request packets */
 } AJ_BusLinkWatcher;
 
-static uint32_t busLinkTimeout;          /**< Timeout value for the link to the daemon bus */
-static AJ_BusLinkWatcher busLinkWatcher; /**< Data structure that maintains information for tracking the link to the daemon bus */
+static AJ_THREAD_LOCAL uint32_t busLinkTimeout;          /**< Timeout value for the link to the daemon bus */
+static AJ_THREAD_LOCAL AJ_BusLinkWatcher busLinkWatcher; /**< Data structure that maintains information for tracking the link to the daemon bus */
 
 /**
  * Forward declaration
@@ -142,7 +142,7 @@ static const uint8_t TypeFlags[] = {
  * Checks that the current message is closed
  */
 #ifndef NDEBUG
-static AJ_Message* currentMsg = NULL;
+static AJ_THREAD_LOCAL AJ_Message* currentMsg = NULL;
 #endif
 
 static void InitArg(AJ_Arg* arg, uint8_t typeId, const void* val)
@@ -168,45 +168,10 @@ static uint32_t PadForType(char typeId, AJ_IOBuffer* ioBuf)
     return (alignment - offset) & (alignment - 1);
 }
 
-#define ENDSWAP16(v) (((v) >> 8) | ((v) << 8))
-#define ENDSWAP32(v) (((v) >> 24) | (((v) & 0xFF0000) >> 8) | (((v) & 0x00FF00) << 8) | ((v) << 24))
-
 static void EndianSwap(AJ_Message* msg, uint8_t typeId, void* data, uint32_t num)
 {
     if (msg->hdr->endianess != HOST_ENDIANESS) {
-        switch (SizeOfType(typeId)) {
-        case 2:
-            {
-                uint16_t* p = (uint16_t*)data;
-                while (num--) {
-                    uint16_t v = *p;
-                    *p++ = ENDSWAP16(v);
-                }
-            }
-            break;
-
-        case 4:
-            {
-                uint32_t* p = (uint32_t*)data;
-                while (num--) {
-                    uint32_t v = *p;
-                    *p++ = ENDSWAP32(v);
-                }
-            }
-            break;
-
-        case 8:
-            {
-                uint32_t* p = (uint32_t*)data;
-                while (num--) {
-                    uint32_t v = p[0];
-                    uint32_t u = p[1];
-                    *p++ = ENDSWAP32(u);
-                    *p++ = ENDSWAP32(v);
-                }
-            }
-            break;
-        }
+        AJ_SwapBytes(data, SizeOfType(typeId), num);
     }
 }
 
@@ -232,7 +197,7 @@ static AJ_Status DecryptMessage(AJ_Message* msg)
 {
     AJ_IOBuffer* ioBuf = &msg->bus->sock.rx;
     AJ_Status status;
-    uint8_t key[16];
+    const AJ_KeySchedule* key;
     uint8_t nonce[5];
     uint8_t role = AJ_ROLE_KEY_UNDEFINED;
     uint32_t mlen = MessageLen(msg);
@@ -248,9 +213,9 @@ static AJ_Status DecryptMessage(AJ_Message* msg)
      * Use the group key for multicast and broadcast signals the session key otherwise.
      */
     if ((msg->hdr->msgType == AJ_MSG_SIGNAL) && !msg->destination) {
-        status = AJ_GetGroupKey(msg->sender, key);
+        status = AJ_GetGroupKeySchedule(msg->sender, &key);
     } else {
-        status = AJ_GetSessionKey(msg->sender, key, &role);
+        status = AJ_GetSessionKeySchedule(msg->sender, &key, &role);
         /*
          * We use the oppsite role when decrypting.
          */
@@ -260,7 +225,7 @@ static AJ_Status DecryptMessage(AJ_Message* msg)
         status = AJ_ERR_SECURITY;
     } else {
         InitNonce(msg, role, nonce);
-        status = AJ_Decrypt_CCM(key, ioBuf->bufStart, mlen - MAC_LENGTH, hLen, MAC_LENGTH, nonce, sizeof(nonce));
+        status = AJ_Decrypt_CCM_Key(key, ioBuf->bufStart, mlen - MAC_LENGTH, hLen, MAC_LENGTH, nonce, sizeof(nonce));
     }
     return status;
 }
@@ -269,7 +234,7 @@ static AJ_Status EncryptMessage(AJ_Message* msg)
 {
     AJ_IOBuffer* ioBuf = &msg->bus->sock.tx;
     AJ_Status status;
-    uint8_t key[16];
+    const AJ_KeySchedule* key;
     uint8_t nonce[5];
     uint8_t role = AJ_ROLE_KEY_UNDEFINED;
     uint32_t mlen = MessageLen(msg);
@@ -287,15 +252,15 @@ static AJ_Status EncryptMessage(AJ_Message* msg)
      * Use the group key for multicast and broadcast signals the session key otherwise.
      */
     if ((msg->hdr->msgType == AJ_MSG_SIGNAL) && !msg->destination) {
-        status = AJ_GetGroupKey(NULL, key);
+        status = AJ_GetGroupKeySchedule(NULL, &key);
     } else {
-        status = AJ_GetSessionKey(msg->destination, key, &role);
+        status = AJ_GetSessionKeySchedule(msg->destination, &key, &role);
     }
     if (status != AJ_OK) {
         status = AJ_ERR_SECURITY;
     } else {
         InitNonce(msg, role, nonce);
-        status = AJ_Encrypt_CCM(key, ioBuf->bufStart, mlen, hlen, MAC_LENGTH, nonce, sizeof(nonce));
+        status = AJ_Encrypt_CCM_Key(key, ioBuf->bufStart, mlen, hlen, MAC_LENGTH, nonce, sizeof(nonce));
     }
     return status;
 }
@@ -328,6 +293,9 @@ AJ_Status AJ_DeliverMsg(AJ_Message* msg)
     if (status == AJ_OK) {
         //#pragma calls = AJ_Net_Send
         status = ioBuf->send(ioBuf);
+        if (status == AJ_OK) {
+            ++ioBuf->messages;
+        }
     }
     memset(msg, 0, sizeof(AJ_Message));
     return status;
@@ -422,6 +390,14 @@ static AJ_Status WriteBytes(AJ_Message* msg, const void* data, size_t numBytes,
  */
 #define WritePad(msg, pad) WriteBytes(msg, NULL, 0, pad)
 
+/*
+ * Raw data of at least this many bytes is sent without copying if the transport supports
+ * scatter-gather sends. Smaller amounts are cheaper to copy into the transmit buffer.
+ */
+#ifndef AJ_SENDV_THRESHOLD
+#define AJ_SENDV_THRESHOLD 256
+#endif
+
 
 AJ_Status AJ_CloseMsg(AJ_Message* msg)
 {
@@ -552,7 +528,7 @@ static AJ_Status UnmarshalArray(AJ_Message* msg, const char** sig, AJ_Arg* arg,
         /*
          * For scalar types we do an inplace endian swap (if needed) and return a pointer into the read buffer.
          */
-        EndianSwap(msg, typeId, (void*)arg->val.v_data, arg->len);
+        EndianSwap(msg, typeId, (void*)arg->val.v_data, numBytes / SizeOfType(typeId));
         ioBuf->readPtr += numBytes;
         arg->typeId = typeId;
         arg->flags = AJ_ARRAY_FLAG;
@@ -651,6 +627,22 @@ static AJ_Status Unmarshal(AJ_Message* msg, const char** sig, AJ_Arg* arg)
 
 static const AJ_MsgHeader internalErrorHdr = { HOST_ENDIANESS, AJ_MSG_ERROR, 0, 0, 0, 1, 0 };
 
+/*
+ * If a method call has timed out turn the message into an internal error reply to the call so the
+ * application can proceed.
+ */
+static uint8_t TimedOutReply(AJ_Message* msg)
+{
+    if (AJ_TimedOutMethodCall(msg)) {
+        msg->hdr = (AJ_MsgHeader*)&internalErrorHdr;
+        msg->error = AJ_ErrTimeout;
+        msg->sender = AJ_GetUniqueName(msg->bus);
+        msg->destination = msg->sender;
+        return TRUE;
+    }
+    return FALSE;
+}
+
 AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeout)
 {
     AJ_Status status;
@@ -671,19 +663,18 @@ AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeo
      * Load the message header
      */
     while (AJ_IO_BUF_AVAIL(ioBuf) < sizeof(AJ_MsgHeader)) {
+        /*
+         * Don't wait past the point where an outstanding method call times out
+         */
         //#pragma calls = AJ_Net_Recv
-        status = ioBuf->recv(ioBuf, sizeof(AJ_MsgHeader) - AJ_IO_BUF_AVAIL(ioBuf), timeout);
+        status = ioBuf->recv(ioBuf, sizeof(AJ_MsgHeader) - AJ_IO_BUF_AVAIL(ioBuf), AJ_ReplyTimeout(timeout));
         if (status != AJ_OK) {
             /*
              * If there were no messages to receive check if we have any methods call that have
              * timed-out and if so generate an internal error message to allow the application to
              * proceed.
              */
-            if ((status == AJ_ERR_TIMEOUT) && AJ_TimedOutMethodCall(msg)) {
-                msg->hdr = (AJ_MsgHeader*)&internalErrorHdr;
-                msg->error = AJ_ErrTimeout;
-                msg->sender = AJ_GetUniqueName(msg->bus);
-                msg->destination = msg->sender;
+            if ((status == AJ_ERR_TIMEOUT) && TimedOutReply(msg)) {
                 status = AJ_OK;
             }
 
@@ -701,6 +692,7 @@ AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeo
     if ((msg->hdr->endianess != AJ_LITTLE_ENDIAN) && (msg->hdr->endianess != AJ_BIG_ENDIAN)) {
         return AJ_ERR_READ;
     }
+    ++ioBuf->messages;
     /*
      * Endian swap header info - conventiently they are contiguous in the header
      */
@@ -862,6 +854,106 @@ AJ_Status AJ_UnmarshalMsg(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t timeo
     return status;
 }
 
+/*
+ * Works out how many bytes must be in the receive buffer before the message at the front of the
+ * buffer can be unmarshaled without blocking. The buffer itself holds the parser state between
+ * calls: first the fixed header is needed, then the header fields and, if it fits, the body.
+ */
+static AJ_Status BytesNeeded(AJ_IOBuffer* ioBuf, uint32_t* needed)
+{
+    AJ_MsgHeader hdr;
+    uint32_t avail = AJ_IO_BUF_AVAIL(ioBuf);
+    uint32_t room = ioBuf->bufSize - AJ_IO_BUF_CONSUMED(ioBuf);
+
+    if (avail < sizeof(AJ_MsgHeader)) {
+        *needed = sizeof(AJ_MsgHeader);
+        return AJ_OK;
+    }
+    memcpy(&hdr, ioBuf->readPtr, sizeof(AJ_MsgHeader));
+    if ((hdr.endianess != AJ_LITTLE_ENDIAN) && (hdr.endianess != AJ_BIG_ENDIAN)) {
+        return AJ_ERR_READ;
+    }
+    if (hdr.endianess != HOST_ENDIANESS) {
+        AJ_SwapBytes(&hdr.bodyLen, 4, 3);
+    }
+    /*
+     * A header that is too big is reported by AJ_UnmarshalMsg()
+     */
+    if (hdr.headerLen > room) {
+        *needed = avail;
+        return AJ_OK;
+    }
+    *needed = sizeof(AJ_MsgHeader) + hdr.headerLen + ((8 - hdr.headerLen) & 7);
+    /*
+     * Bodies that don't fit in the buffer are loaded as they are unmarshaled
+     */
+    if ((*needed <= room) && (hdr.bodyLen <= (room - *needed))) {
+        *needed += hdr.bodyLen;
+    }
+    return AJ_OK;
+}
+
+AJ_Status AJ_ProcessReady(AJ_BusAttachment* bus, AJ_Message* msg)
+{
+    AJ_Status status;
+    AJ_IOBuffer* ioBuf = &bus->sock.rx;
+    uint32_t needed;
+
+    /*
+     * The message is cleared so it is always safe to close even if an error is returned
+     */
+    memset(msg, 0, sizeof(AJ_Message));
+    msg->msgId = AJ_INVALID_MSG_ID;
+    msg->bus = bus;
+    /*
+     * Finish sending anything left over from an earlier partial write. Any other data in the tx
+     * buffer belongs to a message that was never delivered.
+     */
+    if (bus->sock.tx.pending) {
+        status = bus->sock.tx.send(&bus->sock.tx);
+        if (status != AJ_OK) {
+            return status;
+        }
+    }
+    AJ_IOBufRebase(ioBuf);
+    while (TRUE) {
+        status = BytesNeeded(ioBuf, &needed);
+        if (status != AJ_OK) {
+            return status;
+        }
+        if (AJ_IO_BUF_AVAIL(ioBuf) >= needed) {
+            break;
+        }
+        //#pragma calls = AJ_Net_Recv
+        status = ioBuf->recv(ioBuf, needed - AJ_IO_BUF_AVAIL(ioBuf), 0);
+        if (status == AJ_ERR_TIMEOUT) {
+            return TimedOutReply(msg) ? AJ_OK : AJ_ERR_WOULD_BLOCK;
+        }
+        if (status != AJ_OK) {
+            return status;
+        }
+    }
+    /*
+     * The message is all in the buffer so this will not block
+     */
+    return AJ_UnmarshalMsg(bus, msg, 0);
+}
+
+uint8_t AJ_GetIOInterest(AJ_BusAttachment* bus)
+{
+    AJ_IOBuffer* ioBuf = &bus->sock.rx;
+    uint8_t interest = AJ_IO_WANT_READ;
+    uint32_t needed;
+
+    if (bus->sock.tx.pending) {
+        interest |= AJ_IO_WANT_WRITE;
+    }
+    if (AJ_IO_BUF_AVAIL(ioBuf) && ((BytesNeeded(ioBuf, &needed) != AJ_OK) || (AJ_IO_BUF_AVAIL(ioBuf) >= needed))) {
+        interest |= AJ_IO_PENDING;
+    }
+    return interest;
+}
+
 AJ_Status AJ_UnmarshalArg(AJ_Message* msg, AJ_Arg* arg)
 {
     AJ_Status status;
@@ -916,6 +1008,287 @@ AJ_Status AJ_UnmarshalArg(AJ_Message* msg, AJ_Arg* arg)
     return status;
 }
 
+/*
+ * Number of compiled signature plans cached for AJ_MarshalArgs() and AJ_UnmarshalArgs(). Define
+ * this as zero to compile out signature plans.
+ */
+#ifndef AJ_SIG_PLAN_CACHE_SIZE
+#define AJ_SIG_PLAN_CACHE_SIZE 4
+#endif
+
+#if AJ_SIG_PLAN_CACHE_SIZE
+
+/*
+ * Longest signature that will be compiled into a plan
+ */
+#define SIG_PLAN_MAX_OPS 16
+
+/*
+ * A signature plan is a signature compiled into a flat list of op-codes. The op-code for a type is
+ * its TypeFlags entry so encodes the type class and the alignment, which for scalars is also the
+ * size, so the marshal and unmarshal loops don't have to decode the signature on every call.
+ */
+typedef struct _SigPlan {
+    const char* key;                /* The signature pointer the plan was compiled from */
+    uint32_t lastUse;               /* For LRU replacement */
+    uint8_t numOps;                 /* Number of op-codes in the plan */
+    uint8_t noPlan;                 /* TRUE if the signature cannot be compiled into a plan */
+    char sig[SIG_PLAN_MAX_OPS];     /* Copy of the signature to validate a key match */
+    uint8_t ops[SIG_PLAN_MAX_OPS];  /* The op-codes */
+} SigPlan;
+
+static AJ_THREAD_LOCAL SigPlan sigPlans[AJ_SIG_PLAN_CACHE_SIZE];
+static AJ_THREAD_LOCAL uint32_t sigPlanClock = 0;
+static uint8_t sigPlansEnabled = TRUE;
+
+/*
+ * Lookup a plan for a signature compiling a new one if there isn't a match in the cache. Returns
+ * NULL if the signature cannot be compiled into a plan.
+ */
+static const SigPlan* GetSigPlan(const char* sig)
+{
+    SigPlan* plan = &sigPlans[0];
+    size_t len;
+    size_t i;
+
+    if (!sigPlansEnabled) {
+        return NULL;
+    }
+    ++sigPlanClock;
+    /*
+     * Signatures are almost always string constants so the pointer is a good key but the contents
+     * must be checked in case the key is a reused buffer.
+     */
+    for (i = 0; i < AJ_SIG_PLAN_CACHE_SIZE; ++i) {
+        if (sigPlans[i].key == sig) {
+            plan = &sigPlans[i];
+            if ((strncmp(plan->sig, sig, plan->numOps) == 0) && !sig[plan->numOps]) {
+                plan->lastUse = sigPlanClock;
+                return plan->noPlan ? NULL : plan;
+            }
+            break;
+        }
+        if (sigPlans[i].lastUse < plan->lastUse) {
+            plan = &sigPlans[i];
+        }
+    }
+    /*
+     * Plans can only be compiled for short signatures of basic types. Short signatures that cannot
+     * be compiled are cached too so they are only checked once.
+     */
+    len = strlen(sig);
+    if (len > SIG_PLAN_MAX_OPS) {
+        return NULL;
+    }
+    plan->noPlan = FALSE;
+    for (i = 0; i < len; ++i) {
+        uint8_t typeId = (uint8_t)sig[i];
+        if ((typeId < AJ_ARG_ARRAY) || (typeId > AJ_ARG_DICT_ENTRY) || !IsBasicType(typeId)) {
+            plan->noPlan = TRUE;
+        } else {
+            plan->ops[i] = TYPE_FLAG(typeId);
+        }
+        plan->sig[i] = (char)typeId;
+    }
+    plan->key = sig;
+    plan->numOps = (uint8_t)len;
+    plan->lastUse = sigPlanClock;
+    return plan->noPlan ? NULL : plan;
+}
+
+/*
+ * Returns the signature position a plan will marshal or unmarshal at or NULL if the plan cannot be
+ * used at the current position in the message.
+ */
+static const char* PlanSignature(AJ_Message* msg, const SigPlan* plan)
+{
+    const char* sig;
+
+    if (!msg->hdr || msg->varOffset) {
+        return NULL;
+    }
+    if (msg->outer) {
+        /*
+         * Array elements reuse the element signature so are left to the general case
+         */
+        if (msg->outer->typeId == AJ_ARG_ARRAY) {
+            return NULL;
+        }
+        sig = msg->outer->sigPtr;
+    } else {
+        sig = msg->signature + msg->sigOffset;
+    }
+    return (strncmp(sig, plan->sig, plan->numOps) == 0) ? sig : NULL;
+}
+
+/*
+ * Advance the signature after a plan has marshaled or unmarshaled numOps arguments
+ */
+static void PlanAdvance(AJ_Message* msg, uint8_t numOps)
+{
+    if (msg->outer) {
+        msg->outer->sigPtr += numOps;
+    } else {
+        msg->sigOffset += numOps;
+    }
+}
+
+/*
+ * Marshal arguments using a signature plan. Returns AJ_ERR_NO_MATCH without consuming any arguments
+ * if the plan cannot be used at the current position in the message.
+ */
+static AJ_Status MarshalPlan(AJ_Message* msg, const SigPlan* plan, va_list* argp)
+{
+    AJ_Status status = AJ_OK;
+    AJ_IOBuffer* ioBuf = &msg->bus->sock.tx;
+    uint8_t* argStart = ioBuf->writePtr;
+    uint8_t i;
+
+    if (!PlanSignature(msg, plan)) {
+        return AJ_ERR_NO_MATCH;
+    }
+    for (i = 0; i < plan->numOps; ++i) {
+        uint8_t op = plan->ops[i];
+        uint32_t align = op & 0xF;
+        uint32_t pad = (align - (uint32_t)(ioBuf->writePtr - ioBuf->bufStart)) & (align - 1);
+
+        if (op & AJ_SCALAR) {
+            uint64_t u64;
+            uint32_t u32;
+            uint16_t u16;
+            uint8_t u8;
+            void* val;
+            if (align == 8) {
+                u64 = va_arg(*argp, uint64_t);
+                val = &u64;
+            } else if (align == 4) {
+                u32 = va_arg(*argp, uint32_t);
+                val = &u32;
+            } else if (align == 2) {
+                u16 = (uint16_t)va_arg(*argp, uint32_t);
+                val = &u16;
+            } else {
+                u8 = (uint8_t)va_arg(*argp, uint32_t);
+                val = &u8;
+            }
+            if ((pad + align) > AJ_IO_BUF_SPACE(ioBuf)) {
+                status = AJ_ERR_RESOURCES;
+                break;
+            }
+            memset(ioBuf->writePtr, 0, pad);
+            ioBuf->writePtr += pad;
+            memcpy(ioBuf->writePtr, val, align);
+            ioBuf->writePtr += align;
+        } else {
+            const char* str = va_arg(*argp, const char*);
+            uint32_t sz;
+            if (!str) {
+                status = AJ_ERR_NULL;
+                break;
+            }
+            sz = (uint32_t)strlen(str);
+            /*
+             * Length field for a signature is 1 byte, for regular strings its 4 bytes
+             */
+            if ((align == 1) && (sz > 255)) {
+                status = AJ_ERR_MARSHAL;
+                break;
+            }
+            if ((pad + align + sz + 1) > AJ_IO_BUF_SPACE(ioBuf)) {
+                status = AJ_ERR_RESOURCES;
+                break;
+            }
+            memset(ioBuf->writePtr, 0, pad);
+            ioBuf->writePtr += pad;
+            if (align == 1) {
+                *ioBuf->writePtr = (uint8_t)sz;
+            } else {
+                memcpy(ioBuf->writePtr, &sz, 4);
+            }
+            ioBuf->writePtr += align;
+            /*
+             * Copy the string including the NUL terminator
+             */
+            memcpy(ioBuf->writePtr, str, sz + 1);
+            ioBuf->writePtr += sz + 1;
+        }
+    }
+    msg->bodyBytes += (uint16_t)(ioBuf->writePtr - argStart);
+    PlanAdvance(msg, i);
+    if (status != AJ_OK) {
+        AJ_ReleaseReplyContext(msg);
+    }
+    return status;
+}
+
+/*
+ * Unmarshal arguments using a signature plan. Returns AJ_ERR_NO_MATCH without consuming any
+ * arguments if the plan cannot be used at the current position in the message.
+ */
+static AJ_Status UnmarshalPlan(AJ_Message* msg, const SigPlan* plan, va_list* argp)
+{
+    AJ_Status status = AJ_OK;
+    AJ_IOBuffer* ioBuf = &msg->bus->sock.rx;
+    uint8_t i;
+
+    if (!PlanSignature(msg, plan)) {
+        return AJ_ERR_NO_MATCH;
+    }
+    for (i = 0; i < plan->numOps; ++i) {
+        uint8_t op = plan->ops[i];
+        uint32_t align = op & 0xF;
+        uint8_t* argStart = ioBuf->readPtr;
+        uint32_t pad = (align - (uint32_t)(argStart - ioBuf->bufStart)) & (align - 1);
+        void* val = va_arg(*argp, void*);
+        size_t consumed;
+
+        status = LoadBytes(ioBuf, (uint16_t)align, (uint8_t)pad);
+        if (status != AJ_OK) {
+            break;
+        }
+        if (op & AJ_SCALAR) {
+            EndianSwap(msg, plan->sig[i], ioBuf->readPtr, 1);
+            memcpy(val, ioBuf->readPtr, align);
+            ioBuf->readPtr += align;
+        } else {
+            uint32_t sz;
+            if (align == 4) {
+                EndianSwap(msg, AJ_ARG_UINT32, ioBuf->readPtr, 1);
+                sz = *((uint32_t*)ioBuf->readPtr);
+            } else {
+                sz = (uint32_t)(*ioBuf->readPtr);
+            }
+            ioBuf->readPtr += align;
+            status = LoadBytes(ioBuf, (uint16_t)(sz + 1), 0);
+            if (status != AJ_OK) {
+                break;
+            }
+            *((const char**)val) = (const char*)ioBuf->readPtr;
+            ioBuf->readPtr += sz + 1;
+        }
+        consumed = (ioBuf->readPtr - argStart);
+        if (consumed > msg->bodyBytes) {
+            /*
+             * Unrecoverable
+             */
+            status = AJ_ERR_READ;
+            break;
+        }
+        msg->bodyBytes -= (uint16_t)consumed;
+    }
+    PlanAdvance(msg, i);
+    return status;
+}
+
+#endif
+
+void AJ_EnableSignaturePlans(uint8_t enable)
+{
+#if AJ_SIG_PLAN_CACHE_SIZE
+    sigPlansEnabled = enable;
+#endif
+}
+
 AJ_Status AJ_UnmarshalArgs(AJ_Message* msg, const char* sig, ...)
 {
     AJ_Status status = AJ_OK;
@@ -923,6 +1296,19 @@ AJ_Status AJ_UnmarshalArgs(AJ_Message* msg, const char* sig, ...)
     va_list argp;
 
     va_start(argp, sig);
+#if AJ_SIG_PLAN_CACHE_SIZE
+    {
+        const SigPlan* plan = GetSigPlan(sig);
+        if (plan) {
+            status = UnmarshalPlan(msg, plan, &argp);
+            if (status != AJ_ERR_NO_MATCH) {
+                va_end(argp);
+                return status;
+            }
+            status = AJ_OK;
+        }
+    }
+#endif
     while (*sig) {
         uint8_t typeId = (uint8_t)*sig++;
         void* val = va_arg(argp, void*);
@@ -965,6 +1351,29 @@ AJ_Status AJ_UnmarshalArgs(AJ_Message* msg, const char* sig, ...)
     return status;
 }
 
+AJ_Status AJ_UnmarshalScalarArray(AJ_Message* msg, uint8_t typeId, const void** data, size_t* count)
+{
+    AJ_Status status;
+    AJ_Arg arg;
+
+    if ((typeId < AJ_ARG_ARRAY) || (typeId > AJ_ARG_DICT_ENTRY) || !IsScalarType(typeId)) {
+        return AJ_ERR_UNEXPECTED;
+    }
+    /*
+     * Arrays of scalars are unmarshaled and endian swapped in a single operation
+     */
+    status = AJ_UnmarshalArg(msg, &arg);
+    if (status == AJ_OK) {
+        if ((arg.typeId != typeId) || !(arg.flags & AJ_ARRAY_FLAG)) {
+            status = AJ_ERR_UNMARSHAL;
+        } else {
+            *data = arg.val.v_data;
+            *count = arg.len / SizeOfType(typeId);
+        }
+    }
+    return status;
+}
+
 AJ_Status AJ_UnmarshalRaw(AJ_Message* msg, const void** data, size_t len, size_t* actual)
 {
     AJ_Status status;
@@ -1201,12 +1610,176 @@ static AJ_Status Marshal(AJ_Message* msg, const char** sig, AJ_Arg* arg)
     return status;
 }
 
+/*
+ * Number of pre-marshaled message headers cached for signals and method calls. Define this as zero
+ * to compile out header templates.
+ */
+#ifndef AJ_HDR_TEMPLATE_CACHE_SIZE
+#define AJ_HDR_TEMPLATE_CACHE_SIZE 4
+#endif
+
+/*
+ * Largest header, including the pad to the start of the body, that will be cached
+ */
+#ifndef AJ_HDR_TEMPLATE_MAX
+#define AJ_HDR_TEMPLATE_MAX 192
+#endif
+
+#if AJ_HDR_TEMPLATE_CACHE_SIZE
+
+/*
+ * A header template is the marshaled header for a message id sent with a specific destination,
+ * session id, flags and time-to-live. Sending the same message again only changes the serial
+ * number, the timestamp and the body length so the header is copied from the template and those
+ * fields are patched in place. The body length is filled in when the message is delivered.
+ */
+typedef struct _HdrTemplate {
+    AJ_BusAttachment* bus;           /* Bus the header was marshaled for, NULL if the entry is free */
+    uint32_t msgId;                  /* Message id passed in by the caller */
+    uint32_t sessionId;              /* Session id passed in by the caller */
+    uint32_t ttl;                    /* Time-to-live passed in by the caller */
+    uint32_t lastUse;                /* For LRU replacement */
+    uint8_t msgType;                 /* Method call or signal */
+    uint8_t flags;                   /* Flags passed in by the caller */
+    uint16_t len;                    /* Length of the marshaled header */
+    uint16_t destOffset;             /* Offset of the destination string or zero if there is no destination */
+    uint16_t sigOffset;              /* Offset of the signature string */
+    uint16_t timestampOffset;        /* Offset of the timestamp value or zero if there is no timestamp */
+    const char* objPath;             /* Message fields from AJ_InitMessageFromMsgId() */
+    const char* iface;
+    const char* member;
+    uint8_t hdr[AJ_HDR_TEMPLATE_MAX];
+} HdrTemplate;
+
+static AJ_THREAD_LOCAL HdrTemplate hdrTemplates[AJ_HDR_TEMPLATE_CACHE_SIZE];
+static AJ_THREAD_LOCAL uint32_t hdrTemplateClock = 0;
+static uint8_t hdrTemplatesEnabled = TRUE;
+
+/*
+ * Find a template that matches the message being marshaled
+ */
+static const HdrTemplate* FindHdrTemplate(AJ_Message* msg, uint8_t msgType, uint32_t msgId, uint8_t flags)
+{
+    size_t i;
+
+    ++hdrTemplateClock;
+    for (i = 0; i < AJ_HDR_TEMPLATE_CACHE_SIZE; ++i) {
+        HdrTemplate* tmpl = &hdrTemplates[i];
+        if ((tmpl->bus == msg->bus) && (tmpl->msgId == msgId) && (tmpl->msgType == msgType) && (tmpl->flags == flags) &&
+            (tmpl->sessionId == msg->sessionId) && (tmpl->ttl == msg->ttl)) {
+            /*
+             * The destination is compared against the copy in the marshaled header
+             */
+            const char* dest = tmpl->destOffset ? (const char*)&tmpl->hdr[tmpl->destOffset] : NULL;
+            if (dest ? (msg->destination && (strcmp(dest, msg->destination) == 0)) : !msg->destination) {
+                tmpl->lastUse = hdrTemplateClock;
+                return tmpl;
+            }
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Save the header that was just marshaled as a template replacing the least recently used entry
+ */
+static void SaveHdrTemplate(AJ_Message* msg, uint32_t msgId, uint8_t flags, uint16_t destOffset, uint16_t sigOffset, uint16_t timestampOffset)
+{
+    AJ_IOBuffer* ioBuf = &msg->bus->sock.tx;
+    size_t len = ioBuf->writePtr - ioBuf->bufStart;
+    HdrTemplate* tmpl = &hdrTemplates[0];
+    size_t i;
+
+    if (len > AJ_HDR_TEMPLATE_MAX) {
+        return;
+    }
+    for (i = 1; i < AJ_HDR_TEMPLATE_CACHE_SIZE; ++i) {
+        if (hdrTemplates[i].lastUse < tmpl->lastUse) {
+            tmpl = &hdrTemplates[i];
+        }
+    }
+    tmpl->bus = msg->bus;
+    tmpl->msgId = msgId;
+    tmpl->sessionId = msg->sessionId;
+    tmpl->ttl = msg->ttl;
+    tmpl->lastUse = hdrTemplateClock;
+    tmpl->msgType = msg->hdr->msgType;
+    tmpl->flags = flags;
+    tmpl->len = (uint16_t)len;
+    tmpl->destOffset = destOffset;
+    tmpl->sigOffset = sigOffset;
+    tmpl->timestampOffset = timestampOffset;
+    tmpl->objPath = msg->objPath;
+    tmpl->iface = msg->iface;
+    tmpl->member = msg->member;
+    memcpy(tmpl->hdr, ioBuf->bufStart, len);
+}
+
+/*
+ * Initialize a message header from a template
+ */
+static void ApplyHdrTemplate(AJ_Message* msg, const HdrTemplate* tmpl)
+{
+    AJ_IOBuffer* ioBuf = &msg->bus->sock.tx;
+
+    AJ_IO_BUF_RESET(ioBuf);
+    memcpy(ioBuf->writePtr, tmpl->hdr, tmpl->len);
+    ioBuf->writePtr += tmpl->len;
+
+    msg->hdr = (AJ_MsgHeader*)ioBuf->bufStart;
+    msg->msgId = tmpl->msgId;
+    msg->objPath = tmpl->objPath;
+    msg->iface = tmpl->iface;
+    msg->member = tmpl->member;
+    msg->signature = (const char*)(ioBuf->bufStart + tmpl->sigOffset);
+
+    do { msg->hdr->serialNum = msg->bus->serial++; } while (msg->bus->serial == 1);
+
+    if (tmpl->timestampOffset) {
+        AJ_Time timer;
+        timer.seconds = 0;
+        timer.milliseconds = 0;
+        msg->timestamp = AJ_GetElapsedTime(&timer, FALSE);
+        memcpy(ioBuf->bufStart + tmpl->timestampOffset, &msg->timestamp, sizeof(msg->timestamp));
+    }
+}
+
+#endif
+
+void AJ_EnableHeaderTemplates(uint8_t enable)
+{
+#if AJ_HDR_TEMPLATE_CACHE_SIZE
+    hdrTemplatesEnabled = enable;
+    AJ_InvalidateHeaderTemplates();
+#endif
+}
+
+void AJ_InvalidateHeaderTemplates(void)
+{
+#if AJ_HDR_TEMPLATE_CACHE_SIZE
+    memset(hdrTemplates, 0, sizeof(hdrTemplates));
+#endif
+}
+
 static AJ_Status MarshalMsg(AJ_Message* msg, uint8_t msgType, uint32_t msgId, uint8_t flags)
 {
     AJ_Status status = AJ_OK;
     AJ_IOBuffer* ioBuf = &msg->bus->sock.tx;
     uint8_t fieldId;
     uint8_t secure = FALSE;
+#if AJ_HDR_TEMPLATE_CACHE_SIZE
+    uint16_t destOffset = 0;
+    uint16_t sigOffset = 0;
+    uint16_t timestampOffset = 0;
+
+    if (hdrTemplatesEnabled && ((msgType == AJ_MSG_METHOD_CALL) || (msgType == AJ_MSG_SIGNAL))) {
+        const HdrTemplate* tmpl = FindHdrTemplate(msg, msgType, msgId, flags);
+        if (tmpl && (tmpl->len <= ioBuf->bufSize)) {
+            ApplyHdrTemplate(msg, tmpl);
+            return AJ_OK;
+        }
+    }
+#endif
 
     /*
      * Use the msgId to lookup information in the object and interface descriptions to
@@ -1342,6 +1915,18 @@ static AJ_Status MarshalMsg(AJ_Message* msg, uint8_t msgType, uint32_t msgId, ui
          * Now marshal the field value
          */
         Marshal(msg, &fieldSig, &hdrVal);
+#if AJ_HDR_TEMPLATE_CACHE_SIZE
+        /*
+         * Remember where the fields a template needs to match or patch were marshaled
+         */
+        if (fieldId == AJ_HDR_DESTINATION) {
+            destOffset = (uint16_t)((ioBuf->writePtr - ioBuf->bufStart) - strlen(msg->destination) - 1);
+        } else if (fieldId == AJ_HDR_SIGNATURE) {
+            sigOffset = (uint16_t)((ioBuf->writePtr - ioBuf->bufStart) - strlen(msg->signature) - 1);
+        } else if (fieldId == AJ_HDR_TIMESTAMP) {
+            timestampOffset = (uint16_t)((ioBuf->writePtr - ioBuf->bufStart) - sizeof(msg->timestamp));
+        }
+#endif
     }
     if (status == AJ_OK) {
         /*
@@ -1353,6 +1938,11 @@ static AJ_Status MarshalMsg(AJ_Message* msg, uint8_t msgType, uint32_t msgId, ui
          */
         status = WritePad(msg, (8 - msg->hdr->headerLen) & 7);
     }
+#if AJ_HDR_TEMPLATE_CACHE_SIZE
+    if ((status == AJ_OK) && hdrTemplatesEnabled && sigOffset && ((msgType == AJ_MSG_METHOD_CALL) || (msgType == AJ_MSG_SIGNAL))) {
+        SaveHdrTemplate(msg, msgId, flags, destOffset, sigOffset, timestampOffset);
+    }
+#endif
     return status;
 }
 
@@ -1426,6 +2016,19 @@ AJ_Status AJ_MarshalArgs(AJ_Message* msg, const char* sig, ...)
     va_list argp;
 
     va_start(argp, sig);
+#if AJ_SIG_PLAN_CACHE_SIZE
+    {
+        const SigPlan* plan = GetSigPlan(sig);
+        if (plan) {
+            status = MarshalPlan(msg, plan, &argp);
+            if (status != AJ_ERR_NO_MATCH) {
+                va_end(argp);
+                return status;
+            }
+            status = AJ_OK;
+        }
+    }
+#endif
     while (*sig) {
         uint8_t u8;
         uint16_t u16;
@@ -1532,6 +2135,15 @@ AJ_Status AJ_MarshalRaw(AJ_Message* msg, const void* data, size_t len)
         return AJ_ERR_WRITE;
     }
     msg->bodyBytes -= (uint32_t)len;
+    /*
+     * Large blocks of data are sent directly from the application's buffer if the transport
+     * supports it. Note that partial delivery is not supported for encrypted messages so there is
+     * no case where the data has to be copied so it can be encrypted.
+     */
+    if (data && (len >= AJ_SENDV_THRESHOLD) && msg->bus->sock.tx.sendv) {
+        AJ_IOBuffer* ioBuf = &msg->bus->sock.tx;
+        return ioBuf->sendv(ioBuf, (const uint8_t*)data, (uint32_t)len);
+    }
     return WriteBytes(msg, data, len, 0);
 }
 
@@ -1606,6 +2218,12 @@ AJ_Status AJ_MarshalVariant(AJ_Message* msg, const char* sig)
 }
 
 AJ_Status AJ_MarshalMethodCall(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t msgId, const char* destination, AJ_SessionId sessionId, uint8_t flags, uint32_t timeout)
+{
+    return AJ_MarshalMethodCallAsync(bus, msg, msgId, destination, sessionId, flags, timeout, NULL, NULL);
+}
+
+AJ_Status AJ_MarshalMethodCallAsync(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t msgId, const char* destination, AJ_SessionId sessionId,
+                                    uint8_t flags, uint32_t timeout, AJ_ReplyCallback callback, void* context)
 {
     AJ_Status status;
 
@@ -1615,7 +2233,7 @@ AJ_Status AJ_MarshalMethodCall(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t
     msg->sessionId = sessionId;
     status = MarshalMsg(msg, AJ_MSG_METHOD_CALL, msgId, flags);
     if (status == AJ_OK) {
-        status = AJ_AllocReplyContext(msg, timeout);
+        status = AJ_AllocAsyncReplyContext(msg, timeout, callback, context);
     }
     return status;
 }
@@ -1630,27 +2248,66 @@ AJ_Status AJ_MarshalSignal(AJ_BusAttachment* bus, AJ_Message* msg, uint32_t msgI
     return MarshalMsg(msg, AJ_MSG_SIGNAL, msgId, flags);
 }
 
+/*
+ * Replies are marshaled the same way from a live method call or a reply token
+ */
+static AJ_Status MarshalReply(AJ_BusAttachment* bus, const char* destination, AJ_SessionId sessionId, uint32_t serialNum,
+                              uint32_t msgId, uint8_t flags, AJ_Message* reply, const char* error)
+{
+    memset(reply, 0, sizeof(AJ_Message));
+    reply->bus = bus;
+    reply->destination = destination;
+    reply->sessionId = sessionId;
+    reply->replySerial = serialNum;
+    reply->error = error;
+    return MarshalMsg(reply, error ? AJ_MSG_ERROR : AJ_MSG_METHOD_RET, msgId, flags & AJ_FLAG_ENCRYPTED);
+}
+
 AJ_Status AJ_MarshalReplyMsg(const AJ_Message* methodCall, AJ_Message* reply)
 {
     AJ_ASSERT(methodCall->hdr->msgType == AJ_MSG_METHOD_CALL);
-    memset(reply, 0, sizeof(AJ_Message));
-    reply->bus = methodCall->bus;
-    reply->destination = methodCall->sender;
-    reply->sessionId = methodCall->sessionId;
-    reply->replySerial = methodCall->hdr->serialNum;
-    return MarshalMsg(reply, AJ_MSG_METHOD_RET, methodCall->msgId, methodCall->hdr->flags & AJ_FLAG_ENCRYPTED);
+    return MarshalReply(methodCall->bus, methodCall->sender, methodCall->sessionId, methodCall->hdr->serialNum,
+                        methodCall->msgId, methodCall->hdr->flags, reply, NULL);
 }
 
 AJ_Status AJ_MarshalErrorMsg(const AJ_Message* methodCall, AJ_Message* reply, const char* error)
 {
     AJ_ASSERT(methodCall->hdr->msgType == AJ_MSG_METHOD_CALL);
-    memset(reply, 0, sizeof(AJ_Message));
-    reply->bus = methodCall->bus;
-    reply->destination = methodCall->sender;
-    reply->sessionId = methodCall->sessionId;
-    reply->replySerial = methodCall->hdr->serialNum;
-    reply->error = error;
-    return MarshalMsg(reply, AJ_MSG_ERROR, methodCall->msgId, methodCall->hdr->flags & AJ_FLAG_ENCRYPTED);
+    AJ_ASSERT(error);
+    return MarshalReply(methodCall->bus, methodCall->sender, methodCall->sessionId, methodCall->hdr->serialNum,
+                        methodCall->msgId, methodCall->hdr->flags, reply, error);
+}
+
+AJ_Status AJ_SaveReplyToken(const AJ_Message* methodCall, AJ_ReplyToken* token)
+{
+    size_t len;
+
+    AJ_ASSERT(methodCall->hdr->msgType == AJ_MSG_METHOD_CALL);
+    if (!methodCall->sender) {
+        return AJ_ERR_NULL;
+    }
+    len = strlen(methodCall->sender);
+    if (len >= sizeof(token->sender)) {
+        return AJ_ERR_RESOURCES;
+    }
+    token->bus = methodCall->bus;
+    token->msgId = methodCall->msgId;
+    token->serialNum = methodCall->hdr->serialNum;
+    token->sessionId = methodCall->sessionId;
+    token->flags = methodCall->hdr->flags;
+    memcpy(token->sender, methodCall->sender, len + 1);
+    return AJ_OK;
+}
+
+AJ_Status AJ_MarshalDeferredReply(const AJ_ReplyToken* token, AJ_Message* reply)
+{
+    return MarshalReply(token->bus, token->sender, token->sessionId, token->serialNum, token->msgId, token->flags, reply, NULL);
+}
+
+AJ_Status AJ_MarshalDeferredError(const AJ_ReplyToken* token, AJ_Message* reply, const char* error)
+{
+    AJ_ASSERT(error);
+    return MarshalReply(token->bus, token->sender, token->sessionId, token->serialNum, token->msgId, token->flags, reply, error);
 }
 
 
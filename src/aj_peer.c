@@ -73,7 +73,7 @@ typedef struct _AuthContext {
     AJ_Time timer;                   /* Timer for detecting failed authentication attempts */
 } AuthContext;
 
-static AuthContext authContext;
+static AJ_THREAD_LOCAL AuthContext authContext;
 
 /*
  * Authentication mechanisms (currently on one)
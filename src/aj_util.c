@@ -22,6 +22,14 @@
 #include "aj_target.h"
 #include "aj_util.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 static uint8_t A2H(char hex, AJ_Status* status)
 {
     if (hex >= '0' && hex <= '9') {
@@ -96,3 +104,173 @@ AJ_Status AJ_HexToRaw(const char* hex, size_t hexLen, uint8_t* raw, size_t rawLe
     }
     return status;
 }
+
+#define ENDSWAP16(v) (((v) >> 8) | ((v) << 8))
+#define ENDSWAP32(v) (((v) >> 24) | (((v) & 0xFF0000) >> 8) | (((v) & 0x00FF00) << 8) | ((v) << 24))
+
+/*
+ * The vector kernels swap as many whole vectors as will fit in len bytes and return the number of
+ * bytes swapped. Any remaining elements are swapped by the scalar loops in AJ_SwapBytes().
+ */
+#if defined(__AVX2__)
+
+static size_t SwapVector(uint8_t* p, uint8_t size, size_t len)
+{
+    __m256i mask;
+    size_t n;
+
+    switch (size) {
+    case 2:
+        mask = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+        break;
+
+    case 4:
+        mask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+        break;
+
+    case 8:
+        mask = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+        break;
+
+    default:
+        return 0;
+    }
+    for (n = 0; (n + 32) <= len; n += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(p + n));
+        _mm256_storeu_si256((__m256i*)(p + n), _mm256_shuffle_epi8(v, mask));
+    }
+    return n;
+}
+
+#elif defined(__SSE2__)
+
+/*
+ * SSE2 doesn't have a byte shuffle so bytes are swapped within 16 bit words with shifts and then
+ * the words are shuffled to complete 32 and 64 bit swaps.
+ */
+#define SWAP_WORD_BYTES(v) _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8))
+
+static size_t SwapVector(uint8_t* p, uint8_t size, size_t len)
+{
+    size_t n;
+
+    switch (size) {
+    case 2:
+        for (n = 0; (n + 16) <= len; n += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(p + n));
+            _mm_storeu_si128((__m128i*)(p + n), SWAP_WORD_BYTES(v));
+        }
+        break;
+
+    case 4:
+        for (n = 0; (n + 16) <= len; n += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(p + n));
+            v = SWAP_WORD_BYTES(v);
+            v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+            v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+            _mm_storeu_si128((__m128i*)(p + n), v);
+        }
+        break;
+
+    case 8:
+        for (n = 0; (n + 16) <= len; n += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*)(p + n));
+            v = SWAP_WORD_BYTES(v);
+            v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+            v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+            _mm_storeu_si128((__m128i*)(p + n), v);
+        }
+        break;
+
+    default:
+        n = 0;
+        break;
+    }
+    return n;
+}
+
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+
+static size_t SwapVector(uint8_t* p, uint8_t size, size_t len)
+{
+    size_t n;
+
+    switch (size) {
+    case 2:
+        for (n = 0; (n + 16) <= len; n += 16) {
+            vst1q_u8(p + n, vrev16q_u8(vld1q_u8(p + n)));
+        }
+        break;
+
+    case 4:
+        for (n = 0; (n + 16) <= len; n += 16) {
+            vst1q_u8(p + n, vrev32q_u8(vld1q_u8(p + n)));
+        }
+        break;
+
+    case 8:
+        for (n = 0; (n + 16) <= len; n += 16) {
+            vst1q_u8(p + n, vrev64q_u8(vld1q_u8(p + n)));
+        }
+        break;
+
+    default:
+        n = 0;
+        break;
+    }
+    return n;
+}
+
+#else
+
+#define SwapVector(p, size, len) 0
+
+#endif
+
+void AJ_SwapBytes(void* data, uint8_t size, uint32_t num)
+{
+    uint8_t* p = (uint8_t*)data;
+    size_t done;
+
+    if (num > 1) {
+        done = SwapVector(p, size, (size_t)size * num);
+        p += done;
+        num -= (uint32_t)(done / size);
+    }
+    switch (size) {
+    case 2:
+        {
+            uint16_t* p16 = (uint16_t*)p;
+            while (num--) {
+                uint16_t v = *p16;
+                *p16++ = ENDSWAP16(v);
+            }
+        }
+        break;
+
+    case 4:
+        {
+            uint32_t* p32 = (uint32_t*)p;
+            while (num--) {
+                uint32_t v = *p32;
+                *p32++ = ENDSWAP32(v);
+            }
+        }
+        break;
+
+    case 8:
+        {
+            uint32_t* p32 = (uint32_t*)p;
+            while (num--) {
+                uint32_t v = p32[0];
+                uint32_t u = p32[1];
+                *p32++ = ENDSWAP32(u);
+                *p32++ = ENDSWAP32(v);
+            }
+        }
+        break;
+    }
+}
@@ -203,6 +203,11 @@ void AJ_Net_Disconnect(AJ_NetSocket* netSock)
     g_client.stop();
 }
 
+int AJ_Net_GetFd(AJ_NetSocket* netSock)
+{
+    return -1;
+}
+
 AJ_Status AJ_Net_SendTo(AJ_IOBuffer* buf)
 {
     int ret;
@@ -85,6 +85,11 @@ void ram_diag();
 
 #define AJ_ASSERT(x) assert(x)
 
+/*
+ * There is only one thread on this platform
+ */
+#define AJ_THREAD_LOCAL
+
 /*
  * AJ_Reboot() is a NOOP on this platform
  */
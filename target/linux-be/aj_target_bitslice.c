@@ -0,0 +1,434 @@
+/**
+ * @file  Bitsliced constant time AES-128 encryption
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include "aj_target.h"
+
+#if AJ_AES_BITSLICE
+
+#include "aj_target_bitslice.h"
+
+/*
+ * The state of four blocks is spread over eight 64 bit words, word i holds bit i of every byte. Two
+ * such sets are held side by side in 128 bit vectors so eight blocks go through each pass, the
+ * compiler uses NEON or SSE2 registers where there are any and pairs of 64 bit registers otherwise.
+ * There are no table lookups or data dependent branches so the time taken reveals nothing about
+ * the key.
+ */
+typedef uint64_t Word __attribute__((vector_size(16)));
+
+#define ROUNDS 10
+
+/*
+ * The S-box as a circuit of 113 logic gates (Boyar and Peralta)
+ */
+static void SubBytes(Word* q)
+{
+    Word x0, x1, x2, x3, x4, x5, x6, x7;
+    Word y1, y2, y3, y4, y5, y6, y7, y8, y9, y10, y11, y12, y13, y14, y15, y16, y17, y18, y19, y20, y21;
+    Word z0, z1, z2, z3, z4, z5, z6, z7, z8, z9, z10, z11, z12, z13, z14, z15, z16, z17;
+    Word t0, t1, t2, t3, t4, t5, t6, t7, t8, t9, t10, t11, t12, t13, t14, t15, t16, t17, t18, t19;
+    Word t20, t21, t22, t23, t24, t25, t26, t27, t28, t29, t30, t31, t32, t33, t34, t35, t36, t37, t38, t39;
+    Word t40, t41, t42, t43, t44, t45, t46, t47, t48, t49, t50, t51, t52, t53, t54, t55, t56, t57, t58, t59;
+    Word t60, t61, t62, t63, t64, t65, t66, t67;
+    Word s0, s1, s2, s3, s4, s5, s6, s7;
+
+    x0 = q[7];
+    x1 = q[6];
+    x2 = q[5];
+    x3 = q[4];
+    x4 = q[3];
+    x5 = q[2];
+    x6 = q[1];
+    x7 = q[0];
+
+    /*
+     * Top linear transformation
+     */
+    y14 = x3 ^ x5;
+    y13 = x0 ^ x6;
+    y9 = x0 ^ x3;
+    y8 = x0 ^ x5;
+    t0 = x1 ^ x2;
+    y1 = t0 ^ x7;
+    y4 = y1 ^ x3;
+    y12 = y13 ^ y14;
+    y2 = y1 ^ x0;
+    y5 = y1 ^ x6;
+    y3 = y5 ^ y8;
+    t1 = x4 ^ y12;
+    y15 = t1 ^ x5;
+    y20 = t1 ^ x1;
+    y6 = y15 ^ x7;
+    y10 = y15 ^ t0;
+    y11 = y20 ^ y9;
+    y7 = x7 ^ y11;
+    y17 = y10 ^ y11;
+    y19 = y10 ^ y8;
+    y16 = t0 ^ y11;
+    y21 = y13 ^ y16;
+    y18 = x0 ^ y16;
+
+    /*
+     * Non-linear section
+     */
+    t2 = y12 & y15;
+    t3 = y3 & y6;
+    t4 = t3 ^ t2;
+    t5 = y4 & x7;
+    t6 = t5 ^ t2;
+    t7 = y13 & y16;
+    t8 = y5 & y1;
+    t9 = t8 ^ t7;
+    t10 = y2 & y7;
+    t11 = t10 ^ t7;
+    t12 = y9 & y11;
+    t13 = y14 & y17;
+    t14 = t13 ^ t12;
+    t15 = y8 & y10;
+    t16 = t15 ^ t12;
+    t17 = t4 ^ t14;
+    t18 = t6 ^ t16;
+    t19 = t9 ^ t14;
+    t20 = t11 ^ t16;
+    t21 = t17 ^ y20;
+    t22 = t18 ^ y19;
+    t23 = t19 ^ y21;
+    t24 = t20 ^ y18;
+
+    t25 = t21 ^ t22;
+    t26 = t21 & t23;
+    t27 = t24 ^ t26;
+    t28 = t25 & t27;
+    t29 = t28 ^ t22;
+    t30 = t23 ^ t24;
+    t31 = t22 ^ t26;
+    t32 = t31 & t30;
+    t33 = t32 ^ t24;
+    t34 = t23 ^ t33;
+    t35 = t27 ^ t33;
+    t36 = t24 & t35;
+    t37 = t36 ^ t34;
+    t38 = t27 ^ t36;
+    t39 = t29 & t38;
+    t40 = t25 ^ t39;
+
+    t41 = t40 ^ t37;
+    t42 = t29 ^ t33;
+    t43 = t29 ^ t40;
+    t44 = t33 ^ t37;
+    t45 = t42 ^ t41;
+    z0 = t44 & y15;
+    z1 = t37 & y6;
+    z2 = t33 & x7;
+    z3 = t43 & y16;
+    z4 = t40 & y1;
+    z5 = t29 & y7;
+    z6 = t42 & y11;
+    z7 = t45 & y17;
+    z8 = t41 & y10;
+    z9 = t44 & y12;
+    z10 = t37 & y3;
+    z11 = t33 & y4;
+    z12 = t43 & y13;
+    z13 = t40 & y5;
+    z14 = t29 & y2;
+    z15 = t42 & y9;
+    z16 = t45 & y14;
+    z17 = t41 & y8;
+
+    /*
+     * Bottom linear transformation
+     */
+    t46 = z15 ^ z16;
+    t47 = z10 ^ z11;
+    t48 = z5 ^ z13;
+    t49 = z9 ^ z10;
+    t50 = z2 ^ z12;
+    t51 = z2 ^ z5;
+    t52 = z7 ^ z8;
+    t53 = z0 ^ z3;
+    t54 = z6 ^ z7;
+    t55 = z16 ^ z17;
+    t56 = z12 ^ t48;
+    t57 = t50 ^ t53;
+    t58 = z4 ^ t46;
+    t59 = z3 ^ t54;
+    t60 = t46 ^ t57;
+    t61 = z14 ^ t57;
+    t62 = t52 ^ t58;
+    t63 = t49 ^ t58;
+    t64 = z4 ^ t59;
+    t65 = t61 ^ t62;
+    t66 = z1 ^ t63;
+    s0 = t59 ^ t63;
+    s6 = t56 ^ ~t62;
+    s7 = t48 ^ ~t60;
+    t67 = t64 ^ t65;
+    s3 = t53 ^ t66;
+    s4 = t51 ^ t66;
+    s5 = t47 ^ t65;
+    s1 = t64 ^ ~s3;
+    s2 = t55 ^ ~t67;
+
+    q[7] = s0;
+    q[6] = s1;
+    q[5] = s2;
+    q[4] = s3;
+    q[3] = s4;
+    q[2] = s5;
+    q[1] = s6;
+    q[0] = s7;
+}
+
+#define SWAPN(cl, ch, s, x, y) \
+    do { \
+        Word a = (x); \
+        Word b = (y); \
+        (x) = (a & (cl)) | ((b & (cl)) << (s)); \
+        (y) = ((a & (ch)) >> (s)) | (b & (ch)); \
+    } while (0)
+
+#define SWAP2(x, y)  SWAPN(0x5555555555555555ull, 0xAAAAAAAAAAAAAAAAull, 1, x, y)
+#define SWAP4(x, y)  SWAPN(0x3333333333333333ull, 0xCCCCCCCCCCCCCCCCull, 2, x, y)
+#define SWAP8(x, y)  SWAPN(0x0F0F0F0F0F0F0F0Full, 0xF0F0F0F0F0F0F0F0ull, 4, x, y)
+
+/*
+ * Transposes between the byte and bitsliced layouts, it is its own inverse
+ */
+static void Ortho(Word* q)
+{
+    SWAP2(q[0], q[1]);
+    SWAP2(q[2], q[3]);
+    SWAP2(q[4], q[5]);
+    SWAP2(q[6], q[7]);
+
+    SWAP4(q[0], q[2]);
+    SWAP4(q[1], q[3]);
+    SWAP4(q[4], q[6]);
+    SWAP4(q[5], q[7]);
+
+    SWAP8(q[0], q[4]);
+    SWAP8(q[1], q[5]);
+    SWAP8(q[2], q[6]);
+    SWAP8(q[3], q[7]);
+}
+
+static uint32_t Dec32le(const uint8_t* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void Enc32le(uint8_t* p, uint32_t x)
+{
+    p[0] = (uint8_t)x;
+    p[1] = (uint8_t)(x >> 8);
+    p[2] = (uint8_t)(x >> 16);
+    p[3] = (uint8_t)(x >> 24);
+}
+
+/*
+ * Spread the bytes of a block over two words ready for Ortho()
+ */
+static void InterleaveIn(uint64_t* q0, uint64_t* q1, const uint8_t* block)
+{
+    uint64_t x0 = Dec32le(block);
+    uint64_t x1 = Dec32le(block + 4);
+    uint64_t x2 = Dec32le(block + 8);
+    uint64_t x3 = Dec32le(block + 12);
+
+    x0 |= (x0 << 16);
+    x1 |= (x1 << 16);
+    x2 |= (x2 << 16);
+    x3 |= (x3 << 16);
+    x0 &= 0x0000FFFF0000FFFFull;
+    x1 &= 0x0000FFFF0000FFFFull;
+    x2 &= 0x0000FFFF0000FFFFull;
+    x3 &= 0x0000FFFF0000FFFFull;
+    x0 |= (x0 << 8);
+    x1 |= (x1 << 8);
+    x2 |= (x2 << 8);
+    x3 |= (x3 << 8);
+    x0 &= 0x00FF00FF00FF00FFull;
+    x1 &= 0x00FF00FF00FF00FFull;
+    x2 &= 0x00FF00FF00FF00FFull;
+    x3 &= 0x00FF00FF00FF00FFull;
+    *q0 = x0 | (x2 << 8);
+    *q1 = x1 | (x3 << 8);
+}
+
+static void InterleaveOut(uint8_t* block, uint64_t q0, uint64_t q1)
+{
+    uint64_t x0 = q0 & 0x00FF00FF00FF00FFull;
+    uint64_t x1 = q1 & 0x00FF00FF00FF00FFull;
+    uint64_t x2 = (q0 >> 8) & 0x00FF00FF00FF00FFull;
+    uint64_t x3 = (q1 >> 8) & 0x00FF00FF00FF00FFull;
+
+    x0 |= (x0 >> 8);
+    x1 |= (x1 >> 8);
+    x2 |= (x2 >> 8);
+    x3 |= (x3 >> 8);
+    x0 &= 0x0000FFFF0000FFFFull;
+    x1 &= 0x0000FFFF0000FFFFull;
+    x2 &= 0x0000FFFF0000FFFFull;
+    x3 &= 0x0000FFFF0000FFFFull;
+    Enc32le(block, (uint32_t)x0 | (uint32_t)(x0 >> 16));
+    Enc32le(block + 4, (uint32_t)x1 | (uint32_t)(x1 >> 16));
+    Enc32le(block + 8, (uint32_t)x2 | (uint32_t)(x2 >> 16));
+    Enc32le(block + 12, (uint32_t)x3 | (uint32_t)(x3 >> 16));
+}
+
+static void AddRoundKey(Word* q, const uint64_t* rk)
+{
+    int i;
+
+    for (i = 0; i < 8; ++i) {
+        q[i] ^= rk[i];
+    }
+}
+
+static void ShiftRows(Word* q)
+{
+    int i;
+
+    for (i = 0; i < 8; ++i) {
+        Word x = q[i];
+        q[i] = (x & 0x000000000000FFFFull)
+               | ((x & 0x00000000FFF00000ull) >> 4)
+               | ((x & 0x00000000000F0000ull) << 12)
+               | ((x & 0x0000FF0000000000ull) >> 8)
+               | ((x & 0x000000FF00000000ull) << 8)
+               | ((x & 0xF000000000000000ull) >> 12)
+               | ((x & 0x0FFF000000000000ull) << 4);
+    }
+}
+
+#define ROTR32(x)  (((x) << 32) | ((x) >> 32))
+#define ROTR16(x)  (((x) >> 16) | ((x) << 48))
+
+static void MixColumns(Word* q)
+{
+    Word q0 = q[0], q1 = q[1], q2 = q[2], q3 = q[3], q4 = q[4], q5 = q[5], q6 = q[6], q7 = q[7];
+    Word r0 = ROTR16(q0), r1 = ROTR16(q1), r2 = ROTR16(q2), r3 = ROTR16(q3);
+    Word r4 = ROTR16(q4), r5 = ROTR16(q5), r6 = ROTR16(q6), r7 = ROTR16(q7);
+
+    q[0] = q7 ^ r7 ^ r0 ^ ROTR32(q0 ^ r0);
+    q[1] = q0 ^ r0 ^ q7 ^ r7 ^ r1 ^ ROTR32(q1 ^ r1);
+    q[2] = q1 ^ r1 ^ r2 ^ ROTR32(q2 ^ r2);
+    q[3] = q2 ^ r2 ^ q7 ^ r7 ^ r3 ^ ROTR32(q3 ^ r3);
+    q[4] = q3 ^ r3 ^ q7 ^ r7 ^ r4 ^ ROTR32(q4 ^ r4);
+    q[5] = q4 ^ r4 ^ r5 ^ ROTR32(q5 ^ r5);
+    q[6] = q5 ^ r5 ^ r6 ^ ROTR32(q6 ^ r6);
+    q[7] = q6 ^ r6 ^ r7 ^ ROTR32(q7 ^ r7);
+}
+
+/*
+ * SubWord for the key schedule, using the S-box circuit so the key does not leak through the cache
+ */
+static uint32_t SubWord(uint32_t x)
+{
+    Word q[8];
+
+    memset(q, 0, sizeof(q));
+    q[0][0] = x;
+    Ortho(q);
+    SubBytes(q);
+    Ortho(q);
+    return (uint32_t)q[0][0];
+}
+
+void _AJ_BS_ExpandKey(const uint8_t* key, uint64_t* rk)
+{
+    static const uint8_t rcon[ROUNDS] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1B, 0x36 };
+    uint32_t w[(ROUNDS + 1) * 4];
+    uint8_t block[16];
+    int i;
+
+    for (i = 0; i < 4; ++i) {
+        w[i] = Dec32le(key + i * 4);
+    }
+    for (i = 4; i < (ROUNDS + 1) * 4; ++i) {
+        uint32_t t = w[i - 1];
+        if ((i % 4) == 0) {
+            t = SubWord((t << 24) | (t >> 8)) ^ rcon[i / 4 - 1];
+        }
+        w[i] = w[i - 4] ^ t;
+    }
+    /*
+     * Each round key is replicated in all four blocks of a word then transposed
+     */
+    for (i = 0; i <= ROUNDS; ++i) {
+        Word q[8];
+        uint64_t q0;
+        uint64_t q1;
+        int j;
+
+        Enc32le(block, w[i * 4]);
+        Enc32le(block + 4, w[i * 4 + 1]);
+        Enc32le(block + 8, w[i * 4 + 2]);
+        Enc32le(block + 12, w[i * 4 + 3]);
+        InterleaveIn(&q0, &q1, block);
+        for (j = 0; j < 4; ++j) {
+            q[j] = (Word) { q0, q0 };
+            q[j + 4] = (Word) { q1, q1 };
+        }
+        Ortho(q);
+        for (j = 0; j < 8; ++j) {
+            rk[i * 8 + j] = q[j][0];
+        }
+    }
+    memset(w, 0, sizeof(w));
+    memset(block, 0, sizeof(block));
+}
+
+void _AJ_BS_Encrypt(const uint64_t* rk, const uint8_t* in, uint8_t* out, uint32_t blocks)
+{
+    uint64_t lanes[2][8];
+    Word q[8];
+    uint32_t i;
+    int r;
+
+    memset(lanes, 0, sizeof(lanes));
+    for (i = 0; i < blocks; ++i) {
+        InterleaveIn(&lanes[i / 4][i % 4], &lanes[i / 4][i % 4 + 4], in + i * 16);
+    }
+    for (i = 0; i < 8; ++i) {
+        q[i] = (Word) { lanes[0][i], lanes[1][i] };
+    }
+    Ortho(q);
+    AddRoundKey(q, rk);
+    for (r = 1; r < ROUNDS; ++r) {
+        SubBytes(q);
+        ShiftRows(q);
+        MixColumns(q);
+        AddRoundKey(q, rk + r * 8);
+    }
+    SubBytes(q);
+    ShiftRows(q);
+    AddRoundKey(q, rk + ROUNDS * 8);
+    Ortho(q);
+    for (i = 0; i < 8; ++i) {
+        lanes[0][i] = q[i][0];
+        lanes[1][i] = q[i][1];
+    }
+    for (i = 0; i < blocks; ++i) {
+        InterleaveOut(out + i * 16, lanes[i / 4][i % 4], lanes[i / 4][i % 4 + 4]);
+    }
+}
+
+#endif
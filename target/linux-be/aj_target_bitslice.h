@@ -0,0 +1,53 @@
+#ifndef _AJ_TARGET_BITSLICE_H_
+#define _AJ_TARGET_BITSLICE_H_
+/**
+ * @file
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include "aj_target.h"
+
+/*
+ * Number of blocks encrypted in one pass
+ */
+#define AJ_BS_BLOCKS 8
+
+/*
+ * Number of 64 bit words in a bitsliced AES-128 key schedule
+ */
+#define AJ_BS_KEY_WORDS ((10 + 1) * 8)
+
+/**
+ * Expand an AES-128 key into the bitsliced key schedule
+ *
+ * @param key  The 16 byte key
+ * @param rk   Returns AJ_BS_KEY_WORDS words of round keys
+ */
+void _AJ_BS_ExpandKey(const uint8_t* key, uint64_t* rk);
+
+/**
+ * Encrypt up to AJ_BS_BLOCKS independent blocks. Every block costs the same as a full pass, the
+ * time taken does not depend on the key or the data.
+ *
+ * @param rk      Round keys from _AJ_BS_ExpandKey()
+ * @param in      The blocks to encrypt
+ * @param out     The encrypted blocks, may be the same as in
+ * @param blocks  The number of blocks, 1 to AJ_BS_BLOCKS
+ */
+void _AJ_BS_Encrypt(const uint64_t* rk, const uint8_t* in, uint8_t* out, uint32_t blocks);
+
+#endif
@@ -0,0 +1,601 @@
+/**
+ * @file  Pool of worker threads for running method handlers off the message loop thread
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include "aj_target.h"
+
+#if AJ_WORKER_POOL
+
+#if !AJ_NET_EPOLL
+#error "AJ_WORKER_POOL requires AJ_NET_EPOLL"
+#endif
+
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/eventfd.h>
+
+#include "alljoyn.h"
+#include "aj_helper.h"
+#include "aj_bufio.h"
+#include "aj_net.h"
+
+/*
+ * Maximum number of worker threads
+ */
+#ifndef AJ_MAX_WORKERS
+#define AJ_MAX_WORKERS 16
+#endif
+
+/*
+ * Maximum number of method calls passed to the workers that have not had their replies sent yet,
+ * must be a power of 2. When they are all in use the message loop waits for a worker to finish.
+ */
+#ifndef AJ_WORKER_JOBS
+#define AJ_WORKER_JOBS 64
+#endif
+
+#if (AJ_WORKER_JOBS & (AJ_WORKER_JOBS - 1))
+#error AJ_WORKER_JOBS must be a power of 2
+#endif
+
+/*
+ * Size of the buffer each worker marshals replies into
+ */
+#ifndef AJ_WORKER_TX_BUFFER_SIZE
+#define AJ_WORKER_TX_BUFFER_SIZE 1024
+#endif
+
+#define CACHE_LINE 64
+
+#define JOB_FREE    0
+#define JOB_QUEUED  1   /* Passed to the workers, the reply has not been sent yet */
+#define JOB_HELD    2   /* Waiting for an earlier ordered call in the same session */
+#define JOB_DONE    3   /* Handled, waiting for AJ_DeliverCompletedCalls() to be called for its bus */
+
+/**
+ * A method call being handled by a worker
+ */
+typedef struct _WorkerJob {
+    struct _WorkerJob* next;   /**< Next job on the free, held or completed list */
+    AJ_BusAttachment* bus;     /**< The bus the method call was received on, the reply is sent on it */
+    AJ_Message msg;            /**< The method call with its pointers moved into the call buffer */
+    MessageHandler handler;    /**< The handler to call */
+    uint8_t* call;             /**< Copy of the method call header and body */
+    uint32_t callLen;
+    uint32_t callSize;
+    uint32_t bodyOffset;       /**< Offset of the body in the call buffer */
+    uint8_t* reply;            /**< The marshaled reply */
+    uint32_t replyLen;
+    uint32_t replySize;
+    uint32_t sessionId;
+    AJ_Status status;          /**< Status returned by the handler */
+    uint8_t flags;
+    uint8_t state;
+} WorkerJob;
+
+/*
+ * Bounded lock-free queue that any thread can push to and pop from. Each cell has a sequence number
+ * that tells a pusher when the cell is free for a given position and a popper when it has been
+ * filled, so the only contention is the compare-and-swap on the head or tail position.
+ */
+typedef struct {
+    uint32_t seq;
+    WorkerJob* job;
+} QueueCell;
+
+typedef struct {
+    QueueCell cells[AJ_WORKER_JOBS];
+    uint32_t head __attribute__((aligned(CACHE_LINE)));
+    uint32_t tail __attribute__((aligned(CACHE_LINE)));
+} JobQueue;
+
+struct _WorkerPool;
+
+/**
+ * A worker thread. Method calls are unmarshaled from and replies marshaled to a bus attachment
+ * that only the worker uses.
+ */
+typedef struct {
+    pthread_t thread;
+    struct _WorkerPool* pool;
+    AJ_BusAttachment bus;
+    WorkerJob* job;
+    uint8_t txBuffer[AJ_WORKER_TX_BUFFER_SIZE];
+} Worker;
+
+/**
+ * The workers started by one message loop thread
+ */
+typedef struct _WorkerPool {
+    /*
+     * Jobs are passed to the workers on the submit queue and come back on the done queue. The
+     * message loop watches an eventfd that the workers write to when they finish a job.
+     */
+    JobQueue submitQueue;
+    JobQueue doneQueue;
+    sem_t jobsReady;
+    int doneFd;
+    /*
+     * The objects registered by the message loop thread
+     */
+    const AJ_Object* localObjects;
+    const AJ_Object* proxyObjects;
+    /*
+     * Only the message loop thread uses the jobs and the free, held and completed lists
+     */
+    WorkerJob jobs[AJ_WORKER_JOBS];
+    WorkerJob* freeJobs;
+    WorkerJob* heldHead;
+    WorkerJob* heldTail;
+    WorkerJob* completed;
+    uint32_t numWorkers;
+    Worker workers[AJ_MAX_WORKERS];
+} WorkerPool;
+
+/*
+ * Each message loop thread has its own pool, the bus attachments and the runtime state the pool
+ * works with belong to that thread
+ */
+static AJ_THREAD_LOCAL WorkerPool* pool = NULL;
+
+static void QueueInit(JobQueue* queue)
+{
+    uint32_t i;
+
+    for (i = 0; i < AJ_WORKER_JOBS; ++i) {
+        queue->cells[i].seq = i;
+        queue->cells[i].job = NULL;
+    }
+    queue->head = 0;
+    queue->tail = 0;
+}
+
+static uint8_t QueuePush(JobQueue* queue, WorkerJob* job)
+{
+    uint32_t pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+
+    while (TRUE) {
+        QueueCell* cell = &queue->cells[pos & (AJ_WORKER_JOBS - 1)];
+        int32_t diff = (int32_t)(__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&queue->head, &pos, pos + 1, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                cell->job = job;
+                __atomic_store_n(&cell->seq, pos + 1, __ATOMIC_RELEASE);
+                return TRUE;
+            }
+        } else if (diff < 0) {
+            return FALSE;
+        } else {
+            pos = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static WorkerJob* QueuePop(JobQueue* queue)
+{
+    uint32_t pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+
+    while (TRUE) {
+        QueueCell* cell = &queue->cells[pos & (AJ_WORKER_JOBS - 1)];
+        int32_t diff = (int32_t)(__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) - (pos + 1));
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&queue->tail, &pos, pos + 1, TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                WorkerJob* job = cell->job;
+                __atomic_store_n(&cell->seq, pos + AJ_WORKER_JOBS, __ATOMIC_RELEASE);
+                return job;
+            }
+        } else if (diff < 0) {
+            return NULL;
+        } else {
+            pos = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/*
+ * The whole method call is in the buffer so any attempt to read more is an error
+ */
+static AJ_Status WorkerRecv(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    return AJ_ERR_READ;
+}
+
+/*
+ * Appends marshaled reply data to the job's reply buffer
+ */
+static AJ_Status WorkerSend(AJ_IOBuffer* buf)
+{
+    Worker* worker = (Worker*)buf->context;
+    WorkerJob* job = worker->job;
+    uint32_t len = AJ_IO_BUF_AVAIL(buf);
+
+    if ((job->replyLen + len) > job->replySize) {
+        uint32_t size = max(job->replyLen + len, 2 * job->replySize);
+        uint8_t* reply = (uint8_t*)AJ_Malloc(size);
+        if (!reply) {
+            return AJ_ERR_RESOURCES;
+        }
+        memcpy(reply, job->reply, job->replyLen);
+        AJ_Free(job->reply);
+        job->reply = reply;
+        job->replySize = size;
+    }
+    memcpy(job->reply + job->replyLen, buf->readPtr, len);
+    job->replyLen += len;
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+static void RunJob(Worker* worker, WorkerJob* job)
+{
+    AJ_BusAttachment* bus = &worker->bus;
+    AJ_IOBuffer* rx = &bus->sock.rx;
+    AJ_Message reply;
+    AJ_Status status;
+
+    worker->job = job;
+    job->replyLen = 0;
+    AJ_IOBufInit(rx, job->call, job->callLen, AJ_IO_BUF_RX, worker);
+    rx->readPtr += job->bodyOffset;
+    rx->writePtr += job->callLen;
+    rx->recv = WorkerRecv;
+    AJ_IO_BUF_RESET(&bus->sock.tx);
+    job->msg.bus = bus;
+
+    status = AJ_MarshalReplyMsg(&job->msg, &reply);
+    if (status == AJ_OK) {
+        status = (job->handler)(&job->msg, &reply);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&reply);
+    }
+    AJ_CloseMsg(&job->msg);
+    job->status = status;
+}
+
+static void* WorkerThread(void* arg)
+{
+    Worker* worker = (Worker*)arg;
+    WorkerPool* workerPool = worker->pool;
+
+    AJ_RegisterObjects(workerPool->localObjects, workerPool->proxyObjects);
+    while (TRUE) {
+        WorkerJob* job;
+
+        while ((sem_wait(&workerPool->jobsReady) == -1) && (errno == EINTR)) {
+        }
+        /*
+         * The semaphore is posted without a job when the workers are being stopped
+         */
+        job = QueuePop(&workerPool->submitQueue);
+        if (!job) {
+            break;
+        }
+        RunJob(worker, job);
+        QueuePush(&workerPool->doneQueue, job);
+        eventfd_write(workerPool->doneFd, 1);
+    }
+    return NULL;
+}
+
+static void Submit(WorkerJob* job)
+{
+    job->state = JOB_QUEUED;
+    QueuePush(&pool->submitQueue, job);
+    sem_post(&pool->jobsReady);
+}
+
+/*
+ * Checks if an ordered method call in a session is being handled or waiting to be handled
+ */
+static uint8_t SessionBusy(const AJ_BusAttachment* bus, uint32_t sessionId)
+{
+    uint32_t i;
+
+    for (i = 0; i < AJ_WORKER_JOBS; ++i) {
+        WorkerJob* job = &pool->jobs[i];
+        if ((job->state != JOB_FREE) && (job->flags & AJ_HANDLER_ORDERED) && (job->sessionId == sessionId) && (job->bus == bus)) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+/*
+ * Passes the next held method call for a session to the workers
+ */
+static void ReleaseHeld(const AJ_BusAttachment* bus, uint32_t sessionId)
+{
+    WorkerJob* prev = NULL;
+    WorkerJob* job;
+
+    for (job = pool->heldHead; job; prev = job, job = job->next) {
+        if ((job->sessionId == sessionId) && (job->bus == bus)) {
+            if (prev) {
+                prev->next = job->next;
+            } else {
+                pool->heldHead = job->next;
+            }
+            if (pool->heldTail == job) {
+                pool->heldTail = prev;
+            }
+            Submit(job);
+            break;
+        }
+    }
+}
+
+static AJ_Status SendReply(AJ_BusAttachment* bus, WorkerJob* job)
+{
+    AJ_Status status = AJ_OK;
+    AJ_IOBuffer* ioBuf = &bus->sock.tx;
+    uint32_t sent = 0;
+
+    while ((status == AJ_OK) && (sent < job->replyLen)) {
+        uint32_t len = min(AJ_IO_BUF_SPACE(ioBuf), job->replyLen - sent);
+        memcpy(ioBuf->writePtr, job->reply + sent, len);
+        ioBuf->writePtr += len;
+        sent += len;
+        status = ioBuf->send(ioBuf);
+    }
+    return status;
+}
+
+static void WaitForWorker(void)
+{
+    struct pollfd fds;
+
+    fds.fd = pool->doneFd;
+    fds.events = POLLIN;
+    while ((poll(&fds, 1, -1) == -1) && (errno == EINTR)) {
+    }
+}
+
+/*
+ * Sends the reply for a finished job and returns the job to the free list
+ */
+static AJ_Status CompleteJob(WorkerJob* job)
+{
+    AJ_Status status = job->status;
+
+    if (status == AJ_OK) {
+        status = SendReply(job->bus, job);
+    }
+    job->state = JOB_FREE;
+    job->next = pool->freeJobs;
+    pool->freeJobs = job;
+    /*
+     * The next ordered call in the session is not passed to the workers until this reply was sent
+     */
+    if (job->flags & AJ_HANDLER_ORDERED) {
+        ReleaseHeld(job->bus, job->sessionId);
+    }
+    return status;
+}
+
+AJ_Status AJ_DeliverCompletedCalls(AJ_BusAttachment* bus)
+{
+    AJ_Status status = AJ_OK;
+    AJ_Status jobStatus;
+    WorkerJob** link;
+    eventfd_t count;
+    WorkerJob* job;
+
+    if (!pool || !pool->numWorkers) {
+        return AJ_OK;
+    }
+    /*
+     * Reset the eventfd before emptying the queue so a job that finishes after this is not missed
+     */
+    eventfd_read(pool->doneFd, &count);
+    /*
+     * Jobs for other buses are kept in the order they finished until this is called for their bus
+     */
+    link = &pool->completed;
+    while ((job = *link) != NULL) {
+        if (!bus || (job->bus == bus)) {
+            *link = job->next;
+            jobStatus = CompleteJob(job);
+            if (status == AJ_OK) {
+                status = jobStatus;
+            }
+        } else {
+            link = &job->next;
+        }
+    }
+    while ((job = QueuePop(&pool->doneQueue)) != NULL) {
+        if (!bus || (job->bus == bus)) {
+            jobStatus = CompleteJob(job);
+            if (status == AJ_OK) {
+                status = jobStatus;
+            }
+        } else {
+            job->state = JOB_DONE;
+            job->next = NULL;
+            *link = job;
+            link = &job->next;
+        }
+    }
+    return status;
+}
+
+/*
+ * Moves a pointer that points into a message to the same place in a copy of the message
+ */
+static const char* Rebase(const char* ptr, const uint8_t* from, uint32_t len, uint8_t* to)
+{
+    if (((const uint8_t*)ptr >= from) && ((const uint8_t*)ptr < (from + len))) {
+        return (const char*)(to + ((const uint8_t*)ptr - from));
+    }
+    return ptr;
+}
+
+AJ_Status AJ_QueueMethodCall(AJ_Message* msg, MessageHandler handler, uint8_t flags)
+{
+    AJ_IOBuffer* ioBuf = &msg->bus->sock.rx;
+    uint8_t* start = (uint8_t*)msg->hdr;
+    WorkerJob* job;
+    uint32_t len;
+
+    if (!pool || !pool->numWorkers || (msg->hdr->msgType != AJ_MSG_METHOD_CALL) || (msg->hdr->flags & AJ_FLAG_ENCRYPTED)) {
+        return AJ_ERR_UNEXPECTED;
+    }
+    /*
+     * The workers cannot read from the socket so the whole body must already be in the buffer
+     */
+    if (AJ_IO_BUF_AVAIL(ioBuf) < msg->bodyBytes) {
+        return AJ_ERR_RESOURCES;
+    }
+    while (!pool->freeJobs) {
+        AJ_DeliverCompletedCalls(NULL);
+        if (!pool->freeJobs) {
+            WaitForWorker();
+        }
+    }
+    job = pool->freeJobs;
+    len = (uint32_t)(ioBuf->readPtr - start) + msg->bodyBytes;
+    if (len > job->callSize) {
+        uint8_t* call = (uint8_t*)AJ_Malloc(len);
+        if (!call) {
+            return AJ_ERR_RESOURCES;
+        }
+        AJ_Free(job->call);
+        job->call = call;
+        job->callSize = len;
+    }
+    pool->freeJobs = job->next;
+    memcpy(job->call, start, len);
+    job->callLen = len;
+    job->bodyOffset = (uint32_t)(ioBuf->readPtr - start);
+    /*
+     * Header fields that point into the receive buffer are moved to the copy
+     */
+    job->msg = *msg;
+    job->msg.hdr = (AJ_MsgHeader*)job->call;
+    job->msg.objPath = Rebase(job->msg.objPath, start, len, job->call);
+    job->msg.member = Rebase(job->msg.member, start, len, job->call);
+    job->msg.iface = Rebase(job->msg.iface, start, len, job->call);
+    job->msg.sender = Rebase(job->msg.sender, start, len, job->call);
+    job->msg.destination = Rebase(job->msg.destination, start, len, job->call);
+    job->msg.signature = Rebase(job->msg.signature, start, len, job->call);
+    job->bus = msg->bus;
+    job->handler = handler;
+    job->flags = flags;
+    job->sessionId = msg->sessionId;
+    job->status = AJ_OK;
+    job->next = NULL;
+    if ((flags & AJ_HANDLER_ORDERED) && SessionBusy(msg->bus, msg->sessionId)) {
+        job->state = JOB_HELD;
+        if (pool->heldTail) {
+            pool->heldTail->next = job;
+        } else {
+            pool->heldHead = job;
+        }
+        pool->heldTail = job;
+    } else {
+        Submit(job);
+    }
+    return AJ_OK;
+}
+
+AJ_Status AJ_StartWorkers(uint32_t num)
+{
+    AJ_Status status = AJ_OK;
+    uint32_t i;
+
+    if (pool) {
+        return AJ_ERR_UNEXPECTED;
+    }
+    if (!num || (num > AJ_MAX_WORKERS)) {
+        return AJ_ERR_INVALID;
+    }
+    pool = (WorkerPool*)AJ_Malloc(sizeof(WorkerPool));
+    if (!pool) {
+        return AJ_ERR_RESOURCES;
+    }
+    memset(pool, 0, sizeof(WorkerPool));
+    AJ_GetRegisteredObjects(&pool->localObjects, &pool->proxyObjects);
+    QueueInit(&pool->submitQueue);
+    QueueInit(&pool->doneQueue);
+    for (i = 0; i < AJ_WORKER_JOBS; ++i) {
+        pool->jobs[i].state = JOB_FREE;
+        pool->jobs[i].next = pool->freeJobs;
+        pool->freeJobs = &pool->jobs[i];
+    }
+    pool->doneFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (pool->doneFd == -1) {
+        AJ_Free(pool);
+        pool = NULL;
+        return AJ_ERR_RESOURCES;
+    }
+    sem_init(&pool->jobsReady, 0, 0);
+    status = AJ_Net_Watch(pool->doneFd);
+    for (i = 0; (i < num) && (status == AJ_OK); ++i) {
+        Worker* worker = &pool->workers[i];
+        worker->pool = pool;
+        AJ_IOBufInit(&worker->bus.sock.tx, worker->txBuffer, sizeof(worker->txBuffer), AJ_IO_BUF_TX, worker);
+        worker->bus.sock.tx.send = WorkerSend;
+        /*
+         * Each worker numbers its replies from a different range
+         */
+        worker->bus.serial = 0x80000000 | (i << 24);
+        if (pthread_create(&worker->thread, NULL, WorkerThread, worker) != 0) {
+            status = AJ_ERR_RESOURCES;
+            break;
+        }
+        ++pool->numWorkers;
+    }
+    if (status != AJ_OK) {
+        AJ_StopWorkers();
+    }
+    return status;
+}
+
+void AJ_StopWorkers(void)
+{
+    uint32_t i;
+
+    if (!pool) {
+        return;
+    }
+    for (i = 0; i < pool->numWorkers; ++i) {
+        sem_post(&pool->jobsReady);
+    }
+    for (i = 0; i < pool->numWorkers; ++i) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+    AJ_Net_Unwatch(pool->doneFd);
+    close(pool->doneFd);
+    sem_destroy(&pool->jobsReady);
+    for (i = 0; i < AJ_WORKER_JOBS; ++i) {
+        AJ_Free(pool->jobs[i].call);
+        AJ_Free(pool->jobs[i].reply);
+    }
+    AJ_Free(pool);
+    pool = NULL;
+}
+
+uint32_t AJ_GetNumWorkers(void)
+{
+    return pool ? pool->numWorkers : 0;
+}
+
+#endif
@@ -17,15 +17,22 @@
  *    limitations under the license.
  ******************************************************************************/
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE /* for memfd_create() */
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/mman.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <assert.h>
 #include <errno.h>
 #include <time.h>
+#include <limits.h>
 
 #include "aj_target.h"
 #include "aj_bufio.h"
@@ -34,6 +41,12 @@
 
 #define INVALID_SOCKET (-1)
 
+#if AJ_NET_EPOLL
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#endif
+
 /*
  * IANA assigned IPv4 multicast group for AllJoyn.
  */
@@ -49,6 +62,481 @@ static const char AJ_IPV6_MULTICAST_GROUP[] = "ff02::13a";
  */
 #define AJ_UDP_PORT 9956
 
+#if AJ_NET_EPOLL
+
+/*
+ * How long a send waits for the peer to drain the socket before failing
+ */
+#ifndef AJ_NET_SEND_TIMEOUT
+#define AJ_NET_SEND_TIMEOUT (30 * 1000)
+#endif
+
+/*
+ * Maximum number of events collected by one epoll_wait()
+ */
+#define NET_EVENT_BATCH 64
+
+/*
+ * Sockets are registered edge-triggered so readiness is only reported when it changes. The last
+ * reported readiness is cached here, indexed by file descriptor, and cleared when a read or write
+ * would block.
+ */
+typedef struct {
+    AJ_NetSocket* owner;   /* The bus connection or NULL for a multicast socket */
+    int nextPending;       /* Next entry in the list of readable bus connections */
+    uint8_t registered;
+    uint8_t watched;       /* An application file descriptor that wakes up AJ_Net_Poll() */
+    uint8_t readable;
+    uint8_t writable;
+    uint8_t pending;
+} NetReady;
+
+static AJ_THREAD_LOCAL NetReady* netReady = NULL;
+static AJ_THREAD_LOCAL int numNetReady = 0;
+
+static AJ_THREAD_LOCAL int epollFd = INVALID_SOCKET;
+
+/*
+ * Bus connections that have become readable and have not yet been returned by AJ_Net_Poll()
+ */
+static AJ_THREAD_LOCAL int pendingHead = INVALID_SOCKET;
+static AJ_THREAD_LOCAL int pendingTail = INVALID_SOCKET;
+
+/*
+ * Whether a watched file descriptor has become readable since AJ_Net_Poll() last returned
+ */
+static AJ_THREAD_LOCAL uint8_t watchReady = FALSE;
+
+static NetReady* GetReady(int sock)
+{
+    if ((sock >= 0) && (sock < numNetReady) && netReady[sock].registered) {
+        return &netReady[sock];
+    }
+    return NULL;
+}
+
+/*
+ * Make a socket non-blocking and add it to the epoll instance
+ */
+static AJ_Status NetEpoll(void)
+{
+    if (epollFd == INVALID_SOCKET) {
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (epollFd == INVALID_SOCKET) {
+            return AJ_ERR_RESOURCES;
+        }
+    }
+    return AJ_OK;
+}
+
+/*
+ * Make sure the readiness table has an entry for a file descriptor
+ */
+static AJ_Status NetGrow(int fd)
+{
+    if (fd >= numNetReady) {
+        int num = max(fd + 1, 2 * numNetReady);
+        NetReady* grown = (NetReady*)realloc(netReady, num * sizeof(NetReady));
+        if (!grown) {
+            return AJ_ERR_RESOURCES;
+        }
+        memset(grown + numNetReady, 0, (num - numNetReady) * sizeof(NetReady));
+        netReady = grown;
+        numNetReady = num;
+    }
+    return AJ_OK;
+}
+
+static AJ_Status NetRegister(int sock, AJ_NetSocket* owner)
+{
+    struct epoll_event ev;
+    NetReady* ready;
+    int flags;
+
+    if (NetGrow(sock) != AJ_OK) {
+        return AJ_ERR_RESOURCES;
+    }
+    if (NetEpoll() != AJ_OK) {
+        return AJ_ERR_RESOURCES;
+    }
+    flags = fcntl(sock, F_GETFL, 0);
+    if ((flags == -1) || (fcntl(sock, F_SETFL, flags | O_NONBLOCK) == -1)) {
+        return AJ_ERR_RESOURCES;
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    ev.data.fd = sock;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, sock, &ev) == -1) {
+        return AJ_ERR_RESOURCES;
+    }
+    /*
+     * Assume the socket is ready, the first read or write finds out if it is not. An entry for a
+     * closed socket may still be on the pending list so that is left alone.
+     */
+    ready = &netReady[sock];
+    ready->owner = owner;
+    ready->registered = TRUE;
+    ready->readable = TRUE;
+    ready->writable = TRUE;
+    return AJ_OK;
+}
+
+static void NetUnregister(int sock)
+{
+    NetReady* ready = GetReady(sock);
+    if (ready) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, sock, NULL);
+        ready->registered = FALSE;
+        ready->owner = NULL;
+    }
+}
+
+/*
+ * Records the events reported for a socket and queues bus connections that became readable
+ */
+static void NetEvent(const struct epoll_event* event)
+{
+    NetReady* ready;
+
+    if ((event->data.fd < numNetReady) && netReady[event->data.fd].watched) {
+        watchReady = TRUE;
+        return;
+    }
+    ready = GetReady(event->data.fd);
+    if (!ready) {
+        return;
+    }
+    if (event->events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+        ready->readable = TRUE;
+        if (ready->owner && !ready->pending) {
+            ready->pending = TRUE;
+            ready->nextPending = INVALID_SOCKET;
+            if (pendingTail == INVALID_SOCKET) {
+                pendingHead = event->data.fd;
+            } else {
+                netReady[pendingTail].nextPending = event->data.fd;
+            }
+            pendingTail = event->data.fd;
+        }
+    }
+    if (event->events & (EPOLLOUT | EPOLLHUP | EPOLLERR)) {
+        ready->writable = TRUE;
+    }
+}
+
+/*
+ * Waits for a socket to become readable or writable. Events for other registered sockets are
+ * recorded so they are not lost.
+ */
+static AJ_Status NetWait(AJ_IOBuffer* buf, NetReady* ready, uint8_t forWrite, uint32_t timeout)
+{
+    struct epoll_event events[NET_EVENT_BATCH];
+    uint32_t elapsed = 0;
+    AJ_Time timer;
+
+    AJ_InitTimer(&timer);
+    while (!(forWrite ? ready->writable : ready->readable)) {
+        int wait = (timeout == (uint32_t)-1) ? -1 : (int)min(timeout - elapsed, INT_MAX);
+        int n;
+        int i;
+
+        if (!wait) {
+            return AJ_ERR_TIMEOUT;
+        }
+        n = epoll_wait(epollFd, events, NET_EVENT_BATCH, wait);
+        ++buf->syscalls;
+        if ((n == -1) && (errno != EINTR)) {
+            return AJ_ERR_READ;
+        }
+        for (i = 0; i < n; ++i) {
+            NetEvent(&events[i]);
+        }
+        if (forWrite ? ready->writable : ready->readable) {
+            break;
+        }
+        elapsed = AJ_GetElapsedTime(&timer, TRUE);
+        if (elapsed >= timeout) {
+            return AJ_ERR_TIMEOUT;
+        }
+    }
+    return AJ_OK;
+}
+
+uint32_t AJ_Net_Poll(AJ_NetSocket** ready, uint32_t max, uint32_t timeout)
+{
+    uint32_t num = 0;
+    uint32_t elapsed = 0;
+    AJ_Time timer;
+
+    AJ_InitTimer(&timer);
+    /*
+     * Events that only report a socket is writable don't end the wait
+     */
+    while ((pendingHead == INVALID_SOCKET) && !watchReady && (epollFd != INVALID_SOCKET)) {
+        struct epoll_event events[NET_EVENT_BATCH];
+        int wait = (timeout == (uint32_t)-1) ? -1 : (int)min(timeout - elapsed, INT_MAX);
+        int n = epoll_wait(epollFd, events, NET_EVENT_BATCH, wait);
+        int i;
+
+        for (i = 0; i < n; ++i) {
+            NetEvent(&events[i]);
+        }
+        elapsed = AJ_GetElapsedTime(&timer, TRUE);
+        if (elapsed >= timeout) {
+            break;
+        }
+    }
+    while ((num < max) && (pendingHead != INVALID_SOCKET)) {
+        NetReady* entry = &netReady[pendingHead];
+        /*
+         * Connections that were closed while they were on the list are skipped
+         */
+        if (entry->owner) {
+            ready[num++] = entry->owner;
+        }
+        entry->pending = FALSE;
+        pendingHead = entry->nextPending;
+        if (pendingHead == INVALID_SOCKET) {
+            pendingTail = INVALID_SOCKET;
+        }
+    }
+    watchReady = FALSE;
+    return num;
+}
+
+AJ_Status AJ_Net_Watch(int fd)
+{
+    struct epoll_event ev;
+
+    if ((NetEpoll() != AJ_OK) || (NetGrow(fd) != AJ_OK)) {
+        return AJ_ERR_RESOURCES;
+    }
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.fd = fd;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        return AJ_ERR_RESOURCES;
+    }
+    netReady[fd].watched = TRUE;
+    return AJ_OK;
+}
+
+void AJ_Net_Unwatch(int fd)
+{
+    if ((fd >= 0) && (fd < numNetReady) && netReady[fd].watched) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+        netReady[fd].watched = FALSE;
+    }
+}
+
+/*
+ * Sends all the buffered data. A short write means the socket buffer is full so rather than
+ * retrying straight away this waits for epoll to report that the peer has drained some data.
+ */
+AJ_Status AJ_Net_Send(AJ_IOBuffer* buf)
+{
+    int sock = (int)buf->context;
+    NetReady* ready = GetReady(sock);
+
+    assert(buf->direction == AJ_IO_BUF_TX);
+
+    if (!ready) {
+        return AJ_ERR_WRITE;
+    }
+    while (AJ_IO_BUF_AVAIL(buf)) {
+        if (ready->writable) {
+            size_t tx = AJ_IO_BUF_AVAIL(buf);
+            ssize_t ret = send(sock, buf->readPtr, tx, MSG_NOSIGNAL);
+            ++buf->syscalls;
+            if (ret >= 0) {
+                buf->readPtr += ret;
+                if ((size_t)ret < tx) {
+                    ready->writable = FALSE;
+                }
+                continue;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+#ifndef NDEBUG
+                fprintf(stderr, "send() failed: %s\n", strerror(errno));
+#endif
+                return AJ_ERR_WRITE;
+            }
+            ready->writable = FALSE;
+        }
+        if (NetWait(buf, ready, TRUE, AJ_NET_SEND_TIMEOUT) != AJ_OK) {
+            return AJ_ERR_WRITE;
+        }
+    }
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+/*
+ * Sends a list of buffers with as few sendmsg() calls as the socket allows. Empty buffers must not
+ * be in the list.
+ */
+static AJ_Status SendIov(AJ_IOBuffer* buf, struct iovec* iov, size_t num)
+{
+    int sock = (int)buf->context;
+    NetReady* ready = GetReady(sock);
+    struct msghdr mh;
+    ssize_t ret;
+
+    assert(buf->direction == AJ_IO_BUF_TX);
+
+    if (!ready) {
+        return AJ_ERR_WRITE;
+    }
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = iov;
+    mh.msg_iovlen = num;
+
+    while (mh.msg_iovlen) {
+        if (ready->writable) {
+            ret = sendmsg(sock, &mh, MSG_NOSIGNAL);
+            ++buf->syscalls;
+            if (ret == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+#ifndef NDEBUG
+                    fprintf(stderr, "sendmsg() failed: %s\n", strerror(errno));
+#endif
+                    return AJ_ERR_WRITE;
+                }
+                ready->writable = FALSE;
+            } else {
+                /*
+                 * Skip over whatever was sent in case this was a partial write
+                 */
+                while (mh.msg_iovlen && ((size_t)ret >= mh.msg_iov->iov_len)) {
+                    ret -= mh.msg_iov->iov_len;
+                    ++mh.msg_iov;
+                    --mh.msg_iovlen;
+                }
+                if (mh.msg_iovlen) {
+                    mh.msg_iov->iov_base = (uint8_t*)mh.msg_iov->iov_base + ret;
+                    mh.msg_iov->iov_len -= ret;
+                    ready->writable = FALSE;
+                }
+                continue;
+            }
+        }
+        if (NetWait(buf, ready, TRUE, AJ_NET_SEND_TIMEOUT) != AJ_OK) {
+            return AJ_ERR_WRITE;
+        }
+    }
+    return AJ_OK;
+}
+
+/*
+ * Sends the buffered data and the application data with a single sendmsg() so the application data
+ * is never copied.
+ */
+static AJ_Status AJ_Net_SendV(AJ_IOBuffer* buf, const uint8_t* data, uint32_t len)
+{
+    AJ_Status status;
+    struct iovec iov[2];
+
+    iov[0].iov_base = buf->readPtr;
+    iov[0].iov_len = AJ_IO_BUF_AVAIL(buf);
+    iov[1].iov_base = (void*)data;
+    iov[1].iov_len = len;
+    status = SendIov(buf, iov[0].iov_len ? &iov[0] : &iov[1], iov[0].iov_len ? 2 : 1);
+    if (status == AJ_OK) {
+        AJ_IO_BUF_RESET(buf);
+    }
+    return status;
+}
+
+AJ_Status AJ_Net_SendFrames(AJ_IOBuffer* buf, uint8_t* const* frames, const uint32_t* lens, uint32_t num)
+{
+    AJ_Status status;
+    struct iovec iov[AJ_NET_MAX_FRAMES + 1];
+    size_t n = 0;
+    uint32_t i;
+
+    if (num > AJ_NET_MAX_FRAMES) {
+        return AJ_ERR_INVALID;
+    }
+    if (AJ_IO_BUF_AVAIL(buf)) {
+        iov[n].iov_base = buf->readPtr;
+        iov[n++].iov_len = AJ_IO_BUF_AVAIL(buf);
+    }
+    for (i = 0; i < num; ++i) {
+        if (lens[i]) {
+            iov[n].iov_base = frames[i];
+            iov[n++].iov_len = lens[i];
+        }
+    }
+    status = SendIov(buf, iov, n);
+    if (status == AJ_OK) {
+        AJ_IO_BUF_RESET(buf);
+    }
+    return status;
+}
+
+/*
+ * Reads as much as will fit in the buffer rather than just the len bytes requested. When messages
+ * arrive in a burst the ones after the first are unmarshaled from the buffer without any further
+ * system calls. The socket is only waited on when a read would block.
+ */
+AJ_Status AJ_Net_Recv(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    AJ_Status status;
+    size_t rx = AJ_IO_BUF_SPACE(buf);
+    int sock = (int)buf->context;
+    NetReady* ready = GetReady(sock);
+    ssize_t ret;
+
+    assert(buf->direction == AJ_IO_BUF_RX);
+
+    if (!rx) {
+        return AJ_ERR_RESOURCES;
+    }
+    if (!ready) {
+        return AJ_ERR_READ;
+    }
+    while (TRUE) {
+        /*
+         * A zero timeout is a poll from an application event loop which may know better than the
+         * cache that there is data to read
+         */
+        if (ready->readable || !timeout) {
+            ret = recv(sock, buf->writePtr, rx, 0);
+            ++buf->syscalls;
+            if (ret > 0) {
+                /*
+                 * The socket is left marked readable even after a short read. Reading first is
+                 * cheaper than an epoll_wait() when more data arrived in the mean time.
+                 */
+                buf->writePtr += ret;
+                return AJ_OK;
+            }
+            if ((ret == -1) && (errno == EINTR)) {
+                continue;
+            }
+            if ((ret == 0) || ((errno != EAGAIN) && (errno != EWOULDBLOCK))) {
+#ifndef NDEBUG
+                fprintf(stderr, "recv() failed: %s\n", ret ? strerror(errno) : "connection closed");
+#endif
+                return AJ_ERR_READ;
+            }
+            ready->readable = FALSE;
+        }
+        status = NetWait(buf, ready, FALSE, timeout);
+        if (status != AJ_OK) {
+            return status;
+        }
+    }
+}
+
+#else
+
 AJ_Status AJ_Net_Send(AJ_IOBuffer* buf)
 {
     ssize_t ret;
@@ -58,6 +546,7 @@ AJ_Status AJ_Net_Send(AJ_IOBuffer* buf)
 
     if (tx > 0) {
         ret = send((int)buf->context, buf->readPtr, tx, 0);
+        ++buf->syscalls;
         if (ret == -1) {
 #ifndef NDEBUG
             fprintf(stderr, "send() failed: %s\n", strerror(errno));
@@ -68,53 +557,261 @@ AJ_Status AJ_Net_Send(AJ_IOBuffer* buf)
     }
     if (AJ_IO_BUF_AVAIL(buf) == 0) {
         AJ_IO_BUF_RESET(buf);
+    } else {
+        /*
+         * The rest is sent by AJ_ProcessReady() when the socket is writable
+         */
+        buf->pending = TRUE;
+    }
+    return AJ_OK;
+}
+
+/*
+ * Sends the buffered data and the application data with a single sendmsg() so the application data
+ * is never copied.
+ */
+static AJ_Status AJ_Net_SendV(AJ_IOBuffer* buf, const uint8_t* data, uint32_t len)
+{
+    struct iovec iov[2];
+    struct msghdr mh;
+    ssize_t ret;
+
+    assert(buf->direction == AJ_IO_BUF_TX);
+
+    iov[0].iov_base = buf->readPtr;
+    iov[0].iov_len = AJ_IO_BUF_AVAIL(buf);
+    iov[1].iov_base = (void*)data;
+    iov[1].iov_len = len;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov = iov[0].iov_len ? &iov[0] : &iov[1];
+    mh.msg_iovlen = iov[0].iov_len ? 2 : 1;
+
+    while (mh.msg_iovlen) {
+        ret = sendmsg((int)buf->context, &mh, MSG_NOSIGNAL);
+        ++buf->syscalls;
+        if (ret == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+#ifndef NDEBUG
+            fprintf(stderr, "sendmsg() failed: %s\n", strerror(errno));
+#endif
+            return AJ_ERR_WRITE;
+        }
+        /*
+         * Skip over whatever was sent in case this was a partial write
+         */
+        while (mh.msg_iovlen && ((size_t)ret >= mh.msg_iov->iov_len)) {
+            ret -= mh.msg_iov->iov_len;
+            ++mh.msg_iov;
+            --mh.msg_iovlen;
+        }
+        if (mh.msg_iovlen) {
+            mh.msg_iov->iov_base = (uint8_t*)mh.msg_iov->iov_base + ret;
+            mh.msg_iov->iov_len -= ret;
+        }
     }
+    AJ_IO_BUF_RESET(buf);
     return AJ_OK;
 }
 
+/*
+ * Reads as much as will fit in the buffer rather than just the len bytes requested. When messages
+ * arrive in a burst the ones after the first are unmarshaled from the buffer without any further
+ * system calls. The socket is read without blocking first so select() is only called when there
+ * is nothing waiting to be read.
+ */
 AJ_Status AJ_Net_Recv(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
 {
     AJ_Status status = AJ_OK;
     size_t rx = AJ_IO_BUF_SPACE(buf);
-    fd_set fds;
-    int maxFd = INVALID_SOCKET;
-    int rc = 0;
-    struct timeval tv = { timeout / 1000, 1000 * (timeout % 1000) };
+    int sock = (int)buf->context;
+    ssize_t ret;
 
     assert(buf->direction == AJ_IO_BUF_RX);
 
-    FD_ZERO(&fds);
-    FD_SET((int)buf->context, &fds);
-    maxFd = max(maxFd, (int)buf->context);
-    rc = select(maxFd + 1, &fds, NULL, NULL, &tv);
-    if (rc == 0) {
-        return AJ_ERR_TIMEOUT;
+    if (!rx) {
+        return AJ_ERR_RESOURCES;
     }
+    ret = recv(sock, buf->writePtr, rx, MSG_DONTWAIT);
+    ++buf->syscalls;
+    if ((ret == -1) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))) {
+        fd_set fds;
+        struct timeval tv = { timeout / 1000, 1000 * (timeout % 1000) };
 
-    rx = min(rx, len);
-    if (rx) {
-        ssize_t ret = recv((int)buf->context, buf->writePtr, rx, 0);
-        if ((ret == -1) || (ret == 0)) {
+        /*
+         * Linux updates tv with the time left so an interrupted select() is just called again
+         */
+        do {
+            FD_ZERO(&fds);
+            FD_SET(sock, &fds);
+            ret = select(sock + 1, &fds, NULL, NULL, &tv);
+            ++buf->syscalls;
+        } while ((ret == -1) && (errno == EINTR));
+        if (ret == 0) {
+            return AJ_ERR_TIMEOUT;
+        }
+        if (ret > 0) {
+            do {
+                ret = recv(sock, buf->writePtr, rx, 0);
+                ++buf->syscalls;
+            } while ((ret == -1) && (errno == EINTR));
+        }
+    }
+    if ((ret == -1) || (ret == 0)) {
 #ifndef NDEBUG
-            fprintf(stderr, "recv() failed: %s\n", strerror(errno));
+        fprintf(stderr, "recv() failed: %s\n", strerror(errno));
 #endif
-            status = AJ_ERR_READ;
-        } else {
-            buf->writePtr += ret;
-        }
+        status = AJ_ERR_READ;
+    } else {
+        buf->writePtr += ret;
     }
     return status;
 }
 
+#endif
+
+/*
+ * Size of the I/O buffers given to each bus connection
+ */
+#ifndef AJ_NET_RX_BUFFER_SIZE
+#define AJ_NET_RX_BUFFER_SIZE 1024
+#endif
+
+#ifndef AJ_NET_TX_BUFFER_SIZE
+#define AJ_NET_TX_BUFFER_SIZE 1024
+#endif
+
+#if AJ_RX_RING_SIZE > 0xFFFF
+#error "AJ_RX_RING_SIZE must be less than 64K"
+#endif
+
+uint8_t* AJ_Net_MapRing(uint32_t size)
+{
+    uint8_t* ring = NULL;
+    int fd;
+
+    if (size % sysconf(_SC_PAGESIZE)) {
+        return NULL;
+    }
+    fd = memfd_create("aj_rx_ring", 0);
+    if (fd == -1) {
+        return NULL;
+    }
+    if (ftruncate(fd, size) == 0) {
+        /*
+         * Reserve the address space for both mappings then map the memory into each half
+         */
+        ring = mmap(NULL, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ring == MAP_FAILED) {
+            ring = NULL;
+        } else if ((mmap(ring, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) ||
+                   (mmap(ring + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)) {
+            munmap(ring, 2 * size);
+            ring = NULL;
+        }
+    }
+    close(fd);
+    return ring;
+}
+
+void AJ_Net_UnmapRing(uint8_t* ring, uint32_t size)
+{
+    if (ring) {
+        munmap(ring, 2 * size);
+    }
+}
+
+/*
+ * The buffers for one connection. These are taken from a free list when a socket is opened and
+ * returned to it when the socket is closed so a process can have many bus attachments.
+ */
+typedef struct _NetBuffers {
+    struct _NetBuffers* next;
+#if AJ_RX_RING_SIZE
+    uint8_t* ring;   /* Mapped when the buffers are allocated and kept until the process exits */
+#endif
+    uint8_t tx[AJ_NET_TX_BUFFER_SIZE];
+    uint8_t rx[AJ_NET_RX_BUFFER_SIZE]; /* Must be last, it is not allocated when there is a ring */
+} NetBuffers;
+
+static AJ_THREAD_LOCAL NetBuffers* freeBuffers = NULL;
+#if AJ_RX_RING_SIZE
+static AJ_THREAD_LOCAL NetBuffers* freeRings = NULL;
+#endif
+
+/*
+ * Buffers for a bus connection receive into a ring if one can be mapped, multicast sockets always
+ * use the linear receive buffer
+ */
+static NetBuffers* AllocBuffers(uint8_t ring)
+{
+    NetBuffers** freeList = &freeBuffers;
+    NetBuffers* bufs;
+
+#if AJ_RX_RING_SIZE
+    if (ring) {
+        freeList = &freeRings;
+    }
+#endif
+    bufs = *freeList;
+    if (bufs) {
+        *freeList = bufs->next;
+        return bufs;
+    }
+#if AJ_RX_RING_SIZE
+    if (ring) {
+        uint8_t* mem = AJ_Net_MapRing(AJ_RX_RING_SIZE);
+        if (mem) {
+            bufs = (NetBuffers*)AJ_Malloc(offsetof(NetBuffers, rx));
+            if (bufs) {
+                bufs->ring = mem;
+            } else {
+                AJ_Net_UnmapRing(mem, AJ_RX_RING_SIZE);
+            }
+            return bufs;
+        }
+    }
+#endif
+    bufs = (NetBuffers*)AJ_Malloc(sizeof(NetBuffers));
+#if AJ_RX_RING_SIZE
+    if (bufs) {
+        bufs->ring = NULL;
+    }
+#endif
+    return bufs;
+}
+
+static void FreeBuffers(NetBuffers* bufs)
+{
+    NetBuffers** freeList = &freeBuffers;
 
-static uint8_t rxData[1024];
-static uint8_t txData[1024];
+#if AJ_RX_RING_SIZE
+    if (bufs->ring) {
+        freeList = &freeRings;
+    }
+#endif
+    bufs->next = *freeList;
+    *freeList = bufs;
+}
+
+/*
+ * Returns a socket's buffers to the free list and marks it as closed
+ */
+static void ReleaseSocket(AJ_NetSocket* netSock)
+{
+    FreeBuffers((NetBuffers*)(netSock->tx.bufStart - offsetof(NetBuffers, tx)));
+    memset(netSock, 0, sizeof(AJ_NetSocket));
+    netSock->rx.context = (void*)INVALID_SOCKET;
+    netSock->tx.context = (void*)INVALID_SOCKET;
+}
 
 AJ_Status AJ_Net_Connect(AJ_NetSocket* netSock, uint16_t port, uint8_t addrType, const uint32_t* addr)
 {
     int ret;
     struct sockaddr_storage addrBuf;
     socklen_t addrSize;
+    NetBuffers* bufs;
 
     memset(&addrBuf, 0, sizeof(addrBuf));
 
@@ -141,26 +838,58 @@ AJ_Status AJ_Net_Connect(AJ_NetSocket* netSock, uint16_t port, uint8_t addrType,
 #ifndef NDEBUG
         fprintf(stderr, "connect() failed: %d\n", ret);
 #endif
+        close(tcpSock);
+        return AJ_ERR_CONNECT;
+    }
+    bufs = AllocBuffers(TRUE);
+    if (!bufs) {
+        close(tcpSock);
+        return AJ_ERR_RESOURCES;
+    }
+#if AJ_NET_EPOLL
+    if (NetRegister(tcpSock, netSock) != AJ_OK) {
+        FreeBuffers(bufs);
+        close(tcpSock);
         return AJ_ERR_CONNECT;
+    }
+#endif
+#if AJ_RX_RING_SIZE
+    if (bufs->ring) {
+        AJ_IOBufInitRing(&netSock->rx, bufs->ring, AJ_RX_RING_SIZE, AJ_IO_BUF_RX, (void*)tcpSock);
     } else {
-        AJ_IOBufInit(&netSock->rx, rxData, sizeof(rxData), AJ_IO_BUF_RX, (void*)tcpSock);
-        netSock->rx.recv = AJ_Net_Recv;
-        AJ_IOBufInit(&netSock->tx, txData, sizeof(txData), AJ_IO_BUF_TX, (void*)tcpSock);
-        netSock->tx.send = AJ_Net_Send;
-        return AJ_OK;
+        AJ_IOBufInit(&netSock->rx, bufs->rx, sizeof(bufs->rx), AJ_IO_BUF_RX, (void*)tcpSock);
     }
+#else
+    AJ_IOBufInit(&netSock->rx, bufs->rx, sizeof(bufs->rx), AJ_IO_BUF_RX, (void*)tcpSock);
+#endif
+    netSock->rx.recv = AJ_Net_Recv;
+    AJ_IOBufInit(&netSock->tx, bufs->tx, sizeof(bufs->tx), AJ_IO_BUF_TX, (void*)tcpSock);
+    netSock->tx.send = AJ_Net_Send;
+    netSock->tx.sendv = AJ_Net_SendV;
+    return AJ_OK;
 }
 
 void AJ_Net_Disconnect(AJ_NetSocket* netSock)
 {
     int tcpSock = (int)netSock->rx.context;
-    if (tcpSock != INVALID_SOCKET) {
+    /*
+     * Only a connected socket has buffers
+     */
+    if (netSock->tx.bufStart) {
+#if AJ_NET_EPOLL
+        NetUnregister(tcpSock);
+#endif
         shutdown(tcpSock, SHUT_RDWR);
         close(tcpSock);
-        tcpSock = INVALID_SOCKET;
+        ReleaseSocket(netSock);
     }
 }
 
+int AJ_Net_GetFd(AJ_NetSocket* netSock)
+{
+    return (int)netSock->rx.context;
+}
+
 AJ_Status AJ_Net_SendTo(AJ_IOBuffer* buf)
 {
     ssize_t ret;
@@ -177,6 +906,21 @@ AJ_Status AJ_Net_SendTo(AJ_IOBuffer* buf)
         sin.sin_port = htons(AJ_UDP_PORT);
         sin.sin_addr.s_addr = inet_addr(AJ_IPV4_MULTICAST_GROUP);
         ret = sendto((int)buf->context, buf->readPtr, tx, 0, (struct sockaddr*)&sin, sizeof(sin));
+#if AJ_NET_EPOLL
+        /*
+         * The socket is non-blocking so wait for space if the send buffer is full
+         */
+        while ((ret == -1) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))) {
+            NetReady* ready = GetReady((int)buf->context);
+            if (errno != EINTR) {
+                ready->writable = FALSE;
+                if (NetWait(buf, ready, TRUE, AJ_NET_SEND_TIMEOUT) != AJ_OK) {
+                    break;
+                }
+            }
+            ret = sendto((int)buf->context, buf->readPtr, tx, 0, (struct sockaddr*)&sin, sizeof(sin));
+        }
+#endif
         if (ret == -1) {
 #ifndef NDEBUG
             fprintf(stderr, "sendto() failed: %s\n", strerror(errno));
@@ -194,6 +938,40 @@ AJ_Status AJ_Net_RecvFrom(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
     AJ_Status status;
     ssize_t ret;
     size_t rx = AJ_IO_BUF_SPACE(buf);
+#if AJ_NET_EPOLL
+    int sock = (int)buf->context;
+    NetReady* ready = GetReady(sock);
+
+    assert(buf->direction == AJ_IO_BUF_RX);
+
+    if (!ready) {
+        return AJ_ERR_READ;
+    }
+    rx = min(rx, len);
+    while (TRUE) {
+        if (ready->readable) {
+            /*
+             * Each datagram raises an edge so the socket stays readable until a read would block
+             */
+            ret = recvfrom(sock, buf->writePtr, rx, 0, NULL, 0);
+            if (ret >= 0) {
+                buf->writePtr += ret;
+                return AJ_OK;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+                return AJ_ERR_READ;
+            }
+            ready->readable = FALSE;
+        }
+        status = NetWait(buf, ready, FALSE, timeout);
+        if (status != AJ_OK) {
+            return status;
+        }
+    }
+#else
     fd_set fds;
     int maxFd = INVALID_SOCKET;
     int rc = 0;
@@ -218,11 +996,9 @@ AJ_Status AJ_Net_RecvFrom(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
         status = AJ_OK;
     }
     return status;
+#endif
 }
 
-static uint8_t rxDataMCast[256];
-static uint8_t txDataMCast[256];
-
 #ifndef SO_REUSEPORT
 #define SO_REUSEPORT SO_REUSEADDR
 #endif
@@ -233,6 +1009,7 @@ AJ_Status AJ_Net_MCastUp(AJ_NetSocket* netSock)
     struct ip_mreq mreq;
     struct sockaddr_in sin;
     int reuse = 1;
+    NetBuffers* bufs;
 
     int mcastSock = socket(AF_INET, SOCK_DGRAM, 0);
     if (mcastSock == INVALID_SOCKET) {
@@ -263,15 +1040,22 @@ AJ_Status AJ_Net_MCastUp(AJ_NetSocket* netSock)
     mreq.imr_multiaddr.s_addr = inet_addr(AJ_IPV4_MULTICAST_GROUP);
     mreq.imr_interface.s_addr = INADDR_ANY;
     ret = setsockopt(mcastSock, IPPROTO_IP, IP_ADD_MEMBERSHIP, (char*)&mreq, sizeof(mreq));
-    if (ret < 0) {
+    bufs = (ret == 0) ? AllocBuffers(FALSE) : NULL;
+    if (!bufs) {
+        close(mcastSock);
+        return AJ_ERR_READ;
+    }
+#if AJ_NET_EPOLL
+    if (NetRegister(mcastSock, NULL) != AJ_OK) {
+        FreeBuffers(bufs);
         close(mcastSock);
         return AJ_ERR_READ;
-    } else {
-        AJ_IOBufInit(&netSock->rx, rxDataMCast, sizeof(rxDataMCast), AJ_IO_BUF_RX, (void*)mcastSock);
-        netSock->rx.recv = AJ_Net_RecvFrom;
-        AJ_IOBufInit(&netSock->tx, txDataMCast, sizeof(txDataMCast), AJ_IO_BUF_TX, (void*)mcastSock);
-        netSock->tx.send = AJ_Net_SendTo;
     }
+#endif
+    AJ_IOBufInit(&netSock->rx, bufs->rx, sizeof(bufs->rx), AJ_IO_BUF_RX, (void*)mcastSock);
+    netSock->rx.recv = AJ_Net_RecvFrom;
+    AJ_IOBufInit(&netSock->tx, bufs->tx, sizeof(bufs->tx), AJ_IO_BUF_TX, (void*)mcastSock);
+    netSock->tx.send = AJ_Net_SendTo;
 
     return AJ_OK;
 }
@@ -281,16 +1065,19 @@ void AJ_Net_MCastDown(AJ_NetSocket* netSock)
     struct ip_mreq mreq;
     int mcastSock = (int)netSock->rx.context;
 
-    if (mcastSock != INVALID_SOCKET) {
+    if (netSock->tx.bufStart) {
         /*
          * Leave our multicast group
          */
         mreq.imr_multiaddr.s_addr = inet_addr(AJ_IPV4_MULTICAST_GROUP);
         mreq.imr_interface.s_addr = INADDR_ANY;
         setsockopt(mcastSock, IPPROTO_IP, IP_DROP_MEMBERSHIP, (char*) &mreq, sizeof(mreq));
+#if AJ_NET_EPOLL
+        NetUnregister(mcastSock);
+#endif
         shutdown(mcastSock, SHUT_RDWR);
         close(mcastSock);
-        mcastSock = INVALID_SOCKET;
+        ReleaseSocket(netSock);
     }
 }
 
@@ -300,6 +1087,24 @@ AJ_Status AJ_Net_Up()
     return AJ_OK;
 }
 
+#if AJ_NET_EPOLL
+uint32_t AJ_Net_RaiseFileLimit(void)
+{
+    struct rlimit limit;
+
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0) {
+        return 0;
+    }
+    if (limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &limit) != 0) {
+            getrlimit(RLIMIT_NOFILE, &limit);
+        }
+    }
+    return (limit.rlim_cur > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)limit.rlim_cur;
+}
+#endif
+
 void AJ_Net_Down()
 {
 }
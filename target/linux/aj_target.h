@@ -54,6 +54,110 @@
 
 #define AJ_ASSERT(x) assert(x)
 
+/*
+ * Runtime state is kept per thread so each thread can run its own bus attachments. Define this as
+ * empty if the library is only used from one thread.
+ */
+#ifndef AJ_THREAD_LOCAL
+#define AJ_THREAD_LOCAL __thread
+#endif
+
+/*
+ * Set to 1 to use non-blocking sockets with epoll() or 0 to use select()
+ */
+#ifndef AJ_NET_EPOLL
+#define AJ_NET_EPOLL 1
+#endif
+
+/*
+ * Size of the receive ring buffer. This must be a multiple of the page size and less than 64K. Zero
+ * uses the linear receive buffer. The ring saves copying unconsumed data but each connection then
+ * needs a memfd, a double mapping and the ring memory.
+ */
+#ifndef AJ_RX_RING_SIZE
+#define AJ_RX_RING_SIZE 0
+#endif
+
+/*
+ * Set to 1 on CPUs that trap on unaligned loads so received messages are kept 8 byte aligned
+ */
+#ifndef AJ_STRICT_ALIGNMENT
+#if defined(__i386__) || defined(__x86_64__) || defined(__aarch64__)
+#define AJ_STRICT_ALIGNMENT 0
+#else
+#define AJ_STRICT_ALIGNMENT 1
+#endif
+#endif
+
+/*
+ * Set to 1 to allow method handlers to run on a pool of worker threads, see AJ_StartWorkers()
+ */
+#ifndef AJ_WORKER_POOL
+#define AJ_WORKER_POOL AJ_NET_EPOLL
+#endif
+
+/*
+ * Set to 1 to allow threads other than the message loop to send messages, see AJ_EnableTxQueue()
+ */
+#ifndef AJ_TX_QUEUE
+#define AJ_TX_QUEUE AJ_NET_EPOLL
+#endif
+
+/*
+ * Set to 1 to use the CPU's AES instructions when it has them, see AJ_AES_UseHardware()
+ */
+#ifndef AJ_AES_HW
+#define AJ_AES_HW 1
+#endif
+
+/*
+ * Set to 1 to use a bitsliced constant time AES instead of OpenSSL's table based AES when the CPU
+ * has no AES instructions
+ */
+#ifndef AJ_AES_BITSLICE
+#define AJ_AES_BITSLICE 0
+#endif
+
+/*
+ * Set to 1 to have the kernel crypto API (AF_ALG ccm(aes)) encrypt and decrypt messages of at
+ * least AJ_AF_ALG_THRESHOLD bytes, shorter messages and kernels without ccm(aes) use AES in process
+ */
+#ifndef AJ_AES_AF_ALG
+#define AJ_AES_AF_ALG 0
+#endif
+
+#if AJ_AES_AF_ALG
+#define AJ_CCM_OFFLOAD
+#ifndef AJ_AF_ALG_THRESHOLD
+#define AJ_AF_ALG_THRESHOLD 1024
+#endif
+#endif
+
+/*
+ * Size of the expanded key schedule kept with each session and group key, see AJ_KeySchedule
+ */
+#if AJ_AES_BITSLICE
+#define AJ_AES_SCHEDULE_SIZE 720
+#else
+#define AJ_AES_SCHEDULE_SIZE 272
+#endif
+
+/*
+ * The target provides a single pass CCM body primitive, see AJ_AES_CTR_CBC_128()
+ */
+#define AJ_AES_CTR_CBC
+
+/*
+ * Allow dozens of method calls to be waiting for replies, see AJ_MarshalMethodCallAsync()
+ */
+#ifndef AJ_NUM_REPLY_CONTEXTS
+#define AJ_NUM_REPLY_CONTEXTS 64
+#endif
+
+#ifndef AJ_REPLY_HASH_SIZE
+#define AJ_REPLY_HASH_SIZE 64
+#endif
+
 /*
  * AJ_Reboot() is a NOOP on this platform
  */
@@ -0,0 +1,329 @@
+/**
+ * @file  AES-CCM offload to the Linux kernel crypto API through AF_ALG sockets
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#define _GNU_SOURCE
+
+#include "aj_target.h"
+
+#if AJ_AES_AF_ALG
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <linux/if_alg.h>
+
+#include "aj_crypto.h"
+
+#ifndef SOL_ALG
+#define SOL_ALG 279
+#endif
+
+/*
+ * Number of keys that keep their kernel sockets open
+ */
+#define NUM_ALG_SOCKETS 4
+
+/*
+ * Messages at least this long are spliced into the kernel instead of copied
+ */
+#define SPLICE_MIN 4096
+
+/*
+ * Sockets for a key loaded into the kernel. The transform socket holds the key and tag length, the
+ * operation socket accepted from it carries the messages.
+ */
+typedef struct {
+    uint8_t key[16];
+    uint8_t tagLen;
+    int tfm;
+    int op;
+    uint32_t lastUse;
+} AlgSocket;
+
+static AJ_THREAD_LOCAL AlgSocket algSockets[NUM_ALG_SOCKETS];
+static AJ_THREAD_LOCAL uint32_t useCount;
+static AJ_THREAD_LOCAL int splicePipe[2] = { -1, -1 };
+
+/*
+ * -1 until a socket for ccm(aes) has been tried
+ */
+static int8_t kernelCCM = -1;
+static uint32_t threshold = AJ_AF_ALG_THRESHOLD;
+
+/*
+ * Compares keys without stopping at the first difference
+ */
+static uint8_t SameKey(const uint8_t* a, const uint8_t* b)
+{
+    uint8_t diff = 0;
+    int i;
+
+    for (i = 0; i < 16; ++i) {
+        diff |= a[i] ^ b[i];
+    }
+    return diff == 0;
+}
+
+static int BindCCM(void)
+{
+    struct sockaddr_alg sa;
+    int fd = socket(AF_ALG, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+
+    if (fd < 0) {
+        return -1;
+    }
+    memset(&sa, 0, sizeof(sa));
+    sa.salg_family = AF_ALG;
+    strcpy((char*)sa.salg_type, "aead");
+    strcpy((char*)sa.salg_name, "ccm(aes)");
+    if (bind(fd, (struct sockaddr*)&sa, sizeof(sa)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static uint8_t KernelSupportsCCM(void)
+{
+    int8_t supported = __atomic_load_n(&kernelCCM, __ATOMIC_RELAXED);
+
+    if (supported < 0) {
+        int fd = BindCCM();
+        supported = (fd >= 0) ? TRUE : FALSE;
+        if (fd >= 0) {
+            close(fd);
+        } else {
+            AJ_Printf("KernelSupportsCCM(): no ccm(aes) in the kernel errno=%d\n", errno);
+        }
+        __atomic_store_n(&kernelCCM, supported, __ATOMIC_RELAXED);
+    }
+    return (uint8_t)supported;
+}
+
+uint8_t AJ_CCM_SetOffloadThreshold(uint32_t minLen)
+{
+    __atomic_store_n(&threshold, minLen, __ATOMIC_RELAXED);
+    return KernelSupportsCCM();
+}
+
+static void CloseSocket(AlgSocket* s)
+{
+    if (s->op >= 0) {
+        close(s->op);
+    }
+    if (s->tfm >= 0) {
+        close(s->tfm);
+    }
+    memset(s, 0, sizeof(AlgSocket));
+}
+
+void AJ_CCM_ReleaseKey(const uint8_t* key)
+{
+    int i;
+
+    for (i = 0; i < NUM_ALG_SOCKETS; ++i) {
+        if (algSockets[i].lastUse && SameKey(algSockets[i].key, key)) {
+            CloseSocket(&algSockets[i]);
+        }
+    }
+}
+
+/*
+ * Find the sockets for a key or load the key into the least recently used entry
+ */
+static AlgSocket* GetSocket(const uint8_t* key, uint8_t tagLen)
+{
+    AlgSocket* s = &algSockets[0];
+    int i;
+
+    for (i = 0; i < NUM_ALG_SOCKETS; ++i) {
+        if (algSockets[i].lastUse && (algSockets[i].tagLen == tagLen) && SameKey(algSockets[i].key, key)) {
+            algSockets[i].lastUse = ++useCount;
+            return &algSockets[i];
+        }
+        if (algSockets[i].lastUse < s->lastUse) {
+            s = &algSockets[i];
+        }
+    }
+    if (s->lastUse) {
+        CloseSocket(s);
+    }
+    s->tfm = BindCCM();
+    s->op = -1;
+    if ((s->tfm < 0) ||
+        (setsockopt(s->tfm, SOL_ALG, ALG_SET_KEY, key, 16) != 0) ||
+        (setsockopt(s->tfm, SOL_ALG, ALG_SET_AEAD_AUTHSIZE, NULL, tagLen) != 0) ||
+        ((s->op = accept4(s->tfm, NULL, 0, SOCK_CLOEXEC)) < 0)) {
+        AJ_Printf("GetSocket(): failed to load key errno=%d\n", errno);
+        CloseSocket(s);
+        return NULL;
+    }
+    memcpy(s->key, key, 16);
+    s->tagLen = tagLen;
+    s->lastUse = ++useCount;
+    return s;
+}
+
+static void ClosePipe(void)
+{
+    close(splicePipe[0]);
+    close(splicePipe[1]);
+    splicePipe[0] = splicePipe[1] = -1;
+}
+
+/*
+ * Hand the message to the kernel by reference through a pipe, the pages must not change until the
+ * result has been read. On failure the pipe is closed so no stale data is left in it.
+ */
+static int SpliceIn(int op, uint8_t* data, uint32_t len)
+{
+    if ((splicePipe[0] < 0) && (pipe2(splicePipe, O_CLOEXEC) != 0)) {
+        splicePipe[0] = splicePipe[1] = -1;
+        return -1;
+    }
+    while (len) {
+        struct iovec iov;
+        ssize_t n;
+
+        iov.iov_base = data;
+        iov.iov_len = len;
+        n = vmsplice(splicePipe[1], &iov, 1, 0);
+        if (n <= 0) {
+            ClosePipe();
+            return -1;
+        }
+        data += n;
+        len -= n;
+        while (n) {
+            ssize_t m = splice(splicePipe[0], NULL, op, NULL, n, len ? SPLICE_F_MORE : 0);
+            if (m <= 0) {
+                ClosePipe();
+                return -1;
+            }
+            n -= m;
+        }
+    }
+    return 0;
+}
+
+AJ_Status AJ_CCM_Offload(const AJ_KeySchedule* ks,
+                         uint8_t* msg,
+                         uint32_t msgLen,
+                         uint32_t hdrLen,
+                         uint8_t tagLen,
+                         const uint8_t* nonce,
+                         uint32_t nLen,
+                         uint8_t encrypt)
+{
+    uint8_t cbuf[CMSG_SPACE(sizeof(uint32_t)) * 2 + CMSG_SPACE(sizeof(struct af_alg_iv) + 16)];
+    uint32_t inLen = encrypt ? msgLen : msgLen + tagLen;
+    uint32_t outLen = encrypt ? msgLen + tagLen : msgLen;
+    struct af_alg_iv* iv;
+    struct cmsghdr* cmsg;
+    struct msghdr mh;
+    struct iovec iov;
+    AlgSocket* s;
+    uint8_t splice = FALSE;
+    ssize_t ret;
+
+    if ((msgLen < __atomic_load_n(&threshold, __ATOMIC_RELAXED)) || (nLen > 13) || !KernelSupportsCCM()) {
+        return AJ_ERR_DISALLOWED;
+    }
+    s = GetSocket(ks->key, tagLen);
+    if (!s) {
+        return AJ_ERR_DISALLOWED;
+    }
+    memset(cbuf, 0, sizeof(cbuf));
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_control = cbuf;
+    mh.msg_controllen = sizeof(cbuf);
+
+    cmsg = CMSG_FIRSTHDR(&mh);
+    cmsg->cmsg_level = SOL_ALG;
+    cmsg->cmsg_type = ALG_SET_OP;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint32_t));
+    *(uint32_t*)CMSG_DATA(cmsg) = encrypt ? ALG_OP_ENCRYPT : ALG_OP_DECRYPT;
+
+    cmsg = CMSG_NXTHDR(&mh, cmsg);
+    cmsg->cmsg_level = SOL_ALG;
+    cmsg->cmsg_type = ALG_SET_AEAD_ASSOCLEN;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint32_t));
+    *(uint32_t*)CMSG_DATA(cmsg) = hdrLen;
+
+    /*
+     * The IV is the initial counter block, the first byte encodes the length of the counter field
+     */
+    cmsg = CMSG_NXTHDR(&mh, cmsg);
+    cmsg->cmsg_level = SOL_ALG;
+    cmsg->cmsg_type = ALG_SET_IV;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(struct af_alg_iv) + 16);
+    iv = (struct af_alg_iv*)CMSG_DATA(cmsg);
+    iv->ivlen = 16;
+    iv->iv[0] = 15 - max(nLen, 11) - 1;
+    memcpy(&iv->iv[1], nonce, nLen);
+
+    if (inLen >= SPLICE_MIN) {
+        ret = sendmsg(s->op, &mh, MSG_MORE);
+        splice = TRUE;
+    } else {
+        iov.iov_base = msg;
+        iov.iov_len = inLen;
+        mh.msg_iov = &iov;
+        mh.msg_iovlen = 1;
+        ret = sendmsg(s->op, &mh, 0);
+    }
+    if (ret < 0) {
+        AJ_Printf("AJ_CCM_Offload(): sendmsg failed errno=%d\n", errno);
+        CloseSocket(s);
+        return AJ_ERR_DISALLOWED;
+    }
+    if (splice && (SpliceIn(s->op, msg, inLen) != 0)) {
+        /*
+         * The message was only read so it can still be handled in process
+         */
+        AJ_Printf("AJ_CCM_Offload(): splice failed errno=%d\n", errno);
+        CloseSocket(s);
+        return AJ_ERR_DISALLOWED;
+    }
+    /*
+     * The result replaces the message, the header is passed through unchanged
+     */
+    ret = read(s->op, msg, outLen);
+    if (ret == (ssize_t)outLen) {
+        return AJ_OK;
+    }
+    if ((ret < 0) && (errno == EBADMSG)) {
+        /*
+         * Authentication failed clear the message
+         */
+        memset(msg, 0, msgLen + tagLen);
+        return AJ_ERR_SECURITY;
+    }
+    AJ_Printf("AJ_CCM_Offload(): read returned %d errno=%d\n", (int)ret, errno);
+    CloseSocket(s);
+    if (!encrypt) {
+        memset(msg, 0, msgLen + tagLen);
+        return AJ_ERR_SECURITY;
+    }
+    return AJ_ERR_FAILURE;
+}
+
+#endif
@@ -2,7 +2,7 @@
  * @file
  */
 /******************************************************************************
- * Copyright 2012, Qualcomm Innovation Center, Inc.
+ * Copyright 2012-2013, Qualcomm Innovation Center, Inc.
  *
  *    All rights reserved.
  *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
@@ -21,19 +21,516 @@
 #include "aj_crypto.h"
 #include <openssl/aes.h>
 #include <openssl/bn.h>
+#if AJ_AES_BITSLICE
+#include "aj_target_bitslice.h"
+#endif
 
-static AES_KEY keyState;
+/*
+ * The AES instructions are used when the CPU has them, checked at run time so one binary runs
+ * everywhere. OpenSSL's table based AES is the fallback.
+ */
+#if AJ_AES_HW && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define AES_HW_X86 1
+#define HW_TARGET __attribute__((target("aes,sse2")))
+#elif AJ_AES_HW && defined(__aarch64__) && !defined(__AARCH64EB__)
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#define AES_HW_ARM 1
+#define HW_TARGET __attribute__((target("+crypto")))
+#endif
 
-void AJ_AES_Enable(const uint8_t* key)
+#define ROUNDS 10
+
+/*
+ * Expanded key in the layout of whichever implementation is in use. This is the schedule kept in an
+ * AJ_KeySchedule.
+ */
+typedef struct {
+    union {
+#if AJ_AES_BITSLICE
+        uint64_t bs[AJ_BS_KEY_WORDS];                 /* Bitsliced round keys */
+#else
+        AES_KEY ssl;                                  /* Key schedule for OpenSSL */
+#endif
+        uint8_t rk[(ROUNDS + 1) * 16];                /* Round keys for the AES instructions */
+    } __attribute__((aligned(16)));
+    uint8_t hw;                                       /* TRUE if the round keys are in use */
+} KeyState;
+
+typedef char KeyStateFitsSchedule[(sizeof(KeyState) <= AJ_AES_SCHEDULE_SIZE) ? 1 : -1];
+
+/*
+ * The key expanded by AJ_AES_Enable() and the key in use, set by AJ_AES_Enable() or
+ * AJ_AES_EnableSchedule()
+ */
+static AJ_THREAD_LOCAL KeyState keyState;
+static AJ_THREAD_LOCAL const KeyState* active;
+
+#if defined(AES_HW_X86) || defined(AES_HW_ARM)
+
+/*
+ * -1 until the CPU has been checked
+ */
+static int8_t hwSupported = -1;
+static uint8_t hwEnabled = TRUE;
+
+static uint8_t HardwareSupported(void)
 {
-    AES_set_encrypt_key(key, 16 * 8, &keyState);
+    int8_t supported = __atomic_load_n(&hwSupported, __ATOMIC_RELAXED);
+
+    if (supported < 0) {
+#ifdef AES_HW_X86
+        __builtin_cpu_init();
+        supported = __builtin_cpu_supports("aes") ? TRUE : FALSE;
+#else
+        supported = (getauxval(AT_HWCAP) & HWCAP_AES) ? TRUE : FALSE;
+#endif
+        __atomic_store_n(&hwSupported, supported, __ATOMIC_RELAXED);
+    }
+    return (uint8_t)supported;
 }
 
-void AJ_AES_Disable(void)
+uint8_t AJ_AES_UseHardware(uint8_t enable)
 {
+    __atomic_store_n(&hwEnabled, enable, __ATOMIC_RELAXED);
+    return enable && HardwareSupported();
 }
 
-void AJ_AES_CTR_128(const uint8_t* key, const uint8_t* in, uint8_t* out, uint32_t len, uint8_t* ctr)
+static uint8_t UseHardware(void)
+{
+    return __atomic_load_n(&hwEnabled, __ATOMIC_RELAXED) && HardwareSupported();
+}
+
+#ifdef AES_HW_X86
+
+typedef __m128i Block;
+
+#define LOAD(p)      _mm_loadu_si128((const __m128i*)(p))
+#define STORE(p, b)  _mm_storeu_si128((__m128i*)(p), b)
+#define XOR(a, b)    _mm_xor_si128(a, b)
+
+HW_TARGET static inline __m128i ExpandStep(__m128i key, __m128i gen)
+{
+    gen = _mm_shuffle_epi32(gen, 0xFF);
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, gen);
+}
+
+/*
+ * The round constant must be an immediate operand
+ */
+#define EXPAND(i, rcon) rk[i] = ExpandStep(rk[i - 1], _mm_aeskeygenassist_si128(rk[i - 1], rcon))
+
+HW_TARGET static void HwExpandKey(const uint8_t* key, KeyState* ks)
+{
+    __m128i* rk = (__m128i*)ks->rk;
+
+    rk[0] = LOAD(key);
+    EXPAND(1, 0x01);
+    EXPAND(2, 0x02);
+    EXPAND(3, 0x04);
+    EXPAND(4, 0x08);
+    EXPAND(5, 0x10);
+    EXPAND(6, 0x20);
+    EXPAND(7, 0x40);
+    EXPAND(8, 0x80);
+    EXPAND(9, 0x1B);
+    EXPAND(10, 0x36);
+}
+
+HW_TARGET static inline __m128i EncryptBlock(__m128i b, const __m128i* rk)
+{
+    int r;
+
+    b = _mm_xor_si128(b, rk[0]);
+    for (r = 1; r < ROUNDS; ++r) {
+        b = _mm_aesenc_si128(b, rk[r]);
+    }
+    return _mm_aesenclast_si128(b, rk[ROUNDS]);
+}
+
+/*
+ * Independent blocks are interleaved so the latency of each AES instruction is hidden
+ */
+HW_TARGET static inline void Encrypt4(__m128i* b, const __m128i* rk)
+{
+    int r;
+
+    b[0] = _mm_xor_si128(b[0], rk[0]);
+    b[1] = _mm_xor_si128(b[1], rk[0]);
+    b[2] = _mm_xor_si128(b[2], rk[0]);
+    b[3] = _mm_xor_si128(b[3], rk[0]);
+    for (r = 1; r < ROUNDS; ++r) {
+        b[0] = _mm_aesenc_si128(b[0], rk[r]);
+        b[1] = _mm_aesenc_si128(b[1], rk[r]);
+        b[2] = _mm_aesenc_si128(b[2], rk[r]);
+        b[3] = _mm_aesenc_si128(b[3], rk[r]);
+    }
+    b[0] = _mm_aesenclast_si128(b[0], rk[ROUNDS]);
+    b[1] = _mm_aesenclast_si128(b[1], rk[ROUNDS]);
+    b[2] = _mm_aesenclast_si128(b[2], rk[ROUNDS]);
+    b[3] = _mm_aesenclast_si128(b[3], rk[ROUNDS]);
+}
+
+/*
+ * The serial CBC-MAC block is interleaved with an independent counter block
+ */
+HW_TARGET static inline void Encrypt2(__m128i* mac, __m128i* ctr, const __m128i* rk)
+{
+    __m128i m = _mm_xor_si128(*mac, rk[0]);
+    __m128i c = _mm_xor_si128(*ctr, rk[0]);
+    int r;
+
+    for (r = 1; r < ROUNDS; ++r) {
+        m = _mm_aesenc_si128(m, rk[r]);
+        c = _mm_aesenc_si128(c, rk[r]);
+    }
+    *mac = _mm_aesenclast_si128(m, rk[ROUNDS]);
+    *ctr = _mm_aesenclast_si128(c, rk[ROUNDS]);
+}
+
+/*
+ * Counter block with the big-endian 16 bit counter in the last two bytes
+ */
+HW_TARGET static inline __m128i CounterBlock(__m128i base, uint16_t counter)
+{
+    return _mm_insert_epi16(base, (uint16_t)((counter >> 8) | (counter << 8)), 7);
+}
+
+#else /* AES_HW_ARM */
+
+typedef uint8x16_t Block;
+
+#define LOAD(p)      vld1q_u8((const uint8_t*)(p))
+#define STORE(p, b)  vst1q_u8((uint8_t*)(p), b)
+#define XOR(a, b)    veorq_u8(a, b)
+
+/*
+ * With the word in every column ShiftRows has no effect so AESE with a zero key is just SubBytes
+ */
+HW_TARGET static uint32_t SubWord(uint32_t w)
+{
+    uint8x16_t b = vaeseq_u8(vreinterpretq_u8_u32(vdupq_n_u32(w)), vdupq_n_u8(0));
+    return vgetq_lane_u32(vreinterpretq_u32_u8(b), 0);
+}
+
+HW_TARGET static void HwExpandKey(const uint8_t* key, KeyState* ks)
+{
+    static const uint8_t rcon[ROUNDS] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1B, 0x36 };
+    uint32_t w[(ROUNDS + 1) * 4];
+    int i;
+
+    memcpy(w, key, 16);
+    for (i = 4; i < (ROUNDS + 1) * 4; ++i) {
+        uint32_t t = w[i - 1];
+        if ((i % 4) == 0) {
+            t = SubWord((t >> 8) | (t << 24)) ^ rcon[i / 4 - 1];
+        }
+        w[i] = w[i - 4] ^ t;
+    }
+    memcpy(ks->rk, w, sizeof(w));
+}
+
+HW_TARGET static inline uint8x16_t EncryptBlock(uint8x16_t b, const uint8x16_t* rk)
+{
+    int r;
+
+    for (r = 0; r < ROUNDS - 1; ++r) {
+        b = vaesmcq_u8(vaeseq_u8(b, rk[r]));
+    }
+    b = vaeseq_u8(b, rk[ROUNDS - 1]);
+    return veorq_u8(b, rk[ROUNDS]);
+}
+
+HW_TARGET static inline void Encrypt4(uint8x16_t* b, const uint8x16_t* rk)
+{
+    int r;
+
+    for (r = 0; r < ROUNDS - 1; ++r) {
+        b[0] = vaesmcq_u8(vaeseq_u8(b[0], rk[r]));
+        b[1] = vaesmcq_u8(vaeseq_u8(b[1], rk[r]));
+        b[2] = vaesmcq_u8(vaeseq_u8(b[2], rk[r]));
+        b[3] = vaesmcq_u8(vaeseq_u8(b[3], rk[r]));
+    }
+    b[0] = veorq_u8(vaeseq_u8(b[0], rk[ROUNDS - 1]), rk[ROUNDS]);
+    b[1] = veorq_u8(vaeseq_u8(b[1], rk[ROUNDS - 1]), rk[ROUNDS]);
+    b[2] = veorq_u8(vaeseq_u8(b[2], rk[ROUNDS - 1]), rk[ROUNDS]);
+    b[3] = veorq_u8(vaeseq_u8(b[3], rk[ROUNDS - 1]), rk[ROUNDS]);
+}
+
+HW_TARGET static inline void Encrypt2(uint8x16_t* mac, uint8x16_t* ctr, const uint8x16_t* rk)
+{
+    uint8x16_t m = *mac;
+    uint8x16_t c = *ctr;
+    int r;
+
+    for (r = 0; r < ROUNDS - 1; ++r) {
+        m = vaesmcq_u8(vaeseq_u8(m, rk[r]));
+        c = vaesmcq_u8(vaeseq_u8(c, rk[r]));
+    }
+    *mac = veorq_u8(vaeseq_u8(m, rk[ROUNDS - 1]), rk[ROUNDS]);
+    *ctr = veorq_u8(vaeseq_u8(c, rk[ROUNDS - 1]), rk[ROUNDS]);
+}
+
+HW_TARGET static inline uint8x16_t CounterBlock(uint8x16_t base, uint16_t counter)
+{
+    base = vsetq_lane_u8((uint8_t)(counter >> 8), base, 14);
+    return vsetq_lane_u8((uint8_t)counter, base, 15);
+}
+
+#endif
+
+HW_TARGET static void HwCTR(const uint8_t* in, uint8_t* out, uint32_t len, uint8_t* ctr)
+{
+    const Block* rk = (const Block*)active->rk;
+    Block base = LOAD(ctr);
+    uint16_t counter = (ctr[14] << 8) | ctr[15];
+
+    while (len >= 4 * 16) {
+        Block b[4];
+        b[0] = CounterBlock(base, counter);
+        b[1] = CounterBlock(base, counter + 1);
+        b[2] = CounterBlock(base, counter + 2);
+        b[3] = CounterBlock(base, counter + 3);
+        Encrypt4(b, rk);
+        STORE(out, XOR(b[0], LOAD(in)));
+        STORE(out + 16, XOR(b[1], LOAD(in + 16)));
+        STORE(out + 32, XOR(b[2], LOAD(in + 32)));
+        STORE(out + 48, XOR(b[3], LOAD(in + 48)));
+        counter += 4;
+        in += 4 * 16;
+        out += 4 * 16;
+        len -= 4 * 16;
+    }
+    while (len) {
+        Block b = EncryptBlock(CounterBlock(base, counter++), rk);
+        if (len >= 16) {
+            STORE(out, XOR(b, LOAD(in)));
+            in += 16;
+            out += 16;
+            len -= 16;
+        } else {
+            uint8_t enc[16];
+            uint8_t* p = enc;
+            STORE(enc, b);
+            while (len--) {
+                *out++ = *p++ ^ *in++;
+            }
+            len = 0;
+        }
+    }
+    ctr[15] = counter;
+    ctr[14] = counter >> 8;
+}
+
+HW_TARGET static void HwCBC(const uint8_t* in, uint8_t* out, uint32_t len, uint8_t* iv)
+{
+    const Block* rk = (const Block*)active->rk;
+    Block b = LOAD(iv);
+
+    while (len >= 16) {
+        b = EncryptBlock(XOR(b, LOAD(in)), rk);
+        STORE(out, b);
+        in += 16;
+        out += 16;
+        len -= 16;
+    }
+    STORE(iv, b);
+}
+
+HW_TARGET static void HwECB(const uint8_t* in, uint8_t* out)
+{
+    STORE(out, EncryptBlock(LOAD(in), (const Block*)active->rk));
+}
+
+/*
+ * One pass over the CCM payload. The key stream runs a group of four blocks ahead so each serial
+ * CBC-MAC step is paired with a counter block that does not depend on it, when decrypting the
+ * plaintext for the MAC is only known once its key stream block is ready.
+ */
+HW_TARGET static void HwCTR_CBC(uint8_t* data, uint32_t len, uint8_t* mac, uint8_t* ctr, uint8_t encrypt)
+{
+    const Block* rk = (const Block*)active->rk;
+    Block base = LOAD(ctr);
+    Block t = LOAD(mac);
+    Block ks[4];
+    uint16_t counter = (ctr[14] << 8) | ctr[15];
+    uint32_t blocks = (len + 15) / 16;
+    uint32_t j;
+
+    ks[0] = CounterBlock(base, counter);
+    ks[1] = CounterBlock(base, counter + 1);
+    ks[2] = CounterBlock(base, counter + 2);
+    ks[3] = CounterBlock(base, counter + 3);
+    Encrypt4(ks, rk);
+    while (len >= 4 * 16) {
+        Block next[4];
+        for (j = 0; j < 4; ++j) {
+            Block in = LOAD(data + j * 16);
+            Block plain = encrypt ? in : XOR(in, ks[j]);
+            next[j] = CounterBlock(base, counter + 4 + j);
+            t = XOR(t, plain);
+            Encrypt2(&t, &next[j], rk);
+            STORE(data + j * 16, XOR(in, ks[j]));
+        }
+        memcpy(ks, next, sizeof(ks));
+        counter += 4;
+        data += 4 * 16;
+        len -= 4 * 16;
+    }
+    /*
+     * Fewer than four blocks are left and their key stream is ready
+     */
+    for (j = 0; len; ++j) {
+        Block in;
+        uint8_t pad[16];
+        uint32_t n = min(len, 16);
+
+        memset(pad, 0, sizeof(pad));
+        memcpy(pad, data, n);
+        in = LOAD(pad);
+        STORE(pad, XOR(in, ks[j]));
+        memcpy(data, pad, n);
+        if (!encrypt) {
+            /*
+             * The MAC is over the plaintext padded with zeroes
+             */
+            memset(pad + n, 0, sizeof(pad) - n);
+            in = LOAD(pad);
+        }
+        t = EncryptBlock(XOR(t, in), rk);
+        data += n;
+        len -= n;
+    }
+    STORE(mac, t);
+    counter = ((ctr[14] << 8) | ctr[15]) + blocks;
+    ctr[15] = counter;
+    ctr[14] = counter >> 8;
+}
+
+#else
+
+uint8_t AJ_AES_UseHardware(uint8_t enable)
+{
+    return FALSE;
+}
+
+#define UseHardware()           FALSE
+#define HwExpandKey(key, ks)
+#define HwCTR(in, out, len, ctr)
+#define HwCBC(in, out, len, iv)
+#define HwECB(in, out)
+#define HwCTR_CBC(data, len, mac, ctr, encrypt)
+
+#endif
+
+static void SetCounter(uint8_t* ctr, uint16_t counter)
+{
+    ctr[15] = counter;
+    ctr[14] = counter >> 8;
+}
+
+#if AJ_AES_BITSLICE
+
+/*
+ * Software AES is the bitsliced implementation, counter mode fills all the blocks of a pass and the
+ * serial CBC-MAC shares its pass with a counter block.
+ */
+#define SwExpandKey(key, ks)  _AJ_BS_ExpandKey(key, (ks)->bs)
+
+static void SwCTR(const uint8_t* in, uint8_t* out, uint32_t len, uint8_t* ctr)
+{
+    uint8_t ks[AJ_BS_BLOCKS * 16];
+    uint16_t counter = (ctr[14] << 8) | ctr[15];
+
+    while (len) {
+        uint32_t n = min(len, sizeof(ks));
+        uint32_t blocks = (n + 15) / 16;
+        uint32_t i;
+
+        for (i = 0; i < blocks; ++i) {
+            memcpy(ks + i * 16, ctr, 16);
+            SetCounter(ks + i * 16, counter++);
+        }
+        _AJ_BS_Encrypt(active->bs, ks, ks, blocks);
+        for (i = 0; i < n; ++i) {
+            out[i] = in[i] ^ ks[i];
+        }
+        in += n;
+        out += n;
+        len -= n;
+    }
+    SetCounter(ctr, counter);
+}
+
+static void SwCBC(const uint8_t* in, uint8_t* out, uint32_t len, uint8_t* iv)
+{
+    uint8_t block[16];
+    uint32_t i;
+
+    memcpy(block, iv, 16);
+    while (len >= 16) {
+        for (i = 0; i < 16; ++i) {
+            block[i] ^= in[i];
+        }
+        _AJ_BS_Encrypt(active->bs, block, block, 1);
+        memcpy(out, block, 16);
+        in += 16;
+        out += 16;
+        len -= 16;
+    }
+    memcpy(iv, block, 16);
+}
+
+static void SwECB(const uint8_t* in, uint8_t* out)
+{
+    _AJ_BS_Encrypt(active->bs, in, out, 1);
+}
+
+/*
+ * The key stream runs one block ahead so when decrypting the plaintext is ready for the MAC
+ */
+static void SwCTR_CBC(uint8_t* data, uint32_t len, uint8_t* mac, uint8_t* ctr, uint8_t encrypt)
+{
+    uint8_t pass[2][16];
+    uint16_t counter = (ctr[14] << 8) | ctr[15];
+
+    memcpy(pass[1], ctr, 16);
+    _AJ_BS_Encrypt(active->bs, pass[1], pass[1], 1);
+    memcpy(pass[0], mac, 16);
+    while (len) {
+        uint8_t ks[16];
+        uint32_t n = min(len, 16);
+        uint32_t i;
+
+        memcpy(ks, pass[1], 16);
+        for (i = 0; i < n; ++i) {
+            uint8_t c = data[i] ^ ks[i];
+            pass[0][i] ^= encrypt ? data[i] : c;
+            data[i] = c;
+        }
+        memcpy(pass[1], ctr, 16);
+        SetCounter(pass[1], ++counter);
+        _AJ_BS_Encrypt(active->bs, pass[0], pass[0], 2);
+        data += n;
+        len -= n;
+    }
+    memcpy(mac, pass[0], 16);
+    SetCounter(ctr, counter);
+}
+
+#else
+
+/*
+ * Software AES is OpenSSL's
+ */
+#define SwExpandKey(key, ks)  AES_set_encrypt_key(key, 16 * 8, &(ks)->ssl)
+
+static void SwCTR(const uint8_t* in, uint8_t* out, uint32_t len, uint8_t* ctr)
 {
     /*
        Counter mode the hard way because the SSL CTR-mode API is just wierd.
@@ -44,24 +541,108 @@ void AJ_AES_CTR_128(const uint8_t* key, const uint8_t* in, uint8_t* out, uint32_
         uint8_t* p = enc;
         uint16_t counter = (ctr[14] << 8) | ctr[15];
         len -= n;
-        AES_encrypt(ctr, enc, &keyState);
+        AES_encrypt(ctr, enc, &active->ssl);
         while (n--) {
             *out++ = *p++ ^ *in++;
         }
-        ++counter;
-        ctr[15] = counter;
-        ctr[14] = counter >> 8;
+        SetCounter(ctr, counter + 1);
+    }
+}
+
+#define SwCBC(in, out, len, iv)  AES_cbc_encrypt(in, out, len, &active->ssl, iv, AES_ENCRYPT)
+#define SwECB(in, out)           AES_encrypt(in, out, &active->ssl)
+
+static void SwCTR_CBC(uint8_t* data, uint32_t len, uint8_t* mac, uint8_t* ctr, uint8_t encrypt)
+{
+    while (len) {
+        uint8_t block[16];
+        uint32_t n = min(len, 16);
+        uint32_t i;
+
+        if (!encrypt) {
+            SwCTR(data, data, n, ctr);
+        }
+        memset(block, 0, sizeof(block));
+        memcpy(block, data, n);
+        for (i = 0; i < 16; ++i) {
+            mac[i] ^= block[i];
+        }
+        AES_encrypt(mac, mac, &active->ssl);
+        if (encrypt) {
+            SwCTR(data, data, n, ctr);
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+#endif
+
+static void ExpandKey(const uint8_t* key, KeyState* ks)
+{
+    ks->hw = UseHardware();
+    if (ks->hw) {
+        HwExpandKey(key, ks);
+    } else {
+        SwExpandKey(key, ks);
+    }
+}
+
+void AJ_AES_ExpandKey(const uint8_t* key, uint8_t* schedule)
+{
+    ExpandKey(key, (KeyState*)schedule);
+}
+
+void AJ_AES_EnableSchedule(const uint8_t* schedule)
+{
+    active = (const KeyState*)schedule;
+}
+
+void AJ_AES_Enable(const uint8_t* key)
+{
+    ExpandKey(key, &keyState);
+    active = &keyState;
+}
+
+void AJ_AES_Disable(void)
+{
+    active = &keyState;
+}
+
+void AJ_AES_CTR_128(const uint8_t* key, const uint8_t* in, uint8_t* out, uint32_t len, uint8_t* ctr)
+{
+    if (active->hw) {
+        HwCTR(in, out, len, ctr);
+    } else {
+        SwCTR(in, out, len, ctr);
     }
 }
 
 void AJ_AES_CBC_128_ENCRYPT(const uint8_t* key, const uint8_t* in, uint8_t* out, uint32_t len, uint8_t* iv)
 {
-    AES_cbc_encrypt(in, out, len, &keyState, iv, AES_ENCRYPT);
+    if (active->hw) {
+        HwCBC(in, out, len, iv);
+    } else {
+        SwCBC(in, out, len, iv);
+    }
 }
 
 void AJ_AES_ECB_128_ENCRYPT(const uint8_t* key, const uint8_t* in, uint8_t* out)
 {
-    AES_encrypt(in, out, &keyState);
+    if (active->hw) {
+        HwECB(in, out);
+    } else {
+        SwECB(in, out);
+    }
+}
+
+void AJ_AES_CTR_CBC_128(const uint8_t* key, uint8_t* data, uint32_t len, uint8_t* mac, uint8_t* ctr, uint8_t encrypt)
+{
+    if (active->hw) {
+        HwCTR_CBC(data, len, mac, ctr, encrypt);
+    } else {
+        SwCTR_CBC(data, len, mac, ctr, encrypt);
+    }
 }
 
 void AJ_RandBytes(uint8_t* rand, uint32_t len)
@@ -71,4 +652,3 @@ void AJ_RandBytes(uint8_t* rand, uint32_t len)
     BN_bn2bin(bn, rand);
     BN_free(bn);
 }
-
@@ -0,0 +1,512 @@
+/**
+ * @file  Lock-free transmit queue that lets producer threads send messages on a bus connection
+ *        owned by the message loop thread
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include "aj_target.h"
+
+#if AJ_TX_QUEUE
+
+#if !AJ_NET_EPOLL
+#error "AJ_TX_QUEUE requires AJ_NET_EPOLL"
+#endif
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/eventfd.h>
+
+#include "alljoyn.h"
+#include "aj_helper.h"
+#include "aj_bufio.h"
+#include "aj_net.h"
+
+/*
+ * Largest message a producer can send
+ */
+#ifndef AJ_TX_FRAME_SIZE
+#define AJ_TX_FRAME_SIZE 1024
+#endif
+
+/*
+ * Number of frames each producer has, when they are all queued the producer waits for the message
+ * loop to send one
+ */
+#ifndef AJ_TX_PRODUCER_FRAMES
+#define AJ_TX_PRODUCER_FRAMES 16
+#endif
+
+/*
+ * Maximum number of bus attachments with a transmit queue
+ */
+#ifndef AJ_MAX_TX_QUEUES
+#define AJ_MAX_TX_QUEUES 8
+#endif
+
+#define CACHE_LINE 64
+
+typedef struct _TxNode {
+    struct _TxNode* next;
+} TxNode;
+
+struct _Producer;
+
+/**
+ * A message marshaled by a producer
+ */
+typedef struct _TxFrame {
+    TxNode node;                  /**< Link in the transmit queue, must be first */
+    struct _TxFrame* nextFree;    /**< Link in the producer's free stack */
+    struct _Producer* producer;   /**< The producer the frame belongs to */
+    uint32_t len;
+    uint8_t data[AJ_TX_FRAME_SIZE];
+} TxFrame;
+
+/*
+ * Unbounded multi-producer single-consumer queue of frames. A producer swaps itself in as the head
+ * and then links the previous head to it so pushing never waits for another producer. The message
+ * loop pops from the tail, a stub node keeps the queue from ever being empty.
+ */
+typedef struct _TxQueue {
+    TxNode* head __attribute__((aligned(CACHE_LINE)));   /**< Pushed by the producers */
+    TxNode* tail __attribute__((aligned(CACHE_LINE)));   /**< Popped by the message loop */
+    TxNode stub;
+    uint32_t signalled;           /**< Set when wakeFd has been written and not yet read */
+    int wakeFd;                   /**< Wakes the message loop when frames are queued */
+    AJ_BusAttachment* bus;
+    uint32_t numProducers;        /**< Protected by queuesLock */
+    const AJ_Object* localObjects;
+    const AJ_Object* proxyObjects;
+    struct _TxQueue* nextOwned;   /**< Next queue owned by the same message loop thread */
+} TxQueue;
+
+/**
+ * Frames for one producer bus attachment. The free frames are kept on a stack that the message loop
+ * pushes to and only the producer pops from, with a semaphore counting them. The memory is freed
+ * when the producer has been stopped and none of its frames are queued.
+ */
+typedef struct _Producer {
+    TxFrame* freeFrames;
+    sem_t numFree;
+    uint32_t refs;                /**< One for the producer and one for each queued frame */
+    TxQueue* queue;
+    TxFrame frames[AJ_TX_PRODUCER_FRAMES];
+} Producer;
+
+static TxQueue* queues[AJ_MAX_TX_QUEUES];
+static pthread_mutex_t queuesLock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t producersStarted = 0;
+
+/*
+ * The queues owned by the message loop running on this thread
+ */
+static AJ_THREAD_LOCAL TxQueue* ownedQueues = NULL;
+static AJ_THREAD_LOCAL uint32_t numOwned = 0;
+
+static void QueuePush(TxQueue* queue, TxNode* node)
+{
+    TxNode* prev;
+
+    __atomic_store_n(&node->next, NULL, __ATOMIC_RELAXED);
+    prev = __atomic_exchange_n(&queue->head, node, __ATOMIC_ACQ_REL);
+    __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+}
+
+static TxNode* QueuePop(TxQueue* queue)
+{
+    TxNode* tail = queue->tail;
+    TxNode* next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+
+    if (tail == &queue->stub) {
+        if (!next) {
+            return NULL;
+        }
+        queue->tail = next;
+        tail = next;
+        next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    }
+    if (next) {
+        queue->tail = next;
+        return tail;
+    }
+    /*
+     * The tail is the last node unless a producer is part way through pushing after it, in which
+     * case the pushed frames are picked up on the next wake
+     */
+    if (tail != __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    QueuePush(queue, &queue->stub);
+    next = __atomic_load_n(&tail->next, __ATOMIC_ACQUIRE);
+    if (next) {
+        queue->tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+static void PushFree(Producer* producer, TxFrame* frame)
+{
+    TxFrame* top = __atomic_load_n(&producer->freeFrames, __ATOMIC_RELAXED);
+
+    do {
+        frame->nextFree = top;
+    } while (!__atomic_compare_exchange_n(&producer->freeFrames, &top, frame, TRUE, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/*
+ * Only the producer pops so a frame cannot be popped and pushed back between reading the top and
+ * swapping it out
+ */
+static TxFrame* PopFree(Producer* producer)
+{
+    TxFrame* top = __atomic_load_n(&producer->freeFrames, __ATOMIC_ACQUIRE);
+
+    while (top && !__atomic_compare_exchange_n(&producer->freeFrames, &top, top->nextFree, TRUE, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+    }
+    return top;
+}
+
+static void ReleaseProducer(Producer* producer)
+{
+    if (__atomic_sub_fetch(&producer->refs, 1, __ATOMIC_ACQ_REL) == 0) {
+        sem_destroy(&producer->numFree);
+        free(producer);
+    }
+}
+
+static void ReturnFrame(TxFrame* frame)
+{
+    Producer* producer = frame->producer;
+
+    PushFree(producer, frame);
+    sem_post(&producer->numFree);
+    ReleaseProducer(producer);
+}
+
+static AJ_Status ProducerRecv(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    return AJ_ERR_READ;
+}
+
+/*
+ * Called by AJ_DeliverMsg() on the producer thread when a message has been marshaled into the
+ * current frame. The frame is queued and the next message is marshaled into a free frame.
+ */
+static AJ_Status ProducerSend(AJ_IOBuffer* buf)
+{
+    Producer* producer = (Producer*)buf->context;
+    TxQueue* queue = producer->queue;
+    TxFrame* frame = (TxFrame*)(buf->bufStart - offsetof(TxFrame, data));
+    AJ_MsgHeader* hdr = (AJ_MsgHeader*)buf->bufStart;
+    uint32_t len = AJ_IO_BUF_AVAIL(buf);
+
+    /*
+     * Only whole messages can be queued, the parts of a message too big for a frame would be
+     * interleaved with messages from other producers
+     */
+    if ((buf->readPtr != buf->bufStart) || (len < sizeof(AJ_MsgHeader)) ||
+        (len != sizeof(AJ_MsgHeader) + ((hdr->headerLen + 7) & ~7) + hdr->bodyLen)) {
+        AJ_IO_BUF_RESET(buf);
+        return AJ_ERR_RESOURCES;
+    }
+    frame->len = len;
+    __atomic_add_fetch(&producer->refs, 1, __ATOMIC_RELAXED);
+    QueuePush(queue, &frame->node);
+    /*
+     * Only the first frame queued since the message loop last woke up needs to wake it
+     */
+    if (!__atomic_exchange_n(&queue->signalled, 1, __ATOMIC_ACQ_REL)) {
+        eventfd_write(queue->wakeFd, 1);
+    }
+    while ((sem_wait(&producer->numFree) == -1) && (errno == EINTR)) {
+    }
+    frame = PopFree(producer);
+    AJ_IOBufInit(buf, frame->data, AJ_TX_FRAME_SIZE, AJ_IO_BUF_TX, producer);
+    buf->send = ProducerSend;
+    return AJ_OK;
+}
+
+/*
+ * Must be called with queuesLock held
+ */
+static TxQueue* FindQueue(const AJ_BusAttachment* bus)
+{
+    uint32_t i;
+
+    for (i = 0; i < AJ_MAX_TX_QUEUES; ++i) {
+        if (queues[i] && (queues[i]->bus == bus)) {
+            return queues[i];
+        }
+    }
+    return NULL;
+}
+
+static void FreeQueue(TxQueue* queue)
+{
+    if (queue->wakeFd != -1) {
+        AJ_Net_Unwatch(queue->wakeFd);
+        close(queue->wakeFd);
+    }
+    free(queue);
+}
+
+/*
+ * Writes the bus's buffered data and queued frames. Connections that are not sockets are written
+ * one frame at a time through the bus's transmit buffer.
+ */
+static AJ_Status SendBatch(AJ_BusAttachment* bus, TxFrame** batch, uint32_t num)
+{
+    AJ_IOBuffer* tx = &bus->sock.tx;
+    uint8_t* data[AJ_NET_MAX_FRAMES];
+    uint32_t lens[AJ_NET_MAX_FRAMES];
+    AJ_Status status = AJ_OK;
+    uint32_t i;
+
+    /*
+     * Only the rest of a partial write goes ahead of the batch, anything else in the buffer is a
+     * message that was marshaled but never delivered
+     */
+    if (!tx->pending) {
+        AJ_IO_BUF_RESET(tx);
+    }
+    if (tx->send == AJ_Net_Send) {
+        for (i = 0; i < num; ++i) {
+            data[i] = batch[i]->data;
+            lens[i] = batch[i]->len;
+        }
+        return AJ_Net_SendFrames(tx, data, lens, num);
+    }
+    for (i = 0; (i < num) && (status == AJ_OK); ++i) {
+        if (AJ_IO_BUF_SPACE(tx) < batch[i]->len) {
+            status = tx->send(tx);
+        }
+        if (status == AJ_OK) {
+            if (AJ_IO_BUF_SPACE(tx) < batch[i]->len) {
+                return AJ_ERR_RESOURCES;
+            }
+            memcpy(tx->writePtr, batch[i]->data, batch[i]->len);
+            tx->writePtr += batch[i]->len;
+        }
+    }
+    if ((status == AJ_OK) && AJ_IO_BUF_AVAIL(tx)) {
+        status = tx->send(tx);
+    }
+    return status;
+}
+
+static AJ_Status SendQueue(TxQueue* queue)
+{
+    TxFrame* batch[AJ_NET_MAX_FRAMES];
+    AJ_Status status = AJ_OK;
+    eventfd_t count;
+    uint32_t num;
+    uint32_t i;
+
+    /*
+     * Clear the signal before draining so a frame queued after this point wakes the loop again. The
+     * exchange also makes every frame pushed by a producer that saw the signal set visible here.
+     */
+    __atomic_exchange_n(&queue->signalled, 0, __ATOMIC_ACQ_REL);
+    eventfd_read(queue->wakeFd, &count);
+    do {
+        TxNode* node;
+        num = 0;
+        while ((num < AJ_NET_MAX_FRAMES) && ((node = QueuePop(queue)) != NULL)) {
+            batch[num++] = (TxFrame*)node;
+        }
+        if (num && (status == AJ_OK)) {
+            status = SendBatch(queue->bus, batch, num);
+        }
+        /*
+         * Frames are returned to their producers even if they could not be sent
+         */
+        for (i = 0; i < num; ++i) {
+            ReturnFrame(batch[i]);
+        }
+    } while (num == AJ_NET_MAX_FRAMES);
+    return status;
+}
+
+AJ_Status AJ_EnableTxQueue(AJ_BusAttachment* bus)
+{
+    TxQueue* queue;
+    uint32_t i;
+
+    queue = (TxQueue*)calloc(1, sizeof(TxQueue));
+    if (!queue) {
+        return AJ_ERR_RESOURCES;
+    }
+    queue->head = queue->tail = &queue->stub;
+    queue->bus = bus;
+    queue->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (queue->wakeFd == -1) {
+        free(queue);
+        return AJ_ERR_RESOURCES;
+    }
+    if (AJ_Net_Watch(queue->wakeFd) != AJ_OK) {
+        close(queue->wakeFd);
+        free(queue);
+        return AJ_ERR_RESOURCES;
+    }
+    AJ_GetRegisteredObjects(&queue->localObjects, &queue->proxyObjects);
+
+    pthread_mutex_lock(&queuesLock);
+    if (FindQueue(bus)) {
+        pthread_mutex_unlock(&queuesLock);
+        FreeQueue(queue);
+        return AJ_ERR_UNEXPECTED;
+    }
+    for (i = 0; i < AJ_MAX_TX_QUEUES; ++i) {
+        if (!queues[i]) {
+            queues[i] = queue;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&queuesLock);
+    if (i == AJ_MAX_TX_QUEUES) {
+        FreeQueue(queue);
+        return AJ_ERR_RESOURCES;
+    }
+    queue->nextOwned = ownedQueues;
+    ownedQueues = queue;
+    ++numOwned;
+    return AJ_OK;
+}
+
+AJ_Status AJ_DisableTxQueue(AJ_BusAttachment* bus)
+{
+    TxQueue** prev;
+    TxQueue* queue;
+    AJ_Status status;
+    uint32_t i;
+
+    pthread_mutex_lock(&queuesLock);
+    queue = FindQueue(bus);
+    if (!queue || queue->numProducers) {
+        pthread_mutex_unlock(&queuesLock);
+        return AJ_ERR_UNEXPECTED;
+    }
+    for (i = 0; i < AJ_MAX_TX_QUEUES; ++i) {
+        if (queues[i] == queue) {
+            queues[i] = NULL;
+        }
+    }
+    pthread_mutex_unlock(&queuesLock);
+    /*
+     * Frames queued by producers that have already been stopped are still sent
+     */
+    status = SendQueue(queue);
+    for (prev = &ownedQueues; *prev; prev = &(*prev)->nextOwned) {
+        if (*prev == queue) {
+            *prev = queue->nextOwned;
+            --numOwned;
+            break;
+        }
+    }
+    FreeQueue(queue);
+    return status;
+}
+
+uint32_t AJ_GetNumTxQueues(void)
+{
+    return numOwned;
+}
+
+AJ_Status AJ_SendQueued(AJ_BusAttachment* bus)
+{
+    AJ_Status status = AJ_OK;
+    TxQueue* queue;
+
+    for (queue = ownedQueues; queue; queue = queue->nextOwned) {
+        if (!bus || (queue->bus == bus)) {
+            AJ_Status sent = SendQueue(queue);
+            if (status == AJ_OK) {
+                status = sent;
+            }
+        }
+    }
+    return status;
+}
+
+AJ_Status AJ_StartProducer(AJ_BusAttachment* bus, AJ_BusAttachment* producer)
+{
+    Producer* p;
+    TxQueue* queue;
+    uint32_t n;
+    uint32_t i;
+
+    pthread_mutex_lock(&queuesLock);
+    queue = FindQueue(bus);
+    if (queue) {
+        ++queue->numProducers;
+    }
+    pthread_mutex_unlock(&queuesLock);
+    if (!queue) {
+        return AJ_ERR_UNEXPECTED;
+    }
+    p = (Producer*)malloc(sizeof(Producer));
+    if (!p || (sem_init(&p->numFree, 0, AJ_TX_PRODUCER_FRAMES - 1) != 0)) {
+        free(p);
+        pthread_mutex_lock(&queuesLock);
+        --queue->numProducers;
+        pthread_mutex_unlock(&queuesLock);
+        return AJ_ERR_RESOURCES;
+    }
+    p->queue = queue;
+    p->refs = 1;
+    p->freeFrames = NULL;
+    for (i = 0; i < AJ_TX_PRODUCER_FRAMES; ++i) {
+        p->frames[i].producer = p;
+        if (i) {
+            PushFree(p, &p->frames[i]);
+        }
+    }
+    /*
+     * The producer sends with the unique name of the bus, each producer numbers its messages from a
+     * different range of serial numbers so they do not clash with the message loop or each other
+     */
+    n = __atomic_fetch_add(&producersStarted, 1, __ATOMIC_RELAXED);
+    memset(producer, 0, sizeof(AJ_BusAttachment));
+    memcpy(producer->uniqueName, bus->uniqueName, sizeof(producer->uniqueName));
+    producer->serial = 0xC0000000 | ((n & 0x3F) << 24);
+    AJ_IOBufInit(&producer->sock.tx, p->frames[0].data, AJ_TX_FRAME_SIZE, AJ_IO_BUF_TX, p);
+    producer->sock.tx.send = ProducerSend;
+    AJ_IOBufInit(&producer->sock.rx, NULL, 0, AJ_IO_BUF_RX, NULL);
+    producer->sock.rx.recv = ProducerRecv;
+    AJ_RegisterObjects(queue->localObjects, queue->proxyObjects);
+    return AJ_OK;
+}
+
+void AJ_StopProducer(AJ_BusAttachment* producer)
+{
+    Producer* p = (Producer*)producer->sock.tx.context;
+
+    if (!p || (producer->sock.tx.send != ProducerSend)) {
+        return;
+    }
+    pthread_mutex_lock(&queuesLock);
+    --p->queue->numProducers;
+    pthread_mutex_unlock(&queuesLock);
+    memset(producer, 0, sizeof(AJ_BusAttachment));
+    ReleaseProducer(p);
+}
+
+#endif
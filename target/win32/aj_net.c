@@ -161,6 +161,11 @@ void AJ_Net_Disconnect(AJ_NetSocket* netSock)
     }
 }
 
+int AJ_Net_GetFd(AJ_NetSocket* netSock)
+{
+    return (int)(SOCKET)netSock->rx.context;
+}
+
 static SOCKET* McastSocks = NULL;
 static size_t NumMcastSocks = 0;
 
@@ -64,6 +64,14 @@ typedef unsigned long long uint64_t;  /** 64-bit unsigned integer */
 
 #define AJ_ASSERT(x)  assert(x)
 
+/*
+ * Runtime state is kept per thread so each thread can run its own bus attachments. Define this as
+ * empty if the library is only used from one thread.
+ */
+#ifndef AJ_THREAD_LOCAL
+#define AJ_THREAD_LOCAL __declspec(thread)
+#endif
+
 /*
  * AJ_Reboot() is a NOOP on this platform
  */
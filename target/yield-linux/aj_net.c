@@ -49,185 +49,89 @@ static const char AJ_IPV6_MULTICAST_GROUP[] = "ff02::13a";
  */
 #define AJ_UDP_PORT 9956
 
+/*
+ * How long a send waits for the peer to drain the socket before failing
+ */
+#ifndef AJ_NET_SEND_TIMEOUT
+#define AJ_NET_SEND_TIMEOUT (30 * 1000)
+#endif
 
-#include <pthread.h>
-
-static uint8_t ioThreadRunningWrite = FALSE;
-static uint8_t ioThreadRunningRead = FALSE;
-static uint8_t ioThreadRunningSleep = FALSE;
-static pthread_t threadIdWrite;
-static pthread_t threadIdRead;
-static pthread_t threadIdSleep;
-
-
-
-
-void* AJ_TimeExpired(void* threadArg)
-{
-    //AJ_Printf("T %d\n", (uint32_t)threadArg);
-    sleep((uint32_t)threadArg);
-    AJ_Schedule(AJWAITEVENT_TIMER);
-    return 0;
-}
-
-
-
-void* AJ_WriteReady(void* threadArg)
+/*
+ * Sockets are non-blocking, a task that would block waits in the scheduler so other tasks can run
+ */
+static AJ_Status Send(AJ_IOBuffer* buf)
 {
-    //AJ_Printf("W ");
-
-    AJ_IOBuffer* buf = (AJ_IOBuffer*)threadArg;
-    ssize_t ret;
-    size_t tx = AJ_IO_BUF_AVAIL(buf);
+    int sock = (int)(intptr_t)buf->context;
 
     assert(buf->direction == AJ_IO_BUF_TX);
 
-    if (tx > 0) {
-        ret = send((int)buf->context, buf->readPtr, tx, 0);
+    while (AJ_IO_BUF_AVAIL(buf) > 0) {
+        ssize_t ret = send(sock, buf->readPtr, AJ_IO_BUF_AVAIL(buf), MSG_NOSIGNAL);
         if (ret == -1) {
+            if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
 #ifndef NDEBUG
-            fprintf(stderr, "send() failed: %s\n", strerror(errno));
+                fprintf(stderr, "send() failed: %s\n", strerror(errno));
 #endif
-            AJ_Schedule(AJWAITEVENT_TIMER);
-            return AJ_ERR_WRITE;
-        }
-        buf->readPtr += ret;
-    }
-    if (AJ_IO_BUF_AVAIL(buf) == 0) {
-        AJ_IO_BUF_RESET(buf);
-    }
-
-    AJ_Schedule(AJWAITEVENT_WRITE);
-    return 0;
-}
-
-static AJ_Status Send(AJ_IOBuffer* buf)
-{
-    AJ_Status status = AJ_OK;
-    //  spin a thread that only does a select and then returns.
-    int ret = 0;
-    if (!ioThreadRunningWrite) {
-        ret = pthread_create(&threadIdWrite, NULL, AJ_WriteReady, buf);
-        if (ret != 0) {
-            printf("Error: fail to spin a thread for writing\n");
+                return AJ_ERR_WRITE;
+            }
+            if (AJ_WaitFd(sock, AJWAITEVENT_WRITE, AJ_NET_SEND_TIMEOUT) != AJ_OK) {
+                return AJ_ERR_WRITE;
+            }
+        } else {
+            buf->readPtr += ret;
         }
-        ioThreadRunningWrite = TRUE;
     }
-
-    // yield until the write is complete
-    AJ_YieldUntil(AJWAITEVENT_WRITE | AJWAITEVENT_TIMER);
-
-    /// wait for the thread to finish and then cleanup
-    void* exit_status;
-    if (ioThreadRunningWrite) {
-        pthread_join(threadIdWrite, &exit_status);
-        ioThreadRunningWrite = FALSE;
-    }
-    if (AJ_GetEventState(AJWAITEVENT_TIMER)) {
-        AJ_Printf("Debug: write timeout\n");
-        status = AJ_ERR_TIMEOUT;
-    }
-    AJ_ClearEvents(AJWAITEVENT_WRITE | AJWAITEVENT_TIMER); //reset the event once we have returned here.
-    return status;
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
 }
 
-
-typedef struct {
-    AJ_IOBuffer* buf;
-    uint32_t len;
-    uint32_t timeout;
-} recv_struct;
-
-void* AJ_ReadReady(void* threadArg)
+static AJ_Status Recv(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
 {
-    //AJ_Printf("R ");
-    recv_struct* rs = (recv_struct*)threadArg;
-
-
-    fd_set fds;
-    int maxFd = INVALID_SOCKET;
-    int rc = 0;
-    struct timeval tv = { rs->timeout / 1000, 1000 * (rs->timeout % 1000) };
-
-    assert(rs->buf->direction == AJ_IO_BUF_RX);
+    int sock = (int)(intptr_t)buf->context;
+    size_t rx = min(AJ_IO_BUF_SPACE(buf), len);
+    ssize_t ret;
 
-    FD_ZERO(&fds);
-    FD_SET((int)rs->buf->context, &fds);
-    maxFd = max(maxFd, (int)rs->buf->context);
+    assert(buf->direction == AJ_IO_BUF_RX);
 
-    rc = select(maxFd + 1, &fds, NULL, NULL, &tv);
-    if (rc == 0) {
-        AJ_Schedule(AJWAITEVENT_TIMER);
-        return AJ_ERR_TIMEOUT;
+    if (!rx) {
+        return AJ_OK;
     }
-
-    AJ_Schedule(AJWAITEVENT_READ);
-    return 0;
-}
-
-static AJ_Status Recv(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
-{
-    AJ_Status status = AJ_OK;
-    size_t rx = AJ_IO_BUF_SPACE(buf);
-
-    //  spin a thread that only does a select and then returns.
-    int ret = 0;
-    if (!ioThreadRunningRead) {
-        recv_struct rs = { buf, len, timeout };
-        ret = pthread_create(&threadIdRead, NULL, AJ_ReadReady, &rs);
-        if (ret != 0) {
-            printf("Error: fail to spin a thread for reading\n");
+    while ((ret = recv(sock, buf->writePtr, rx, 0)) == -1) {
+        if ((errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+            break;
+        }
+        if (AJ_WaitFd(sock, AJWAITEVENT_READ, timeout) != AJ_OK) {
+            return AJ_ERR_TIMEOUT;
         }
-        ioThreadRunningRead = TRUE;
-    }
-
-    //
-    // yield until the select is complete
-    //
-    AJ_YieldUntil(AJWAITEVENT_READ | AJWAITEVENT_TIMER);
-
-    /// wait for the thread to finish and then cleanup
-    void* exit_status;
-    if (ioThreadRunningRead) {
-        pthread_join(threadIdRead, &exit_status);
-        ioThreadRunningRead = FALSE;
     }
-    if (AJ_GetEventState(AJWAITEVENT_TIMER)) {
-        AJ_Printf("Debug: read timeout\n");
-        status = AJ_ERR_TIMEOUT;
-    } else {
-
-        rx = min(rx, len);
-        if (rx) {
-            ssize_t ret = recv((int)buf->context, buf->writePtr, rx, 0);
-            if ((ret == -1) || (ret == 0)) {
+    if ((ret == -1) || (ret == 0)) {
 #ifndef NDEBUG
-                fprintf(stderr, "recv() failed: %s\n", strerror(errno));
+        fprintf(stderr, "recv() failed: %s\n", strerror(errno));
 #endif
-                status = AJ_ERR_READ;
-            } else {
-                buf->writePtr += ret;
-            }
-        }
+        return AJ_ERR_READ;
     }
-
-    AJ_ClearEvents(AJWAITEVENT_READ | AJWAITEVENT_TIMER); //reset the event once we have returned here.
-    return status;
+    buf->writePtr += ret;
+    return AJ_OK;
 }
 
-
-static uint8_t rxData[1024];
-static uint8_t txData[1024];
+/*
+ * The buffers for one connection so each task can have its own bus attachment
+ */
+typedef struct _NetBuffers {
+    uint8_t rx[1024];
+    uint8_t tx[1024];
+} NetBuffers;
 
 AJ_Status AJ_Net_Connect(AJ_NetSocket* netSock, uint16_t port, uint8_t addrType, const uint32_t* addr)
 {
     int ret;
     struct sockaddr_storage addrBuf;
     socklen_t addrSize;
+    NetBuffers* bufs;
 
     memset(&addrBuf, 0, sizeof(addrBuf));
 
-    int tcpSock = socket(AF_INET, SOCK_STREAM, 0);
+    int tcpSock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
     if (tcpSock == INVALID_SOCKET) {
         return AJ_ERR_CONNECT;
     }
@@ -246,15 +150,29 @@ AJ_Status AJ_Net_Connect(AJ_NetSocket* netSock, uint16_t port, uint8_t addrType,
         addrSize = sizeof(*sa);
     }
     ret = connect(tcpSock, (struct sockaddr*)&addrBuf, addrSize);
-    if (ret < 0) {
+    if ((ret < 0) && (errno == EINPROGRESS)) {
+        /*
+         * Other tasks run while the connection is made
+         */
+        int err = 0;
+        socklen_t errLen = sizeof(err);
+        AJ_WaitFd(tcpSock, AJWAITEVENT_WRITE, (uint32_t)-1);
+        ret = getsockopt(tcpSock, SOL_SOCKET, SO_ERROR, &err, &errLen);
+        if ((ret == 0) && err) {
+            ret = -1;
+        }
+    }
+    bufs = (ret == 0) ? (NetBuffers*)AJ_Malloc(sizeof(NetBuffers)) : NULL;
+    if (!bufs) {
 #ifndef NDEBUG
         fprintf(stderr, "connect() failed: %d\n", ret);
 #endif
+        close(tcpSock);
         return AJ_ERR_CONNECT;
     } else {
-        AJ_IOBufInit(&netSock->rx, rxData, sizeof(rxData), AJ_IO_BUF_RX, (void*)tcpSock);
+        AJ_IOBufInit(&netSock->rx, bufs->rx, sizeof(bufs->rx), AJ_IO_BUF_RX, (void*)(intptr_t)tcpSock);
         netSock->rx.recv = Recv;
-        AJ_IOBufInit(&netSock->tx, txData, sizeof(txData), AJ_IO_BUF_TX, (void*)tcpSock);
+        AJ_IOBufInit(&netSock->tx, bufs->tx, sizeof(bufs->tx), AJ_IO_BUF_TX, (void*)(intptr_t)tcpSock);
         netSock->tx.send = Send;
         return AJ_OK;
     }
@@ -262,14 +180,22 @@ AJ_Status AJ_Net_Connect(AJ_NetSocket* netSock, uint16_t port, uint8_t addrType,
 
 void AJ_Net_Disconnect(AJ_NetSocket* netSock)
 {
-    int tcpSock = (int)netSock->rx.context;
+    int tcpSock = (int)(intptr_t)netSock->rx.context;
     if (tcpSock != INVALID_SOCKET) {
         shutdown(tcpSock, SHUT_RDWR);
         close(tcpSock);
-        tcpSock = INVALID_SOCKET;
+        AJ_Free(netSock->rx.bufStart);
+        memset(netSock, 0, sizeof(AJ_NetSocket));
+        netSock->rx.context = (void*)(intptr_t)INVALID_SOCKET;
+        netSock->tx.context = (void*)(intptr_t)INVALID_SOCKET;
     }
 }
 
+int AJ_Net_GetFd(AJ_NetSocket* netSock)
+{
+    return (int)(intptr_t)netSock->rx.context;
+}
+
 static AJ_Status SendTo(AJ_IOBuffer* buf)
 {
     ssize_t ret;
@@ -285,7 +211,7 @@ static AJ_Status SendTo(AJ_IOBuffer* buf)
         sin.sin_family = AF_INET;
         sin.sin_port = htons(AJ_UDP_PORT);
         sin.sin_addr.s_addr = inet_addr(AJ_IPV4_MULTICAST_GROUP);
-        ret = sendto((int)buf->context, buf->readPtr, tx, 0, (struct sockaddr*)&sin, sizeof(sin));
+        ret = sendto((int)(intptr_t)buf->context, buf->readPtr, tx, 0, (struct sockaddr*)&sin, sizeof(sin));
         if (ret == -1) {
 #ifndef NDEBUG
             fprintf(stderr, "sendto() failed: %s\n", strerror(errno));
@@ -303,23 +229,15 @@ static AJ_Status RecvFrom(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
     AJ_Status status;
     ssize_t ret;
     size_t rx = AJ_IO_BUF_SPACE(buf);
-    fd_set fds;
-    int maxFd = INVALID_SOCKET;
-    int rc = 0;
-    struct timeval tv = { timeout / 1000, 1000 * (timeout % 1000) };
 
     assert(buf->direction == AJ_IO_BUF_RX);
 
-    FD_ZERO(&fds);
-    FD_SET((int) buf->context, &fds);
-    maxFd = max(maxFd, (int)buf->context);
-    rc = select(maxFd + 1, &fds, NULL, NULL, &tv);
-    if (rc == 0) {
+    if (AJ_WaitFd((int)(intptr_t)buf->context, AJWAITEVENT_READ, timeout) != AJ_OK) {
         return AJ_ERR_TIMEOUT;
     }
 
     rx = min(rx, len);
-    ret = recvfrom((int)buf->context, buf->writePtr, rx, 0, NULL, 0);
+    ret = recvfrom((int)(intptr_t)buf->context, buf->writePtr, rx, MSG_DONTWAIT, NULL, 0);
     if (ret == -1) {
         status = AJ_ERR_READ;
     } else {
@@ -329,8 +247,13 @@ static AJ_Status RecvFrom(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
     return status;
 }
 
-static uint8_t rxDataMCast[256];
-static uint8_t txDataMCast[256];
+/*
+ * The buffers for one multicast socket
+ */
+typedef struct _MCastBuffers {
+    uint8_t rx[256];
+    uint8_t tx[256];
+} MCastBuffers;
 
 #ifndef SO_REUSEPORT
 #define SO_REUSEPORT SO_REUSEADDR
@@ -342,6 +265,7 @@ AJ_Status AJ_Net_MCastUp(AJ_NetSocket* netSock)
     struct ip_mreq mreq;
     struct sockaddr_in sin;
     int reuse = 1;
+    MCastBuffers* bufs;
 
     int mcastSock = socket(AF_INET, SOCK_DGRAM, 0);
     if (mcastSock == INVALID_SOCKET) {
@@ -363,6 +287,7 @@ AJ_Status AJ_Net_MCastUp(AJ_NetSocket* netSock)
     sin.sin_addr.s_addr = INADDR_ANY;
     ret = bind(mcastSock, (struct sockaddr*)&sin, sizeof(sin));
     if (ret < 0) {
+        close(mcastSock);
         return AJ_ERR_READ;
     }
     /*
@@ -371,13 +296,14 @@ AJ_Status AJ_Net_MCastUp(AJ_NetSocket* netSock)
     mreq.imr_multiaddr.s_addr = inet_addr(AJ_IPV4_MULTICAST_GROUP);
     mreq.imr_interface.s_addr = INADDR_ANY;
     ret = setsockopt(mcastSock, IPPROTO_IP, IP_ADD_MEMBERSHIP, (char*)&mreq, sizeof(mreq));
-    if (ret < 0) {
+    bufs = (ret == 0) ? (MCastBuffers*)AJ_Malloc(sizeof(MCastBuffers)) : NULL;
+    if (!bufs) {
         close(mcastSock);
         return AJ_ERR_READ;
     } else {
-        AJ_IOBufInit(&netSock->rx, rxDataMCast, sizeof(rxDataMCast), AJ_IO_BUF_RX, (void*)mcastSock);
+        AJ_IOBufInit(&netSock->rx, bufs->rx, sizeof(bufs->rx), AJ_IO_BUF_RX, (void*)(intptr_t)mcastSock);
         netSock->rx.recv = RecvFrom;
-        AJ_IOBufInit(&netSock->tx, txDataMCast, sizeof(txDataMCast), AJ_IO_BUF_TX, (void*)mcastSock);
+        AJ_IOBufInit(&netSock->tx, bufs->tx, sizeof(bufs->tx), AJ_IO_BUF_TX, (void*)(intptr_t)mcastSock);
         netSock->tx.send = SendTo;
     }
 
@@ -387,7 +313,7 @@ AJ_Status AJ_Net_MCastUp(AJ_NetSocket* netSock)
 void AJ_Net_MCastDown(AJ_NetSocket* netSock)
 {
     struct ip_mreq mreq;
-    int mcastSock = (int)netSock->rx.context;
+    int mcastSock = (int)(intptr_t)netSock->rx.context;
 
     if (mcastSock != INVALID_SOCKET) {
         /*
@@ -398,7 +324,10 @@ void AJ_Net_MCastDown(AJ_NetSocket* netSock)
         setsockopt(mcastSock, IPPROTO_IP, IP_DROP_MEMBERSHIP, (char*) &mreq, sizeof(mreq));
         shutdown(mcastSock, SHUT_RDWR);
         close(mcastSock);
-        mcastSock = INVALID_SOCKET;
+        AJ_Free(netSock->rx.bufStart);
+        memset(netSock, 0, sizeof(AJ_NetSocket));
+        netSock->rx.context = (void*)(intptr_t)INVALID_SOCKET;
+        netSock->tx.context = (void*)(intptr_t)INVALID_SOCKET;
     }
 }
 
@@ -21,204 +21,373 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <pthread.h>
-#include <setjmp.h>
+#include <errno.h>
+#include <poll.h>
+#include <ucontext.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 
 #include "aj_target.h"
 #include "aj_status.h"
 #include "aj_util.h"
 
+/*
+ * Each task runs on its own stack and is switched to and from the loop with swapcontext(). A task
+ * waits for events raised by AJ_Schedule(), for a socket to become ready or for a timeout. Sockets
+ * are watched with one epoll instance that AJ_Loop() waits on, so a task is only resumed when there
+ * is something for it to do.
+ */
+typedef struct _Task {
+    ucontext_t ctx;
+    AJ_TaskFunction function;
+    void* context;
+    uint8_t* stack;       /* Mapping that holds the guard page and the stack */
+    uint32_t requested;   /* Events the task is waiting for */
+    uint32_t raised;      /* Events raised for the task since they were last cleared */
+    int fd;               /* File descriptor the task is waiting on or -1 */
+    int registeredFd;     /* File descriptor registered with epoll for the task or -1 */
+    uint64_t deadline;    /* Time in ms when the current wait times out */
+    uint8_t timed;        /* TRUE if the current wait has a deadline */
+    uint8_t fdReady;      /* TRUE if the file descriptor became ready */
+    uint8_t timedOut;     /* TRUE if the deadline passed */
+    uint8_t inUse;
+    uint8_t done;
+} Task;
 
-
-static jmp_buf superEnv;
-static jmp_buf waitEnv;
-
-static AJ_Event alwaysSet = { 1, 0 };
-static AJ_Event readEvent = { 0, 0 };
-static AJ_Event writeEvent = { 0, 0 };
-static AJ_Event timeEvent = { 0, 0 };
-static AJ_Event exitEvent = { 0, 0 };
-static AJ_Event* waitEvents[] = { &readEvent, &writeEvent, &timeEvent, &exitEvent };
-
+static Task tasks[AJ_MAX_TASKS];
+static Task* current = NULL;
+static ucontext_t loopCtx;
+static uint32_t numTasks = 0;
+static int epollFd = -1;
+static int wakeFd = -1;
+static size_t pageSize;
 
 /*
- * Call stack for AJ_Main()
+ * Events raised from any thread that have not been passed to the tasks yet
  */
-static uint64_t CallStack[1024];
-AJ_MainRoutineType AJ_MainRoutine = NULL;
+static volatile uint32_t pendingEvents = 0;
 
+/*
+ * Events seen outside of a task
+ */
+static uint32_t loopEvents = AJWAITEVENT_ALWAYSSET;
 
+AJ_MainRoutineType AJ_MainRoutine = NULL;
 
-static uint32_t bitFlagEventsRequested = 0;
-static uint32_t bitFlagEventsRaised = AJWAITEVENT_ALWAYSSET;
+static uint64_t Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
 
+static AJ_Status Init(void)
+{
+    if (epollFd == -1) {
+        struct epoll_event ev;
 
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if ((epollFd == -1) || (wakeFd == -1)) {
+            return AJ_ERR_RESOURCES;
+        }
+        ev.events = EPOLLIN;
+        ev.data.ptr = NULL;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &ev);
+        pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    }
+    return AJ_OK;
+}
 
 /*
- * called to indicate an event has happened.
- *
- * @param[in]  bitFlag indicates which events to signal
- *
+ * Pass the events raised since the last call to every task
  */
-void AJ_Schedule(uint32_t bitFlag)
+static void RaiseEvents(void)
 {
-    if (bitFlag & AJWAITEVENT_TIMER) {
-        timeEvent.isSet = 1;
-        bitFlagEventsRaised |= AJWAITEVENT_TIMER;
-    }
-    if (bitFlag & AJWAITEVENT_READ) {
-        readEvent.isSet = 1;
-        bitFlagEventsRaised |= AJWAITEVENT_READ;
-    }
-    if (bitFlag & AJWAITEVENT_WRITE) {
-        writeEvent.isSet = 1;
-        bitFlagEventsRaised |= AJWAITEVENT_WRITE;
-    }
-    if (bitFlag & AJWAITEVENT_EXIT) {
-        exitEvent.isSet = 1;
-        bitFlagEventsRaised |= AJWAITEVENT_EXIT;
-    }
+    uint32_t events = __sync_fetch_and_and(&pendingEvents, 0);
 
-    return AJ_OK;
+    if (events) {
+        uint32_t i;
+        loopEvents |= events;
+        for (i = 0; i < AJ_MAX_TASKS; ++i) {
+            tasks[i].raised |= events;
+        }
+    }
 }
 
+static uint8_t Runnable(const Task* task)
+{
+    return ((task->raised | AJWAITEVENT_ALWAYSSET) & task->requested) || task->fdReady || task->timedOut;
+}
 
 /*
- * called by client code to wait until one of the events has happened.
- *
- * @param[in]  bitFlag indicates which events to wait for.
- *
+ * Switch from the current task back to the loop
  */
-AJ_Status AJ_YieldUntil(uint32_t bitFlag)
+static void Suspend(Task* task)
+{
+    swapcontext(&task->ctx, &loopCtx);
+}
+
+static void Resume(Task* task)
 {
-    AJ_Status status = (AJ_Status)setjmp(waitEnv);
-    if (status == AJ_OK) {
-        bitFlagEventsRequested = bitFlag;
-        longjmp(superEnv, 1);
+    current = task;
+    swapcontext(&loopCtx, &task->ctx);
+    current = NULL;
+    if (task->done) {
+        if (task->registeredFd != -1) {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, task->registeredFd, NULL);
+        }
+        munmap(task->stack, AJ_TASK_STACK_SIZE + pageSize);
+        memset(task, 0, sizeof(Task));
+        if (--numTasks == 0) {
+            loopEvents |= AJWAITEVENT_EXIT;
+        }
     }
-    return status;
+}
+
+static void TaskEntry(void)
+{
+    Task* task = current;
+    task->function(task->context);
+    task->done = TRUE;
 }
 
 /*
- * Reset the state of an event to not-raised.
- *
- * @param[in]  bitFlag indicates which events to reset.
- *
+ * Register a file descriptor with epoll to wake the task once. Registrations are kept while the
+ * task waits on the same file descriptor and just re-armed.
  */
-AJ_Status AJ_ClearEvents(uint32_t bitFlag)
+static int Watch(Task* task, int fd, uint32_t events)
 {
-    if (bitFlag & AJWAITEVENT_TIMER) {
-        timeEvent.isSet = 0;
+    struct epoll_event ev;
+
+    ev.events = EPOLLONESHOT;
+    if (events & AJWAITEVENT_READ) {
+        ev.events |= EPOLLIN | EPOLLRDHUP;
     }
-    if (bitFlag & AJWAITEVENT_READ) {
-        readEvent.isSet = 0;
+    if (events & AJWAITEVENT_WRITE) {
+        ev.events |= EPOLLOUT;
     }
-    if (bitFlag & AJWAITEVENT_WRITE) {
-        writeEvent.isSet = 0;
+    ev.data.ptr = task;
+    if (task->registeredFd == fd) {
+        if (epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev) == 0) {
+            return 0;
+        }
+    } else if (task->registeredFd != -1) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, task->registeredFd, NULL);
     }
-    if (bitFlag & AJWAITEVENT_EXIT) {
-        exitEvent.isSet = 0;
+    task->registeredFd = -1;
+    /*
+     * The descriptor may have been closed and reopened since it was last registered
+     */
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        if ((errno != EEXIST) || (epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev) != 0)) {
+            return -1;
+        }
     }
+    task->registeredFd = fd;
+    return 0;
+}
 
+void AJ_Schedule(uint32_t bitFlag)
+{
+    __sync_fetch_and_or(&pendingEvents, bitFlag);
+    if (wakeFd != -1) {
+        eventfd_write(wakeFd, 1);
+    }
+}
+
+AJ_Status AJ_YieldUntil(uint32_t bitFlag)
+{
+    Task* task = current;
+
+    if (!task) {
+        return AJ_ERR_UNEXPECTED;
+    }
+    task->requested = bitFlag;
+    Suspend(task);
+    task->requested = 0;
+    return AJ_OK;
+}
+
+AJ_Status AJ_ClearEvents(uint32_t bitFlag)
+{
+    RaiseEvents();
+    if (current) {
+        current->raised &= ~bitFlag;
+    } else {
+        loopEvents &= ~bitFlag;
+    }
     return AJ_OK;
 }
 
-/*
- * Retrive the state of an event
- *
- * @param[in]  bitFlag indicates which single event to check.
- * @return returns the current state of the event (set or not-set)
- */
 int AJ_GetEventState(uint32_t bitFlag)
 {
-    int eventState = 0;
-    switch (bitFlag) {
-    case AJWAITEVENT_TIMER:
-        eventState = timeEvent.isSet;
-        break;
+    RaiseEvents();
+    return ((current ? current->raised : loopEvents) & bitFlag) != 0;
+}
 
-    case AJWAITEVENT_READ:
-        eventState = readEvent.isSet;
-        break;
+AJ_Status AJ_WaitFd(int fd, uint32_t events, uint32_t timeout)
+{
+    Task* task = current;
+    AJ_Status status;
 
-    case AJWAITEVENT_WRITE:
-        eventState = writeEvent.isSet;
-        break;
+    if (!task) {
+        struct pollfd pfd;
+        pfd.fd = fd;
+        pfd.events = ((events & AJWAITEVENT_READ) ? POLLIN : 0) | ((events & AJWAITEVENT_WRITE) ? POLLOUT : 0);
+        return (poll(&pfd, (fd >= 0) ? 1 : 0, (timeout == (uint32_t)-1) ? -1 : (int)timeout) > 0) ? AJ_OK : AJ_ERR_TIMEOUT;
+    }
+    /*
+     * If the descriptor cannot be watched let the caller find out why
+     */
+    if ((fd >= 0) && (Watch(task, fd, events) != 0)) {
+        return AJ_OK;
+    }
+    /*
+     * A task that has not yielded yet still requests AJWAITEVENT_ALWAYSSET, only the descriptor
+     * and the timeout may wake it
+     */
+    task->requested = 0;
+    task->fd = fd;
+    task->timed = (timeout != (uint32_t)-1);
+    task->deadline = Now() + timeout;
+    Suspend(task);
+    status = task->fdReady ? AJ_OK : AJ_ERR_TIMEOUT;
+    task->fd = -1;
+    task->timed = FALSE;
+    task->fdReady = FALSE;
+    task->timedOut = FALSE;
+    return status;
+}
 
-    case AJWAITEVENT_EXIT:
-        eventState = exitEvent.isSet;
-        break;
+AJ_Status AJ_StartTask(AJ_TaskFunction function, void* context)
+{
+    Task* task = NULL;
+    uint32_t i;
 
+    if (Init() != AJ_OK) {
+        return AJ_ERR_RESOURCES;
     }
-    return eventState;
+    for (i = 0; i < AJ_MAX_TASKS; ++i) {
+        if (!tasks[i].inUse) {
+            task = &tasks[i];
+            break;
+        }
+    }
+    if (!task) {
+        return AJ_ERR_RESOURCES;
+    }
+    /*
+     * The lowest page of the mapping is left inaccessible so a stack overflow faults
+     */
+    task->stack = mmap(NULL, AJ_TASK_STACK_SIZE + pageSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if (task->stack == MAP_FAILED) {
+        task->stack = NULL;
+        return AJ_ERR_RESOURCES;
+    }
+    mprotect(task->stack, pageSize, PROT_NONE);
+    getcontext(&task->ctx);
+    task->ctx.uc_stack.ss_sp = task->stack + pageSize;
+    task->ctx.uc_stack.ss_size = AJ_TASK_STACK_SIZE;
+    task->ctx.uc_link = &loopCtx;
+    makecontext(&task->ctx, TaskEntry, 0);
+    task->function = function;
+    task->context = context;
+    task->requested = AJWAITEVENT_ALWAYSSET;
+    task->raised = 0;
+    task->fd = -1;
+    task->registeredFd = -1;
+    task->inUse = TRUE;
+    ++numTasks;
+    /*
+     * There is something to run again
+     */
+    loopEvents &= ~AJWAITEVENT_EXIT;
+    return AJ_OK;
 }
 
+static void MainTask(void* context)
+{
+    AJ_MainRoutine();
+}
 
-/*
- *   Save CallStack address into the jmp_buf.
- *   This will make all of the AJ_Main calls take place inside the CallStack buffer
- */
 void CallAllJoyn()
 {
-    jmp_buf tmpEnv;
-    if (!setjmp(tmpEnv)) {
-
-        /*
-           The inline assembly is here to adjust the stack pointer to be stored in the same way the runtime library does.
-           It probably goes without saying that this is _very_ system specific, based on how glib saves context
-         */
-        uint64_t mangled = (uint64_t)CallStack + sizeof(CallStack);
-        asm (
-            "xor  %%fs:0x30,%0\n" /// retrieve PTR_MANGLE value
-            "rol  $0x11,%0\n"     /// rol it around
-            "mov  %0,%1\n"        /// save it back to mangled.
-            : "=r" (mangled)
-            : "0" (mangled)
-            );
-        (tmpEnv[0]).__jmpbuf[6] = mangled;
-        // now restore the environment back to the setjmp above, but now the callstack is located in the new CallStack buffer.
-        longjmp(tmpEnv, 1);
-    } else {
-        AJ_MainRoutine();
+    if (AJ_StartTask(MainTask, NULL) != AJ_OK) {
+        AJ_Printf("Error: failed to start the AllJoyn task\n");
     }
 }
 
 int AJ_Loop()
 {
-    static uint8_t firstTime = 1;
-    uint8_t i;
-    uint8_t wasSet = FALSE;
+    static uint8_t firstTime = TRUE;
+    struct epoll_event events[AJ_MAX_TASKS + 1];
+    int timeout = -1;
+    uint64_t now;
+    uint32_t i;
+    int n;
 
     /*
      * The first time through we need to call into the AllJoyn main program.
      */
     if (firstTime) {
-        firstTime = 0;
-        if (!setjmp(superEnv)) {
+        firstTime = FALSE;
+        if (AJ_MainRoutine) {
             CallAllJoyn();
         }
-        return 0;
+    }
+    RaiseEvents();
+    if (!numTasks || (loopEvents & AJWAITEVENT_EXIT)) {
+        return numTasks;
     }
     /*
-     * Check if any events are set.
+     * Don't block if a task is ready, otherwise wait no longer than the nearest deadline
      */
-    for (i = 0; i < (sizeof(waitEvents) / sizeof(waitEvents[0])); ++i) {
-        if (exitEvent.isSet) {
-            return(0);
-        } else if (waitEvents[i]->isSet) {
-            wasSet = TRUE;
-            break;
+    now = Now();
+    for (i = 0; (i < AJ_MAX_TASKS) && timeout; ++i) {
+        Task* task = &tasks[i];
+        if (!task->inUse) {
+            continue;
+        }
+        if (Runnable(task)) {
+            timeout = 0;
+        } else if (task->timed) {
+            int remaining = (task->deadline > now) ? (int)min(task->deadline - now, 0x7FFFFFFF) : 0;
+            if ((timeout < 0) || (remaining < timeout)) {
+                timeout = remaining;
+            }
+        }
+    }
+    n = epoll_wait(epollFd, events, AJ_MAX_TASKS + 1, timeout);
+    for (i = 0; (int)i < n; ++i) {
+        Task* task = (Task*)events[i].data.ptr;
+        if (!task) {
+            eventfd_t count;
+            eventfd_read(wakeFd, &count);
+        } else if (task->inUse && (task->fd != -1)) {
+            task->fdReady = TRUE;
         }
     }
+    RaiseEvents();
+    if (loopEvents & AJWAITEVENT_EXIT) {
+        return numTasks;
+    }
     /*
-     * If there are no events set there is nothing to do yet
+     * Run every task that is ready once
      */
-    if (wasSet) {
-        if (setjmp(superEnv) == 0) {
-            longjmp(waitEnv, 1);
+    now = Now();
+    for (i = 0; i < AJ_MAX_TASKS; ++i) {
+        Task* task = &tasks[i];
+        if (!task->inUse) {
+            continue;
+        }
+        if (!Runnable(task) && task->timed && (task->deadline <= now)) {
+            task->timedOut = TRUE;
+        }
+        if (Runnable(task)) {
+            Resume(task);
         }
     }
-    return AJ_OK;
+    return numTasks;
 }
-
-
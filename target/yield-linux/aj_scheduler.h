@@ -28,6 +28,20 @@
 
 #include "aj_status.h"
 
+/*
+ * Maximum number of tasks that can run at the same time
+ */
+#ifndef AJ_MAX_TASKS
+#define AJ_MAX_TASKS 16
+#endif
+
+/*
+ * Size of each task's stack, a guard page below the stack catches overflows
+ */
+#ifndef AJ_TASK_STACK_SIZE
+#define AJ_TASK_STACK_SIZE (64 * 1024)
+#endif
+
 typedef struct _AJ_Event {
     uint8_t isSet;
     uint32_t data;
@@ -40,14 +54,91 @@ typedef struct _AJ_Event {
 #define AJWAITEVENT_EXIT      0x8
 #define AJWAITEVENT_ALWAYSSET 0x10
 
+/**
+ * Raise events. Every task waiting for one of the events is woken. This can be called from any
+ * thread. The exit event stops AJ_Loop() from running tasks.
+ *
+ * @param bitFlag  The events to raise
+ */
 void AJ_Schedule(uint32_t bitFlag);
+
+/**
+ * Suspend the current task until one of the events has been raised for it. Waiting for
+ * AJWAITEVENT_ALWAYSSET lets the other ready tasks run first.
+ *
+ * @param bitFlag  The events to wait for
+ *
+ * @return
+ *          - AJ_OK when one of the events has been raised
+ *          - AJ_ERR_UNEXPECTED if not called from a task
+ */
 AJ_Status AJ_YieldUntil(uint32_t bitFlag);
+
+/**
+ * Reset events raised for the current task, or outside a task the events seen by AJ_GetEventState()
+ *
+ * @param bitFlag  The events to reset
+ */
 AJ_Status AJ_ClearEvents(uint32_t bitFlag);
+
+/**
+ * Get the state of an event for the current task, or outside a task whether the event has been
+ * raised since it was last cleared.
+ *
+ * @param bitFlag  The single event to check
+ *
+ * @return  Non-zero if the event is set
+ */
 int AJ_GetEventState(uint32_t bitFlag);
 
+/**
+ * Suspend the current task until a file descriptor is ready or the timeout expires. Other tasks run
+ * in the meantime. Outside a task this blocks the calling thread.
+ *
+ * @param fd       The file descriptor or -1 to just wait for the timeout
+ * @param events   AJWAITEVENT_READ and/or AJWAITEVENT_WRITE
+ * @param timeout  Time in milliseconds to wait, (uint32_t)-1 waits forever
+ *
+ * @return
+ *          - AJ_OK if the file descriptor is ready
+ *          - AJ_ERR_TIMEOUT if the timeout expired first
+ */
+AJ_Status AJ_WaitFd(int fd, uint32_t events, uint32_t timeout);
+
+/**
+ * Function prototype for the entry point of a task
+ *
+ * @param context  The context pointer passed to AJ_StartTask()
+ */
+typedef void (*AJ_TaskFunction)(void* context);
+
+/**
+ * Start a task with its own stack. The task first runs from AJ_Loop(). Tasks run on the thread
+ * that calls AJ_Loop() so they share the AllJoyn runtime state of that thread.
+ *
+ * @param function  The entry point of the task, the task ends when it returns
+ * @param context   A context pointer passed to the function
+ *
+ * @return
+ *          - AJ_OK if the task was started
+ *          - AJ_ERR_RESOURCES if there are too many tasks or a stack could not be allocated
+ */
+AJ_Status AJ_StartTask(AJ_TaskFunction function, void* context);
+
 typedef int (*AJ_MainRoutineType)(void);
 
+/**
+ * Start AJ_MainRoutine as a task
+ */
 void CallAllJoyn();
+
+/**
+ * Run every task that is ready, waiting for an event, socket or timeout first if none are. The
+ * first call starts AJ_MainRoutine if it has been set. The exit event is raised when the last task
+ * ends.
+ *
+ * @return  The number of tasks still running
+ */
 int AJ_Loop();
 
 #endif
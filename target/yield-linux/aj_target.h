@@ -55,6 +55,14 @@
 
 #define AJ_ASSERT(x) assert(x)
 
+/*
+ * Runtime state is kept per thread so each thread can run its own bus attachments. Define this as
+ * empty if the library is only used from one thread.
+ */
+#ifndef AJ_THREAD_LOCAL
+#define AJ_THREAD_LOCAL __thread
+#endif
+
 
 #include "aj_scheduler.h"
 #endif
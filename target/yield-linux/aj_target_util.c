@@ -31,9 +31,12 @@ AJ_Status AJ_SuspendWifi(uint32_t msec)
     return AJ_OK;
 }
 
+/*
+ * Inside a task other tasks run while this one sleeps
+ */
 void AJ_Sleep(uint32_t time)
 {
-    usleep(1000 * time);
+    AJ_WaitFd(-1, 0, time);
 }
 
 uint32_t AJ_GetElapsedTime(AJ_Time* timer, uint8_t cumulative)
@@ -19,6 +19,10 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 #include "alljoyn.h"
 #include "aj_crypto.h"
@@ -29,6 +33,136 @@ static const uint8_t key[] = { 0xC6, 0xC4, 0xFC, 0xEF, 0x31, 0x85, 0xFB, 0x66, 0
 static uint8_t msg[1024];
 static uint32_t nonce[2] = { 0x2AC45FAD, 0xD617159A };
 
+#define BENCH_ROUNDS 20000
+#define SMALL_MSG    64
+
+/*
+ * The software AES chosen at build time
+ */
+#if AJ_AES_BITSLICE
+#define SOFTWARE "bitslice"
+#else
+#define SOFTWARE "software"
+#endif
+
+/*
+ * Time stamp counter where there is one, otherwise nanoseconds
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#define UNIT "cycles"
+static uint64_t Cycles(void)
+{
+    return __rdtsc();
+}
+#else
+#define UNIT "ns"
+static uint64_t Cycles(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+#endif
+
+/*
+ * Cost per byte of the CTR and CBC-MAC passes over a whole message and of CCM encryption, then the
+ * cost per small message of CCM with a raw key against a prepared key
+ */
+static void Bench(const char* name)
+{
+    static uint8_t buf[sizeof(msg) + 16];
+    uint8_t block[16];
+    AJ_KeySchedule ks;
+    uint64_t ctr;
+    uint64_t cbc;
+    uint64_t ccm;
+    uint64_t raw;
+    uint64_t prepared;
+    uint64_t start;
+    size_t i;
+
+    memcpy(buf, msg, sizeof(msg));
+    AJ_AES_Enable(key);
+    memset(block, 0, sizeof(block));
+    start = Cycles();
+    for (i = 0; i < BENCH_ROUNDS; ++i) {
+        AJ_AES_CTR_128(key, buf, buf, sizeof(msg), block);
+    }
+    ctr = Cycles() - start;
+    start = Cycles();
+    for (i = 0; i < BENCH_ROUNDS; ++i) {
+        AJ_AES_CBC_128_ENCRYPT(key, buf, buf, sizeof(msg), block);
+    }
+    cbc = Cycles() - start;
+    AJ_AES_Disable();
+    start = Cycles();
+    for (i = 0; i < BENCH_ROUNDS; ++i) {
+        AJ_Encrypt_CCM(key, buf, sizeof(msg), 32, 8, (const uint8_t*)nonce, sizeof(nonce));
+    }
+    ccm = Cycles() - start;
+    start = Cycles();
+    for (i = 0; i < BENCH_ROUNDS; ++i) {
+        AJ_Encrypt_CCM(key, buf, SMALL_MSG, 32, 8, (const uint8_t*)nonce, sizeof(nonce));
+    }
+    raw = Cycles() - start;
+    AJ_AES_InitKey(&ks, key);
+    start = Cycles();
+    for (i = 0; i < BENCH_ROUNDS; ++i) {
+        AJ_Encrypt_CCM_Key(&ks, buf, SMALL_MSG, 32, 8, (const uint8_t*)nonce, sizeof(nonce));
+    }
+    prepared = Cycles() - start;
+    AJ_AES_ClearKey(&ks);
+    printf("%-9s CTR %6.2f  CBC-MAC %6.2f  CCM %6.2f  %s/byte\n", name,
+           (double)ctr / (BENCH_ROUNDS * sizeof(msg)), (double)cbc / (BENCH_ROUNDS * sizeof(msg)),
+           (double)ccm / (BENCH_ROUNDS * sizeof(msg)), UNIT);
+    printf("%-9s CCM %u bytes raw key %6u  prepared key %6u  %s/message\n", name, SMALL_MSG,
+           (uint32_t)(raw / BENCH_ROUNDS), (uint32_t)(prepared / BENCH_ROUNDS), UNIT);
+}
+
+#if AJ_AES_AF_ALG
+/*
+ * Cost per message of CCM in process and in the kernel for a range of message sizes
+ */
+static void BenchOffload(void)
+{
+    static const uint32_t sizes[] = { 64, 256, 1024, 4096, 16384 };
+    static uint8_t buf[16384 + 16];
+    AJ_KeySchedule ks;
+    uint64_t local;
+    uint64_t kernel;
+    uint64_t start;
+    size_t i;
+    size_t j;
+
+    if (!AJ_CCM_SetOffloadThreshold(0)) {
+        printf("kernel    ccm(aes) is not available\n");
+        return;
+    }
+    AJ_AES_InitKey(&ks, key);
+    memset(buf, 0x5A, sizeof(buf));
+    for (i = 0; i < ArraySize(sizes); ++i) {
+        uint32_t rounds = BENCH_ROUNDS / 10;
+
+        AJ_CCM_SetOffloadThreshold(0xFFFFFFFF);
+        start = Cycles();
+        for (j = 0; j < rounds; ++j) {
+            AJ_Encrypt_CCM_Key(&ks, buf, sizes[i], 32, 8, (const uint8_t*)nonce, sizeof(nonce));
+        }
+        local = Cycles() - start;
+        AJ_CCM_SetOffloadThreshold(0);
+        start = Cycles();
+        for (j = 0; j < rounds; ++j) {
+            AJ_Encrypt_CCM_Key(&ks, buf, sizes[i], 32, 8, (const uint8_t*)nonce, sizeof(nonce));
+        }
+        kernel = Cycles() - start;
+        printf("kernel    CCM %5u bytes in process %8u  kernel %8u  %s/message\n", sizes[i],
+               (uint32_t)(local / rounds), (uint32_t)(kernel / rounds), UNIT);
+    }
+    AJ_CCM_SetOffloadThreshold(AJ_AF_ALG_THRESHOLD);
+    AJ_AES_ClearKey(&ks);
+}
+#endif
+
 int main(void)
 {
     AJ_Status status = AJ_OK;
@@ -62,6 +196,18 @@ int main(void)
             nonce[0] += 1;
         }
     }
+#if AJ_AES_HW
+    AJ_AES_UseHardware(FALSE);
+    Bench(SOFTWARE);
+    if (AJ_AES_UseHardware(TRUE)) {
+        Bench("hardware");
+    }
+#else
+    Bench(SOFTWARE);
+#endif
+#if AJ_AES_AF_ALG
+    BenchOffload();
+#endif
     return 0;
 
 ErrorExit:
@@ -20,17 +20,34 @@
 #include "aj_target.h"
 #include "alljoyn.h"
 
+/*
+ * Each thread runs its own bus attachment and service. Build with more threads to stress the per
+ * thread runtime state, thread n > 0 appends ".t<n>" to the service name.
+ */
+#ifndef BASTRESS_THREADS
+#define BASTRESS_THREADS 1
+#endif
+
+#if BASTRESS_THREADS > 1
+#include <pthread.h>
+#endif
+
 
 #define CONNECT_TIMEOUT    (1000ul * 200)
 #define UNMARSHAL_TIMEOUT  (1000ul * 5)
 #define METHOD_TIMEOUT     (1000ul * 3)
 
-/// globals
-AJ_Status status = AJ_OK;
-AJ_BusAttachment bus;
-uint8_t connected = FALSE;
-uint32_t sessionId = 0ul;
-AJ_Status authStatus = AJ_ERR_NULL;
+/// per thread globals
+static AJ_THREAD_LOCAL AJ_Status status = AJ_OK;
+static AJ_THREAD_LOCAL AJ_BusAttachment bus;
+static AJ_THREAD_LOCAL uint8_t connected = FALSE;
+static AJ_THREAD_LOCAL uint32_t sessionId = 0ul;
+static AJ_THREAD_LOCAL AJ_Status authStatus = AJ_ERR_NULL;
+static AJ_THREAD_LOCAL uint32_t threadNum;
+static AJ_THREAD_LOCAL uint32_t catCalls;
+static AJ_THREAD_LOCAL AJ_Time rateTimer;
+
+#define RATE_INTERVAL      (1000ul * 5)
 
 static const char ServiceName[] = "org.alljoyn.Bus.test.bastress";
 static const uint16_t ServicePort = 25;
@@ -67,6 +84,19 @@ void AppDoWork()
     AJ_Printf("AppDoWork\n");
 }
 
+/*
+ * Report how many method calls this thread is handling
+ */
+static void ReportRate()
+{
+    uint32_t elapsed = AJ_GetElapsedTime(&rateTimer, TRUE);
+    if (elapsed >= RATE_INTERVAL) {
+        AJ_Printf("thread %u: %u cat calls/s\n", threadNum, (uint32_t)((catCalls * 1000ull) / elapsed));
+        catCalls = 0;
+        AJ_InitTimer(&rateTimer);
+    }
+}
+
 
 static const char PWD[] = "1234";
 
@@ -105,19 +135,24 @@ AJ_Status AppHandleCat(AJ_Message* msg)
     return status;
 }
 
-int AJ_Main()
+static void* ServiceThread(void* arg)
 {
-    // you're connected now, so print out the data:
-    AJ_Printf("You're connected to the network\n");
-    AJ_Initialize();
-    AJ_PrintXML(AppObjects);
+    char serviceName[sizeof(ServiceName) + 8];
+
+    threadNum = (uint32_t)(uintptr_t)arg;
+    if (threadNum) {
+        sprintf(serviceName, "%s.t%u", ServiceName, threadNum);
+    } else {
+        strcpy(serviceName, ServiceName);
+    }
     AJ_RegisterObjects(AppObjects, NULL);
+    AJ_InitTimer(&rateTimer);
 
     while (TRUE) {
         AJ_Message msg;
 
         if (!connected) {
-            status = AJ_StartService(&bus, NULL, CONNECT_TIMEOUT, ServicePort, ServiceName, AJ_NAME_REQ_DO_NOT_QUEUE, NULL);
+            status = AJ_StartService(&bus, NULL, CONNECT_TIMEOUT, ServicePort, serviceName, AJ_NAME_REQ_DO_NOT_QUEUE, NULL);
             if (status == AJ_OK) {
                 AJ_Printf("StartService returned %d\n", status);
                 connected = TRUE;
@@ -133,6 +168,7 @@ int AJ_Main()
         }
 
         status = AJ_UnmarshalMsg(&bus, &msg, UNMARSHAL_TIMEOUT);
+        ReportRate();
         if (status != AJ_OK) {
             if (status == AJ_ERR_TIMEOUT) {
                 AppDoWork();
@@ -160,6 +196,7 @@ int AJ_Main()
 
             case APP_MY_CAT:
                 status = AppHandleCat(&msg);
+                ++catCalls;
                 break;
 
             case AJ_SIGNAL_SESSION_LOST:
@@ -192,6 +229,27 @@ int AJ_Main()
         }
     }
 
+    return NULL;
+}
+
+int AJ_Main()
+{
+#if BASTRESS_THREADS > 1
+    pthread_t threads[BASTRESS_THREADS];
+    uint32_t i;
+#endif
+
+    // you're connected now, so print out the data:
+    AJ_Printf("You're connected to the network\n");
+    AJ_Initialize();
+    AJ_PrintXML(AppObjects);
+
+#if BASTRESS_THREADS > 1
+    for (i = 1; i < BASTRESS_THREADS; ++i) {
+        pthread_create(&threads[i], NULL, ServiceThread, (void*)(uintptr_t)i);
+    }
+#endif
+    ServiceThread(NULL);
     return 0;
 }
 
@@ -0,0 +1,260 @@
+/**
+ * @file  Benchmark for servicing many bus attachments from one thread
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include "alljoyn.h"
+#include "aj_util.h"
+#include "aj_bufio.h"
+#include "aj_net.h"
+#include "aj_helper.h"
+
+#define MAX_BUSES    1000
+#define TOTAL_MSGS   200000
+#define BURST        4
+
+static const char* const benchInterface[] = {
+    "org.alljoyn.busbench",
+    "!Tick >u",
+    NULL
+};
+
+static const AJ_InterfaceDescription benchInterfaces[] = {
+    benchInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/org/alljoyn/busbench", benchInterfaces },
+    { NULL }
+};
+
+#define TICK_SIGNAL AJ_APP_MESSAGE_ID(0, 0, 0)
+
+/*
+ * A burst of pre-marshaled signals the peer writes to each connection
+ */
+static uint8_t burst[1024];
+static size_t burstLen;
+
+static int peerSocks[MAX_BUSES];
+static uint32_t numPeers;
+static uint32_t rounds;
+
+static uint32_t received;
+static uint32_t failed;
+
+static void* PeerThread(void* arg)
+{
+    uint32_t r;
+    uint32_t i;
+
+    for (r = 0; r < rounds; ++r) {
+        for (i = 0; i < numPeers; ++i) {
+            size_t off = 0;
+            while (off < burstLen) {
+                ssize_t ret = send(peerSocks[i], burst + off, burstLen - off, MSG_NOSIGNAL);
+                if (ret <= 0) {
+                    return NULL;
+                }
+                off += ret;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void Handler(AJ_BusAttachment* bus, AJ_Message* msg, AJ_Status status)
+{
+    if ((status == AJ_OK) && (msg->msgId == TICK_SIGNAL)) {
+        ++received;
+    } else {
+        ++failed;
+    }
+}
+
+static AJ_Status CaptureFunc(AJ_IOBuffer* buf)
+{
+    size_t tx = AJ_IO_BUF_AVAIL(buf);
+
+    if ((burstLen + tx) > sizeof(burst)) {
+        return AJ_ERR_WRITE;
+    }
+    memcpy(burst + burstLen, buf->bufStart, tx);
+    burstLen += tx;
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+static AJ_Status MarshalBurst(void)
+{
+    AJ_Status status = AJ_OK;
+    AJ_BusAttachment bus;
+    uint8_t txBuffer[256];
+    AJ_Message msg;
+    uint32_t i;
+
+    memset(&bus, 0, sizeof(bus));
+    AJ_IOBufInit(&bus.sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, NULL);
+    bus.sock.tx.send = CaptureFunc;
+    for (i = 0; (i < BURST) && (status == AJ_OK); ++i) {
+        status = AJ_MarshalSignal(&bus, &msg, TICK_SIGNAL, NULL, 0, 0, 0);
+        if (status == AJ_OK) {
+            status = AJ_MarshalArgs(&msg, "u", i);
+        }
+        if (status == AJ_OK) {
+            status = AJ_DeliverMsg(&msg);
+        }
+    }
+    return status;
+}
+
+/*
+ * Resident memory in bytes
+ */
+static size_t Resident(void)
+{
+    unsigned long size = 0;
+    unsigned long resident = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+
+    if (f) {
+        if (fscanf(f, "%lu %lu", &size, &resident) != 2) {
+            resident = 0;
+        }
+        fclose(f);
+    }
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+static AJ_Status Run(int listener, struct sockaddr_in* sa, AJ_BusAttachment* buses, uint32_t numBuses)
+{
+    AJ_Status status = AJ_OK;
+    uint32_t addr = sa->sin_addr.s_addr;
+    uint32_t total;
+    uint32_t loops = 0;
+    size_t before;
+    size_t connected;
+    pthread_t thread;
+    AJ_Time timer;
+    uint32_t elapsed;
+    uint32_t i;
+
+    before = Resident();
+    for (i = 0; (i < numBuses) && (status == AJ_OK); ++i) {
+        status = AJ_Net_Connect(&buses[i].sock, ntohs(sa->sin_port), AJ_ADDR_IPV4, &addr);
+        if (status == AJ_OK) {
+            peerSocks[i] = accept(listener, NULL, NULL);
+        }
+    }
+    if (status != AJ_OK) {
+        printf("Connect %u failed %d\n", i, status);
+        numBuses = i;
+    }
+    numPeers = numBuses;
+    connected = Resident();
+    rounds = TOTAL_MSGS / (numBuses * BURST);
+    total = rounds * numBuses * BURST;
+    received = 0;
+    failed = 0;
+
+    if (status == AJ_OK) {
+        pthread_create(&thread, NULL, PeerThread, NULL);
+        AJ_InitTimer(&timer);
+        while ((received < total) && !failed) {
+            if (AJ_ServiceBuses(Handler, 1000) == AJ_ERR_TIMEOUT) {
+                status = AJ_ERR_TIMEOUT;
+                break;
+            }
+            ++loops;
+        }
+        elapsed = AJ_GetElapsedTime(&timer, FALSE);
+        pthread_join(thread, NULL);
+        if (failed) {
+            status = AJ_ERR_READ;
+        }
+        if (status == AJ_OK) {
+            printf("%4u buses  %5u bytes/bus connected  %5u bytes/bus after traffic  %4u ns/msg  %5.1f msgs/wakeup\n",
+                   numBuses, (uint32_t)((connected - before) / numBuses), (uint32_t)((Resident() - before) / numBuses),
+                   (uint32_t)((elapsed * 1000000ull) / total), (double)total / loops);
+        }
+    }
+    for (i = 0; i < numBuses; ++i) {
+        AJ_Net_Disconnect(&buses[i].sock);
+        close(peerSocks[i]);
+    }
+    return status;
+}
+
+int AJ_Main()
+{
+    static const uint32_t counts[] = { 1, 10, 100, 1000 };
+    AJ_Status status;
+    AJ_BusAttachment* buses;
+    struct sockaddr_in sa;
+    socklen_t saLen = sizeof(sa);
+    int listener;
+    size_t i;
+
+    AJ_Net_Up();
+    if (AJ_Net_RaiseFileLimit() < 2 * MAX_BUSES + 16) {
+        printf("Open file limit is too low for %u buses\n", (uint32_t)MAX_BUSES);
+        return 1;
+    }
+    AJ_RegisterObjects(AppObjects, NULL);
+    status = MarshalBurst();
+    if (status != AJ_OK) {
+        printf("Marshal failed %d\n", status);
+        return 1;
+    }
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((bind(listener, (struct sockaddr*)&sa, sizeof(sa)) != 0) || (listen(listener, 16) != 0) ||
+        (getsockname(listener, (struct sockaddr*)&sa, &saLen) != 0)) {
+        printf("Failed to create listener\n");
+        return 1;
+    }
+    buses = (AJ_BusAttachment*)calloc(MAX_BUSES, sizeof(AJ_BusAttachment));
+    printf("%u byte bus attachment, %u messages per run\n", (uint32_t)sizeof(AJ_BusAttachment), TOTAL_MSGS);
+    for (i = 0; (i < ArraySize(counts)) && (status == AJ_OK); ++i) {
+        status = Run(listener, &sa, buses, counts[i]);
+    }
+    if (status != AJ_OK) {
+        printf("Benchmark failed %d\n", status);
+    }
+    free(buses);
+    close(listener);
+    return (status == AJ_OK) ? 0 : 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,115 @@
+/**
+ * @file  Message dispatch benchmark
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+
+#include "alljoyn.h"
+#include "aj_helper.h"
+
+#define NUM_HANDLERS 80
+
+#define DISPATCHES (10 * 1000 * 1000)
+
+static MessageHandlerEntry handlers[NUM_HANDLERS + 1];
+static PropHandlerEntry props[NUM_HANDLERS / 4 + 1];
+static uint32_t handled;
+
+static AJ_Status Handler(AJ_Message* msg, AJ_Message* reply)
+{
+    ++handled;
+    return AJ_OK;
+}
+
+/*
+ * Walk the handler lists the way AJ_RunAllJoynService used to
+ */
+static AJ_Status LinearDispatch(AJ_Message* msg, const AllJoynConfiguration* config)
+{
+    const MessageHandlerEntry* message_entry = config->message_handlers;
+    const PropHandlerEntry* prop_entry = config->prop_handlers;
+
+    while (message_entry->msgid != 0) {
+        if (message_entry->msgid == msg->msgId) {
+            return (message_entry->handler)(msg, NULL);
+        }
+        ++message_entry;
+    }
+    while (prop_entry->msgid != 0) {
+        if (prop_entry->msgid == msg->msgId) {
+            return AJ_OK;
+        }
+        ++prop_entry;
+    }
+    return AJ_BusHandleBusMessage(msg);
+}
+
+static uint32_t Bench(AJ_Status (*dispatch)(AJ_Message*, const AllJoynConfiguration*), const AllJoynConfiguration* config)
+{
+    AJ_Message msg;
+    AJ_MsgHeader hdr;
+    AJ_Time timer;
+    uint32_t i;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msgType = AJ_MSG_SIGNAL;
+    msg.hdr = &hdr;
+    AJ_InitTimer(&timer);
+    for (i = 0; i < DISPATCHES; ++i) {
+        msg.msgId = handlers[(i * 37) % NUM_HANDLERS].msgid;
+        dispatch(&msg, config);
+    }
+    return AJ_GetElapsedTime(&timer, FALSE);
+}
+
+int AJ_Main()
+{
+    AllJoynConfiguration config;
+    uint32_t linearTime;
+    uint32_t tableTime;
+    uint32_t i;
+
+    for (i = 0; i < NUM_HANDLERS; ++i) {
+        handlers[i].msgid = AJ_APP_MESSAGE_ID(i / 20, (i / 5) % 4, i % 5);
+        handlers[i].handler = Handler;
+    }
+    for (i = 0; i < NUM_HANDLERS / 4; ++i) {
+        props[i].msgid = AJ_APP_MESSAGE_ID(7, i, AJ_PROP_GET);
+    }
+    memset(&config, 0, sizeof(config));
+    config.message_handlers = handlers;
+    config.prop_handlers = props;
+
+    linearTime = Bench(LinearDispatch, &config);
+    tableTime = Bench(AJ_DispatchMessage, &config);
+    if (handled != 2 * DISPATCHES) {
+        printf("Benchmark failed %u messages handled\n", handled);
+        return 1;
+    }
+    printf("%u handlers   linear %u ns/msg   table %u ns/msg\n", NUM_HANDLERS,
+           (uint32_t)((linearTime * 1000000ull) / DISPATCHES), (uint32_t)((tableTime * 1000000ull) / DISPATCHES));
+    return 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,119 @@
+/**
+ * @file  Header template micro-benchmark
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+
+#include "alljoyn.h"
+#include "aj_util.h"
+#include "aj_bufio.h"
+
+#define ITERATIONS 500000
+
+static uint8_t txBuffer[1024];
+static uint8_t rxBuffer[1024];
+
+static const char* const sensorInterface[] = {
+    "org.alljoyn.hdrbench.sensor",
+    "!Reading >u >d",
+    NULL
+};
+
+static const AJ_InterfaceDescription sensorInterfaces[] = {
+    sensorInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/org/alljoyn/hdrbench/sensor", sensorInterfaces },
+    { NULL }
+};
+
+#define READING_SIGNAL AJ_APP_MESSAGE_ID(0, 0, 0)
+
+static AJ_BusAttachment bus;
+
+static uint32_t bytesSent = 0;
+
+static AJ_Status TxFunc(AJ_IOBuffer* buf)
+{
+    bytesSent += AJ_IO_BUF_AVAIL(buf);
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+static AJ_Status RxFunc(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    return AJ_ERR_READ;
+}
+
+static AJ_Status RunBench(uint8_t templates)
+{
+    AJ_Status status = AJ_OK;
+    AJ_Message msg;
+    AJ_Time timer;
+    uint32_t elapsed;
+    uint32_t n;
+    double reading = 21.5;
+
+    AJ_EnableHeaderTemplates(templates);
+    AJ_InitTimer(&timer);
+    for (n = 0; (n < ITERATIONS) && (status == AJ_OK); ++n) {
+        status = AJ_MarshalSignal(&bus, &msg, READING_SIGNAL, ":sink.2", 1234, 0, 2000);
+        if (status == AJ_OK) {
+            status = AJ_MarshalArgs(&msg, "ud", n, reading);
+        }
+        if (status == AJ_OK) {
+            status = AJ_DeliverMsg(&msg);
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, FALSE);
+    if (status == AJ_OK) {
+        printf("header templates %-8s %6u ns/signal\n", templates ? "enabled" : "disabled",
+               (uint32_t)((elapsed * 1000000ull) / ITERATIONS));
+    } else {
+        printf("Benchmark failed %d\n", status);
+    }
+    return status;
+}
+
+int AJ_Main()
+{
+    AJ_Status status;
+
+    AJ_IOBufInit(&bus.sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, NULL);
+    bus.sock.tx.send = TxFunc;
+    AJ_IOBufInit(&bus.sock.rx, rxBuffer, sizeof(rxBuffer), AJ_IO_BUF_RX, NULL);
+    bus.sock.rx.recv = RxFunc;
+    strcpy(bus.uniqueName, ":sensor.1");
+
+    AJ_RegisterObjects(AppObjects, NULL);
+
+    status = RunBench(FALSE);
+    if (status == AJ_OK) {
+        status = RunBench(TRUE);
+    }
+    return (status == AJ_OK) ? 0 : 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,122 @@
+/**
+ * @file  Message identification benchmark - object index versus linear search
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alljoyn.h"
+#include "aj_util.h"
+#include "aj_introspect.h"
+
+#define ITERATIONS 200000
+
+/*
+ * Object indices in a message id are 8 bits so this is the most objects a list can have
+ */
+#define MAX_OBJECTS 250
+
+static const char* const deviceInterface[] = {
+    "org.alljoyn.gateway.Device",
+    "!StateChanged >u >s",
+    "!Alarm >u",
+    NULL
+};
+
+static const char* const sensorInterface[] = {
+    "org.alljoyn.gateway.Sensor",
+    "!Reading >u >d",
+    "!Calibrated",
+    NULL
+};
+
+static const AJ_InterfaceDescription deviceInterfaces[] = {
+    deviceInterface,
+    sensorInterface,
+    NULL
+};
+
+static AJ_Object objects[MAX_OBJECTS + 1];
+static char paths[MAX_OBJECTS][48];
+
+static AJ_Status RunBench(uint32_t numObjects, uint8_t indexed)
+{
+    AJ_Status status = AJ_OK;
+    AJ_Message msg;
+    AJ_MsgHeader hdr;
+    AJ_Time timer;
+    uint32_t elapsed;
+    uint32_t n;
+
+    memset(objects, 0, sizeof(objects));
+    for (n = 0; n < numObjects; ++n) {
+        objects[n].path = paths[n];
+        objects[n].interfaces = deviceInterfaces;
+    }
+    AJ_EnableObjectIndex(indexed);
+    AJ_RegisterObjects(objects, NULL);
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msgType = AJ_MSG_SIGNAL;
+    AJ_InitTimer(&timer);
+    for (n = 0; (n < ITERATIONS) && (status == AJ_OK); ++n) {
+        uint32_t obj = (n * 7919) % numObjects;
+        memset(&msg, 0, sizeof(msg));
+        msg.hdr = &hdr;
+        msg.objPath = paths[obj];
+        msg.iface = "org.alljoyn.gateway.Sensor";
+        msg.member = "Reading";
+        msg.signature = "ud";
+        status = AJ_IdentifyMessage(&msg);
+        if ((status == AJ_OK) && (msg.msgId != AJ_APP_MESSAGE_ID(obj, 1, 0))) {
+            status = AJ_ERR_NO_MATCH;
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, FALSE);
+    if (status == AJ_OK) {
+        printf("%3u objects  %-7s %6u ns/msg\n", numObjects, indexed ? "index" : "linear", (uint32_t)((elapsed * 1000000ull) / ITERATIONS));
+    } else {
+        printf("Benchmark failed %d\n", status);
+    }
+    return status;
+}
+
+int AJ_Main()
+{
+    static const uint32_t counts[] = { 10, 100, MAX_OBJECTS };
+    AJ_Status status = AJ_OK;
+    size_t i;
+
+    for (i = 0; i < MAX_OBJECTS; ++i) {
+        sprintf(paths[i], "/org/alljoyn/gateway/devices/device%u", (unsigned)i);
+    }
+    for (i = 0; (i < ArraySize(counts)) && (status == AJ_OK); ++i) {
+        status = RunBench(counts[i], FALSE);
+        if (status == AJ_OK) {
+            status = RunBench(counts[i], TRUE);
+        }
+    }
+    return (status == AJ_OK) ? 0 : 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
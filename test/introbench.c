@@ -0,0 +1,142 @@
+/**
+ * @file  Introspection request benchmark
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+
+#include "alljoyn.h"
+#include "aj_introspect.h"
+#include "aj_std.h"
+
+#define REQUESTS 100000
+
+static const char* const benchInterface[] = {
+    "org.alljoyn.introbench",
+    "?Ping in<s out>s",
+    "?Sum in<ai out>i",
+    "?Lookup key<s index<u value>v",
+    "!Changed path<o >u",
+    "!Alarm >s >t",
+    "@Name=s",
+    "@Count>u",
+    "@Flags<i",
+    NULL
+};
+
+static const char* const auxInterface[] = {
+    "org.alljoyn.introbench.aux",
+    "?Reset",
+    "?Configure settings<a{sv}",
+    "!Event >(ssu)",
+    NULL
+};
+
+static const AJ_InterfaceDescription benchInterfaces[] = {
+    AJ_PropertiesIface,
+    benchInterface,
+    auxInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/org/alljoyn/introbench", benchInterfaces },
+    { "/org/alljoyn/introbench/a", benchInterfaces },
+    { "/org/alljoyn/introbench/b", benchInterfaces },
+    { NULL }
+};
+
+static uint8_t txBuffer[1024];
+static uint8_t cache[8192];
+static uint32_t txBytes;
+
+static AJ_BusAttachment bus;
+
+static AJ_Status TxFunc(AJ_IOBuffer* buf)
+{
+    txBytes += AJ_IO_BUF_AVAIL(buf);
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+static AJ_Status IntrospectBench(const char* path, const char* label)
+{
+    AJ_Status status = AJ_OK;
+    AJ_Message msg;
+    AJ_Message reply;
+    AJ_MsgHeader hdr;
+    AJ_Time timer;
+    uint32_t elapsed;
+    uint32_t i;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msgType = AJ_MSG_METHOD_CALL;
+    msg.hdr = &hdr;
+    msg.bus = &bus;
+    msg.msgId = AJ_METHOD_INTROSPECT;
+    msg.objPath = path;
+    msg.sender = ":1.1";
+    txBytes = 0;
+
+    AJ_InitTimer(&timer);
+    for (i = 0; (i < REQUESTS) && (status == AJ_OK); ++i) {
+        hdr.serialNum = i;
+        status = AJ_HandleIntrospectRequest(&msg, &reply);
+        if (status == AJ_OK) {
+            status = AJ_DeliverMsg(&reply);
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, FALSE);
+    if (status == AJ_OK) {
+        printf("introspect %-28s %-9s %5u bytes %6u ns/request\n", path, label, txBytes / REQUESTS,
+               (uint32_t)((elapsed * 1000000ull) / REQUESTS));
+    }
+    return status;
+}
+
+int AJ_Main()
+{
+    AJ_Status status;
+
+    AJ_IOBufInit(&bus.sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, NULL);
+    bus.sock.tx.send = TxFunc;
+    AJ_RegisterObjects(AppObjects, NULL);
+
+    status = IntrospectBench("/org/alljoyn/introbench", "generated");
+    if (status == AJ_OK) {
+        status = IntrospectBench("/org", "generated");
+    }
+    AJ_SetIntrospectionCache(cache, sizeof(cache));
+    if (status == AJ_OK) {
+        status = IntrospectBench("/org/alljoyn/introbench", "cached");
+    }
+    if (status == AJ_OK) {
+        status = IntrospectBench("/org", "cached");
+    }
+    if (status != AJ_OK) {
+        printf("Benchmark failed %d\n", status);
+    }
+    return (status == AJ_OK) ? 0 : 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,327 @@
+/**
+ * @file  Transport latency and throughput benchmark. Build with AJ_NET_EPOLL=0 to measure the
+ *        select() transport.
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include "alljoyn.h"
+#include "aj_util.h"
+#include "aj_bufio.h"
+#include "aj_net.h"
+
+#define ROUND_TRIPS  20000
+#define STREAM_MSGS  100000
+#define PAYLOAD      512
+
+static const char* const benchInterface[] = {
+    "org.alljoyn.netbench",
+    "!Ping >u",
+    "!Data >ay",
+    NULL
+};
+
+static const AJ_InterfaceDescription benchInterfaces[] = {
+    benchInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/org/alljoyn/netbench", benchInterfaces },
+    { NULL }
+};
+
+#define PING_SIGNAL AJ_APP_MESSAGE_ID(0, 0, 0)
+#define DATA_SIGNAL AJ_APP_MESSAGE_ID(0, 0, 1)
+
+static AJ_BusAttachment bus;
+static uint8_t payload[PAYLOAD];
+
+/*
+ * What the peer thread does with the data it receives
+ */
+#define PEER_ECHO    0
+#define PEER_DISCARD 1
+#define PEER_STREAM  2
+
+static int peerMode;
+static int peerSock;
+static size_t discardLen;
+static uint8_t stream[64 * 1024];
+static size_t streamLen;
+
+static void* PeerThread(void* arg)
+{
+    static uint8_t data[64 * 1024];
+    size_t total = 0;
+    ssize_t ret;
+
+    if (peerMode == PEER_STREAM) {
+        uint32_t sent = 0;
+        /*
+         * Stream is a whole number of messages
+         */
+        while (sent < STREAM_MSGS) {
+            size_t off = 0;
+            while (off < streamLen) {
+                ret = send(peerSock, stream + off, streamLen - off, MSG_NOSIGNAL);
+                if (ret <= 0) {
+                    return NULL;
+                }
+                off += ret;
+            }
+            sent += (uint32_t)(uintptr_t)arg;
+        }
+        return NULL;
+    }
+    while ((ret = recv(peerSock, data, sizeof(data), 0)) > 0) {
+        if (peerMode == PEER_ECHO) {
+            send(peerSock, data, ret, MSG_NOSIGNAL);
+        } else {
+            total += ret;
+            if (total >= discardLen) {
+                break;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void StartPeer(int mode, void* arg, pthread_t* thread)
+{
+    peerMode = mode;
+    pthread_create(thread, NULL, PeerThread, arg);
+}
+
+static AJ_Status Latency(void)
+{
+    AJ_Status status = AJ_OK;
+    pthread_t thread;
+    AJ_Message msg;
+    AJ_Time timer;
+    uint32_t elapsed;
+    uint32_t i;
+
+    StartPeer(PEER_ECHO, NULL, &thread);
+    AJ_InitTimer(&timer);
+    for (i = 0; (i < ROUND_TRIPS) && (status == AJ_OK); ++i) {
+        uint32_t u;
+        status = AJ_MarshalSignal(&bus, &msg, PING_SIGNAL, NULL, 0, 0, 0);
+        if (status == AJ_OK) {
+            status = AJ_MarshalArgs(&msg, "u", i);
+        }
+        if (status == AJ_OK) {
+            status = AJ_DeliverMsg(&msg);
+        }
+        if (status == AJ_OK) {
+            status = AJ_UnmarshalMsg(&bus, &msg, 1000);
+        }
+        if (status == AJ_OK) {
+            status = AJ_UnmarshalArgs(&msg, "u", &u);
+            if ((status == AJ_OK) && (u != i)) {
+                status = AJ_ERR_UNMARSHAL;
+            }
+            AJ_CloseMsg(&msg);
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, FALSE);
+    AJ_Net_Disconnect(&bus.sock);
+    pthread_join(thread, NULL);
+    if (status == AJ_OK) {
+        printf("round trip         %6u ns\n", (uint32_t)((elapsed * 1000000ull) / ROUND_TRIPS));
+    }
+    return status;
+}
+
+static AJ_Status SendThroughput(void)
+{
+    AJ_Status status = AJ_OK;
+    pthread_t thread;
+    AJ_Message msg;
+    AJ_Arg arg;
+    AJ_Time timer;
+    uint32_t elapsed;
+    uint32_t syscalls;
+    uint32_t i;
+
+    discardLen = (size_t)-1;
+    StartPeer(PEER_DISCARD, NULL, &thread);
+    AJ_InitTimer(&timer);
+    for (i = 0; (i < STREAM_MSGS) && (status == AJ_OK); ++i) {
+        status = AJ_MarshalSignal(&bus, &msg, DATA_SIGNAL, NULL, 0, 0, 0);
+        if (status == AJ_OK) {
+            status = AJ_MarshalArg(&msg, AJ_InitArg(&arg, AJ_ARG_BYTE, AJ_ARRAY_FLAG, payload, sizeof(payload)));
+        }
+        if (status == AJ_OK) {
+            status = AJ_DeliverMsg(&msg);
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, FALSE);
+    syscalls = bus.sock.tx.syscalls;
+    AJ_Net_Disconnect(&bus.sock);
+    pthread_join(thread, NULL);
+    if (status == AJ_OK) {
+        printf("send  %u byte body %6u msgs/s  %4u MB/s  %u syscalls\n", PAYLOAD,
+               elapsed ? (uint32_t)((STREAM_MSGS * 1000ull) / elapsed) : 0,
+               elapsed ? (uint32_t)((STREAM_MSGS * (uint64_t)PAYLOAD) / (elapsed * 1000ull)) : 0, syscalls);
+    }
+    return status;
+}
+
+static AJ_Status CaptureFunc(AJ_IOBuffer* buf)
+{
+    size_t tx = AJ_IO_BUF_AVAIL(buf);
+
+    if ((streamLen + tx) > sizeof(stream)) {
+        return AJ_ERR_WRITE;
+    }
+    memcpy(stream + streamLen, buf->bufStart, tx);
+    streamLen += tx;
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+static AJ_Status RecvThroughput(void)
+{
+    AJ_Status status = AJ_OK;
+    AJ_TxFunc send = bus.sock.tx.send;
+    AJ_TxVecFunc sendv = bus.sock.tx.sendv;
+    uint32_t perStream = 0;
+    pthread_t thread;
+    AJ_Message msg;
+    AJ_Arg arg;
+    AJ_Time timer;
+    uint32_t elapsed;
+    uint32_t syscalls;
+    uint32_t i;
+
+    /*
+     * Marshal a block of signals for the peer to send repeatedly
+     */
+    AJ_IO_BUF_RESET(&bus.sock.tx);
+    bus.sock.tx.send = CaptureFunc;
+    bus.sock.tx.sendv = NULL;
+    while ((status == AJ_OK) && (streamLen + PAYLOAD + 256 < sizeof(stream))) {
+        status = AJ_MarshalSignal(&bus, &msg, DATA_SIGNAL, NULL, 0, 0, 0);
+        if (status == AJ_OK) {
+            status = AJ_MarshalArg(&msg, AJ_InitArg(&arg, AJ_ARG_BYTE, AJ_ARRAY_FLAG, payload, sizeof(payload)));
+        }
+        if (status == AJ_OK) {
+            status = AJ_DeliverMsg(&msg);
+        }
+        ++perStream;
+    }
+    bus.sock.tx.send = send;
+    bus.sock.tx.sendv = sendv;
+    if (status != AJ_OK) {
+        return status;
+    }
+    StartPeer(PEER_STREAM, (void*)(uintptr_t)perStream, &thread);
+    bus.sock.rx.syscalls = 0;
+    AJ_InitTimer(&timer);
+    for (i = 0; (i < (STREAM_MSGS / perStream) * perStream) && (status == AJ_OK); ++i) {
+        status = AJ_UnmarshalMsg(&bus, &msg, 1000);
+        if (status == AJ_OK) {
+            status = AJ_UnmarshalArg(&msg, &arg);
+            AJ_CloseMsg(&msg);
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, FALSE);
+    syscalls = bus.sock.rx.syscalls;
+    AJ_Net_Disconnect(&bus.sock);
+    pthread_join(thread, NULL);
+    if (status == AJ_OK) {
+        printf("recv  %u byte body %6u msgs/s  %4u MB/s  %u syscalls\n", PAYLOAD,
+               elapsed ? (uint32_t)((i * 1000ull) / elapsed) : 0,
+               elapsed ? (uint32_t)((i * (uint64_t)PAYLOAD) / (elapsed * 1000ull)) : 0, syscalls);
+    }
+    return status;
+}
+
+static AJ_Status Connect(int listener, struct sockaddr_in* sa)
+{
+    AJ_Status status;
+    uint32_t addr = sa->sin_addr.s_addr;
+
+    status = AJ_Net_Connect(&bus.sock, ntohs(sa->sin_port), AJ_ADDR_IPV4, &addr);
+    if (status == AJ_OK) {
+        peerSock = accept(listener, NULL, NULL);
+    }
+    return status;
+}
+
+int AJ_Main()
+{
+    AJ_Status status;
+    struct sockaddr_in sa;
+    socklen_t saLen = sizeof(sa);
+    int listener;
+
+    AJ_RegisterObjects(AppObjects, NULL);
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((bind(listener, (struct sockaddr*)&sa, sizeof(sa)) != 0) || (listen(listener, 1) != 0) ||
+        (getsockname(listener, (struct sockaddr*)&sa, &saLen) != 0)) {
+        printf("Failed to create listener\n");
+        return 1;
+    }
+#if defined(AJ_NET_EPOLL) && !AJ_NET_EPOLL
+    printf("select transport\n");
+#else
+    printf("epoll transport\n");
+#endif
+    status = Connect(listener, &sa);
+    if (status == AJ_OK) {
+        status = Latency();
+        close(peerSock);
+    }
+    if (status == AJ_OK) {
+        status = Connect(listener, &sa);
+    }
+    if (status == AJ_OK) {
+        status = SendThroughput();
+        close(peerSock);
+    }
+    if (status == AJ_OK) {
+        status = Connect(listener, &sa);
+    }
+    if (status == AJ_OK) {
+        status = RecvThroughput();
+        close(peerSock);
+    }
+    if (status != AJ_OK) {
+        printf("Benchmark failed %d\n", status);
+    }
+    close(listener);
+    return (status == AJ_OK) ? 0 : 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
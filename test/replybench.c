@@ -0,0 +1,135 @@
+/**
+ * @file  Reply context benchmark
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+
+#include "alljoyn.h"
+#include "aj_introspect.h"
+
+/*
+ * Build with a larger AJ_NUM_REPLY_CONTEXTS (and AJ_REPLY_HASH_SIZE) to measure deep pipelines
+ */
+#define CALLS (1000 * 1000)
+
+/*
+ * The linear table that the reply contexts used to be
+ */
+typedef struct _LinearContext {
+    AJ_Time callTime;
+    uint32_t timeout;
+    uint32_t serial;
+} LinearContext;
+
+static LinearContext linear[AJ_NUM_REPLY_CONTEXTS];
+
+static LinearContext* LinearFind(uint32_t serial)
+{
+    size_t i;
+    for (i = 0; i < AJ_NUM_REPLY_CONTEXTS; ++i) {
+        if (linear[i].serial == serial) {
+            return &linear[i];
+        }
+    }
+    return NULL;
+}
+
+static uint8_t LinearTimedOut(void)
+{
+    size_t i;
+    for (i = 0; i < AJ_NUM_REPLY_CONTEXTS; ++i) {
+        if (linear[i].serial && (AJ_GetElapsedTime(&linear[i].callTime, TRUE) > linear[i].timeout)) {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static uint32_t LinearBench(void)
+{
+    AJ_Time timer;
+    uint32_t serial;
+
+    memset(linear, 0, sizeof(linear));
+    AJ_InitTimer(&timer);
+    for (serial = 1; serial <= CALLS; ++serial) {
+        LinearContext* ctx;
+        /*
+         * Retire the oldest call once the pipeline is full
+         */
+        if (serial > AJ_NUM_REPLY_CONTEXTS) {
+            LinearFind(serial - AJ_NUM_REPLY_CONTEXTS)->serial = 0;
+        }
+        ctx = LinearFind(0);
+        ctx->serial = serial;
+        ctx->timeout = 20000;
+        AJ_InitTimer(&ctx->callTime);
+        LinearTimedOut();
+    }
+    return AJ_GetElapsedTime(&timer, FALSE);
+}
+
+static uint32_t ContextBench(AJ_Status* status)
+{
+    AJ_Message msg;
+    AJ_Message timedOut;
+    AJ_MsgHeader hdr;
+    AJ_Time timer;
+    uint32_t serial;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msgType = AJ_MSG_METHOD_CALL;
+    msg.hdr = &hdr;
+    AJ_ReleaseReplyContexts(NULL);
+    AJ_InitTimer(&timer);
+    for (serial = 1; (serial <= CALLS) && (*status == AJ_OK); ++serial) {
+        if (serial > AJ_NUM_REPLY_CONTEXTS) {
+            hdr.serialNum = serial - AJ_NUM_REPLY_CONTEXTS;
+            AJ_ReleaseReplyContext(&msg);
+        }
+        hdr.serialNum = serial;
+        *status = AJ_AllocReplyContext(&msg, 20000);
+        if (AJ_TimedOutMethodCall(&timedOut)) {
+            *status = AJ_ERR_TIMEOUT;
+        }
+    }
+    return AJ_GetElapsedTime(&timer, FALSE);
+}
+
+int AJ_Main()
+{
+    AJ_Status status = AJ_OK;
+    uint32_t linearTime = LinearBench();
+    uint32_t contextTime = ContextBench(&status);
+
+    if (status == AJ_OK) {
+        printf("%u calls in flight   linear %5u ns/call   hashed %5u ns/call\n", AJ_NUM_REPLY_CONTEXTS,
+               (uint32_t)((linearTime * 1000000ull) / CALLS), (uint32_t)((contextTime * 1000000ull) / CALLS));
+    } else {
+        printf("Benchmark failed %d\n", status);
+    }
+    return (status == AJ_OK) ? 0 : 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,193 @@
+/**
+ * @file  Receive buffer benchmark - ring buffer versus linear buffer with rebase
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+
+#include "alljoyn.h"
+#include "aj_util.h"
+#include "aj_bufio.h"
+#include "aj_net.h"
+
+#define RX_SIZE        (16 * 1024)
+#define NUM_MESSAGES   400000
+#define STREAM_SIZE    (256 * 1024)
+
+static const char* const benchInterface[] = {
+    "org.alljoyn.ringbench",
+    "!Data >ay",
+    NULL
+};
+
+static const AJ_InterfaceDescription benchInterfaces[] = {
+    benchInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/org/alljoyn/ringbench", benchInterfaces },
+    { NULL }
+};
+
+static AJ_BusAttachment bus;
+
+static uint8_t txBuffer[4096];
+static uint8_t linearBuffer[RX_SIZE];
+
+/*
+ * A stream of back to back messages that the receive function hands out in a loop
+ */
+static uint8_t stream[STREAM_SIZE];
+static size_t streamLen = 0;
+static size_t streamPos = 0;
+
+static AJ_Status CaptureFunc(AJ_IOBuffer* buf)
+{
+    size_t tx = AJ_IO_BUF_AVAIL(buf);
+
+    if ((streamLen + tx) > sizeof(stream)) {
+        return AJ_ERR_WRITE;
+    }
+    memcpy(stream + streamLen, buf->bufStart, tx);
+    streamLen += tx;
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+/*
+ * Reads greedily into all the free space like AJ_Net_Recv()
+ */
+static AJ_Status StreamRecv(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    size_t space = AJ_IO_BUF_SPACE(buf);
+
+    while (space) {
+        size_t rx = min(space, streamLen - streamPos);
+        memcpy(buf->writePtr, stream + streamPos, rx);
+        buf->writePtr += rx;
+        space -= rx;
+        streamPos += rx;
+        if (streamPos == streamLen) {
+            streamPos = 0;
+        }
+    }
+    return AJ_OK;
+}
+
+static AJ_Status MakeStream(uint16_t bodyLen)
+{
+    AJ_Status status = AJ_OK;
+    AJ_Message msg;
+    AJ_Arg arg;
+    uint8_t payload[2048];
+    size_t msgLen = 0;
+
+    memset(payload, 0xA5, sizeof(payload));
+    streamLen = 0;
+    streamPos = 0;
+    AJ_IOBufInit(&bus.sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, NULL);
+    bus.sock.tx.send = CaptureFunc;
+    while (status == AJ_OK) {
+        if ((streamLen + msgLen) > sizeof(stream)) {
+            break;
+        }
+        status = AJ_MarshalSignal(&bus, &msg, AJ_APP_MESSAGE_ID(0, 0, 0), NULL, 0, 0, 0);
+        if (status == AJ_OK) {
+            status = AJ_MarshalArg(&msg, AJ_InitArg(&arg, AJ_ARG_BYTE, AJ_ARRAY_FLAG, payload, bodyLen));
+        }
+        if (status == AJ_OK) {
+            size_t before = streamLen;
+            status = AJ_DeliverMsg(&msg);
+            msgLen = streamLen - before;
+        }
+    }
+    return status;
+}
+
+static AJ_Status RunBench(uint16_t bodyLen, uint8_t* ring)
+{
+    AJ_Status status = AJ_OK;
+    AJ_IOBuffer* rx = &bus.sock.rx;
+    AJ_Message msg;
+    AJ_Time timer;
+    uint32_t elapsed;
+    uint32_t n;
+
+    if (ring) {
+        AJ_IOBufInitRing(rx, ring, RX_SIZE, AJ_IO_BUF_RX, NULL);
+    } else {
+        AJ_IOBufInit(rx, linearBuffer, sizeof(linearBuffer), AJ_IO_BUF_RX, NULL);
+    }
+    rx->recv = StreamRecv;
+    streamPos = 0;
+
+    AJ_InitTimer(&timer);
+    for (n = 0; (n < NUM_MESSAGES) && (status == AJ_OK); ++n) {
+        status = AJ_UnmarshalMsg(&bus, &msg, 0);
+        if (status == AJ_OK) {
+            AJ_Arg arg;
+            status = AJ_UnmarshalArg(&msg, &arg);
+            if ((status == AJ_OK) && (arg.len != bodyLen)) {
+                status = AJ_ERR_UNMARSHAL;
+            }
+            AJ_CloseMsg(&msg);
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, FALSE);
+    if (status == AJ_OK) {
+        printf("body %4u bytes  %-7s %6u ns/msg\n", bodyLen, ring ? "ring" : "rebase", (uint32_t)((elapsed * 1000000ull) / NUM_MESSAGES));
+    }
+    return status;
+}
+
+int AJ_Main()
+{
+    static const uint16_t sizes[] = { 8, 64, 256, 1024, 2000 };
+    AJ_Status status = AJ_OK;
+    uint8_t* ring;
+    size_t i;
+
+    ring = AJ_Net_MapRing(RX_SIZE);
+    if (!ring) {
+        printf("Failed to map ring\n");
+        return 1;
+    }
+    AJ_RegisterObjects(AppObjects, NULL);
+
+    for (i = 0; (i < ArraySize(sizes)) && (status == AJ_OK); ++i) {
+        status = MakeStream(sizes[i]);
+        if (status == AJ_OK) {
+            status = RunBench(sizes[i], NULL);
+        }
+        if (status == AJ_OK) {
+            status = RunBench(sizes[i], ring);
+        }
+    }
+    if (status != AJ_OK) {
+        printf("Benchmark failed %d\n", status);
+    }
+    AJ_Net_UnmapRing(ring, RX_SIZE);
+    return (status == AJ_OK) ? 0 : 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
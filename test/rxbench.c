@@ -0,0 +1,217 @@
+/**
+ * @file  Receive path benchmark - counts system calls per message for a burst of signals
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include "alljoyn.h"
+#include "aj_util.h"
+#include "aj_bufio.h"
+#include "aj_net.h"
+
+#define BURST      64
+#define NUM_BURSTS 2000
+
+static const char* const sensorInterface[] = {
+    "org.alljoyn.rxbench.sensor",
+    "!Reading >u >d",
+    NULL
+};
+
+static const AJ_InterfaceDescription sensorInterfaces[] = {
+    sensorInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/org/alljoyn/rxbench/sensor", sensorInterfaces },
+    { NULL }
+};
+
+#define READING_SIGNAL AJ_APP_MESSAGE_ID(0, 0, 0)
+
+static AJ_BusAttachment bus;
+
+/*
+ * A burst of marshaled signals
+ */
+static uint8_t burst[BURST * 256];
+static size_t burstLen = 0;
+
+static uint8_t txBuffer[256];
+
+static AJ_Status CaptureFunc(AJ_IOBuffer* buf)
+{
+    size_t tx = AJ_IO_BUF_AVAIL(buf);
+
+    if ((burstLen + tx) > sizeof(burst)) {
+        return AJ_ERR_WRITE;
+    }
+    memcpy(burst + burstLen, buf->bufStart, tx);
+    burstLen += tx;
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+/*
+ * The receive function as it was before read-ahead: a select() and a recv() for exactly the
+ * number of bytes the unmarshaler asked for.
+ */
+static AJ_Status ExactRecv(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    size_t rx = min(AJ_IO_BUF_SPACE(buf), len);
+    struct timeval tv = { timeout / 1000, 1000 * (timeout % 1000) };
+    fd_set fds;
+    ssize_t ret;
+
+    FD_ZERO(&fds);
+    FD_SET((int)buf->context, &fds);
+    ++buf->syscalls;
+    if (select((int)buf->context + 1, &fds, NULL, NULL, &tv) == 0) {
+        return AJ_ERR_TIMEOUT;
+    }
+    ret = recv((int)buf->context, buf->writePtr, rx, 0);
+    ++buf->syscalls;
+    if (ret <= 0) {
+        return AJ_ERR_READ;
+    }
+    buf->writePtr += ret;
+    return AJ_OK;
+}
+
+static AJ_Status MakeBurst(void)
+{
+    AJ_Status status = AJ_OK;
+    AJ_Message msg;
+    uint32_t n;
+
+    AJ_IOBufInit(&bus.sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, NULL);
+    bus.sock.tx.send = CaptureFunc;
+    for (n = 0; (n < BURST) && (status == AJ_OK); ++n) {
+        status = AJ_MarshalSignal(&bus, &msg, READING_SIGNAL, NULL, 0, 0, 0);
+        if (status == AJ_OK) {
+            status = AJ_MarshalArgs(&msg, "ud", n, 21.5);
+        }
+        if (status == AJ_OK) {
+            status = AJ_DeliverMsg(&msg);
+        }
+    }
+    return status;
+}
+
+static AJ_Status RunBench(int peer, AJ_RxFunc recvFunc, const char* name)
+{
+    AJ_Status status = AJ_OK;
+    AJ_IOBuffer* rx = &bus.sock.rx;
+    AJ_Message msg;
+    AJ_Time timer;
+    uint32_t elapsed;
+    uint32_t n;
+
+    rx->recv = recvFunc;
+    rx->syscalls = 0;
+    rx->messages = 0;
+    AJ_InitTimer(&timer);
+    for (n = 0; (n < NUM_BURSTS) && (status == AJ_OK); ++n) {
+        uint32_t i;
+        if (send(peer, burst, burstLen, 0) != (ssize_t)burstLen) {
+            status = AJ_ERR_WRITE;
+            break;
+        }
+        for (i = 0; (i < BURST) && (status == AJ_OK); ++i) {
+            uint32_t u;
+            double d;
+            status = AJ_UnmarshalMsg(&bus, &msg, 1000);
+            if (status == AJ_OK) {
+                status = AJ_UnmarshalArgs(&msg, "ud", &u, &d);
+                if ((status == AJ_OK) && (u != i)) {
+                    status = AJ_ERR_UNMARSHAL;
+                }
+                AJ_CloseMsg(&msg);
+            }
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, FALSE);
+    if (status == AJ_OK) {
+        printf("%-12s %u messages %6u syscalls  %5u.%02u syscalls/msg  %6u ns/msg\n", name, rx->messages, rx->syscalls,
+               rx->syscalls / rx->messages, ((rx->syscalls * 100) / rx->messages) % 100,
+               (uint32_t)((elapsed * 1000000ull) / rx->messages));
+    } else {
+        printf("Benchmark failed %d\n", status);
+    }
+    return status;
+}
+
+int AJ_Main()
+{
+    AJ_Status status;
+    struct sockaddr_in sa;
+    socklen_t saLen = sizeof(sa);
+    uint32_t addr;
+    int listener;
+    int peer;
+
+    AJ_RegisterObjects(AppObjects, NULL);
+    status = MakeBurst();
+    if (status != AJ_OK) {
+        printf("Failed to marshal signals %d\n", status);
+        return 1;
+    }
+    /*
+     * Loopback connection - the benchmark writes bursts of signals on the accepted end and the bus
+     * attachment reads them through the normal transport.
+     */
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((bind(listener, (struct sockaddr*)&sa, sizeof(sa)) != 0) || (listen(listener, 1) != 0) ||
+        (getsockname(listener, (struct sockaddr*)&sa, &saLen) != 0)) {
+        printf("Failed to create listener\n");
+        return 1;
+    }
+    addr = sa.sin_addr.s_addr;
+    status = AJ_Net_Connect(&bus.sock, ntohs(sa.sin_port), AJ_ADDR_IPV4, &addr);
+    if (status != AJ_OK) {
+        printf("Failed to connect %d\n", status);
+        return 1;
+    }
+    peer = accept(listener, NULL, NULL);
+
+    status = RunBench(peer, ExactRecv, "exact read");
+    if (status == AJ_OK) {
+        status = RunBench(peer, AJ_Net_Recv, "AJ_Net_Recv");
+    }
+    AJ_Net_Disconnect(&bus.sock);
+    close(peer);
+    close(listener);
+    return (status == AJ_OK) ? 0 : 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
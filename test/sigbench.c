@@ -0,0 +1,181 @@
+/**
+ * @file  Signature plan micro-benchmark
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+
+#include "alljoyn.h"
+#include "aj_util.h"
+#include "aj_debug.h"
+#include "aj_bufio.h"
+
+#define ITERATIONS 200000
+
+static uint8_t txBuffer[1024];
+static uint8_t rxBuffer[1024];
+
+/*
+ * A single marshaled message that is fed to the unmarshaler over and over
+ */
+static uint8_t frame[1024];
+static size_t frameLen = 0;
+
+static const char* const benchInterface[] = {
+    "org.alljoyn.sigbench",
+    "!Data >u >i >s >q >y >t >s >b",
+    NULL
+};
+
+static const AJ_InterfaceDescription benchInterfaces[] = {
+    benchInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/org/alljoyn/sigbench", benchInterfaces },
+    { NULL }
+};
+
+#define DATA_SIGNAL AJ_APP_MESSAGE_ID(0, 0, 0)
+
+static AJ_BusAttachment bus;
+
+static AJ_Status TxFunc(AJ_IOBuffer* buf)
+{
+    size_t tx = AJ_IO_BUF_AVAIL(buf);
+
+    if (tx > sizeof(frame)) {
+        return AJ_ERR_WRITE;
+    }
+    memcpy(frame, buf->bufStart, tx);
+    frameLen = tx;
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+static AJ_Status RxFunc(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    /*
+     * The frame is always loaded before unmarshaling so there is never anything more to read
+     */
+    return AJ_ERR_READ;
+}
+
+static AJ_Status MarshalData(AJ_Message* msg)
+{
+    AJ_Status status = AJ_MarshalSignal(&bus, msg, DATA_SIGNAL, NULL, 0, 0, 0);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(msg, "uisqytsb", 0x12345678, -1, "sigbench", 0x1234, 0x12, (uint64_t)0x123456789ABCDEF0ull, "a slightly longer string argument", TRUE);
+    }
+    return status;
+}
+
+static AJ_Status UnmarshalData(AJ_Message* msg)
+{
+    uint32_t u;
+    int32_t i;
+    const char* s1;
+    const char* s2;
+    uint16_t q;
+    uint8_t y;
+    uint64_t t;
+    uint32_t b;
+    AJ_IOBuffer* rx = &bus.sock.rx;
+    AJ_Status status;
+
+    AJ_IO_BUF_RESET(rx);
+    memcpy(rx->writePtr, frame, frameLen);
+    rx->writePtr += frameLen;
+
+    status = AJ_UnmarshalMsg(&bus, msg, 0);
+    if (status == AJ_OK) {
+        status = AJ_UnmarshalArgs(msg, "uisqytsb", &u, &i, &s1, &q, &y, &t, &s2, &b);
+        if ((status == AJ_OK) && ((u != 0x12345678) || (t != 0x123456789ABCDEF0ull) || strcmp(s1, "sigbench"))) {
+            status = AJ_ERR_UNMARSHAL;
+        }
+        AJ_CloseMsg(msg);
+    }
+    return status;
+}
+
+static AJ_Status RunBench(uint8_t plans)
+{
+    AJ_Status status = AJ_OK;
+    AJ_Message msg;
+    AJ_Time timer;
+    uint32_t marshalTime;
+    uint32_t unmarshalTime;
+    uint32_t n;
+
+    AJ_EnableSignaturePlans(plans);
+    /*
+     * Marshal only - the message is never delivered
+     */
+    AJ_InitTimer(&timer);
+    for (n = 0; (n < ITERATIONS) && (status == AJ_OK); ++n) {
+        status = MarshalData(&msg);
+    }
+    marshalTime = AJ_GetElapsedTime(&timer, FALSE);
+    /*
+     * Deliver one message to capture a frame to unmarshal
+     */
+    if (status == AJ_OK) {
+        status = MarshalData(&msg);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    AJ_InitTimer(&timer);
+    for (n = 0; (n < ITERATIONS) && (status == AJ_OK); ++n) {
+        status = UnmarshalData(&msg);
+    }
+    unmarshalTime = AJ_GetElapsedTime(&timer, FALSE);
+
+    if (status == AJ_OK) {
+        printf("signature plans %-8s marshal %6u ns/msg   unmarshal %6u ns/msg\n", plans ? "enabled" : "disabled",
+               (uint32_t)((marshalTime * 1000000ull) / ITERATIONS), (uint32_t)((unmarshalTime * 1000000ull) / ITERATIONS));
+    } else {
+        printf("Benchmark failed %d\n", status);
+    }
+    return status;
+}
+
+int AJ_Main()
+{
+    AJ_Status status;
+
+    AJ_IOBufInit(&bus.sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, NULL);
+    bus.sock.tx.send = TxFunc;
+    AJ_IOBufInit(&bus.sock.rx, rxBuffer, sizeof(rxBuffer), AJ_IO_BUF_RX, NULL);
+    bus.sock.rx.recv = RxFunc;
+
+    AJ_RegisterObjects(AppObjects, NULL);
+
+    status = RunBench(FALSE);
+    if (status == AJ_OK) {
+        status = RunBench(TRUE);
+    }
+    return (status == AJ_OK) ? 0 : 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
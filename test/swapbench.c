@@ -0,0 +1,276 @@
+/**
+ * @file  Endian swap and scalar array unmarshal benchmark
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+
+#include "alljoyn.h"
+#include "aj_util.h"
+#include "aj_bufio.h"
+
+/*
+ * Number of bytes swapped for each kernel measurement
+ */
+#define KERNEL_BYTES (256 * 1024 * 1024)
+
+/*
+ * Number of elements unmarshaled for each unmarshal measurement
+ */
+#define UNMARSHAL_ELEMENTS (64 * 1024 * 1024)
+
+#define MAX_ELEMENTS (64 * 1024)
+
+static uint64_t elements[MAX_ELEMENTS];
+
+/*
+ * I/O buffers are limited to 64K so the unmarshal benchmark uses arrays up to 32K bytes
+ */
+static uint8_t txBuffer[0xFF00];
+static uint8_t rxBuffer[0xFF00];
+static uint8_t frame[0xFF00];
+static size_t frameLen = 0;
+
+static const char* const benchInterface[] = {
+    "org.alljoyn.swapbench",
+    "!Q >aq",
+    "!U >au",
+    "!T >at",
+    NULL
+};
+
+static const AJ_InterfaceDescription benchInterfaces[] = {
+    benchInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/org/alljoyn/swapbench", benchInterfaces },
+    { NULL }
+};
+
+static AJ_BusAttachment bus;
+
+static AJ_Status TxFunc(AJ_IOBuffer* buf)
+{
+    frameLen = AJ_IO_BUF_AVAIL(buf);
+    memcpy(frame, buf->bufStart, frameLen);
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+static AJ_Status RxFunc(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    return AJ_ERR_READ;
+}
+
+/*
+ * Element at a time swap - this is what the unmarshaler did before the bulk swap
+ */
+static void ScalarSwap(void* data, uint8_t size, uint32_t num)
+{
+    uint8_t* p = (uint8_t*)data;
+    while (num--) {
+        uint8_t i;
+        for (i = 0; i < size / 2; ++i) {
+            uint8_t b = p[i];
+            p[i] = p[size - 1 - i];
+            p[size - 1 - i] = b;
+        }
+        p += size;
+    }
+}
+
+static void KernelBench(uint8_t size, uint32_t num)
+{
+    uint32_t reps = KERNEL_BYTES / (size * num);
+    uint32_t bulkTime;
+    uint32_t scalarTime;
+    AJ_Time timer;
+    uint32_t i;
+
+    AJ_InitTimer(&timer);
+    for (i = 0; i < reps; ++i) {
+        AJ_SwapBytes(elements, size, num);
+    }
+    bulkTime = AJ_GetElapsedTime(&timer, FALSE);
+    AJ_InitTimer(&timer);
+    for (i = 0; i < reps; ++i) {
+        ScalarSwap(elements, size, num);
+    }
+    scalarTime = AJ_GetElapsedTime(&timer, FALSE);
+    printf("swap %u byte x %5u   bulk %6u MB/s   scalar %6u MB/s\n", size, num,
+           bulkTime ? (uint32_t)((KERNEL_BYTES / 1000ull) / bulkTime) : 0,
+           scalarTime ? (uint32_t)((KERNEL_BYTES / 1000ull) / scalarTime) : 0);
+}
+
+#define SWAP32(p) ScalarSwap(p, 4, 1)
+
+/*
+ * Convert a marshaled message with signature "a<scalar>" from host byte order to the other byte order.
+ */
+static void MakeForeign(uint8_t* msg, uint8_t size)
+{
+    uint32_t hdrLen;
+    uint32_t bodyLen;
+    uint32_t pos;
+    uint32_t end;
+
+    msg[0] = (msg[0] == AJ_LITTLE_ENDIAN) ? AJ_BIG_ENDIAN : AJ_LITTLE_ENDIAN;
+    memcpy(&bodyLen, msg + 4, 4);
+    memcpy(&hdrLen, msg + 12, 4);
+    SWAP32(msg + 4);
+    SWAP32(msg + 8);
+    SWAP32(msg + 12);
+    /*
+     * Header fields
+     */
+    pos = 16;
+    end = 16 + hdrLen;
+    while (pos < end) {
+        uint8_t typeId;
+        uint32_t len;
+
+        pos = (pos + 7) & ~7;
+        typeId = msg[pos + 2];
+        pos += 4;
+        switch (typeId) {
+        case AJ_ARG_STRING:
+        case AJ_ARG_OBJ_PATH:
+            pos = (pos + 3) & ~3;
+            memcpy(&len, msg + pos, 4);
+            SWAP32(msg + pos);
+            pos += 4 + len + 1;
+            break;
+
+        case AJ_ARG_SIGNATURE:
+            pos += 1 + msg[pos] + 1;
+            break;
+
+        case AJ_ARG_UINT32:
+            pos = (pos + 3) & ~3;
+            SWAP32(msg + pos);
+            pos += 4;
+            break;
+        }
+    }
+    /*
+     * Body is the array length followed by the elements
+     */
+    pos = (end + 7) & ~7;
+    SWAP32(msg + pos);
+    pos += 4;
+    pos = (pos + size - 1) & ~(size - 1);
+    ScalarSwap(msg + pos, size, (bodyLen - (pos - ((end + 7) & ~7))) / size);
+}
+
+static AJ_Status UnmarshalBench(uint8_t typeId, uint8_t size, uint32_t num, uint8_t foreign)
+{
+    AJ_Status status;
+    AJ_Message msg;
+    AJ_Arg arg;
+    AJ_Time timer;
+    uint32_t reps = UNMARSHAL_ELEMENTS / num;
+    uint32_t member = (typeId == AJ_ARG_UINT16) ? 0 : ((typeId == AJ_ARG_UINT32) ? 1 : 2);
+    uint32_t elapsed;
+    uint32_t i;
+
+    status = AJ_MarshalSignal(&bus, &msg, AJ_APP_MESSAGE_ID(0, 0, member), NULL, 0, 0, 0);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArg(&msg, AJ_InitArg(&arg, typeId, AJ_ARRAY_FLAG, elements, size * num));
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    if (status != AJ_OK) {
+        return status;
+    }
+    if (foreign) {
+        MakeForeign(frame, size);
+    }
+    AJ_InitTimer(&timer);
+    for (i = 0; (i < reps) && (status == AJ_OK); ++i) {
+        AJ_IOBuffer* rx = &bus.sock.rx;
+        const void* data;
+        size_t count;
+
+        AJ_IO_BUF_RESET(rx);
+        memcpy(rx->writePtr, frame, frameLen);
+        rx->writePtr += frameLen;
+
+        status = AJ_UnmarshalMsg(&bus, &msg, 0);
+        if (status == AJ_OK) {
+            status = AJ_UnmarshalScalarArray(&msg, typeId, &data, &count);
+            if ((status == AJ_OK) && ((count != num) || memcmp(data, elements, size * num))) {
+                status = AJ_ERR_UNMARSHAL;
+            }
+            AJ_CloseMsg(&msg);
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, FALSE);
+    if (status == AJ_OK) {
+        printf("unmarshal a%c x %5u %-14s %6u ns/array\n", typeId, num, foreign ? "(byte swapped)" : "(host order)",
+               (uint32_t)((elapsed * 1000000ull) / reps));
+    }
+    return status;
+}
+
+int AJ_Main()
+{
+    AJ_Status status = AJ_OK;
+    uint32_t num;
+    size_t i;
+
+    for (i = 0; i < sizeof(elements); ++i) {
+        ((uint8_t*)elements)[i] = (uint8_t)(i * 13);
+    }
+    for (num = 1024; num <= MAX_ELEMENTS; num *= 4) {
+        KernelBench(2, num);
+        KernelBench(4, num);
+        KernelBench(8, num);
+    }
+
+    AJ_IOBufInit(&bus.sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, NULL);
+    bus.sock.tx.send = TxFunc;
+    AJ_IOBufInit(&bus.sock.rx, rxBuffer, sizeof(rxBuffer), AJ_IO_BUF_RX, NULL);
+    bus.sock.rx.recv = RxFunc;
+    AJ_RegisterObjects(AppObjects, NULL);
+
+    for (num = 1024; (num <= 4096) && (status == AJ_OK); num *= 2) {
+        uint8_t foreign;
+        for (foreign = 0; (foreign < 2) && (status == AJ_OK); ++foreign) {
+            status = UnmarshalBench(AJ_ARG_UINT16, 2, num * 4, foreign);
+            if (status == AJ_OK) {
+                status = UnmarshalBench(AJ_ARG_UINT32, 4, num * 2, foreign);
+            }
+            if (status == AJ_OK) {
+                status = UnmarshalBench(AJ_ARG_UINT64, 8, num, foreign);
+            }
+        }
+    }
+    if (status != AJ_OK) {
+        printf("Benchmark failed %d\n", status);
+    }
+    return (status == AJ_OK) ? 0 : 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
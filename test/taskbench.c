@@ -0,0 +1,161 @@
+/**
+ * @file  Benchmark for the yield-linux task scheduler. Measures the cost of switching between tasks
+ *        that yield to each other, and the round trip time of tasks woken by socket readiness
+ *        compared to waiting for readiness on a helper thread as the scheduler used to.
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include "alljoyn.h"
+
+#define SWITCHES    1000000
+#define ROUND_TRIPS 100000
+#define PAIRS       4
+
+static uint64_t Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void RunTasks(void)
+{
+    while (AJ_Loop()) {
+    }
+}
+
+static void YieldTask(void* context)
+{
+    uint32_t i;
+
+    for (i = 0; i < SWITCHES / 2; ++i) {
+        AJ_YieldUntil(AJWAITEVENT_ALWAYSSET);
+    }
+}
+
+/*
+ * The first task of a pair sends a byte and waits for it to come back, the second echoes it
+ */
+typedef struct {
+    int fd;
+    uint8_t first;
+    uint32_t count;
+    uint8_t threaded;
+} Peer;
+
+static Peer peers[PAIRS * 2];
+
+static void* ReadyThread(void* arg)
+{
+    struct pollfd pfd;
+
+    pfd.fd = ((Peer*)arg)->fd;
+    pfd.events = POLLIN;
+    poll(&pfd, 1, -1);
+    AJ_Schedule(AJWAITEVENT_READ);
+    return NULL;
+}
+
+static void WaitReadable(Peer* peer)
+{
+    if (peer->threaded) {
+        pthread_t thread;
+        pthread_create(&thread, NULL, ReadyThread, peer);
+        AJ_YieldUntil(AJWAITEVENT_READ);
+        pthread_join(thread, NULL);
+        AJ_ClearEvents(AJWAITEVENT_READ);
+    } else {
+        AJ_WaitFd(peer->fd, AJWAITEVENT_READ, (uint32_t)-1);
+    }
+}
+
+static void PingTask(void* context)
+{
+    Peer* peer = (Peer*)context;
+    uint8_t byte = 0;
+    uint32_t i;
+
+    for (i = 0; i < peer->count; ++i) {
+        if (peer->first) {
+            send(peer->fd, &byte, 1, 0);
+        }
+        while (recv(peer->fd, &byte, 1, MSG_DONTWAIT) != 1) {
+            WaitReadable(peer);
+        }
+        if (!peer->first) {
+            send(peer->fd, &byte, 1, 0);
+        }
+    }
+}
+
+static void PingPong(const char* name, uint32_t pairs, uint8_t threaded)
+{
+    uint32_t count = ROUND_TRIPS / pairs;
+    uint64_t start;
+    uint32_t i;
+
+    if (threaded) {
+        count /= 10;
+    }
+    for (i = 0; i < pairs; ++i) {
+        int fds[2];
+        socketpair(AF_UNIX, SOCK_STREAM, 0, fds);
+        peers[2 * i].fd = fds[0];
+        peers[2 * i].first = TRUE;
+        peers[2 * i + 1].fd = fds[1];
+        peers[2 * i + 1].first = FALSE;
+        peers[2 * i].count = peers[2 * i + 1].count = count;
+        peers[2 * i].threaded = peers[2 * i + 1].threaded = threaded;
+        AJ_StartTask(PingTask, &peers[2 * i]);
+        AJ_StartTask(PingTask, &peers[2 * i + 1]);
+    }
+    start = Now();
+    RunTasks();
+    printf("%-28s %u pairs  %6u ns per round trip\n", name, pairs, (uint32_t)((Now() - start) / (count * pairs)));
+    for (i = 0; i < 2 * pairs; ++i) {
+        close(peers[i].fd);
+    }
+}
+
+int AJ_Main()
+{
+    uint64_t start;
+
+    AJ_StartTask(YieldTask, NULL);
+    AJ_StartTask(YieldTask, NULL);
+    start = Now();
+    RunTasks();
+    printf("%-28s %6u ns per switch\n", "yield between 2 tasks", (uint32_t)((Now() - start) / SWITCHES));
+
+    PingPong("socket wake, helper thread", 1, TRUE);
+    PingPong("socket wake, epoll", 1, FALSE);
+    PingPong("socket wake, epoll", PAIRS, FALSE);
+    return 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
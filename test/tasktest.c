@@ -0,0 +1,97 @@
+/**
+ * @file  Tests for the yield-linux task scheduler
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include "alljoyn.h"
+
+#define SLEEP_TIME 50
+
+static uint32_t failures;
+
+static void RunTasks(void)
+{
+    while (AJ_Loop()) {
+    }
+}
+
+/*
+ * Sleeps as soon as the task starts, before it has ever yielded
+ */
+static void SleepTask(void* context)
+{
+    AJ_Time timer;
+    uint32_t elapsed;
+
+    AJ_InitTimer(&timer);
+    AJ_Sleep(SLEEP_TIME);
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    if (elapsed < SLEEP_TIME) {
+        AJ_Printf("AJ_Sleep(%u) in a new task returned after %u ms\n", SLEEP_TIME, elapsed);
+        ++failures;
+    }
+}
+
+/*
+ * Waits on a descriptor that never becomes ready as soon as the task starts
+ */
+static void WaitFdTask(void* context)
+{
+    int* fds = (int*)context;
+    AJ_Time timer;
+    uint32_t elapsed;
+    AJ_Status status;
+
+    AJ_InitTimer(&timer);
+    status = AJ_WaitFd(fds[0], AJWAITEVENT_READ, SLEEP_TIME);
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    if ((status != AJ_ERR_TIMEOUT) || (elapsed < SLEEP_TIME)) {
+        AJ_Printf("AJ_WaitFd() in a new task returned %d after %u ms\n", status, elapsed);
+        ++failures;
+    }
+}
+
+int AJ_Main()
+{
+    int fds[2];
+
+    AJ_StartTask(SleepTask, NULL);
+    RunTasks();
+
+    if (pipe(fds) != 0) {
+        AJ_Printf("pipe() failed\n");
+        return 1;
+    }
+    AJ_StartTask(WaitFdTask, fds);
+    RunTasks();
+    close(fds[0]);
+    close(fds[1]);
+
+    if (failures) {
+        AJ_Printf("Task scheduler test FAILED\n");
+        return 1;
+    }
+    AJ_Printf("Task scheduler test PASSED\n");
+    return 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,238 @@
+/**
+ * @file  Scaling benchmark for bus attachments running on separate threads. Each thread calls a
+ *        method on its own bus attachment over a loopback buffer, exercising the per thread object
+ *        index, reply contexts, dispatch and timer state.
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <pthread.h>
+
+#include "alljoyn.h"
+#include "aj_bufio.h"
+#include "aj_helper.h"
+#include "aj_init.h"
+
+#define MAX_THREADS  8
+#define CALLS        200000
+
+static const char* const benchInterface[] = {
+    "org.alljoyn.threadbench",
+    "?Add a<u b<u sum>u",
+    NULL
+};
+
+static const AJ_InterfaceDescription benchInterfaces[] = {
+    benchInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/org/alljoyn/threadbench", benchInterfaces },
+    { NULL }
+};
+
+#define ADD_CALL    AJ_PRX_MESSAGE_ID(0, 0, 0)
+#define ADD_METHOD  AJ_APP_MESSAGE_ID(0, 0, 0)
+
+/*
+ * Per thread loopback, everything sent on the bus is received back on the same bus
+ */
+typedef struct {
+    AJ_BusAttachment bus;
+    uint8_t txBuffer[512];
+    uint8_t rxBuffer[512];
+    uint8_t wire[2048];
+    uint32_t wireLen;
+    uint32_t wirePos;
+    uint32_t calls;
+    uint32_t elapsed;
+    AJ_Status status;
+} Worker;
+
+static AJ_Status LoopSend(AJ_IOBuffer* buf)
+{
+    Worker* w = (Worker*)buf->context;
+    uint32_t tx = AJ_IO_BUF_AVAIL(buf);
+
+    if (w->wirePos == w->wireLen) {
+        w->wirePos = w->wireLen = 0;
+    }
+    if ((w->wireLen + tx) > sizeof(w->wire)) {
+        return AJ_ERR_WRITE;
+    }
+    memcpy(w->wire + w->wireLen, buf->readPtr, tx);
+    w->wireLen += tx;
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+static AJ_Status LoopRecv(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    Worker* w = (Worker*)buf->context;
+    uint32_t rx = min(AJ_IO_BUF_SPACE(buf), w->wireLen - w->wirePos);
+
+    if (!rx) {
+        return AJ_ERR_TIMEOUT;
+    }
+    memcpy(buf->writePtr, w->wire + w->wirePos, rx);
+    buf->writePtr += rx;
+    w->wirePos += rx;
+    return AJ_OK;
+}
+
+static void Tick(void* context)
+{
+}
+
+static AJ_Status Call(Worker* w, uint32_t a, uint32_t b)
+{
+    AJ_Status status;
+    AJ_Message msg;
+    AJ_Message reply;
+    uint32_t sum = 0;
+
+    status = AJ_MarshalMethodCall(&w->bus, &msg, ADD_CALL, ":1.1", 0, 0, 1000);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&msg, "uu", a, b);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    /*
+     * Receive the call and reply to it
+     */
+    if (status == AJ_OK) {
+        status = AJ_UnmarshalMsg(&w->bus, &msg, 0);
+    }
+    if (status == AJ_OK) {
+        if (msg.msgId != ADD_METHOD) {
+            status = AJ_ERR_NO_MATCH;
+        }
+        if (status == AJ_OK) {
+            status = AJ_UnmarshalArgs(&msg, "uu", &a, &b);
+        }
+        if (status == AJ_OK) {
+            status = AJ_MarshalReplyMsg(&msg, &reply);
+        }
+        if (status == AJ_OK) {
+            status = AJ_MarshalArgs(&reply, "u", a + b);
+        }
+        if (status == AJ_OK) {
+            status = AJ_DeliverMsg(&reply);
+        }
+        AJ_CloseMsg(&msg);
+    }
+    /*
+     * Receive the reply, this is matched against the caller's reply context
+     */
+    if (status == AJ_OK) {
+        status = AJ_UnmarshalMsg(&w->bus, &msg, 0);
+    }
+    if (status == AJ_OK) {
+        if (msg.msgId != AJ_REPLY_ID(ADD_CALL)) {
+            status = AJ_ERR_NO_MATCH;
+        }
+        if (status == AJ_OK) {
+            status = AJ_UnmarshalArgs(&msg, "u", &sum);
+        }
+        if ((status == AJ_OK) && (sum != a + b)) {
+            status = AJ_ERR_UNMARSHAL;
+        }
+        AJ_CloseMsg(&msg);
+    }
+    return status;
+}
+
+static void* WorkerThread(void* arg)
+{
+    Worker* w = (Worker*)arg;
+    AJ_Status status = AJ_OK;
+    AJ_Time timer;
+    uint32_t i;
+
+    AJ_RegisterObjects(AppObjects, AppObjects);
+    AJ_IOBufInit(&w->bus.sock.tx, w->txBuffer, sizeof(w->txBuffer), AJ_IO_BUF_TX, w);
+    AJ_IOBufInit(&w->bus.sock.rx, w->rxBuffer, sizeof(w->rxBuffer), AJ_IO_BUF_RX, w);
+    w->bus.sock.tx.send = LoopSend;
+    w->bus.sock.rx.recv = LoopRecv;
+    strcpy(w->bus.uniqueName, ":1.1");
+
+    AJ_InitTimer(&timer);
+    for (i = 0; (i < w->calls) && (status == AJ_OK); ++i) {
+        uint32_t id = AJ_SetTimer(1000, Tick, NULL, 0);
+        status = Call(w, i, (uint32_t)(uintptr_t)w);
+        AJ_CancelTimer(id);
+    }
+    w->elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    w->status = status;
+    AJ_RegisterObjects(NULL, NULL);
+    return NULL;
+}
+
+static AJ_Status Run(uint32_t numThreads)
+{
+    static Worker workers[MAX_THREADS];
+    pthread_t threads[MAX_THREADS];
+    AJ_Status status = AJ_OK;
+    uint32_t elapsed = 0;
+    AJ_Time timer;
+    uint32_t i;
+
+    memset(workers, 0, sizeof(workers));
+    AJ_InitTimer(&timer);
+    for (i = 0; i < numThreads; ++i) {
+        workers[i].calls = CALLS;
+        pthread_create(&threads[i], NULL, WorkerThread, &workers[i]);
+    }
+    for (i = 0; i < numThreads; ++i) {
+        pthread_join(threads[i], NULL);
+        if (workers[i].status != AJ_OK) {
+            status = workers[i].status;
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, TRUE);
+    if (status == AJ_OK) {
+        printf("%u threads  %7u calls/s  %7u calls/s/thread\n", numThreads,
+               elapsed ? (uint32_t)((numThreads * CALLS * 1000ull) / elapsed) : 0,
+               workers[0].elapsed ? (uint32_t)((CALLS * 1000ull) / workers[0].elapsed) : 0);
+    }
+    return status;
+}
+
+int AJ_Main()
+{
+    AJ_Status status = AJ_OK;
+    uint32_t numThreads;
+
+    AJ_Initialize();
+    printf("%ld cpus\n", sysconf(_SC_NPROCESSORS_ONLN));
+    for (numThreads = 1; (numThreads <= MAX_THREADS) && (status == AJ_OK); numThreads *= 2) {
+        status = Run(numThreads);
+    }
+    if (status != AJ_OK) {
+        printf("Benchmark failed %d\n", status);
+    }
+    return (status == AJ_OK) ? 0 : 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
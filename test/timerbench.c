@@ -0,0 +1,145 @@
+/**
+ * @file  Timer wheel benchmark
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "alljoyn.h"
+#include "aj_helper.h"
+
+/*
+ * Build with -DAJ_MAX_TIMERS=10000 to run with the full number of timers
+ */
+#define NUM_TIMERS 10000
+
+#define RUN_TIME   3000
+
+#define LOOPS      (1000 * 1000)
+
+typedef struct {
+    uint32_t id;
+    uint32_t due;
+    uint32_t repeat;
+    uint32_t fired;
+    uint32_t late;
+} BenchTimer;
+
+static BenchTimer timers[NUM_TIMERS];
+static uint32_t maxLate;
+static uint32_t early;
+
+static uint32_t Now(void)
+{
+    AJ_Time start = { 0, 0 };
+    return AJ_GetElapsedTime(&start, FALSE);
+}
+
+static void Expired(void* context)
+{
+    BenchTimer* timer = (BenchTimer*)context;
+    uint32_t now = Now();
+
+    if ((int32_t)(now - timer->due) < 0) {
+        ++early;
+    } else if ((now - timer->due) > maxLate) {
+        maxLate = now - timer->due;
+    }
+    ++timer->fired;
+    timer->due += timer->repeat;
+}
+
+int AJ_Main()
+{
+    AJ_Time timer;
+    uint32_t elapsed;
+    uint32_t loops = 0;
+    uint32_t fired = 0;
+    uint32_t missed = 0;
+    uint32_t num;
+    uint32_t rep;
+    uint32_t i;
+
+    /*
+     * Cost of setting and cancelling timers
+     */
+    AJ_InitTimer(&timer);
+    for (rep = 0; rep < 100; ++rep) {
+        for (num = 0; num < NUM_TIMERS; ++num) {
+            timers[num].id = AJ_SetTimer(1000 + num * 7, Expired, &timers[num], 0);
+            if (!timers[num].id) {
+                break;
+            }
+        }
+        for (i = 0; i < num; ++i) {
+            AJ_CancelTimer(timers[i].id);
+        }
+    }
+    elapsed = AJ_GetElapsedTime(&timer, FALSE);
+    printf("%u timers   set+cancel %u ns/timer\n", num, num ? (uint32_t)((elapsed * 10000ull) / num) : 0);
+
+    /*
+     * A third of the timers repeat, the rest fire once at a random time within the run
+     */
+    srand(1);
+    for (i = 0; i < num; ++i) {
+        uint32_t when = 1 + rand() % RUN_TIME;
+        timers[i].repeat = (i % 3) ? 0 : 100 + rand() % 400;
+        timers[i].due = Now() + when;
+        timers[i].id = AJ_SetTimer(when, Expired, &timers[i], timers[i].repeat);
+    }
+    /*
+     * Loop overhead with all the timers pending
+     */
+    AJ_InitTimer(&timer);
+    for (i = 0; i < LOOPS; ++i) {
+        AJ_RunExpiredTimers();
+        AJ_GetNextTimeout();
+    }
+    elapsed = AJ_GetElapsedTime(&timer, FALSE);
+    printf("%u timers   run+next timeout %u ns/loop\n", num, (uint32_t)((elapsed * 1000000ull) / LOOPS));
+    /*
+     * Run a service loop until all the one-shot timers have fired
+     */
+    AJ_InitTimer(&timer);
+    while (AJ_GetElapsedTime(&timer, TRUE) < RUN_TIME) {
+        uint32_t timeout;
+
+        AJ_RunExpiredTimers();
+        timeout = AJ_GetNextTimeout();
+        ++loops;
+        AJ_Sleep(timeout);
+    }
+    for (i = 0; i < num; ++i) {
+        fired += timers[i].fired;
+        if (!timers[i].repeat && (timers[i].fired != 1)) {
+            ++missed;
+        }
+        AJ_CancelTimer(timers[i].id);
+    }
+    printf("%u timers   %u expirations in %u ms   %u loops\n", num, fired, RUN_TIME, loops);
+    printf("fired early %u   missed %u   max late %u ms\n", early, missed, maxLate);
+    return (early || missed) ? 1 : 0;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
@@ -0,0 +1,275 @@
+/**
+ * @file  Benchmark for producer threads sending signals on one bus connection, either through the
+ *        transmit queue or by sending directly on the connection under a mutex. Reports the signal
+ *        throughput and how long each producer spends in AJ_DeliverMsg().
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "alljoyn.h"
+#include "aj_bufio.h"
+#include "aj_net.h"
+#include "aj_helper.h"
+
+#define PRODUCERS 4
+#define SIGNALS   50000
+
+static const char* const benchInterface[] = {
+    "org.alljoyn.txbench",
+    "!Telemetry >u >t >s",
+    NULL
+};
+
+static const AJ_InterfaceDescription benchInterfaces[] = {
+    benchInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/org/alljoyn/txbench", benchInterfaces },
+    { NULL }
+};
+
+#define TELEMETRY_SIGNAL  AJ_APP_MESSAGE_ID(0, 0, 0)
+
+static uint64_t Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static AJ_BusAttachment bus;
+static pthread_mutex_t busLock = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t useQueue;
+static volatile uint32_t running;
+static uint32_t latency[PRODUCERS][SIGNALS];
+static AJ_Status producerStatus[PRODUCERS];
+
+/*
+ * The connection belongs to the message loop thread so without the queue the producers write to the
+ * socket themselves, waiting for it with poll() while holding the mutex
+ */
+static AJ_Status LockedSend(AJ_IOBuffer* buf)
+{
+    int sock = (int)(intptr_t)buf->context;
+
+    while (AJ_IO_BUF_AVAIL(buf)) {
+        ssize_t ret = send(sock, buf->readPtr, AJ_IO_BUF_AVAIL(buf), MSG_NOSIGNAL);
+        ++buf->syscalls;
+        if (ret > 0) {
+            buf->readPtr += ret;
+        } else {
+            struct pollfd fds;
+            fds.fd = sock;
+            fds.events = POLLOUT;
+            if ((ret == 0) || ((errno != EAGAIN) && (errno != EINTR)) || (poll(&fds, 1, 10000) != 1)) {
+                return AJ_ERR_WRITE;
+            }
+        }
+    }
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+static void* ProducerThread(void* arg)
+{
+    uintptr_t id = (uintptr_t)arg;
+    AJ_BusAttachment producer;
+    AJ_Status status = AJ_OK;
+    uint32_t i;
+
+    if (useQueue) {
+        status = AJ_StartProducer(&bus, &producer);
+    } else {
+        AJ_RegisterObjects(AppObjects, NULL);
+    }
+    for (i = 0; (i < SIGNALS) && (status == AJ_OK); ++i) {
+        AJ_Message msg;
+        uint64_t start = Now();
+
+        if (!useQueue) {
+            pthread_mutex_lock(&busLock);
+        }
+        status = AJ_MarshalSignal(useQueue ? &producer : &bus, &msg, TELEMETRY_SIGNAL, NULL, 0, 0, 0);
+        if (status == AJ_OK) {
+            status = AJ_MarshalArgs(&msg, "uts", (uint32_t)id, start, "sensor reading");
+        }
+        if (status == AJ_OK) {
+            status = AJ_DeliverMsg(&msg);
+        }
+        if (!useQueue) {
+            pthread_mutex_unlock(&busLock);
+        }
+        latency[id][i] = (uint32_t)(Now() - start);
+    }
+    if (useQueue) {
+        AJ_StopProducer(&producer);
+    } else {
+        AJ_RegisterObjects(NULL, NULL);
+    }
+    producerStatus[id] = status;
+    __sync_fetch_and_sub(&running, 1);
+    return NULL;
+}
+
+/*
+ * The peer reads everything sent and counts the bytes
+ */
+static int peerSock;
+static volatile uint64_t peerBytes;
+
+static void* PeerThread(void* arg)
+{
+    static uint8_t rxBuffer[65536];
+    ssize_t ret;
+
+    while ((ret = recv(peerSock, rxBuffer, sizeof(rxBuffer), 0)) > 0) {
+        peerBytes += ret;
+    }
+    return NULL;
+}
+
+static int CompareU32(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static AJ_Status Run(const char* name, int listener, struct sockaddr_in* sa, uint8_t queue)
+{
+    static uint32_t sorted[PRODUCERS * SIGNALS];
+    AJ_Status status;
+    uint32_t addr = sa->sin_addr.s_addr;
+    pthread_t producers[PRODUCERS];
+    pthread_t peer;
+    uint64_t start;
+    uint64_t elapsed;
+    uint32_t syscalls;
+    uintptr_t i;
+
+    memset(&bus, 0, sizeof(bus));
+    status = AJ_Net_Connect(&bus.sock, ntohs(sa->sin_port), AJ_ADDR_IPV4, &addr);
+    if (status != AJ_OK) {
+        return status;
+    }
+    strcpy(bus.uniqueName, ":1.1");
+    peerSock = accept(listener, NULL, NULL);
+    peerBytes = 0;
+    pthread_create(&peer, NULL, PeerThread, NULL);
+    useQueue = queue;
+    if (queue) {
+        status = AJ_EnableTxQueue(&bus);
+    } else {
+        bus.sock.tx.send = LockedSend;
+    }
+    if (status != AJ_OK) {
+        return status;
+    }
+    running = PRODUCERS;
+    start = Now();
+    for (i = 0; i < PRODUCERS; ++i) {
+        pthread_create(&producers[i], NULL, ProducerThread, (void*)i);
+    }
+    /*
+     * The message loop sends the queued signals, with the mutex it has nothing to do
+     */
+    while (running) {
+        AJ_NetSocket* ready;
+        AJ_Net_Poll(&ready, 1, 100);
+        if (queue) {
+            AJ_SendQueued(&bus);
+        }
+    }
+    for (i = 0; i < PRODUCERS; ++i) {
+        pthread_join(producers[i], NULL);
+        if (producerStatus[i] != AJ_OK) {
+            status = producerStatus[i];
+        }
+    }
+    if (queue) {
+        AJ_DisableTxQueue(&bus);
+    } else {
+        bus.sock.tx.send = AJ_Net_Send;
+    }
+    elapsed = Now() - start;
+    syscalls = bus.sock.tx.syscalls;
+    AJ_Net_Disconnect(&bus.sock);
+    pthread_join(peer, NULL);
+    close(peerSock);
+
+    if (status == AJ_OK) {
+        for (i = 0; i < PRODUCERS; ++i) {
+            memcpy(&sorted[i * SIGNALS], latency[i], sizeof(latency[i]));
+        }
+        qsort(sorted, PRODUCERS * SIGNALS, sizeof(uint32_t), CompareU32);
+        printf("%-8s %8u signals/s %7u sends  send ns: p50 %6u  p99 %7u  p99.9 %7u  max %8u\n", name,
+               (uint32_t)((PRODUCERS * SIGNALS * 1000000000ull) / elapsed), syscalls,
+               sorted[(PRODUCERS * SIGNALS) / 2], sorted[(PRODUCERS * SIGNALS * 99) / 100],
+               sorted[(PRODUCERS * SIGNALS * 999) / 1000], sorted[PRODUCERS * SIGNALS - 1]);
+    }
+    return status;
+}
+
+int AJ_Main()
+{
+    AJ_Status status;
+    struct sockaddr_in sa;
+    socklen_t saLen = sizeof(sa);
+    int listener;
+
+    AJ_Net_Up();
+    AJ_RegisterObjects(AppObjects, NULL);
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((bind(listener, (struct sockaddr*)&sa, sizeof(sa)) != 0) || (listen(listener, 1) != 0) ||
+        (getsockname(listener, (struct sockaddr*)&sa, &saLen) != 0)) {
+        printf("Failed to create listener\n");
+        return 1;
+    }
+    printf("%u producers sending %u signals each\n", PRODUCERS, SIGNALS);
+    status = Run("mutex", listener, &sa, FALSE);
+    if (status == AJ_OK) {
+        status = Run("queue", listener, &sa, TRUE);
+    }
+    if (status != AJ_OK) {
+        printf("Benchmark failed %d\n", status);
+    }
+    close(listener);
+    return (status == AJ_OK) ? 0 : 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
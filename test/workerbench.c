@@ -0,0 +1,319 @@
+/**
+ * @file  Latency benchmark for method handlers run inline and on worker threads. A peer keeps a
+ *        window of method calls outstanding over four sessions, one in eight calls goes to a handler
+ *        that blocks for a few milliseconds, and the latency of the other calls is measured.
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include "alljoyn.h"
+#include "aj_bufio.h"
+#include "aj_net.h"
+#include "aj_helper.h"
+
+#define CALLS      4000
+#define WINDOW     8
+#define SLOW_EVERY 8
+#define SLOW_MS    5
+#define SESSIONS   4
+
+static const char* const benchInterface[] = {
+    "org.alljoyn.workerbench",
+    "?Fast t<t t>t",
+    "?Slow t<t t>t",
+    NULL
+};
+
+static const AJ_InterfaceDescription benchInterfaces[] = {
+    benchInterface,
+    NULL
+};
+
+static const AJ_Object AppObjects[] = {
+    { "/org/alljoyn/workerbench", benchInterfaces },
+    { NULL }
+};
+
+#define FAST_CALL    AJ_PRX_MESSAGE_ID(0, 0, 0)
+#define SLOW_CALL    AJ_PRX_MESSAGE_ID(0, 0, 1)
+#define FAST_METHOD  AJ_APP_MESSAGE_ID(0, 0, 0)
+#define SLOW_METHOD  AJ_APP_MESSAGE_ID(0, 0, 1)
+
+static uint64_t Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static AJ_Status Echo(AJ_Message* msg, AJ_Message* reply)
+{
+    uint64_t t;
+    AJ_Status status = AJ_UnmarshalArgs(msg, "t", &t);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(reply, "t", t);
+    }
+    return status;
+}
+
+static AJ_Status Slow(AJ_Message* msg, AJ_Message* reply)
+{
+    AJ_Sleep(SLOW_MS);
+    return Echo(msg, reply);
+}
+
+static MessageHandlerEntry handlers[] = {
+    { FAST_METHOD, Echo },
+    { SLOW_METHOD, Slow },
+    { 0 }
+};
+
+/*
+ * The peer makes the method calls on a plain blocking socket
+ */
+static int peerSock;
+static uint32_t fastLatency[CALLS];
+static uint32_t numFast;
+static uint32_t peerElapsed;
+static AJ_Status peerStatus;
+static volatile uint8_t done;
+
+static AJ_Status PeerSend(AJ_IOBuffer* buf)
+{
+    while (AJ_IO_BUF_AVAIL(buf)) {
+        ssize_t ret = send(peerSock, buf->readPtr, AJ_IO_BUF_AVAIL(buf), MSG_NOSIGNAL);
+        if (ret <= 0) {
+            return AJ_ERR_WRITE;
+        }
+        buf->readPtr += ret;
+    }
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+static AJ_Status PeerRecv(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    struct pollfd fds;
+    ssize_t ret;
+
+    fds.fd = peerSock;
+    fds.events = POLLIN;
+    if (poll(&fds, 1, (int)min(timeout, 10000)) == 0) {
+        return AJ_ERR_TIMEOUT;
+    }
+    ret = recv(peerSock, buf->writePtr, AJ_IO_BUF_SPACE(buf), 0);
+    if (ret <= 0) {
+        return AJ_ERR_READ;
+    }
+    buf->writePtr += ret;
+    return AJ_OK;
+}
+
+static AJ_Status PeerCall(AJ_BusAttachment* bus, uint32_t n)
+{
+    AJ_Status status;
+    AJ_Message msg;
+
+    status = AJ_MarshalMethodCall(bus, &msg, (n % SLOW_EVERY) ? FAST_CALL : SLOW_CALL, ":1.1", (n % SESSIONS) + 1, 0, 10000);
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&msg, "t", Now());
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&msg);
+    }
+    return status;
+}
+
+static void* PeerThread(void* arg)
+{
+    static uint8_t txBuffer[1024];
+    static uint8_t rxBuffer[1024];
+    AJ_Status status = AJ_OK;
+    AJ_BusAttachment bus;
+    uint64_t start = Now();
+    uint32_t sent = 0;
+    uint32_t received = 0;
+
+    memset(&bus, 0, sizeof(bus));
+    AJ_IOBufInit(&bus.sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, NULL);
+    AJ_IOBufInit(&bus.sock.rx, rxBuffer, sizeof(rxBuffer), AJ_IO_BUF_RX, NULL);
+    bus.sock.tx.send = PeerSend;
+    bus.sock.rx.recv = PeerRecv;
+    AJ_RegisterObjects(NULL, AppObjects);
+
+    numFast = 0;
+    while ((sent < WINDOW) && (status == AJ_OK)) {
+        status = PeerCall(&bus, sent++);
+    }
+    while ((received < CALLS) && (status == AJ_OK)) {
+        AJ_Message msg;
+        uint64_t t;
+
+        status = AJ_UnmarshalMsg(&bus, &msg, 10000);
+        if (status == AJ_OK) {
+            if (msg.msgId == AJ_REPLY_ID(FAST_CALL) || msg.msgId == AJ_REPLY_ID(SLOW_CALL)) {
+                status = AJ_UnmarshalArgs(&msg, "t", &t);
+                if ((status == AJ_OK) && (msg.msgId == AJ_REPLY_ID(FAST_CALL))) {
+                    fastLatency[numFast++] = (uint32_t)(Now() - t);
+                }
+            } else {
+                status = AJ_ERR_NO_MATCH;
+            }
+            ++received;
+        }
+        AJ_CloseMsg(&msg);
+        if ((status == AJ_OK) && (sent < CALLS)) {
+            status = PeerCall(&bus, sent++);
+        }
+    }
+    peerElapsed = (uint32_t)(Now() - start);
+    peerStatus = status;
+    done = TRUE;
+    AJ_RegisterObjects(NULL, NULL);
+    return NULL;
+}
+
+/*
+ * The service side of AJ_RunAllJoynService() without the daemon connection
+ */
+static void ServiceLoop(AJ_BusAttachment* bus, const AllJoynConfiguration* config)
+{
+    while (!done) {
+        AJ_Message msg;
+        AJ_Status status;
+
+        AJ_DeliverCompletedCalls(bus);
+        if (AJ_GetNumWorkers()) {
+            status = AJ_ProcessReady(bus, &msg);
+            if (status == AJ_ERR_WOULD_BLOCK) {
+                AJ_NetSocket* ready;
+                AJ_Net_Poll(&ready, 1, 100);
+                continue;
+            }
+        } else {
+            status = AJ_UnmarshalMsg(bus, &msg, 100);
+        }
+        if (status == AJ_OK) {
+            AJ_DispatchMessage(&msg, config);
+        }
+        AJ_CloseMsg(&msg);
+        if (status == AJ_ERR_READ) {
+            break;
+        }
+    }
+}
+
+static int CompareU32(const void* a, const void* b)
+{
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+static AJ_Status Run(const char* name, int listener, struct sockaddr_in* sa, uint32_t numWorkers, uint8_t flags)
+{
+    AJ_Status status;
+    AJ_BusAttachment bus;
+    AllJoynConfiguration config;
+    uint32_t addr = sa->sin_addr.s_addr;
+    pthread_t thread;
+
+    memset(&bus, 0, sizeof(bus));
+    memset(&config, 0, sizeof(config));
+    handlers[0].flags = flags;
+    handlers[1].flags = flags;
+    config.message_handlers = handlers;
+
+    status = AJ_Net_Connect(&bus.sock, ntohs(sa->sin_port), AJ_ADDR_IPV4, &addr);
+    if (status != AJ_OK) {
+        return status;
+    }
+    strcpy(bus.uniqueName, ":1.1");
+    peerSock = accept(listener, NULL, NULL);
+    if (numWorkers) {
+        status = AJ_StartWorkers(numWorkers);
+    }
+    if (status == AJ_OK) {
+        done = FALSE;
+        pthread_create(&thread, NULL, PeerThread, NULL);
+        ServiceLoop(&bus, &config);
+        pthread_join(thread, NULL);
+        status = peerStatus;
+    }
+    AJ_StopWorkers();
+    AJ_Net_Disconnect(&bus.sock);
+    close(peerSock);
+
+    if (status == AJ_OK) {
+        qsort(fastLatency, numFast, sizeof(uint32_t), CompareU32);
+        printf("%-18s %7u calls/s  fast call latency us: p50 %6u  p99 %6u  p99.9 %6u  max %6u\n", name,
+               (uint32_t)((CALLS * 1000000ull) / peerElapsed),
+               fastLatency[numFast / 2], fastLatency[(numFast * 99) / 100],
+               fastLatency[(numFast * 999) / 1000], fastLatency[numFast - 1]);
+    }
+    return status;
+}
+
+int AJ_Main()
+{
+    AJ_Status status;
+    struct sockaddr_in sa;
+    socklen_t saLen = sizeof(sa);
+    int listener;
+
+    AJ_Net_Up();
+    AJ_RegisterObjects(AppObjects, NULL);
+    listener = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((bind(listener, (struct sockaddr*)&sa, sizeof(sa)) != 0) || (listen(listener, 1) != 0) ||
+        (getsockname(listener, (struct sockaddr*)&sa, &saLen) != 0)) {
+        printf("Failed to create listener\n");
+        return 1;
+    }
+    printf("%u calls, %u outstanding in %u sessions, every %uth call blocks for %u ms\n", CALLS, WINDOW, SESSIONS, SLOW_EVERY, SLOW_MS);
+    status = Run("inline", listener, &sa, 0, 0);
+    if (status == AJ_OK) {
+        status = Run("4 workers", listener, &sa, 4, AJ_HANDLER_WORKER);
+    }
+    if (status == AJ_OK) {
+        status = Run("4 workers ordered", listener, &sa, 4, AJ_HANDLER_WORKER | AJ_HANDLER_ORDERED);
+    }
+    if (status != AJ_OK) {
+        printf("Benchmark failed %d\n", status);
+    }
+    close(listener);
+    return (status == AJ_OK) ? 0 : 1;
+}
+
+#ifdef AJ_MAIN
+int main()
+{
+    return AJ_Main();
+}
+#endif
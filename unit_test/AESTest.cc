@@ -0,0 +1,316 @@
+/**
+ * @file  AES backend Unit Test
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "alljoyn.h"
+#include "aj_crypto.h"
+#include "aj_guid.h"
+#if AJ_AES_BITSLICE
+#include "aj_target_bitslice.h"
+#endif
+}
+
+#if AJ_AES_BITSLICE
+#include <openssl/aes.h>
+#endif
+
+static const uint8_t key[16] = {
+    0xC0, 0xC1, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xCB, 0xCC, 0xCD, 0xCE, 0xCF
+};
+
+static const uint8_t ccmNonce[13] = { 0, 0, 0, 3, 2, 1, 0, 0xA0, 0xA1, 0xA2, 0xA3, 0xA4, 0xA5 };
+
+/*
+ * A prepared key gives the same result as the raw key
+ */
+TEST(KeyScheduleTest, PreparedKey)
+{
+    AJ_KeySchedule ks;
+    uint8_t raw[200 + 8];
+    uint8_t prepared[200 + 8];
+    uint32_t i;
+
+    for (i = 0; i < sizeof(raw); ++i) {
+        raw[i] = prepared[i] = (uint8_t)i;
+    }
+    AJ_AES_InitKey(&ks, key);
+    ASSERT_EQ(AJ_OK, AJ_Encrypt_CCM(key, raw, 200, 12, 8, ccmNonce, sizeof(ccmNonce)));
+    ASSERT_EQ(AJ_OK, AJ_Encrypt_CCM_Key(&ks, prepared, 200, 12, 8, ccmNonce, sizeof(ccmNonce)));
+    EXPECT_EQ(0, memcmp(raw, prepared, sizeof(raw)));
+    ASSERT_EQ(AJ_OK, AJ_Decrypt_CCM_Key(&ks, prepared, 200, 12, 8, ccmNonce, sizeof(ccmNonce)));
+    for (i = 0; i < 200; ++i) {
+        ASSERT_EQ((uint8_t)i, prepared[i]);
+    }
+    AJ_AES_ClearKey(&ks);
+    for (i = 0; i < sizeof(ks); ++i) {
+        ASSERT_EQ(0, ((uint8_t*)&ks)[i]);
+    }
+}
+
+/*
+ * Keys are prepared when they are set and go away with the name mapping
+ */
+TEST(KeyScheduleTest, NameMap)
+{
+    const AJ_KeySchedule* ks;
+    AJ_GUID guid;
+    uint8_t out[16];
+    uint8_t role = 0;
+
+    memset(&guid, 0x11, sizeof(guid));
+    AJ_GUID_ClearNameMap();
+    ASSERT_EQ(AJ_OK, AJ_GUID_AddNameMapping(&guid, ":1.7", NULL));
+    ASSERT_EQ(AJ_OK, AJ_SetSessionKey(":1.7", key, AJ_ROLE_KEY_INITIATOR));
+    ASSERT_EQ(AJ_OK, AJ_GetSessionKeySchedule(":1.7", &ks, &role));
+    EXPECT_EQ(AJ_ROLE_KEY_INITIATOR, role);
+    EXPECT_EQ(0, memcmp(key, ks->key, sizeof(key)));
+    ASSERT_EQ(AJ_OK, AJ_GetSessionKey(":1.7", out, &role));
+    EXPECT_EQ(0, memcmp(key, out, sizeof(key)));
+    ASSERT_EQ(AJ_OK, AJ_SetGroupKey(":1.7", key));
+    ASSERT_EQ(AJ_OK, AJ_GetGroupKeySchedule(":1.7", &ks));
+    EXPECT_EQ(0, memcmp(key, ks->key, sizeof(key)));
+    /*
+     * The local group key is generated once
+     */
+    ASSERT_EQ(AJ_OK, AJ_GetGroupKeySchedule(NULL, &ks));
+    ASSERT_EQ(AJ_OK, AJ_GetGroupKey(NULL, out));
+    EXPECT_EQ(0, memcmp(out, ks->key, sizeof(out)));
+    AJ_GUID_DeleteNameMapping(":1.7");
+    EXPECT_EQ(AJ_ERR_NO_MATCH, AJ_GetSessionKeySchedule(":1.7", &ks, &role));
+    EXPECT_EQ(AJ_ERR_NO_MATCH, AJ_GetGroupKeySchedule(":1.7", &ks));
+}
+
+#if AJ_AES_BITSLICE
+/*
+ * The bitsliced AES matches OpenSSL for any number of blocks in a pass
+ */
+TEST(BitsliceTest, MatchesOpenSSL)
+{
+    uint64_t rk[AJ_BS_KEY_WORDS];
+    uint8_t in[AJ_BS_BLOCKS * 16];
+    uint8_t out[AJ_BS_BLOCKS * 16];
+    uint8_t ref[16];
+    uint8_t k[16];
+    AES_KEY ssl;
+    uint32_t blocks;
+    uint32_t i;
+    uint32_t j;
+
+    for (i = 0; i < 16; ++i) {
+        for (j = 0; j < 16; ++j) {
+            k[j] = (uint8_t)(i * 31 + j * 17);
+        }
+        for (j = 0; j < sizeof(in); ++j) {
+            in[j] = (uint8_t)(i * 7 + j * 13);
+        }
+        _AJ_BS_ExpandKey(k, rk);
+        AES_set_encrypt_key(k, 128, &ssl);
+        for (blocks = 1; blocks <= AJ_BS_BLOCKS; ++blocks) {
+            memset(out, 0, sizeof(out));
+            _AJ_BS_Encrypt(rk, in, out, blocks);
+            for (j = 0; j < blocks; ++j) {
+                AES_encrypt(in + j * 16, ref, &ssl);
+                ASSERT_EQ(0, memcmp(ref, out + j * 16, 16)) << "key " << i << " block " << j << " of " << blocks;
+            }
+        }
+    }
+}
+#endif
+
+#if AJ_AES_AF_ALG
+/*
+ * The kernel and in process CCM agree, including for messages long enough to be spliced. Without
+ * ccm(aes) in the kernel both runs are in process.
+ */
+TEST(OffloadTest, MatchesInProcess)
+{
+    static const uint32_t lens[] = { 16, 100, 1500, 5000 };
+    static uint8_t kernel[5000 + 16];
+    static uint8_t local[5000 + 16];
+    AJ_KeySchedule ks;
+    uint32_t i;
+    uint32_t j;
+
+    AJ_AES_InitKey(&ks, key);
+    for (i = 0; i < ArraySize(lens); ++i) {
+        for (j = 0; j < lens[i]; ++j) {
+            kernel[j] = local[j] = (uint8_t)(j * 3 + i);
+        }
+        AJ_CCM_SetOffloadThreshold(0xFFFFFFFF);
+        ASSERT_EQ(AJ_OK, AJ_Encrypt_CCM_Key(&ks, local, lens[i], 12, 8, ccmNonce, sizeof(ccmNonce)));
+        AJ_CCM_SetOffloadThreshold(0);
+        ASSERT_EQ(AJ_OK, AJ_Encrypt_CCM_Key(&ks, kernel, lens[i], 12, 8, ccmNonce, sizeof(ccmNonce)));
+        ASSERT_EQ(0, memcmp(local, kernel, lens[i] + 8)) << "length " << lens[i];
+        ASSERT_EQ(AJ_OK, AJ_Decrypt_CCM_Key(&ks, local, lens[i], 12, 8, ccmNonce, sizeof(ccmNonce)));
+        AJ_CCM_SetOffloadThreshold(0xFFFFFFFF);
+        ASSERT_EQ(AJ_OK, AJ_Decrypt_CCM_Key(&ks, kernel, lens[i], 12, 8, ccmNonce, sizeof(ccmNonce)));
+        ASSERT_EQ(0, memcmp(local, kernel, lens[i])) << "length " << lens[i];
+    }
+    AJ_CCM_SetOffloadThreshold(0);
+    ASSERT_EQ(AJ_OK, AJ_Encrypt_CCM_Key(&ks, kernel, 100, 12, 8, ccmNonce, sizeof(ccmNonce)));
+    kernel[50] ^= 1;
+    EXPECT_EQ(AJ_ERR_SECURITY, AJ_Decrypt_CCM_Key(&ks, kernel, 100, 12, 8, ccmNonce, sizeof(ccmNonce)));
+    AJ_CCM_SetOffloadThreshold(AJ_AF_ALG_THRESHOLD);
+    AJ_AES_ClearKey(&ks);
+}
+#endif
+
+#if AJ_AES_HW
+
+/*
+ * The hardware and software implementations must produce the same output for every mode
+ */
+class AESTest : public testing::Test {
+  public:
+    virtual void SetUp() {
+        uint32_t i;
+
+        for (i = 0; i < sizeof(data); ++i) {
+            data[i] = (uint8_t)(i * 7 + 3);
+        }
+        hardware = AJ_AES_UseHardware(TRUE);
+    }
+
+    virtual void TearDown() {
+        AJ_AES_UseHardware(TRUE);
+    }
+
+    void CTR(uint8_t hw, uint32_t len, uint16_t counter, uint8_t* out, uint8_t* ctr) {
+        memset(ctr, 0xA5, 16);
+        ctr[14] = (uint8_t)(counter >> 8);
+        ctr[15] = (uint8_t)counter;
+        AJ_AES_UseHardware(hw);
+        AJ_AES_Enable(key);
+        AJ_AES_CTR_128(key, data, out, len, ctr);
+        AJ_AES_Disable();
+    }
+
+    uint8_t data[1024 + 16];
+    uint8_t hardware;
+};
+
+TEST_F(AESTest, CounterMode)
+{
+    static const uint32_t lens[] = { 1, 15, 16, 17, 63, 64, 65, 100, 1024 };
+    uint8_t sw[sizeof(data)];
+    uint8_t hw[sizeof(data)];
+    uint8_t swCtr[16];
+    uint8_t hwCtr[16];
+    uint32_t i;
+
+    if (!hardware) {
+        return;
+    }
+    for (i = 0; i < ArraySize(lens); ++i) {
+        /*
+         * The 16 bit counter wraps without carrying into the rest of the block
+         */
+        CTR(FALSE, lens[i], 0xFFFE, sw, swCtr);
+        CTR(TRUE, lens[i], 0xFFFE, hw, hwCtr);
+        EXPECT_EQ(0, memcmp(sw, hw, lens[i])) << "length " << lens[i];
+        EXPECT_EQ(0, memcmp(swCtr, hwCtr, 16)) << "length " << lens[i];
+    }
+}
+
+TEST_F(AESTest, CBCAndECB)
+{
+    uint8_t sw[sizeof(data)];
+    uint8_t hw[sizeof(data)];
+    uint8_t swIv[16];
+    uint8_t hwIv[16];
+
+    if (!hardware) {
+        return;
+    }
+    memset(swIv, 0x5A, sizeof(swIv));
+    memset(hwIv, 0x5A, sizeof(hwIv));
+    AJ_AES_UseHardware(FALSE);
+    AJ_AES_Enable(key);
+    AJ_AES_CBC_128_ENCRYPT(key, data, sw, 1024, swIv);
+    AJ_AES_ECB_128_ENCRYPT(key, data, sw + 1024);
+    AJ_AES_UseHardware(TRUE);
+    AJ_AES_Enable(key);
+    AJ_AES_CBC_128_ENCRYPT(key, data, hw, 1024, hwIv);
+    AJ_AES_ECB_128_ENCRYPT(key, data, hw + 1024);
+    EXPECT_EQ(0, memcmp(sw, hw, sizeof(data)));
+    EXPECT_EQ(0, memcmp(swIv, hwIv, sizeof(swIv)));
+}
+
+TEST_F(AESTest, CCMInterop)
+{
+    uint8_t msg[300 + 16];
+    uint8_t orig[300];
+    uint32_t len;
+
+    if (!hardware) {
+        return;
+    }
+    for (len = 20; len <= 300; len += 31) {
+        memcpy(orig, data, len);
+        memcpy(msg, data, len);
+        AJ_AES_UseHardware(TRUE);
+        ASSERT_EQ(AJ_OK, AJ_Encrypt_CCM(key, msg, len, 12, 8, ccmNonce, sizeof(ccmNonce)));
+        AJ_AES_UseHardware(FALSE);
+        ASSERT_EQ(AJ_OK, AJ_Decrypt_CCM(key, msg, len, 12, 8, ccmNonce, sizeof(ccmNonce)));
+        EXPECT_EQ(0, memcmp(orig, msg, len));
+    }
+}
+
+/*
+ * The single pass CCM gives the same result in hardware and software for every split between the
+ * header and the body
+ */
+TEST_F(AESTest, CCMSplits)
+{
+    uint8_t sw[160 + 16];
+    uint8_t hw[160 + 16];
+    uint32_t hdrLen;
+    uint32_t len;
+
+    if (!hardware) {
+        return;
+    }
+    for (len = 0; len <= 160; len += 7) {
+        for (hdrLen = 0; hdrLen <= len; hdrLen += 3) {
+            memcpy(sw, data, len);
+            memcpy(hw, data, len);
+            AJ_AES_UseHardware(FALSE);
+            ASSERT_EQ(AJ_OK, AJ_Encrypt_CCM(key, sw, len, hdrLen, 16, ccmNonce, sizeof(ccmNonce)));
+            AJ_AES_UseHardware(TRUE);
+            ASSERT_EQ(AJ_OK, AJ_Encrypt_CCM(key, hw, len, hdrLen, 16, ccmNonce, sizeof(ccmNonce)));
+            ASSERT_EQ(0, memcmp(sw, hw, len + 16)) << "length " << len << " header " << hdrLen;
+            ASSERT_EQ(AJ_OK, AJ_Decrypt_CCM(key, hw, len, hdrLen, 16, ccmNonce, sizeof(ccmNonce)));
+            AJ_AES_UseHardware(FALSE);
+            ASSERT_EQ(AJ_OK, AJ_Decrypt_CCM(key, sw, len, hdrLen, 16, ccmNonce, sizeof(ccmNonce)));
+            ASSERT_EQ(0, memcmp(data, hw, len));
+            ASSERT_EQ(0, memcmp(data, sw, len));
+        }
+    }
+    /*
+     * A corrupted body fails authentication
+     */
+    memcpy(hw, data, 100);
+    ASSERT_EQ(AJ_OK, AJ_Encrypt_CCM(key, hw, 100, 20, 8, ccmNonce, sizeof(ccmNonce)));
+    hw[70] ^= 1;
+    EXPECT_EQ(AJ_ERR_SECURITY, AJ_Decrypt_CCM(key, hw, 100, 20, 8, ccmNonce, sizeof(ccmNonce)));
+}
+
+#endif
@@ -0,0 +1,243 @@
+/**
+ * @file  Asynchronous method call Unit Test
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include "LoopbackBus.h"
+
+extern "C" {
+#include "alljoyn.h"
+#include "aj_helper.h"
+#include "aj_net.h"
+}
+
+static const char* const ifaceA[] = {
+    "org.test.A",
+    "?Echo u<u u>u",
+    NULL
+};
+
+static const AJ_InterfaceDescription ifacesA[] = { ifaceA, NULL };
+
+static const AJ_Object appObjects[] = {
+    { "/a", ifacesA },
+    { NULL }
+};
+
+#define ECHO_CALL    AJ_PRX_MESSAGE_ID(0, 0, 0)
+#define ECHO_METHOD  AJ_APP_MESSAGE_ID(0, 0, 0)
+
+#define NUM_CALLS  40
+
+static AJ_Status EchoHandler(AJ_Message* msg, AJ_Message* reply)
+{
+    uint32_t u = 0;
+    AJ_Status status = AJ_UnmarshalArgs(msg, "u", &u);
+
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(reply, "u", u * 2);
+    }
+    return status;
+}
+
+static MessageHandlerEntry handlers[] = {
+    { ECHO_METHOD, EchoHandler },
+    { 0 }
+};
+
+/*
+ * What each callback was called with
+ */
+typedef struct {
+    uint32_t calls;
+    uint32_t value;
+    uint8_t isError;
+    uint8_t isNull;
+    std::string error;
+} Completion;
+
+static Completion completions[NUM_CALLS];
+
+static void ReplyCallback(AJ_Message* reply, void* context)
+{
+    Completion* c = (Completion*)context;
+
+    ++c->calls;
+    if (!reply) {
+        c->isNull = TRUE;
+    } else if (reply->hdr->msgType == AJ_MSG_ERROR) {
+        c->isError = TRUE;
+        c->error = reply->error ? reply->error : "";
+    } else {
+        EXPECT_EQ(AJ_REPLY_ID(ECHO_CALL), reply->msgId);
+        EXPECT_EQ(AJ_OK, AJ_UnmarshalArgs(reply, "u", &c->value));
+    }
+}
+
+class AsyncCallTest : public LoopbackTest {
+  public:
+    virtual void SetUp() {
+        uint32_t i;
+
+        LoopbackTest::SetUp();
+        memset(&config, 0, sizeof(config));
+        for (i = 0; i < NUM_CALLS; ++i) {
+            completions[i] = Completion();
+        }
+        config.message_handlers = handlers;
+        AJ_RegisterObjects(appObjects, appObjects);
+    }
+
+    AJ_Status Call(uint32_t i, uint32_t timeout) {
+        AJ_Message msg;
+        AJ_Status status = AJ_MarshalMethodCallAsync(&bus, &msg, ECHO_CALL, ":1.1", 0, 0, timeout, ReplyCallback, &completions[i]);
+        if (status == AJ_OK) {
+            status = AJ_MarshalArgs(&msg, "u", i);
+        }
+        if (status == AJ_OK) {
+            status = AJ_DeliverMsg(&msg);
+        }
+        return status;
+    }
+
+    /*
+     * Receives and dispatches everything on the wire
+     */
+    uint32_t Dispatch() {
+        AJ_Message msg;
+        uint32_t num = 0;
+
+        while (AJ_UnmarshalMsg(&bus, &msg, 0) == AJ_OK) {
+            EXPECT_EQ(AJ_OK, AJ_DispatchMessage(&msg, &config));
+            AJ_CloseMsg(&msg);
+            ++num;
+        }
+        return num;
+    }
+
+    AllJoynConfiguration config;
+};
+
+TEST_F(AsyncCallTest, ManyCallsInFlight)
+{
+    uint32_t i;
+
+    for (i = 0; i < NUM_CALLS; ++i) {
+        ASSERT_EQ(AJ_OK, Call(i, 1000));
+    }
+    /*
+     * The calls are handled first, then the replies are passed to the callbacks
+     */
+    EXPECT_EQ(2u * NUM_CALLS, Dispatch());
+    for (i = 0; i < NUM_CALLS; ++i) {
+        EXPECT_EQ(1u, completions[i].calls);
+        EXPECT_EQ(2 * i, completions[i].value);
+        EXPECT_FALSE(completions[i].isError);
+    }
+    EXPECT_EQ(0u, AJ_ReplyTimeout(0));
+}
+
+TEST_F(AsyncCallTest, Timeout)
+{
+    AJ_Message msg;
+
+    ASSERT_EQ(AJ_OK, Call(0, 5));
+    /*
+     * Drop the call so a reply never arrives
+     */
+    consumed = wire.size();
+    AJ_Sleep(10);
+    ASSERT_EQ(AJ_OK, AJ_UnmarshalMsg(&bus, &msg, 0));
+    EXPECT_EQ(AJ_OK, AJ_DispatchMessage(&msg, &config));
+    AJ_CloseMsg(&msg);
+    EXPECT_EQ(1u, completions[0].calls);
+    EXPECT_TRUE(completions[0].isError);
+    EXPECT_EQ(AJ_ErrTimeout, completions[0].error);
+}
+
+#if AJ_NET_EPOLL
+static uint32_t serviceHandlerCalls;
+
+static void ServiceHandler(AJ_BusAttachment* bus, AJ_Message* msg, AJ_Status status)
+{
+    ++serviceHandlerCalls;
+}
+
+TEST_F(AsyncCallTest, ServiceBusesTimeout)
+{
+    AJ_Time timer;
+    uint32_t loops = 0;
+    int fds[2];
+
+    /*
+     * Watching a pipe that is never written gives AJ_ServiceBuses() something to wait on
+     */
+    ASSERT_EQ(0, pipe(fds));
+    ASSERT_EQ(AJ_OK, AJ_Net_Watch(fds[0]));
+    serviceHandlerCalls = 0;
+    ASSERT_EQ(AJ_OK, Call(0, 20));
+    /*
+     * The peer never answers
+     */
+    consumed = wire.size();
+    AJ_InitTimer(&timer);
+    while (!completions[0].calls && (loops++ < 10)) {
+        AJ_ServiceBuses(ServiceHandler, 1000);
+    }
+    /*
+     * The wait ends when the call times out not when the service timeout expires
+     */
+    EXPECT_GT(500u, AJ_GetElapsedTime(&timer, TRUE));
+    EXPECT_EQ(1u, completions[0].calls);
+    EXPECT_TRUE(completions[0].isError);
+    EXPECT_EQ(AJ_ErrTimeout, completions[0].error);
+    EXPECT_EQ(0u, serviceHandlerCalls);
+    EXPECT_EQ(1000u, AJ_ReplyTimeout(1000));
+    AJ_Net_Unwatch(fds[0]);
+    close(fds[0]);
+    close(fds[1]);
+}
+#endif
+
+TEST_F(AsyncCallTest, ReleasedOnDisconnect)
+{
+    ASSERT_EQ(AJ_OK, Call(0, 1000));
+    ASSERT_EQ(AJ_OK, Call(1, 1000));
+    AJ_ReleaseReplyContexts(&bus);
+    EXPECT_EQ(1u, completions[0].calls);
+    EXPECT_TRUE(completions[0].isNull);
+    EXPECT_EQ(1u, completions[1].calls);
+    EXPECT_TRUE(completions[1].isNull);
+    AJ_ReleaseReplyContexts(&bus);
+    EXPECT_EQ(1u, completions[0].calls);
+}
+
+TEST_F(AsyncCallTest, SyncCallHasNoCallback)
+{
+    AJ_Message msg;
+
+    ASSERT_EQ(AJ_OK, AJ_MarshalMethodCall(&bus, &msg, ECHO_CALL, ":1.1", 0, 0, 1000));
+    ASSERT_EQ(AJ_OK, AJ_MarshalArgs(&msg, "u", 7));
+    ASSERT_EQ(AJ_OK, AJ_DeliverMsg(&msg));
+    ASSERT_EQ(AJ_OK, AJ_UnmarshalMsg(&bus, &msg, 0));
+    EXPECT_EQ(AJ_OK, AJ_DispatchMessage(&msg, &config));
+    AJ_CloseMsg(&msg);
+    ASSERT_EQ(AJ_OK, AJ_UnmarshalMsg(&bus, &msg, 0));
+    EXPECT_EQ(AJ_REPLY_ID(ECHO_CALL), msg.msgId);
+    EXPECT_EQ(AJ_ERR_NO_MATCH, AJ_DispatchReply(&msg));
+    AJ_CloseMsg(&msg);
+}
@@ -0,0 +1,245 @@
+/**
+ * @file  Deferred method reply Unit Test
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include "LoopbackBus.h"
+
+extern "C" {
+#include "alljoyn.h"
+#include "aj_helper.h"
+}
+
+static const char* const ifaceA[] = {
+    "org.test.A",
+    "?Echo u<u u>u",
+    "?Notify u<",
+    "!Note >u",
+    NULL
+};
+
+static const AJ_InterfaceDescription ifacesA[] = { ifaceA, NULL };
+
+static const AJ_Object appObjects[] = {
+    { "/a", ifacesA },
+    { NULL }
+};
+
+#define ECHO_CALL      AJ_PRX_MESSAGE_ID(0, 0, 0)
+#define ECHO_METHOD    AJ_APP_MESSAGE_ID(0, 0, 0)
+#define NOTIFY_CALL    AJ_PRX_MESSAGE_ID(0, 0, 1)
+#define NOTIFY_METHOD  AJ_APP_MESSAGE_ID(0, 0, 1)
+#define NOTE_SIGNAL    AJ_APP_MESSAGE_ID(0, 0, 2)
+
+#define NUM_CALLS  8
+
+/*
+ * The handler saves a token and the argument for each call and replies later
+ */
+static AJ_ReplyToken tokens[NUM_CALLS];
+static uint32_t args[NUM_CALLS];
+static uint32_t numDeferred;
+
+static AJ_Status DeferHandler(AJ_Message* msg, AJ_Message* reply)
+{
+    AJ_Status status = AJ_UnmarshalArgs(msg, "u", &args[numDeferred]);
+
+    if (status == AJ_OK) {
+        status = AJ_SaveReplyToken(msg, &tokens[numDeferred]);
+    }
+    if (status == AJ_OK) {
+        ++numDeferred;
+        status = AJ_ERR_DEFERRED;
+    }
+    return status;
+}
+
+/*
+ * Defers the reply and sends a signal that is only partly written before returning
+ */
+static AJ_Status NotifyHandler(AJ_Message* msg, AJ_Message* reply)
+{
+    AJ_Message note;
+    AJ_Status status = AJ_SaveReplyToken(msg, &tokens[numDeferred]);
+
+    if (status == AJ_OK) {
+        ++numDeferred;
+        msg->bus->sock.tx.send = LoopbackPartialTx;
+        status = AJ_MarshalSignal(msg->bus, &note, NOTE_SIGNAL, NULL, 0, 0, 0);
+    }
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(&note, "u", 42);
+    }
+    if (status == AJ_OK) {
+        status = AJ_DeliverMsg(&note);
+    }
+    return (status == AJ_OK) ? AJ_ERR_DEFERRED : status;
+}
+
+static MessageHandlerEntry handlers[] = {
+    { ECHO_METHOD, DeferHandler },
+    { NOTIFY_METHOD, NotifyHandler },
+    { 0 }
+};
+
+class DeferredReplyTest : public LoopbackTest {
+  public:
+    virtual void SetUp() {
+        LoopbackTest::SetUp();
+        memset(&config, 0, sizeof(config));
+        numDeferred = 0;
+        config.message_handlers = handlers;
+        AJ_RegisterObjects(appObjects, appObjects);
+    }
+
+    /*
+     * Makes the calls then receives and dispatches them, none of them are replied to
+     */
+    void Call(uint32_t num) {
+        AJ_Message msg;
+        uint32_t i;
+
+        for (i = 0; i < num; ++i) {
+            ASSERT_EQ(AJ_OK, AJ_MarshalMethodCall(&bus, &msg, ECHO_CALL, ":1.1", 3, 0, 1000));
+            ASSERT_EQ(AJ_OK, AJ_MarshalArgs(&msg, "u", 100 + i));
+            ASSERT_EQ(AJ_OK, AJ_DeliverMsg(&msg));
+        }
+        for (i = 0; i < num; ++i) {
+            ASSERT_EQ(AJ_OK, AJ_UnmarshalMsg(&bus, &msg, 0));
+            ASSERT_EQ(ECHO_METHOD, msg.msgId);
+            EXPECT_EQ(AJ_OK, AJ_DispatchMessage(&msg, &config));
+            AJ_CloseMsg(&msg);
+        }
+        ASSERT_EQ(num, numDeferred);
+        EXPECT_EQ(wire.size(), consumed);
+    }
+
+    AllJoynConfiguration config;
+};
+
+TEST_F(DeferredReplyTest, ReplyAfterClose)
+{
+    AJ_Message msg;
+    uint32_t i;
+
+    Call(NUM_CALLS);
+    /*
+     * Reply in reverse order, each reply matches the reply context of its call
+     */
+    for (i = NUM_CALLS; i-- > 0;) {
+        EXPECT_EQ(3u, tokens[i].sessionId);
+        EXPECT_STREQ(":1.1", tokens[i].sender);
+        ASSERT_EQ(AJ_OK, AJ_MarshalDeferredReply(&tokens[i], &msg));
+        ASSERT_EQ(AJ_OK, AJ_MarshalArgs(&msg, "u", args[i] * 2));
+        ASSERT_EQ(AJ_OK, AJ_DeliverMsg(&msg));
+    }
+    for (i = NUM_CALLS; i-- > 0;) {
+        uint32_t u = 0;
+        ASSERT_EQ(AJ_OK, AJ_UnmarshalMsg(&bus, &msg, 0));
+        EXPECT_EQ(AJ_REPLY_ID(ECHO_CALL), msg.msgId);
+        EXPECT_EQ(AJ_MSG_METHOD_RET, msg.hdr->msgType);
+        EXPECT_EQ(tokens[i].serialNum, msg.replySerial);
+        EXPECT_EQ(AJ_OK, AJ_UnmarshalArgs(&msg, "u", &u));
+        EXPECT_EQ(2 * (100 + i), u);
+        AJ_CloseMsg(&msg);
+    }
+    EXPECT_EQ(0u, AJ_ReplyTimeout(0));
+}
+
+TEST_F(DeferredReplyTest, ErrorReply)
+{
+    AJ_Message msg;
+
+    Call(1);
+    ASSERT_EQ(AJ_OK, AJ_MarshalDeferredError(&tokens[0], &msg, AJ_ErrRejected));
+    ASSERT_EQ(AJ_OK, AJ_DeliverMsg(&msg));
+    ASSERT_EQ(AJ_OK, AJ_UnmarshalMsg(&bus, &msg, 0));
+    EXPECT_EQ(AJ_REPLY_ID(ECHO_CALL), msg.msgId);
+    EXPECT_EQ(AJ_MSG_ERROR, msg.hdr->msgType);
+    EXPECT_STREQ(AJ_ErrRejected, msg.error);
+    AJ_CloseMsg(&msg);
+}
+
+TEST_F(DeferredReplyTest, DeferredReplyIsDiscarded)
+{
+    /*
+     * The reply marshaled for the handler must not be left behind to be sent later
+     */
+    Call(1);
+    EXPECT_EQ(0, AJ_IO_BUF_AVAIL(&bus.sock.tx));
+    EXPECT_EQ(wire.size(), consumed);
+}
+
+TEST_F(DeferredReplyTest, PartialWriteIsKept)
+{
+    AJ_Message msg;
+    uint32_t u = 0;
+
+    ASSERT_EQ(AJ_OK, AJ_MarshalMethodCall(&bus, &msg, NOTIFY_CALL, ":1.1", 0, 0, 1000));
+    ASSERT_EQ(AJ_OK, AJ_DeliverMsg(&msg));
+    ASSERT_EQ(AJ_OK, AJ_UnmarshalMsg(&bus, &msg, 0));
+    EXPECT_EQ(AJ_OK, AJ_DispatchMessage(&msg, &config));
+    AJ_CloseMsg(&msg);
+    /*
+     * The rest of the signal the handler sent is still waiting to be written
+     */
+    ASSERT_EQ(1u, numDeferred);
+    EXPECT_TRUE(bus.sock.tx.pending);
+    while (bus.sock.tx.pending) {
+        ASSERT_EQ(AJ_OK, bus.sock.tx.send(&bus.sock.tx));
+    }
+    ASSERT_EQ(AJ_OK, AJ_UnmarshalMsg(&bus, &msg, 0));
+    EXPECT_EQ(NOTE_SIGNAL, msg.msgId);
+    EXPECT_EQ(AJ_OK, AJ_UnmarshalArgs(&msg, "u", &u));
+    EXPECT_EQ(42u, u);
+    AJ_CloseMsg(&msg);
+}
+
+TEST_F(DeferredReplyTest, NoSender)
+{
+    AJ_Message msg;
+    AJ_ReplyToken token;
+
+    ASSERT_EQ(AJ_OK, AJ_MarshalMethodCall(&bus, &msg, ECHO_CALL, ":1.1", 0, 0, 1000));
+    ASSERT_EQ(AJ_OK, AJ_MarshalArgs(&msg, "u", 0));
+    ASSERT_EQ(AJ_OK, AJ_DeliverMsg(&msg));
+    ASSERT_EQ(AJ_OK, AJ_UnmarshalMsg(&bus, &msg, 0));
+    msg.sender = NULL;
+    EXPECT_EQ(AJ_ERR_NULL, AJ_SaveReplyToken(&msg, &token));
+    AJ_CloseMsg(&msg);
+}
+
+TEST_F(DeferredReplyTest, SenderTooLong)
+{
+    AJ_Message msg;
+    AJ_ReplyToken token;
+
+    Call(1);
+    ASSERT_EQ(AJ_OK, AJ_MarshalDeferredReply(&tokens[0], &msg));
+    ASSERT_EQ(AJ_OK, AJ_MarshalArgs(&msg, "u", 0));
+    ASSERT_EQ(AJ_OK, AJ_DeliverMsg(&msg));
+    ASSERT_EQ(AJ_OK, AJ_UnmarshalMsg(&bus, &msg, 0));
+    AJ_CloseMsg(&msg);
+
+    ASSERT_EQ(AJ_OK, AJ_MarshalMethodCall(&bus, &msg, ECHO_CALL, ":1.1", 0, 0, 1000));
+    ASSERT_EQ(AJ_OK, AJ_MarshalArgs(&msg, "u", 0));
+    ASSERT_EQ(AJ_OK, AJ_DeliverMsg(&msg));
+    ASSERT_EQ(AJ_OK, AJ_UnmarshalMsg(&bus, &msg, 0));
+    msg.sender = ":1.123456789012345";
+    EXPECT_EQ(AJ_ERR_RESOURCES, AJ_SaveReplyToken(&msg, &token));
+    AJ_CloseMsg(&msg);
+}
@@ -0,0 +1,138 @@
+/**
+ * @file  Message dispatch table Unit Test
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "alljoyn.h"
+#include "aj_helper.h"
+}
+
+#define NUM_HANDLERS 200
+
+static uint32_t lastHandled;
+static uint32_t handledCount;
+
+static AJ_Status Handler(AJ_Message* msg, AJ_Message* reply)
+{
+    lastHandled = msg->msgId;
+    ++handledCount;
+    return AJ_OK;
+}
+
+static AJ_Status OtherHandler(AJ_Message* msg, AJ_Message* reply)
+{
+    return AJ_ERR_FAILURE;
+}
+
+class DispatchTest : public testing::Test {
+  public:
+    virtual void SetUp() {
+        memset(&config, 0, sizeof(config));
+        lastHandled = 0;
+        handledCount = 0;
+    }
+
+    AJ_Status Dispatch(uint32_t msgId) {
+        AJ_Message msg;
+        AJ_MsgHeader hdr;
+
+        memset(&msg, 0, sizeof(msg));
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msgType = AJ_MSG_SIGNAL;
+        msg.hdr = &hdr;
+        msg.msgId = msgId;
+        return AJ_DispatchMessage(&msg, &config);
+    }
+
+    AllJoynConfiguration config;
+};
+
+static void CheckHandlers(DispatchTest* test, MessageHandlerEntry* handlers, uint32_t num)
+{
+    static const PropHandlerEntry props[] = { { 0 } };
+    uint32_t i;
+
+    for (i = 0; i < num; ++i) {
+        handlers[i].msgid = AJ_APP_MESSAGE_ID(i % 7, i / 7, i % 3);
+        handlers[i].handler = Handler;
+    }
+    handlers[i].msgid = 0;
+    test->config.message_handlers = handlers;
+    test->config.prop_handlers = props;
+
+    for (i = 0; i < num; ++i) {
+        EXPECT_EQ(AJ_OK, test->Dispatch(handlers[i].msgid));
+        EXPECT_EQ(handlers[i].msgid, lastHandled);
+    }
+    EXPECT_EQ(num, handledCount);
+    EXPECT_EQ(0u, AJ_GetUnhandledCount(AJ_INVALID_MSG_ID));
+}
+
+TEST_F(DispatchTest, FindsHandlers)
+{
+    static MessageHandlerEntry handlers[81];
+    CheckHandlers(this, handlers, 80);
+}
+
+TEST_F(DispatchTest, TooManyForTable)
+{
+    /*
+     * More handlers than fit in the default table exercises the fallback to searching the list
+     */
+    static MessageHandlerEntry handlers[NUM_HANDLERS + 1];
+    CheckHandlers(this, handlers, NUM_HANDLERS);
+}
+
+TEST_F(DispatchTest, FirstHandlerWins)
+{
+    static const MessageHandlerEntry handlers[] = {
+        { AJ_APP_MESSAGE_ID(0, 0, 1), Handler },
+        { AJ_APP_MESSAGE_ID(0, 0, 1), OtherHandler },
+        { AJ_APP_MESSAGE_ID(0, 0, 2), OtherHandler },
+        { 0 }
+    };
+    static const PropHandlerEntry props[] = { { 0 } };
+
+    config.message_handlers = handlers;
+    config.prop_handlers = props;
+    EXPECT_EQ(AJ_OK, Dispatch(AJ_APP_MESSAGE_ID(0, 0, 1)));
+    EXPECT_EQ(AJ_ERR_FAILURE, Dispatch(AJ_APP_MESSAGE_ID(0, 0, 2)));
+}
+
+TEST_F(DispatchTest, CountsUnhandled)
+{
+    static const MessageHandlerEntry handlers[] = {
+        { AJ_APP_MESSAGE_ID(0, 0, 1), Handler },
+        { 0 }
+    };
+    static const PropHandlerEntry props[] = { { 0 } };
+
+    config.message_handlers = handlers;
+    config.prop_handlers = props;
+    EXPECT_EQ(AJ_OK, Dispatch(AJ_APP_MESSAGE_ID(0, 0, 1)));
+    EXPECT_EQ(AJ_OK, Dispatch(AJ_APP_MESSAGE_ID(0, 0, 3)));
+    EXPECT_EQ(AJ_OK, Dispatch(AJ_APP_MESSAGE_ID(0, 0, 3)));
+    EXPECT_EQ(AJ_OK, Dispatch(AJ_APP_MESSAGE_ID(1, 0, 0)));
+    EXPECT_EQ(1u, handledCount);
+    EXPECT_EQ(2u, AJ_GetUnhandledCount(AJ_APP_MESSAGE_ID(0, 0, 3)));
+    EXPECT_EQ(1u, AJ_GetUnhandledCount(AJ_APP_MESSAGE_ID(1, 0, 0)));
+    EXPECT_EQ(0u, AJ_GetUnhandledCount(AJ_APP_MESSAGE_ID(0, 0, 1)));
+    EXPECT_EQ(3u, AJ_GetUnhandledCount(AJ_INVALID_MSG_ID));
+}
@@ -0,0 +1,137 @@
+/**
+ * @file  Message identification Unit Test
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "alljoyn.h"
+#include "aj_introspect.h"
+}
+
+static const char* const ifaceA[] = {
+    "org.test.A",
+    "!Alpha >u",
+    "!Beta >s",
+    NULL
+};
+
+static const char* const ifaceB[] = {
+    "org.test.B",
+    "!Gamma >u",
+    NULL
+};
+
+static const char* const ifaceW[] = {
+    "org.test.W",
+    "!Ping",
+    NULL
+};
+
+static const AJ_InterfaceDescription ifacesA[] = { ifaceA, NULL };
+static const AJ_InterfaceDescription ifacesB[] = { ifaceB, NULL };
+static const AJ_InterfaceDescription ifacesAB[] = { ifaceA, ifaceB, NULL };
+static const AJ_InterfaceDescription ifacesW[] = { ifaceW, NULL };
+
+static const AJ_Object appObjects[] = {
+    { "/a",             ifacesA },
+    { "/secure",        ifacesB, AJ_OBJ_FLAG_SECURE },
+    { "/secure/child",  ifacesA },
+    { "/b",             ifacesB, AJ_OBJ_FLAG_DISABLED },
+    { "/b",             ifacesAB },
+    { "*",              ifacesW },
+    { NULL }
+};
+
+static AJ_Object proxyObjects[] = {
+    { "/p1",            ifacesB },
+    { NULL }
+};
+
+class IdentifyTest : public testing::TestWithParam<bool> {
+  public:
+    virtual void SetUp() {
+        AJ_EnableObjectIndex(GetParam());
+        proxyObjects[0].path = "/p1";
+        AJ_RegisterObjects(appObjects, proxyObjects);
+    }
+
+    virtual void TearDown() {
+        AJ_EnableObjectIndex(TRUE);
+        AJ_RegisterObjects(NULL, NULL);
+    }
+
+    AJ_Status Identify(const char* path, const char* iface, const char* member, const char* sig, uint8_t flags = AJ_FLAG_ENCRYPTED) {
+        memset(&msg, 0, sizeof(msg));
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msgType = AJ_MSG_SIGNAL;
+        hdr.flags = flags;
+        msg.hdr = &hdr;
+        msg.objPath = path;
+        msg.iface = iface;
+        msg.member = member;
+        msg.signature = sig;
+        return AJ_IdentifyMessage(&msg);
+    }
+
+    AJ_Message msg;
+    AJ_MsgHeader hdr;
+};
+
+TEST_P(IdentifyTest, ExactPath)
+{
+    EXPECT_EQ(AJ_OK, Identify("/a", "org.test.A", "Beta", "s"));
+    EXPECT_EQ(AJ_APP_MESSAGE_ID(0, 0, 1), msg.msgId);
+    EXPECT_NE(AJ_OK, Identify("/a", "org.test.A", "Alpha", "s"));
+    EXPECT_EQ(AJ_ERR_NO_MATCH, Identify("/nope", "org.test.A", "Alpha", "u"));
+    EXPECT_EQ(AJ_ERR_NO_MATCH, Identify("/a", "org.test.B", "Gamma", "u"));
+}
+
+TEST_P(IdentifyTest, SecureParent)
+{
+    EXPECT_EQ(AJ_ERR_SECURITY, Identify("/secure/child", "org.test.A", "Alpha", "u", 0));
+    EXPECT_EQ(AJ_OK, Identify("/secure/child", "org.test.A", "Alpha", "u"));
+    EXPECT_EQ(AJ_APP_MESSAGE_ID(2, 0, 0), msg.msgId);
+    EXPECT_EQ(AJ_OK, Identify("/a", "org.test.A", "Alpha", "u", 0));
+}
+
+TEST_P(IdentifyTest, DuplicatePathSkipsDisabled)
+{
+    EXPECT_EQ(AJ_OK, Identify("/b", "org.test.B", "Gamma", "u"));
+    EXPECT_EQ(AJ_APP_MESSAGE_ID(4, 1, 0), msg.msgId);
+}
+
+TEST_P(IdentifyTest, Wildcard)
+{
+    EXPECT_EQ(AJ_OK, Identify("/anything", "org.test.W", "Ping", ""));
+    EXPECT_EQ(AJ_APP_MESSAGE_ID(5, 0, 0), msg.msgId);
+    EXPECT_EQ(AJ_OK, Identify("/a", "org.test.W", "Ping", ""));
+    EXPECT_EQ(AJ_APP_MESSAGE_ID(5, 0, 0), msg.msgId);
+}
+
+TEST_P(IdentifyTest, ProxyObjectPath)
+{
+    EXPECT_EQ(AJ_OK, Identify("/p1", "org.test.B", "Gamma", "u"));
+    EXPECT_EQ(AJ_PRX_MESSAGE_ID(0, 0, 0), msg.msgId);
+    EXPECT_EQ(AJ_OK, AJ_SetProxyObjectPath(proxyObjects, AJ_PRX_MESSAGE_ID(0, 0, 0), "/p2"));
+    EXPECT_EQ(AJ_ERR_NO_MATCH, Identify("/p1", "org.test.B", "Gamma", "u"));
+    EXPECT_EQ(AJ_OK, Identify("/p2", "org.test.B", "Gamma", "u"));
+    EXPECT_EQ(AJ_PRX_MESSAGE_ID(0, 0, 0), msg.msgId);
+}
+
+INSTANTIATE_TEST_CASE_P(ObjectIndex, IdentifyTest, testing::Bool());
@@ -0,0 +1,142 @@
+/**
+ * @file  Introspection XML cache Unit Test
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+#include <string>
+
+extern "C" {
+#include "alljoyn.h"
+#include "aj_introspect.h"
+#include "aj_std.h"
+}
+
+static const char* const ifaceA[] = {
+    "org.test.A",
+    "!Alpha >u",
+    "?Beta in<s out>s",
+    "@Gamma=u",
+    NULL
+};
+
+static const AJ_InterfaceDescription ifacesA[] = { ifaceA, NULL };
+
+static AJ_Object appObjects[] = {
+    { "/a",             ifacesA },
+    { "/p/x",           ifacesA },
+    { "/p/y",           ifacesA },
+    { NULL }
+};
+
+static std::string wire;
+
+static AJ_Status TxFunc(AJ_IOBuffer* buf)
+{
+    wire.append((const char*)buf->bufStart, AJ_IO_BUF_AVAIL(buf));
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+class IntrospectCacheTest : public testing::Test {
+  public:
+    virtual void SetUp() {
+        memset(&bus, 0, sizeof(bus));
+        AJ_IOBufInit(&bus.sock.tx, txBuffer, sizeof(txBuffer), AJ_IO_BUF_TX, NULL);
+        bus.sock.tx.send = TxFunc;
+        appObjects[0].flags = 0;
+        AJ_RegisterObjects(appObjects, NULL);
+    }
+
+    virtual void TearDown() {
+        AJ_SetIntrospectionCache(NULL, 0);
+        AJ_RegisterObjects(NULL, NULL);
+    }
+
+    /*
+     * Returns the reply to an introspection request with the serial number cleared
+     */
+    std::string Introspect(const char* path) {
+        AJ_Message msg;
+        AJ_Message reply;
+        AJ_MsgHeader hdr;
+
+        memset(&msg, 0, sizeof(msg));
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msgType = AJ_MSG_METHOD_CALL;
+        hdr.serialNum = 7;
+        msg.hdr = &hdr;
+        msg.bus = &bus;
+        msg.msgId = AJ_METHOD_INTROSPECT;
+        msg.objPath = path;
+        msg.sender = ":1.1";
+        wire.clear();
+        EXPECT_EQ(AJ_OK, AJ_HandleIntrospectRequest(&msg, &reply));
+        EXPECT_EQ(AJ_OK, AJ_DeliverMsg(&reply));
+        if (wire.size() > 12) {
+            wire.replace(8, 4, 4, '\0');
+        }
+        return wire;
+    }
+
+    AJ_BusAttachment bus;
+    uint8_t txBuffer[1024];
+};
+
+TEST_F(IntrospectCacheTest, CachedMatchesGenerated)
+{
+    static uint8_t cache[4096];
+    std::string a = Introspect("/a");
+    std::string p = Introspect("/p");
+
+    EXPECT_NE(std::string::npos, a.find("org.test.A"));
+    EXPECT_NE(std::string::npos, p.find("<node name=\"x\"/>"));
+
+    AJ_SetIntrospectionCache(cache, sizeof(cache));
+    /*
+     * First request fills the cache, the second is served from it
+     */
+    EXPECT_EQ(a, Introspect("/a"));
+    EXPECT_EQ(a, Introspect("/a"));
+    EXPECT_EQ(p, Introspect("/p"));
+    EXPECT_EQ(p, Introspect("/p"));
+    EXPECT_EQ(a, Introspect("/a"));
+}
+
+TEST_F(IntrospectCacheTest, FlagChangeRegenerates)
+{
+    static uint8_t cache[4096];
+    AJ_SetIntrospectionCache(cache, sizeof(cache));
+
+    std::string plain = Introspect("/a");
+    EXPECT_EQ(std::string::npos, plain.find("org.alljoyn.Bus.Secure"));
+    appObjects[0].flags = AJ_OBJ_FLAG_SECURE;
+    std::string secure = Introspect("/a");
+    EXPECT_NE(std::string::npos, secure.find("org.alljoyn.Bus.Secure"));
+    appObjects[0].flags = 0;
+    EXPECT_EQ(plain, Introspect("/a"));
+}
+
+TEST_F(IntrospectCacheTest, CacheTooSmall)
+{
+    static uint8_t cache[64];
+    std::string a = Introspect("/a");
+
+    AJ_SetIntrospectionCache(cache, sizeof(cache));
+    EXPECT_EQ(a, Introspect("/a"));
+    EXPECT_EQ(a, Introspect("/a"));
+}
@@ -0,0 +1,66 @@
+#ifndef _LOOPBACKBUS_H_
+#define _LOOPBACKBUS_H_
+/**
+ * @file  A bus attachment for unit tests whose transport is a string in memory
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+#include <string>
+
+extern "C" {
+#include "alljoyn.h"
+}
+
+/*
+ * Everything sent on the bus is appended to the wire and received back on the same bus. Only the
+ * first "arrived" bytes of the wire can be received, by default that is all of them.
+ */
+extern std::string wire;
+extern size_t arrived;
+extern size_t consumed;
+extern uint32_t recvCalls;
+
+/*
+ * Sends everything in the buffer
+ */
+AJ_Status LoopbackTx(AJ_IOBuffer* buf);
+
+/*
+ * Writes at most 8 bytes per call like a socket with a full send buffer
+ */
+AJ_Status LoopbackPartialTx(AJ_IOBuffer* buf);
+
+/*
+ * Receives as much of what has arrived as fits in the buffer
+ */
+AJ_Status LoopbackRx(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout);
+
+/*
+ * Fixture with a loopback bus. Tests register their own objects in SetUp().
+ */
+class LoopbackTest : public testing::Test {
+  public:
+    virtual void SetUp();
+    virtual void TearDown();
+
+    AJ_BusAttachment bus;
+    uint8_t txBuffer[4096];
+    uint8_t rxBuffer[1024];
+};
+
+#endif
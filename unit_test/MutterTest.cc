@@ -71,6 +71,24 @@ AJ_Status RxFunc(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
     }
 }
 
+static size_t vecSends = 0;
+
+static AJ_Status TxVecFunc(AJ_IOBuffer* buf, const uint8_t* data, uint32_t len)
+{
+    AJ_Status status = TxFunc(buf);
+
+    if (status == AJ_OK) {
+        if ((wireBytes + len) > sizeof(wireBuffer)) {
+            status = AJ_ERR_WRITE;
+        } else {
+            memcpy(wireBuffer + wireBytes, data, len);
+            wireBytes += len;
+            ++vecSends;
+        }
+    }
+    return status;
+}
+
 static const uint32_t ZERO_SECONDS = 0;
 
 // Array of test signatures
@@ -89,7 +107,9 @@ static const char* testSignature[] = {
     "a(uuuu)",
     "a(sss)",
     "ya{ss}",
-    "yyyyya{ys}"
+    "yyyyya{ys}",
+    "aqauat",
+    "u"
 };
 
 static AJ_Status MsgInit(AJ_Message* msg, uint32_t msgId, uint8_t msgType)
@@ -123,7 +143,11 @@ static AJ_Arg array2;
 static AJ_Arg struct1;
 static AJ_Arg struct2;
 
-class MutterTest : public testing::Test {
+/*
+ * The tests are run with signature plans enabled and disabled so both the compiled and the general
+ * AJ_MarshalArgs/AJ_UnmarshalArgs paths are exercised.
+ */
+class MutterTest : public testing::TestWithParam<bool> {
   public:
     virtual void SetUp() {
         /* random offset for the buffer to force different alignments */
@@ -138,6 +162,7 @@ class MutterTest : public testing::Test {
         testBus.sock.tx.readPtr = txBuffer;
         testBus.sock.tx.writePtr = txBuffer;
         testBus.sock.tx.send = TxFunc;
+        testBus.sock.tx.sendv = NULL;
 
         testBus.sock.rx.direction = AJ_IO_BUF_RX;
         testBus.sock.rx.bufSize = sizeof(rxBuffer);
@@ -147,10 +172,14 @@ class MutterTest : public testing::Test {
         testBus.sock.rx.recv = RxFunc;
 
         MutterHook = MsgInit;
+        AJ_EnableSignaturePlans(GetParam());
+        AJ_EnableHeaderTemplates(GetParam());
     }
 
     virtual void TearDown() {
         MutterHook = NULL;
+        AJ_EnableSignaturePlans(TRUE);
+        AJ_EnableHeaderTemplates(TRUE);
     }
 };
 
@@ -161,7 +190,7 @@ typedef struct {
     uint32_t d;
 } MutterTestStruct;
 
-TEST_F(MutterTest, ArrayofDict) {
+TEST_P(MutterTest, ArrayofDict) {
 
     AJ_Status status = AJ_ERR_FAILURE;
     //Index of "a{us}" in testSignature[] is 0
@@ -221,7 +250,7 @@ TEST_F(MutterTest, ArrayofDict) {
     }
 }
 
-TEST_F(MutterTest, BasicTypesAndNestedStruct) {
+TEST_P(MutterTest, BasicTypesAndNestedStruct) {
     uint32_t u;
     uint32_t v;
     int32_t n;
@@ -290,7 +319,7 @@ TEST_F(MutterTest, BasicTypesAndNestedStruct) {
     }
 }
 
-TEST_F(MutterTest, ArrayOfStructofBasicTypeStringandByteArray)
+TEST_P(MutterTest, ArrayOfStructofBasicTypeStringandByteArray)
 {
     char* str;
     AJ_Status status = AJ_ERR_FAILURE;
@@ -355,7 +384,7 @@ TEST_F(MutterTest, ArrayOfStructofBasicTypeStringandByteArray)
     }
 }
 
-TEST_F(MutterTest, ArrayOfArrayofString)
+TEST_P(MutterTest, ArrayOfArrayofString)
 {
     uint32_t count = 3;
     AJ_Status status = AJ_ERR_FAILURE;
@@ -438,7 +467,7 @@ TEST_F(MutterTest, ArrayOfArrayofString)
     }
 }
 
-TEST_F(MutterTest, IntegerandVariant)
+TEST_P(MutterTest, IntegerandVariant)
 {
     char* sig;
     uint32_t count = 16;
@@ -520,7 +549,7 @@ TEST_F(MutterTest, IntegerandVariant)
 }
 
 
-TEST_F(MutterTest, StructofInteger_VariantandInteger)
+TEST_P(MutterTest, StructofInteger_VariantandInteger)
 {
     char* str;
     char* sig;
@@ -581,7 +610,7 @@ TEST_F(MutterTest, StructofInteger_VariantandInteger)
 }
 
 
-TEST_F(MutterTest, DeepVariant)
+TEST_P(MutterTest, DeepVariant)
 {
     char* str;
     char* sig;
@@ -641,7 +670,7 @@ TEST_F(MutterTest, DeepVariant)
 }
 
 
-TEST_F(MutterTest, StructofVariants)
+TEST_P(MutterTest, StructofVariants)
 {
     char* str;
     char* sig;
@@ -716,7 +745,7 @@ TEST_F(MutterTest, StructofVariants)
     }
 }
 
-TEST_F(MutterTest, IntegerandArrayofInteger)
+TEST_P(MutterTest, IntegerandArrayofInteger)
 {
     uint32_t len;
     uint32_t j;
@@ -770,7 +799,65 @@ TEST_F(MutterTest, IntegerandArrayofInteger)
     }
 }
 
-TEST_F(MutterTest, ArrayOfStructs)
+TEST_P(MutterTest, IntegerandArrayofIntegerZeroCopy)
+{
+    uint8_t data[5000];
+    uint32_t len = sizeof(data);
+    uint32_t j;
+    uint16_t q;
+    void* raw;
+    size_t sz;
+    AJ_Status status = AJ_ERR_FAILURE;
+
+    for (j = 0; j < len; ++j) {
+        data[j] = (uint8_t)j;
+    }
+    testBus.sock.tx.sendv = TxVecFunc;
+    vecSends = 0;
+    //Index of "uqay" in testSignature[] is 8
+    status = AJ_MarshalSignal(&testBus, &txMsg, 8, "mutter.service", 0, 0, 0);
+    EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+
+    if (AJ_OK == status) {
+        status = AJ_MarshalArgs(&txMsg, "uq", 0xF00F00F00, 0x070707);
+        EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+        status = AJ_DeliverMsgPartial(&txMsg, len + 4);
+        EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+        status = AJ_MarshalRaw(&txMsg, &len, 4);
+        EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+        status = AJ_MarshalRaw(&txMsg, data, len);
+        EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+        status = AJ_DeliverMsg(&txMsg);
+        EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+        /*
+         * The array data should have been sent without being copied into the tx buffer
+         */
+        EXPECT_EQ(1U, vecSends);
+
+        status = AJ_UnmarshalMsg(&testBus, &rxMsg, ZERO_SECONDS);
+        EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+
+        if (AJ_OK == status) {
+            status = AJ_UnmarshalArgs(&rxMsg, "uq", &j, &q);
+            EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+            status = AJ_UnmarshalRaw(&rxMsg, (const void**)&raw, sizeof(len), &sz);
+            EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+            EXPECT_EQ(sizeof(data), *((uint32_t*)raw));
+            for (j = 0; j < len; j += sz) {
+                status = AJ_UnmarshalRaw(&rxMsg, (const void**)&raw, len - j, &sz);
+                EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+                if (AJ_OK != status) {
+                    break;
+                }
+                EXPECT_EQ(0, memcmp(raw, data + j, sz));
+            }
+            status = AJ_CloseMsg(&rxMsg);
+            EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+        }
+    }
+}
+
+TEST_P(MutterTest, ArrayOfStructs)
 {
     void* raw;
     size_t sz;
@@ -838,7 +925,7 @@ TEST_F(MutterTest, ArrayOfStructs)
 }
 
 
-TEST_F(MutterTest, ArrayOfStructofStrings)
+TEST_P(MutterTest, ArrayOfStructofStrings)
 {
     AJ_Status status = AJ_ERR_FAILURE;
     //Index of "a(sss)" in testSignature[] is 10
@@ -881,7 +968,7 @@ TEST_F(MutterTest, ArrayOfStructofStrings)
     }
 }
 
-TEST_F(MutterTest, ByteAndDictionaryEntries)
+TEST_P(MutterTest, ByteAndDictionaryEntries)
 {
     AJ_Status status = AJ_ERR_FAILURE;
     //Index of "ya{ss}" in testSignature[] is 11
@@ -1000,7 +1087,7 @@ TEST_F(MutterTest, ByteAndDictionaryEntries)
     }
 }
 
-TEST_F(MutterTest, MultipleBytesAndDictionaryEntries)
+TEST_P(MutterTest, MultipleBytesAndDictionaryEntries)
 {
     AJ_Status status = AJ_ERR_FAILURE;
     //Index of "yyyyya{ys}" in testSignature[] is 12
@@ -1123,3 +1210,158 @@ TEST_F(MutterTest, MultipleBytesAndDictionaryEntries)
         }
     }
 }
+
+TEST_P(MutterTest, ArraysOfScalars)
+{
+    uint16_t q[7];
+    uint32_t u[33];
+    uint64_t t[5];
+    const void* data;
+    size_t count;
+    AJ_Arg arg;
+    AJ_Status status = AJ_ERR_FAILURE;
+
+    for (size_t i = 0; i < ArraySize(q); ++i) {
+        q[i] = (uint16_t)(0x0102 * i);
+    }
+    for (size_t i = 0; i < ArraySize(u); ++i) {
+        u[i] = (uint32_t)(0x01020304 * i);
+    }
+    for (size_t i = 0; i < ArraySize(t); ++i) {
+        t[i] = 0x0102030405060708ull * i;
+    }
+    //Index of "aqauat" in testSignature[] is 13
+    status = AJ_MarshalSignal(&testBus, &txMsg, 13, "mutter.service", 0, 0, 0);
+    EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+
+    if (AJ_OK == status) {
+        status = AJ_MarshalArg(&txMsg, AJ_InitArg(&arg, AJ_ARG_UINT16, AJ_ARRAY_FLAG, q, sizeof(q)));
+        EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+        status = AJ_MarshalArg(&txMsg, AJ_InitArg(&arg, AJ_ARG_UINT32, AJ_ARRAY_FLAG, u, sizeof(u)));
+        EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+        status = AJ_MarshalArg(&txMsg, AJ_InitArg(&arg, AJ_ARG_UINT64, AJ_ARRAY_FLAG, t, sizeof(t)));
+        EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+        status = AJ_DeliverMsg(&txMsg);
+        EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+
+        status = AJ_UnmarshalMsg(&testBus, &rxMsg, ZERO_SECONDS);
+        EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+
+        if (AJ_OK == status) {
+            /*
+             * Element type must match
+             */
+            status = AJ_UnmarshalScalarArray(&rxMsg, AJ_ARG_STRING, &data, &count);
+            EXPECT_EQ(AJ_ERR_UNEXPECTED, status) << "  Actual Status: " << AJ_StatusText(status);
+
+            status = AJ_UnmarshalScalarArray(&rxMsg, AJ_ARG_UINT16, &data, &count);
+            EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+            EXPECT_EQ(ArraySize(q), count);
+            EXPECT_EQ(0, memcmp(q, data, sizeof(q)));
+
+            status = AJ_UnmarshalScalarArray(&rxMsg, AJ_ARG_UINT32, &data, &count);
+            EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+            EXPECT_EQ(ArraySize(u), count);
+            EXPECT_EQ(0, memcmp(u, data, sizeof(u)));
+
+            status = AJ_UnmarshalScalarArray(&rxMsg, AJ_ARG_UINT64, &data, &count);
+            EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+            EXPECT_EQ(ArraySize(t), count);
+            EXPECT_EQ(0, memcmp(t, data, sizeof(t)));
+
+            status = AJ_CloseMsg(&rxMsg);
+            EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+        }
+    }
+}
+
+TEST_P(MutterTest, ReusedSignatureBuffer)
+{
+    char sig[8];
+    uint32_t u = 0;
+    AJ_Status status;
+
+    //Index of "u" in testSignature[] is 14
+    status = AJ_MarshalSignal(&testBus, &txMsg, 14, "mutter.service", 0, 0, 0);
+    ASSERT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+    /*
+     * A signature that cannot be planned is remembered but must not stick to the buffer
+     */
+    strcpy(sig, "a{sv}");
+    EXPECT_EQ(AJ_ERR_UNEXPECTED, AJ_MarshalArgs(&txMsg, sig, 1));
+    EXPECT_EQ(AJ_ERR_UNEXPECTED, AJ_MarshalArgs(&txMsg, sig, 1));
+    strcpy(sig, "u");
+    status = AJ_MarshalArgs(&txMsg, sig, 12345);
+    EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+    status = AJ_DeliverMsg(&txMsg);
+    EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+
+    status = AJ_UnmarshalMsg(&testBus, &rxMsg, ZERO_SECONDS);
+    ASSERT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+    strcpy(sig, "a{sv}");
+    EXPECT_EQ(AJ_ERR_UNEXPECTED, AJ_UnmarshalArgs(&rxMsg, sig, &u));
+    strcpy(sig, "u");
+    status = AJ_UnmarshalArgs(&rxMsg, sig, &u);
+    EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+    EXPECT_EQ(12345u, u);
+    status = AJ_CloseMsg(&rxMsg);
+    EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+}
+
+TEST_P(MutterTest, RepeatedSignalHeaders)
+{
+    static const char* const dests[] = { "mutter.service", "mutter.service", "mutter.service", "other.service", NULL, NULL };
+    uint32_t lastSerial = 0;
+    uint32_t u;
+    AJ_Status status = AJ_ERR_FAILURE;
+
+    for (size_t i = 0; i < ArraySize(dests); ++i) {
+        uint32_t ttl = (i < 2) ? 0 : 1000;
+        //Index of "u" in testSignature[] is 14
+        status = AJ_MarshalSignal(&testBus, &txMsg, 14, dests[i], 7, 0, ttl);
+        EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+        if (AJ_OK != status) {
+            break;
+        }
+        /*
+         * The second send is built from the cached template, the signature must be the copy in the
+         * message buffer not the one in the cache
+         */
+        if (GetParam() && (i == 1)) {
+            EXPECT_TRUE((uint8_t*)txMsg.signature > testBus.sock.tx.bufStart);
+            EXPECT_TRUE((uint8_t*)txMsg.signature < testBus.sock.tx.writePtr);
+        }
+        status = AJ_MarshalArgs(&txMsg, "u", (uint32_t)i);
+        EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+        status = AJ_DeliverMsg(&txMsg);
+        EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+
+        status = AJ_UnmarshalMsg(&testBus, &rxMsg, ZERO_SECONDS);
+        EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+        if (AJ_OK != status) {
+            break;
+        }
+        /*
+         * Every send must get its own serial number and the header fields it asked for
+         */
+        EXPECT_NE(lastSerial, rxMsg.hdr->serialNum);
+        lastSerial = rxMsg.hdr->serialNum;
+        if (dests[i]) {
+            ASSERT_TRUE(rxMsg.destination != NULL);
+            EXPECT_STREQ(dests[i], rxMsg.destination);
+        } else {
+            EXPECT_TRUE(rxMsg.destination == NULL);
+        }
+        EXPECT_EQ(7U, rxMsg.sessionId);
+        EXPECT_EQ(ttl, rxMsg.ttl);
+        EXPECT_STREQ("u", rxMsg.signature);
+        status = AJ_UnmarshalArgs(&rxMsg, "u", &u);
+        EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+        EXPECT_EQ(i, u);
+        status = AJ_CloseMsg(&rxMsg);
+        EXPECT_EQ(AJ_OK, status) << "  Actual Status: " << AJ_StatusText(status);
+    }
+}
+
+
+INSTANTIATE_TEST_CASE_P(FastPaths, MutterTest, testing::Bool());
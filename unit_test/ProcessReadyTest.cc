@@ -0,0 +1,185 @@
+/**
+ * @file  Non-blocking message processing Unit Test
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include "LoopbackBus.h"
+
+extern "C" {
+#include "alljoyn.h"
+#include "aj_introspect.h"
+}
+
+static const char* const ifaceA[] = {
+    "org.test.A",
+    "!Alpha >u",
+    NULL
+};
+
+static const AJ_InterfaceDescription ifacesA[] = { ifaceA, NULL };
+
+static const AJ_Object appObjects[] = {
+    { "/a", ifacesA },
+    { NULL }
+};
+
+#define ALPHA_SIGNAL AJ_APP_MESSAGE_ID(0, 0, 0)
+
+class ProcessReadyTest : public LoopbackTest {
+  public:
+    virtual void SetUp() {
+        LoopbackTest::SetUp();
+        /*
+         * Tests decide when the bytes sent arrive
+         */
+        arrived = 0;
+        AJ_RegisterObjects(appObjects, NULL);
+    }
+
+    void Signal(uint32_t val) {
+        AJ_Message msg;
+        EXPECT_EQ(AJ_OK, AJ_MarshalSignal(&bus, &msg, ALPHA_SIGNAL, NULL, 0, 0, 0));
+        EXPECT_EQ(AJ_OK, AJ_MarshalArgs(&msg, "u", val));
+        EXPECT_EQ(AJ_OK, AJ_DeliverMsg(&msg));
+    }
+
+    void ExpectSignal(uint32_t val) {
+        AJ_Message msg;
+        uint32_t u = 0;
+        ASSERT_EQ(AJ_OK, AJ_ProcessReady(&bus, &msg));
+        EXPECT_EQ(ALPHA_SIGNAL, msg.msgId);
+        EXPECT_EQ(AJ_OK, AJ_UnmarshalArgs(&msg, "u", &u));
+        EXPECT_EQ(val, u);
+        AJ_CloseMsg(&msg);
+    }
+};
+
+TEST_F(ProcessReadyTest, NothingToRead)
+{
+    AJ_Message msg;
+    EXPECT_EQ(AJ_ERR_WOULD_BLOCK, AJ_ProcessReady(&bus, &msg));
+    EXPECT_EQ(AJ_IO_WANT_READ, AJ_GetIOInterest(&bus));
+}
+
+TEST_F(ProcessReadyTest, ResumesPartialMessage)
+{
+    AJ_Message msg;
+    size_t blocked = 0;
+
+    Signal(1234);
+    /*
+     * Deliver the message a few bytes at a time, every step must return without the full message
+     */
+    while (arrived + 3 < wire.size()) {
+        arrived += 3;
+        EXPECT_EQ(AJ_ERR_WOULD_BLOCK, AJ_ProcessReady(&bus, &msg));
+        EXPECT_EQ(0, AJ_GetIOInterest(&bus) & AJ_IO_PENDING);
+        ++blocked;
+    }
+    EXPECT_GT(blocked, 10u);
+    arrived = wire.size();
+    ExpectSignal(1234);
+    EXPECT_EQ(AJ_ERR_WOULD_BLOCK, AJ_ProcessReady(&bus, &msg));
+}
+
+TEST_F(ProcessReadyTest, BufferedBurst)
+{
+    AJ_Message msg;
+    uint32_t calls;
+
+    Signal(1);
+    Signal(2);
+    Signal(3);
+    arrived = wire.size();
+    ExpectSignal(1);
+    /*
+     * The other messages arrived with the first one and are processed without reading
+     */
+    calls = recvCalls;
+    EXPECT_NE(0, AJ_GetIOInterest(&bus) & AJ_IO_PENDING);
+    ExpectSignal(2);
+    ExpectSignal(3);
+    EXPECT_EQ(calls, recvCalls);
+    EXPECT_EQ(0, AJ_GetIOInterest(&bus) & AJ_IO_PENDING);
+    EXPECT_EQ(AJ_ERR_WOULD_BLOCK, AJ_ProcessReady(&bus, &msg));
+}
+
+TEST_F(ProcessReadyTest, MethodCallTimeout)
+{
+    AJ_Message call;
+    AJ_Message msg;
+    AJ_MsgHeader hdr;
+
+    memset(&call, 0, sizeof(call));
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msgType = AJ_MSG_METHOD_CALL;
+    hdr.serialNum = 77;
+    call.hdr = &hdr;
+    call.bus = &bus;
+    call.msgId = ALPHA_SIGNAL;
+    EXPECT_EQ(AJ_OK, AJ_AllocReplyContext(&call, 5));
+    EXPECT_EQ(AJ_ERR_WOULD_BLOCK, AJ_ProcessReady(&bus, &msg));
+    AJ_Sleep(10);
+    ASSERT_EQ(AJ_OK, AJ_ProcessReady(&bus, &msg));
+    EXPECT_EQ(AJ_MSG_ERROR, msg.hdr->msgType);
+    EXPECT_EQ(77u, msg.replySerial);
+    AJ_CloseMsg(&msg);
+}
+
+TEST_F(ProcessReadyTest, BadHeader)
+{
+    AJ_Message msg;
+
+    wire.assign(16, 'x');
+    arrived = wire.size();
+    EXPECT_EQ(AJ_ERR_READ, AJ_ProcessReady(&bus, &msg));
+}
+
+TEST_F(ProcessReadyTest, FlushesPartialWrite)
+{
+    AJ_Message msg;
+    size_t len;
+
+    bus.sock.tx.send = LoopbackPartialTx;
+    Signal(5);
+    EXPECT_EQ(8u, wire.size());
+    EXPECT_NE(0, AJ_GetIOInterest(&bus) & AJ_IO_WANT_WRITE);
+    /*
+     * Each call sends a little more until the whole message has been written
+     */
+    while (AJ_GetIOInterest(&bus) & AJ_IO_WANT_WRITE) {
+        len = wire.size();
+        EXPECT_EQ(AJ_ERR_WOULD_BLOCK, AJ_ProcessReady(&bus, &msg));
+        EXPECT_GT(wire.size(), len);
+    }
+    arrived = wire.size();
+    ExpectSignal(5);
+}
+
+TEST_F(ProcessReadyTest, DoesNotSendAbandonedMessage)
+{
+    AJ_Message msg;
+
+    /*
+     * A message that was marshaled but never delivered is not a pending write
+     */
+    EXPECT_EQ(AJ_OK, AJ_MarshalSignal(&bus, &msg, ALPHA_SIGNAL, NULL, 0, 0, 0));
+    EXPECT_NE(0u, AJ_IO_BUF_AVAIL(&bus.sock.tx));
+    EXPECT_EQ(AJ_IO_WANT_READ, AJ_GetIOInterest(&bus));
+    EXPECT_EQ(AJ_ERR_WOULD_BLOCK, AJ_ProcessReady(&bus, &msg));
+    EXPECT_TRUE(wire.empty());
+}
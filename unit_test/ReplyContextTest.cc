@@ -0,0 +1,225 @@
+/**
+ * @file  Method call reply context Unit Test
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "alljoyn.h"
+#include "aj_introspect.h"
+}
+
+class ReplyContextTest : public testing::Test {
+  public:
+    virtual void SetUp() {
+        AJ_ReleaseReplyContexts(NULL);
+    }
+
+    virtual void TearDown() {
+        AJ_ReleaseReplyContexts(NULL);
+    }
+
+    AJ_Message* Call(uint32_t serial, AJ_BusAttachment* bus = NULL) {
+        memset(&msg, 0, sizeof(msg));
+        msg.bus = bus;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msgType = AJ_MSG_METHOD_CALL;
+        hdr.serialNum = serial;
+        msg.hdr = &hdr;
+        msg.msgId = AJ_APP_MESSAGE_ID(0, 0, serial & 0xFF);
+        return &msg;
+    }
+
+    AJ_Status Alloc(uint32_t serial, uint32_t timeout) {
+        return AJ_AllocReplyContext(Call(serial), timeout);
+    }
+
+    void Release(uint32_t serial) {
+        AJ_ReleaseReplyContext(Call(serial));
+    }
+
+    /*
+     * Returns the serial number of the next timed out call or 0 if there are none
+     */
+    uint32_t TimedOut(AJ_BusAttachment* bus = NULL) {
+        AJ_Message timedOut;
+        memset(&timedOut, 0, sizeof(timedOut));
+        timedOut.bus = bus;
+        return AJ_TimedOutMethodCall(&timedOut) ? timedOut.replySerial : 0;
+    }
+
+    AJ_Message msg;
+    AJ_MsgHeader hdr;
+};
+
+TEST_F(ReplyContextTest, Capacity)
+{
+    uint32_t serial;
+
+    for (serial = 1; serial <= AJ_NUM_REPLY_CONTEXTS; ++serial) {
+        EXPECT_EQ(AJ_OK, Alloc(serial, 0));
+    }
+    EXPECT_EQ(AJ_ERR_RESOURCES, Alloc(serial, 0));
+    Release(AJ_NUM_REPLY_CONTEXTS / 2 + 1);
+    EXPECT_EQ(AJ_OK, Alloc(serial, 0));
+    EXPECT_EQ(AJ_ERR_RESOURCES, Alloc(serial + 1, 0));
+}
+
+TEST_F(ReplyContextTest, NoReplyExpected)
+{
+    uint32_t serial;
+
+    for (serial = 1; serial <= AJ_NUM_REPLY_CONTEXTS; ++serial) {
+        EXPECT_EQ(AJ_OK, Alloc(serial, 0));
+    }
+    Call(serial);
+    hdr.flags = AJ_FLAG_NO_REPLY_EXPECTED;
+    EXPECT_EQ(AJ_OK, AJ_AllocReplyContext(&msg, 0));
+}
+
+TEST_F(ReplyContextTest, TimeoutOrder)
+{
+    static const uint32_t timeouts[] = { 50, 10, 30, 20, 40 };
+    size_t i;
+
+    EXPECT_EQ(1000u, AJ_ReplyTimeout(1000));
+    for (i = 0; i < ArraySize(timeouts); ++i) {
+        EXPECT_EQ(AJ_OK, Alloc(timeouts[i], timeouts[i]));
+    }
+    EXPECT_GE(11u, AJ_ReplyTimeout(1000));
+    EXPECT_EQ(5u, AJ_ReplyTimeout(5));
+    EXPECT_EQ(0u, TimedOut());
+
+    AJ_Sleep(60);
+    EXPECT_EQ(0u, AJ_ReplyTimeout(1000));
+    EXPECT_EQ(10u, TimedOut());
+    EXPECT_EQ(20u, TimedOut());
+    EXPECT_EQ(30u, TimedOut());
+    EXPECT_EQ(40u, TimedOut());
+    EXPECT_EQ(50u, TimedOut());
+    EXPECT_EQ(0u, TimedOut());
+    EXPECT_EQ(1000u, AJ_ReplyTimeout(1000));
+}
+
+TEST_F(ReplyContextTest, ReleaseOutOfOrder)
+{
+    uint32_t serial;
+    uint32_t expect;
+
+    /*
+     * Serials that collide in the hash with timeouts that interleave in the heap
+     */
+    for (serial = 1; serial <= AJ_NUM_REPLY_CONTEXTS; ++serial) {
+        EXPECT_EQ(AJ_OK, Alloc(serial * 64, 5 + ((serial * 7) % AJ_NUM_REPLY_CONTEXTS) * 2));
+    }
+    for (serial = 1; serial <= AJ_NUM_REPLY_CONTEXTS; serial += 3) {
+        Release(serial * 64);
+    }
+    AJ_Sleep(10 + AJ_NUM_REPLY_CONTEXTS * 2);
+    /*
+     * Remaining calls must time out in deadline order
+     */
+    for (expect = 0; expect < AJ_NUM_REPLY_CONTEXTS; ++expect) {
+        for (serial = 1; serial <= AJ_NUM_REPLY_CONTEXTS; ++serial) {
+            if ((((serial * 7) % AJ_NUM_REPLY_CONTEXTS) == expect) && ((serial - 1) % 3)) {
+                EXPECT_EQ(serial * 64, TimedOut());
+            }
+        }
+    }
+    EXPECT_EQ(0u, TimedOut());
+}
+
+TEST_F(ReplyContextTest, SerialsArePerBus)
+{
+    AJ_BusAttachment busA;
+    AJ_BusAttachment busB;
+
+    /*
+     * Both buses have a call with the same serial number, the one on bus B times out first
+     */
+    EXPECT_EQ(AJ_OK, AJ_AllocReplyContext(Call(7, &busA), 1000));
+    EXPECT_EQ(AJ_OK, AJ_AllocReplyContext(Call(7, &busB), 5));
+    AJ_Sleep(10);
+    EXPECT_EQ(0u, TimedOut(&busA));
+    EXPECT_EQ(7u, TimedOut(&busB));
+    EXPECT_EQ(0u, TimedOut(&busB));
+    /*
+     * Releasing the call on bus B must not touch the one on bus A
+     */
+    EXPECT_EQ(AJ_OK, AJ_AllocReplyContext(Call(7, &busB), 5));
+    AJ_ReleaseReplyContext(Call(7, &busB));
+    AJ_Sleep(10);
+    EXPECT_EQ(0u, TimedOut(&busB));
+    /*
+     * The call on bus A is still waiting
+     */
+    EXPECT_LT(900u, AJ_ReplyTimeout(2000));
+    EXPECT_GE(1000u, AJ_ReplyTimeout(2000));
+}
+
+TEST_F(ReplyContextTest, DisconnectReleasesOneBus)
+{
+    AJ_BusAttachment busA;
+    AJ_BusAttachment busB;
+    uint32_t serial;
+
+    for (serial = 1; serial <= 4; ++serial) {
+        EXPECT_EQ(AJ_OK, AJ_AllocReplyContext(Call(serial, &busA), serial));
+        EXPECT_EQ(AJ_OK, AJ_AllocReplyContext(Call(serial, &busB), serial * 2));
+    }
+    AJ_ReleaseReplyContexts(&busA);
+    AJ_Sleep(10);
+    EXPECT_EQ(0u, TimedOut(&busA));
+    for (serial = 1; serial <= 4; ++serial) {
+        EXPECT_EQ(serial, TimedOut(&busB));
+    }
+    EXPECT_EQ(0u, TimedOut(&busB));
+}
+
+TEST_F(ReplyContextTest, EarliestPerBus)
+{
+    AJ_BusAttachment bus[3];
+    uint32_t serial;
+    uint32_t expect;
+    size_t b;
+
+    /*
+     * Interleave the deadlines across the buses and release calls from the middle of each heap
+     */
+    for (serial = 1; serial <= AJ_NUM_REPLY_CONTEXTS; ++serial) {
+        EXPECT_EQ(AJ_OK, AJ_AllocReplyContext(Call(serial, &bus[serial % 3]), 5 + ((serial * 7) % AJ_NUM_REPLY_CONTEXTS) * 2));
+    }
+    for (serial = 1; serial <= AJ_NUM_REPLY_CONTEXTS; serial += 4) {
+        AJ_ReleaseReplyContext(Call(serial, &bus[serial % 3]));
+    }
+    AJ_Sleep(10 + AJ_NUM_REPLY_CONTEXTS * 2);
+    /*
+     * Each bus times out its own calls in deadline order
+     */
+    for (b = 0; b < ArraySize(bus); ++b) {
+        for (expect = 0; expect < AJ_NUM_REPLY_CONTEXTS; ++expect) {
+            for (serial = 1; serial <= AJ_NUM_REPLY_CONTEXTS; ++serial) {
+                if ((((serial * 7) % AJ_NUM_REPLY_CONTEXTS) == expect) && ((serial - 1) % 4) && ((serial % 3) == b)) {
+                    EXPECT_EQ(serial, TimedOut(&bus[b]));
+                }
+            }
+        }
+        EXPECT_EQ(0u, TimedOut(&bus[b]));
+    }
+    EXPECT_EQ(1000u, AJ_ReplyTimeout(1000));
+}
@@ -0,0 +1,144 @@
+/**
+ * @file  Ring buffer I/O buffer Unit Test
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "alljoyn.h"
+#include "aj_bufio.h"
+#include "aj_net.h"
+}
+
+#define RING_SIZE 4096
+
+class RingBufferTest : public testing::Test {
+  public:
+    RingBufferTest() : ring(NULL) { }
+
+#ifdef AJ_RX_RING_SIZE
+    virtual void SetUp() {
+        ring = AJ_Net_MapRing(RING_SIZE);
+        ASSERT_TRUE(ring != NULL);
+        AJ_IOBufInitRing(&ioBuf, ring, RING_SIZE, AJ_IO_BUF_RX, NULL);
+    }
+
+    virtual void TearDown() {
+        AJ_Net_UnmapRing(ring, RING_SIZE);
+    }
+#endif
+
+    void Fill(size_t len) {
+        for (size_t i = 0; i < len; ++i) {
+            *ioBuf.writePtr++ = (uint8_t)(fillCount++);
+        }
+    }
+
+    uint8_t* ring;
+    AJ_IOBuffer ioBuf;
+    uint32_t fillCount;
+};
+
+#ifdef AJ_RX_RING_SIZE
+TEST_F(RingBufferTest, RebaseDoesNotMoveData)
+{
+    fillCount = 0;
+    Fill(100);
+    ioBuf.readPtr += 64;
+    uint8_t* unconsumed = ioBuf.readPtr;
+
+    AJ_IOBufRebase(&ioBuf);
+
+    EXPECT_EQ(unconsumed, ioBuf.bufStart);
+    EXPECT_EQ(unconsumed, ioBuf.readPtr);
+    EXPECT_EQ(36U, AJ_IO_BUF_AVAIL(&ioBuf));
+    EXPECT_EQ(64, ioBuf.readPtr[0]);
+    EXPECT_EQ((uint32_t)(RING_SIZE - 36), AJ_IO_BUF_SPACE(&ioBuf));
+}
+
+TEST_F(RingBufferTest, RebaseUnalignedMessage)
+{
+    fillCount = 0;
+    Fill(100);
+    ioBuf.readPtr += 61;
+
+    AJ_IOBufRebase(&ioBuf);
+
+#if AJ_STRICT_ALIGNMENT
+    /*
+     * The unconsumed data is moved down to the next 8 byte boundary
+     */
+    EXPECT_EQ(ring + 56, ioBuf.bufStart);
+    EXPECT_EQ(ring + 56, ioBuf.readPtr);
+#else
+    /*
+     * Unaligned messages are not moved either
+     */
+    EXPECT_EQ(ring + 61, ioBuf.bufStart);
+    EXPECT_EQ(ring + 61, ioBuf.readPtr);
+#endif
+    EXPECT_EQ(39U, AJ_IO_BUF_AVAIL(&ioBuf));
+    for (uint32_t i = 0; i < 39; ++i) {
+        EXPECT_EQ((uint8_t)(61 + i), ioBuf.readPtr[i]);
+    }
+    EXPECT_EQ((uint32_t)(RING_SIZE - 39), AJ_IO_BUF_SPACE(&ioBuf));
+}
+
+TEST_F(RingBufferTest, DataIsContiguousAcrossTheWrap)
+{
+    fillCount = 0;
+    /*
+     * Consume most of the ring then write past the end of the first mapping
+     */
+    Fill(RING_SIZE - 16);
+    ioBuf.readPtr = ioBuf.writePtr;
+    AJ_IOBufRebase(&ioBuf);
+    Fill(100);
+    EXPECT_EQ(100U, AJ_IO_BUF_AVAIL(&ioBuf));
+    for (uint32_t i = 0; i < 100; ++i) {
+        EXPECT_EQ((uint8_t)(RING_SIZE - 16 + i), ioBuf.readPtr[i]);
+    }
+    /*
+     * Once the start moves into the second mapping all pointers move back to the first
+     */
+    ioBuf.readPtr += 56;
+    AJ_IOBufRebase(&ioBuf);
+    EXPECT_EQ(ring + 40, ioBuf.bufStart);
+    EXPECT_EQ(ring + 40, ioBuf.readPtr);
+    EXPECT_EQ(44U, AJ_IO_BUF_AVAIL(&ioBuf));
+    for (uint32_t i = 0; i < 44; ++i) {
+        EXPECT_EQ((uint8_t)(RING_SIZE + 40 + i), ioBuf.readPtr[i]);
+    }
+    EXPECT_EQ((uint32_t)(RING_SIZE - 44), AJ_IO_BUF_SPACE(&ioBuf));
+}
+#endif
+
+TEST_F(RingBufferTest, LinearBufferStillMoves)
+{
+    uint8_t buf[64];
+
+    AJ_IOBufInit(&ioBuf, buf, sizeof(buf), AJ_IO_BUF_RX, NULL);
+    fillCount = 0;
+    Fill(32);
+    ioBuf.readPtr += 16;
+    AJ_IOBufRebase(&ioBuf);
+    EXPECT_EQ(buf, ioBuf.bufStart);
+    EXPECT_EQ(buf, ioBuf.readPtr);
+    EXPECT_EQ(16, buf[0]);
+    EXPECT_EQ(16U, AJ_IO_BUF_AVAIL(&ioBuf));
+}
@@ -0,0 +1,75 @@
+/**
+ * @file  Endian swap Unit Test
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "alljoyn.h"
+#include "aj_util.h"
+}
+
+/*
+ * Byte at a time reference swap
+ */
+static void ReferenceSwap(uint8_t* data, uint8_t size, uint32_t num)
+{
+    for (uint32_t i = 0; i < num; ++i, data += size) {
+        for (uint8_t j = 0; j < size / 2; ++j) {
+            uint8_t b = data[j];
+            data[j] = data[size - 1 - j];
+            data[size - 1 - j] = b;
+        }
+    }
+}
+
+TEST(SwapBytesTest, MatchesReference)
+{
+    static const uint8_t sizes[] = { 2, 4, 8 };
+    uint8_t buf[8 * 72 + 8];
+    uint8_t ref[sizeof(buf)];
+
+    for (size_t s = 0; s < ArraySize(sizes); ++s) {
+        uint8_t size = sizes[s];
+        /*
+         * Cover lengths that exercise the vector kernels and the scalar tails
+         */
+        for (uint32_t num = 0; num <= 72; ++num) {
+            for (size_t i = 0; i < sizeof(buf); ++i) {
+                buf[i] = (uint8_t)(i * 7 + num);
+            }
+            memcpy(ref, buf, sizeof(buf));
+            /*
+             * Offset by the element size so the data is aligned as it would be in a message
+             */
+            AJ_SwapBytes(buf + size, size, num);
+            ReferenceSwap(ref + size, size, num);
+            EXPECT_EQ(0, memcmp(buf, ref, sizeof(buf))) << "size " << (int)size << " num " << num;
+        }
+    }
+}
+
+TEST(SwapBytesTest, SingleByteUnchanged)
+{
+    uint8_t buf[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20 };
+    uint8_t ref[sizeof(buf)];
+
+    memcpy(ref, buf, sizeof(buf));
+    AJ_SwapBytes(buf, 1, sizeof(buf));
+    EXPECT_EQ(0, memcmp(buf, ref, sizeof(buf)));
+}
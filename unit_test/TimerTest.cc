@@ -0,0 +1,181 @@
+/**
+ * @file  Timer wheel Unit Test
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include <gtest/gtest.h>
+#include <vector>
+
+extern "C" {
+#include "alljoyn.h"
+#include "aj_helper.h"
+}
+
+static std::vector<uintptr_t> fired;
+static uint32_t selfId;
+
+static void Record(void* context)
+{
+    fired.push_back((uintptr_t)context);
+}
+
+static void CancelSelf(void* context)
+{
+    fired.push_back((uintptr_t)context);
+    AJ_CancelTimer(selfId);
+}
+
+class TimerTest : public testing::Test {
+  public:
+    virtual void SetUp() {
+        fired.clear();
+        ids.clear();
+    }
+
+    virtual void TearDown() {
+        for (size_t i = 0; i < ids.size(); ++i) {
+            AJ_CancelTimer(ids[i]);
+        }
+        EXPECT_EQ((uint32_t)-1, AJ_GetNextTimeout());
+    }
+
+    uint32_t Set(uint32_t when, uintptr_t context, uint32_t repeat = 0, TimeoutHandler handler = Record) {
+        uint32_t id = AJ_SetTimer(when, handler, (void*)context, repeat);
+        EXPECT_NE(0u, id);
+        ids.push_back(id);
+        return id;
+    }
+
+    /*
+     * Run the timers until the time has elapsed
+     */
+    void RunFor(uint32_t ms) {
+        AJ_Time timer;
+        AJ_InitTimer(&timer);
+        while (AJ_GetElapsedTime(&timer, TRUE) < ms) {
+            AJ_RunExpiredTimers();
+            AJ_Sleep(1);
+        }
+        AJ_RunExpiredTimers();
+    }
+
+    std::vector<uint32_t> ids;
+};
+
+TEST_F(TimerTest, FireInOrder)
+{
+    Set(40, 4);
+    Set(10, 1);
+    Set(30, 3);
+    Set(20, 2);
+    RunFor(60);
+    ASSERT_EQ(4u, fired.size());
+    for (size_t i = 0; i < fired.size(); ++i) {
+        EXPECT_EQ(i + 1, fired[i]);
+    }
+    EXPECT_EQ((uint32_t)-1, AJ_GetNextTimeout());
+}
+
+TEST_F(TimerTest, NextTimeoutIsEarliest)
+{
+    Set(5000, 1);
+    Set(50, 2);
+    Set(200, 3);
+    uint32_t next = AJ_GetNextTimeout();
+    EXPECT_LE(next, 50u);
+    EXPECT_GE(next, 40u);
+}
+
+TEST_F(TimerTest, NextTimeoutFarTimer)
+{
+    /*
+     * A timer in a coarse level may wake the loop early but never late
+     */
+    Set(100000, 1);
+    uint32_t next = AJ_GetNextTimeout();
+    EXPECT_LE(next, 100000u);
+    EXPECT_GT(next, 0u);
+    AJ_RunExpiredTimers();
+    EXPECT_EQ(0u, fired.size());
+}
+
+TEST_F(TimerTest, Cancel)
+{
+    uint32_t id = Set(10, 1);
+    Set(20, 2);
+    AJ_CancelTimer(id);
+    /*
+     * Cancelling twice or after the slot is reused is harmless
+     */
+    AJ_CancelTimer(id);
+    Set(15, 3);
+    AJ_CancelTimer(id);
+    RunFor(40);
+    ASSERT_EQ(2u, fired.size());
+    EXPECT_EQ(3u, fired[0]);
+    EXPECT_EQ(2u, fired[1]);
+}
+
+TEST_F(TimerTest, RepeatDoesNotDrift)
+{
+    Set(10, 1, 10);
+    RunFor(105);
+    EXPECT_GE(fired.size(), 9u);
+    EXPECT_LE(fired.size(), 11u);
+}
+
+TEST_F(TimerTest, StalledRepeatSkipsMissedPeriods)
+{
+    Set(1, 1, 1);
+    RunFor(5);
+    /*
+     * A blocked loop runs the timer once not once for every missed period
+     */
+    fired.clear();
+    AJ_Sleep(50);
+    AJ_RunExpiredTimers();
+    EXPECT_EQ(1u, fired.size());
+    EXPECT_LE(AJ_GetNextTimeout(), 1u);
+    RunFor(10);
+    EXPECT_GE(fired.size(), 5u);
+    EXPECT_LE(fired.size(), 12u);
+}
+
+TEST_F(TimerTest, CancelInHandler)
+{
+    selfId = Set(5, 1, 5, CancelSelf);
+    RunFor(30);
+    EXPECT_EQ(1u, fired.size());
+}
+
+TEST_F(TimerTest, Capacity)
+{
+    uint32_t id;
+    size_t n = 0;
+
+    while ((id = AJ_SetTimer(1000 + n, Record, NULL, 0)) != 0) {
+        ids.push_back(id);
+        ++n;
+    }
+    EXPECT_GT(n, 4u);
+    AJ_CancelTimer(ids[n / 2]);
+    id = AJ_SetTimer(10, Record, (void*)1, 0);
+    EXPECT_NE(0u, id);
+    ids.push_back(id);
+    RunFor(20);
+    EXPECT_EQ(1u, fired.size());
+}
@@ -0,0 +1,190 @@
+/**
+ * @file  Transmit queue Unit Test
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include "LoopbackBus.h"
+#include <pthread.h>
+
+extern "C" {
+#include "alljoyn.h"
+#include "aj_helper.h"
+#include "aj_net.h"
+}
+
+#if AJ_TX_QUEUE
+
+static const char* const ifaceA[] = {
+    "org.test.A",
+    "!Tick u >u",
+    "!Text >s",
+    NULL
+};
+
+static const AJ_InterfaceDescription ifacesA[] = { ifaceA, NULL };
+
+static const AJ_Object appObjects[] = {
+    { "/a", ifacesA },
+    { NULL }
+};
+
+#define TICK_SIGNAL  AJ_APP_MESSAGE_ID(0, 0, 0)
+#define TEXT_SIGNAL  AJ_APP_MESSAGE_ID(0, 0, 1)
+
+#define NUM_PRODUCERS  4
+#define NUM_SIGNALS    500
+
+typedef struct {
+    AJ_BusAttachment* bus;
+    uint32_t id;
+    AJ_Status status;
+} ProducerArgs;
+
+/*
+ * Each producer sends its id and a sequence number in every signal
+ */
+static void* ProducerThread(void* arg)
+{
+    ProducerArgs* args = (ProducerArgs*)arg;
+    AJ_BusAttachment producer;
+    uint32_t i;
+
+    args->status = AJ_StartProducer(args->bus, &producer);
+    for (i = 0; (i < NUM_SIGNALS) && (args->status == AJ_OK); ++i) {
+        AJ_Message msg;
+        args->status = AJ_MarshalSignal(&producer, &msg, TICK_SIGNAL, NULL, 0, 0, 0);
+        if (args->status == AJ_OK) {
+            args->status = AJ_MarshalArgs(&msg, "u", (args->id << 16) | i);
+        }
+        if (args->status == AJ_OK) {
+            args->status = AJ_DeliverMsg(&msg);
+        }
+    }
+    AJ_StopProducer(&producer);
+    return NULL;
+}
+
+class TxQueueTest : public LoopbackTest {
+  public:
+    virtual void SetUp() {
+        LoopbackTest::SetUp();
+        AJ_RegisterObjects(appObjects, appObjects);
+    }
+
+    virtual void TearDown() {
+        AJ_DisableTxQueue(&bus);
+        LoopbackTest::TearDown();
+    }
+};
+
+TEST_F(TxQueueTest, ConcurrentProducers)
+{
+    pthread_t threads[NUM_PRODUCERS];
+    ProducerArgs args[NUM_PRODUCERS];
+    uint32_t next[NUM_PRODUCERS] = { 0 };
+    uint32_t serials[NUM_PRODUCERS] = { 0 };
+    AJ_Message msg;
+    uint32_t total = 0;
+    uint32_t i;
+
+    ASSERT_EQ(AJ_OK, AJ_EnableTxQueue(&bus));
+    EXPECT_EQ(1u, AJ_GetNumTxQueues());
+    for (i = 0; i < NUM_PRODUCERS; ++i) {
+        args[i].bus = &bus;
+        args[i].id = i;
+        pthread_create(&threads[i], NULL, ProducerThread, &args[i]);
+    }
+    /*
+     * Producers wait for frames to be sent when theirs are all queued so keep sending until they
+     * have all finished
+     */
+    for (i = 0; i < NUM_PRODUCERS; ++i) {
+        AJ_NetSocket* ready;
+        while (pthread_tryjoin_np(threads[i], NULL) != 0) {
+            AJ_Net_Poll(&ready, 1, 10);
+            EXPECT_EQ(AJ_OK, AJ_SendQueued(&bus));
+        }
+        EXPECT_EQ(AJ_OK, args[i].status);
+    }
+    EXPECT_EQ(AJ_OK, AJ_SendQueued(NULL));
+    /*
+     * Every signal arrives whole and each producer's signals arrive in the order they were sent
+     */
+    while (AJ_UnmarshalMsg(&bus, &msg, 0) == AJ_OK) {
+        uint32_t u = 0;
+        EXPECT_EQ(AJ_MSG_SIGNAL, msg.hdr->msgType);
+        EXPECT_STREQ(":1.1", msg.sender);
+        ASSERT_EQ(AJ_OK, AJ_UnmarshalArgs(&msg, "u", &u));
+        ASSERT_LT(u >> 16, (uint32_t)NUM_PRODUCERS);
+        EXPECT_EQ(next[u >> 16], u & 0xFFFF);
+        EXPECT_NE(serials[u >> 16], msg.hdr->serialNum);
+        next[u >> 16] = (u & 0xFFFF) + 1;
+        serials[u >> 16] = msg.hdr->serialNum;
+        AJ_CloseMsg(&msg);
+        ++total;
+    }
+    EXPECT_EQ((uint32_t)(NUM_PRODUCERS * NUM_SIGNALS), total);
+    EXPECT_EQ(wire.size(), consumed);
+    EXPECT_EQ(AJ_OK, AJ_DisableTxQueue(&bus));
+    EXPECT_EQ(0u, AJ_GetNumTxQueues());
+}
+
+TEST_F(TxQueueTest, DisableWithProducer)
+{
+    AJ_BusAttachment producer;
+    AJ_Message msg;
+
+    EXPECT_EQ(AJ_ERR_UNEXPECTED, AJ_StartProducer(&bus, &producer));
+    ASSERT_EQ(AJ_OK, AJ_EnableTxQueue(&bus));
+    EXPECT_EQ(AJ_ERR_UNEXPECTED, AJ_EnableTxQueue(&bus));
+    ASSERT_EQ(AJ_OK, AJ_StartProducer(&bus, &producer));
+    EXPECT_EQ(AJ_ERR_UNEXPECTED, AJ_DisableTxQueue(&bus));
+    ASSERT_EQ(AJ_OK, AJ_MarshalSignal(&producer, &msg, TICK_SIGNAL, NULL, 0, 0, 0));
+    ASSERT_EQ(AJ_OK, AJ_MarshalArgs(&msg, "u", 7));
+    ASSERT_EQ(AJ_OK, AJ_DeliverMsg(&msg));
+    AJ_StopProducer(&producer);
+    /*
+     * The signal queued before the producer stopped is sent when the queue is disabled
+     */
+    EXPECT_EQ(AJ_OK, AJ_DisableTxQueue(&bus));
+    EXPECT_EQ(AJ_ERR_UNEXPECTED, AJ_DisableTxQueue(&bus));
+    ASSERT_EQ(AJ_OK, AJ_UnmarshalMsg(&bus, &msg, 0));
+    EXPECT_EQ(AJ_MSG_SIGNAL, msg.hdr->msgType);
+    AJ_CloseMsg(&msg);
+}
+
+TEST_F(TxQueueTest, MessageTooBig)
+{
+    AJ_BusAttachment producer;
+    AJ_Message msg;
+    char big[2048];
+
+    memset(big, 'x', sizeof(big) - 1);
+    big[sizeof(big) - 1] = 0;
+    ASSERT_EQ(AJ_OK, AJ_EnableTxQueue(&bus));
+    ASSERT_EQ(AJ_OK, AJ_StartProducer(&bus, &producer));
+    /*
+     * A message can only be queued whole so one that does not fit in a frame fails
+     */
+    ASSERT_EQ(AJ_OK, AJ_MarshalSignal(&producer, &msg, TEXT_SIGNAL, NULL, 0, 0, 0));
+    EXPECT_EQ(AJ_ERR_RESOURCES, AJ_MarshalArgs(&msg, "s", big));
+    AJ_StopProducer(&producer);
+    EXPECT_EQ(AJ_OK, AJ_SendQueued(&bus));
+    EXPECT_TRUE(wire.empty());
+}
+
+#endif
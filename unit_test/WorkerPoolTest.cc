@@ -0,0 +1,267 @@
+/**
+ * @file  Method handler worker pool Unit Test
+ */
+/******************************************************************************
+ * Copyright 2013, Qualcomm Innovation Center, Inc.
+ *
+ *    All rights reserved.
+ *    This file is licensed under the 3-clause BSD license in the NOTICE.txt
+ *    file for this project. A copy of the 3-clause BSD license is found at:
+ *
+ *        http://opensource.org/licenses/BSD-3-Clause.
+ *
+ *    Unless required by applicable law or agreed to in writing, software
+ *    distributed under the license is distributed on an "AS IS" BASIS,
+ *    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *    See the license for the specific language governing permissions and
+ *    limitations under the license.
+ ******************************************************************************/
+
+#include "LoopbackBus.h"
+
+extern "C" {
+#include "alljoyn.h"
+#include "aj_helper.h"
+}
+
+#if AJ_WORKER_POOL
+
+static const char* const ifaceA[] = {
+    "org.test.A",
+    "?Echo u<u u>u",
+    NULL
+};
+
+static const AJ_InterfaceDescription ifacesA[] = { ifaceA, NULL };
+
+static const AJ_Object appObjects[] = {
+    { "/a", ifacesA },
+    { NULL }
+};
+
+#define ECHO_CALL    AJ_PRX_MESSAGE_ID(0, 0, 0)
+#define ECHO_METHOD  AJ_APP_MESSAGE_ID(0, 0, 0)
+
+static uint32_t handledOnCaller;
+
+/*
+ * A second bus that receives what the first bus sends and sends to its own wire
+ */
+static std::string otherWire;
+static size_t otherConsumed;
+
+static AJ_Status OtherTxFunc(AJ_IOBuffer* buf)
+{
+    otherWire.append((const char*)buf->bufStart, AJ_IO_BUF_AVAIL(buf));
+    AJ_IO_BUF_RESET(buf);
+    return AJ_OK;
+}
+
+static AJ_Status OtherRxFunc(AJ_IOBuffer* buf, uint32_t len, uint32_t timeout)
+{
+    size_t n = min((size_t)AJ_IO_BUF_SPACE(buf), wire.size() - otherConsumed);
+
+    if (!n) {
+        return AJ_ERR_TIMEOUT;
+    }
+    memcpy(buf->writePtr, wire.data() + otherConsumed, n);
+    buf->writePtr += n;
+    otherConsumed += n;
+    return AJ_OK;
+}
+
+static pthread_t caller;
+
+/*
+ * Later calls take less time so they finish first unless the calls are ordered
+ */
+static AJ_Status EchoHandler(AJ_Message* msg, AJ_Message* reply)
+{
+    uint32_t u = 0;
+    AJ_Status status = AJ_UnmarshalArgs(msg, "u", &u);
+
+    if (pthread_equal(pthread_self(), caller)) {
+        ++handledOnCaller;
+    }
+    AJ_Sleep(4 * (4 - min(u, 4)));
+    if (status == AJ_OK) {
+        status = AJ_MarshalArgs(reply, "u", u);
+    }
+    return status;
+}
+
+static MessageHandlerEntry handlers[] = {
+    { ECHO_METHOD, EchoHandler },
+    { 0 }
+};
+
+class WorkerPoolTest : public LoopbackTest {
+  public:
+    virtual void SetUp() {
+        LoopbackTest::SetUp();
+        memset(&config, 0, sizeof(config));
+        handledOnCaller = 0;
+        caller = pthread_self();
+        config.message_handlers = handlers;
+        AJ_RegisterObjects(appObjects, appObjects);
+    }
+
+    virtual void TearDown() {
+        AJ_StopWorkers();
+        LoopbackTest::TearDown();
+    }
+
+    /*
+     * Makes the calls then receives and dispatches them
+     */
+    void Call(uint32_t num) {
+        AJ_Message msg;
+        uint32_t i;
+
+        for (i = 0; i < num; ++i) {
+            ASSERT_EQ(AJ_OK, AJ_MarshalMethodCall(&bus, &msg, ECHO_CALL, ":1.1", 1, 0, 1000));
+            ASSERT_EQ(AJ_OK, AJ_MarshalArgs(&msg, "u", i));
+            ASSERT_EQ(AJ_OK, AJ_DeliverMsg(&msg));
+        }
+        for (i = 0; i < num; ++i) {
+            ASSERT_EQ(AJ_OK, AJ_UnmarshalMsg(&bus, &msg, 0));
+            ASSERT_EQ(ECHO_METHOD, msg.msgId);
+            EXPECT_EQ(AJ_OK, AJ_DispatchMessage(&msg, &config));
+            AJ_CloseMsg(&msg);
+        }
+    }
+
+    /*
+     * Waits for the replies and returns the order they arrived in
+     */
+    std::string Replies(uint32_t num) {
+        std::string order;
+        uint32_t wait = 0;
+
+        while ((order.size() < num) && (wait < 1000)) {
+            AJ_Message msg;
+            uint32_t u;
+
+            EXPECT_EQ(AJ_OK, AJ_DeliverCompletedCalls(&bus));
+            if (AJ_UnmarshalMsg(&bus, &msg, 0) == AJ_OK) {
+                EXPECT_EQ(AJ_REPLY_ID(ECHO_CALL), msg.msgId);
+                EXPECT_EQ(AJ_OK, AJ_UnmarshalArgs(&msg, "u", &u));
+                order += (char)('0' + u);
+                AJ_CloseMsg(&msg);
+            } else {
+                AJ_Sleep(1);
+                ++wait;
+            }
+        }
+        return order;
+    }
+
+    AllJoynConfiguration config;
+};
+
+static void* CountWorkers(void* arg)
+{
+    *(uint32_t*)arg = AJ_GetNumWorkers();
+    return NULL;
+}
+
+TEST_F(WorkerPoolTest, InlineWithoutWorkers)
+{
+    handlers[0].flags = AJ_HANDLER_WORKER;
+    Call(2);
+    EXPECT_EQ(2u, handledOnCaller);
+    EXPECT_EQ("01", Replies(2));
+}
+
+TEST_F(WorkerPoolTest, RepliesFromWorkers)
+{
+    handlers[0].flags = AJ_HANDLER_WORKER;
+    ASSERT_EQ(AJ_OK, AJ_StartWorkers(4));
+    EXPECT_EQ(4u, AJ_GetNumWorkers());
+    Call(4);
+    std::string order = Replies(4);
+    EXPECT_EQ(0u, handledOnCaller);
+    EXPECT_EQ(4u, order.size());
+    EXPECT_NE(std::string::npos, order.find('0'));
+    EXPECT_NE(std::string::npos, order.find('3'));
+}
+
+TEST_F(WorkerPoolTest, OrderedReplies)
+{
+    handlers[0].flags = AJ_HANDLER_WORKER | AJ_HANDLER_ORDERED;
+    ASSERT_EQ(AJ_OK, AJ_StartWorkers(4));
+    Call(4);
+    EXPECT_EQ("0123", Replies(4));
+    EXPECT_EQ(0u, handledOnCaller);
+}
+
+TEST_F(WorkerPoolTest, HandlerWithoutFlag)
+{
+    handlers[0].flags = 0;
+    ASSERT_EQ(AJ_OK, AJ_StartWorkers(2));
+    Call(2);
+    EXPECT_EQ(2u, handledOnCaller);
+    EXPECT_EQ("01", Replies(2));
+}
+
+TEST_F(WorkerPoolTest, ReplySentOnCallersBus)
+{
+    AJ_BusAttachment otherBus;
+    uint8_t otherTx[1024];
+    uint8_t otherRx[1024];
+    AJ_Message msg;
+    size_t sent;
+    uint32_t wait;
+
+    memset(&otherBus, 0, sizeof(otherBus));
+    AJ_IOBufInit(&otherBus.sock.tx, otherTx, sizeof(otherTx), AJ_IO_BUF_TX, NULL);
+    AJ_IOBufInit(&otherBus.sock.rx, otherRx, sizeof(otherRx), AJ_IO_BUF_RX, NULL);
+    otherBus.sock.tx.send = OtherTxFunc;
+    otherBus.sock.rx.recv = OtherRxFunc;
+    otherWire.clear();
+    otherConsumed = 0;
+
+    handlers[0].flags = AJ_HANDLER_WORKER;
+    ASSERT_EQ(AJ_OK, AJ_StartWorkers(1));
+    ASSERT_EQ(AJ_OK, AJ_MarshalMethodCall(&bus, &msg, ECHO_CALL, ":1.1", 1, 0, 1000));
+    ASSERT_EQ(AJ_OK, AJ_MarshalArgs(&msg, "u", 4));
+    ASSERT_EQ(AJ_OK, AJ_DeliverMsg(&msg));
+    sent = wire.size();
+    ASSERT_EQ(AJ_OK, AJ_UnmarshalMsg(&otherBus, &msg, 0));
+    EXPECT_EQ(AJ_OK, AJ_DispatchMessage(&msg, &config));
+    AJ_CloseMsg(&msg);
+    /*
+     * The reply is only sent when completed calls are delivered for the bus the call came in on
+     */
+    for (wait = 0; otherWire.empty() && (wait < 1000); ++wait) {
+        AJ_Sleep(1);
+        EXPECT_EQ(AJ_OK, AJ_DeliverCompletedCalls(&bus));
+        EXPECT_EQ(sent, wire.size());
+        EXPECT_EQ(AJ_OK, AJ_DeliverCompletedCalls(&otherBus));
+    }
+    EXPECT_FALSE(otherWire.empty());
+    EXPECT_EQ(0u, handledOnCaller);
+}
+
+TEST_F(WorkerPoolTest, PoolBelongsToThread)
+{
+    pthread_t thread;
+    uint32_t num = 99;
+
+    ASSERT_EQ(AJ_OK, AJ_StartWorkers(2));
+    ASSERT_EQ(0, pthread_create(&thread, NULL, CountWorkers, &num));
+    pthread_join(thread, NULL);
+    EXPECT_EQ(0u, num);
+    EXPECT_EQ(2u, AJ_GetNumWorkers());
+}
+
+TEST_F(WorkerPoolTest, StartTwice)
+{
+    ASSERT_EQ(AJ_OK, AJ_StartWorkers(1));
+    EXPECT_EQ(AJ_ERR_UNEXPECTED, AJ_StartWorkers(1));
+    AJ_StopWorkers();
+    EXPECT_EQ(0u, AJ_GetNumWorkers());
+    EXPECT_EQ(AJ_ERR_INVALID, AJ_StartWorkers(0));
+}
+
+#endif